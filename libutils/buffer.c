@@ -323,6 +323,28 @@ void BufferAppendChar(Buffer *buffer, char byte)
     }
 }
 
+char *BufferReserve(Buffer *buffer, size_t length)
+{
+    assert(buffer != NULL);
+
+    /* Leaves space for the terminating '\0' (see ExpandIfNeeded()). */
+    ExpandIfNeeded(buffer, buffer->used + length);
+    return buffer->buffer + buffer->used;
+}
+
+void BufferCommit(Buffer *buffer, size_t length)
+{
+    assert(buffer != NULL);
+    assert(buffer->used + length < buffer->capacity);
+
+    if (buffer->mode == BUFFER_BEHAVIOR_CSTRING)
+    {
+        length = strnlen(buffer->buffer + buffer->used, length);
+    }
+    buffer->used += length;
+    buffer->buffer[buffer->used] = '\0';
+}
+
 void BufferAppendF(Buffer *buffer, const char *format, ...)
 {
     assert(buffer != NULL);
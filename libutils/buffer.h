@@ -144,6 +144,28 @@ void BufferAppend(Buffer *buffer, const char *bytes, size_t length);
   @param byte Char to be added to the buffer.
   */
 void BufferAppendChar(Buffer *buffer, char byte);
+
+/**
+  @brief Reserves space for appending #length bytes directly into the buffer's storage.
+
+  Use this to fill the buffer without an intermediate copy, e.g. by read(2). The data written to the
+  returned memory becomes part of the buffer only after BufferCommit() is called.
+  @note The returned pointer is invalidated by any other operation on the buffer.
+  @param buffer Buffer to be used.
+  @param length Number of bytes to reserve.
+  @return Pointer to (at least) #length writable bytes right after the current contents of the buffer.
+  */
+char *BufferReserve(Buffer *buffer, size_t length);
+
+/**
+  @brief Appends #length bytes previously written to the memory returned by BufferReserve().
+
+  In CString mode the data is only appended up to the first '\0'.
+  @param buffer Buffer to be used.
+  @param length Number of bytes written, must not exceed the reserved length.
+  */
+void BufferCommit(Buffer *buffer, size_t length);
+
 void BufferAppendF(Buffer *buffer, const char *format, ...);
 void BufferAppendString(Buffer *buffer, const char *str);
 
@@ -364,3 +364,442 @@ char *GetCsvLineNext(FILE *fp)
 
     return StringWriterClose(buffer);
 }
+
+/*********************************************************************/
+
+/* Initial size of the CsvReader buffer, it grows if a record doesn't fit. */
+#define CSV_READER_BLOCK_SIZE (256 * 1024)
+
+struct CsvReader_
+{
+    int fd;                     /* -1 if reading from memory */
+    bool eof;
+    bool drop_incomplete;       /* ignore data after the last complete record */
+
+    char *buffer;
+    size_t buffer_size;
+    size_t start;               /* start of the next record */
+    size_t end;                 /* end of the data read */
+
+    /* progress of the search for the end of the next record */
+    size_t scan_pos;            /* relative to #start */
+    bool scan_in_quotes;
+
+    StringRef *fields;
+    size_t fields_capacity;
+};
+
+CsvReader *CsvReaderNew(int fd)
+{
+    CsvReader *reader = xcalloc(1, sizeof(CsvReader));
+    reader->fd = fd;
+    reader->buffer_size = CSV_READER_BLOCK_SIZE;
+    reader->buffer = xmalloc(reader->buffer_size);
+    reader->fields_capacity = 16;
+    reader->fields = xmalloc(reader->fields_capacity * sizeof(StringRef));
+    return reader;
+}
+
+CsvReader *CsvReaderNewFromData(char *data, size_t len, bool at_end)
+{
+    assert(data != NULL);
+
+    CsvReader *reader = xcalloc(1, sizeof(CsvReader));
+    reader->fd = -1;
+    reader->eof = true;
+    reader->drop_incomplete = !at_end;
+    reader->buffer = data;
+    reader->buffer_size = len + 1;
+    reader->end = len;
+    reader->fields_capacity = 16;
+    reader->fields = xmalloc(reader->fields_capacity * sizeof(StringRef));
+    return reader;
+}
+
+void CsvReaderDestroy(CsvReader *reader)
+{
+    if (reader != NULL)
+    {
+        if (reader->fd >= 0)
+        {
+            free(reader->buffer);
+        }
+        free(reader->fields);
+        free(reader);
+    }
+}
+
+/**
+ * Looks for the end of the record at #data the same way GetCsvLineNext()
+ * does, i.e. for CRLF outside of quotes, skipping over the data with
+ * memchr() instead of looking at every character.
+ *
+ * @param pos, in_quotes Where to continue the search, updated so that it can
+ *                       be continued once more data is available.
+ * @return Whether the end was found, *pos is then the size of the record.
+ */
+static bool CsvFindRecordEnd(const char *data, size_t len, size_t *pos, bool *in_quotes)
+{
+    size_t i = *pos;
+    bool quoted = *in_quotes;
+
+    while (i < len)
+    {
+        if (quoted)
+        {
+            const char *quote = memchr(data + i, '"', len - i);
+            if (quote == NULL)
+            {
+                i = len;
+                break;
+            }
+            i = (quote - data) + 1;
+            quoted = false;
+            continue;
+        }
+
+        const char *nl = memchr(data + i, '\n', len - i);
+        const size_t line_end = (nl != NULL) ? (size_t) (nl - data) : len;
+        const char *quote = memchr(data + i, '"', line_end - i);
+        if (quote != NULL)
+        {
+            i = (quote - data) + 1;
+            quoted = true;
+            continue;
+        }
+        if (nl == NULL)
+        {
+            i = len;
+            break;
+        }
+
+        i = line_end + 1;
+        if ((line_end > 0) && (data[line_end - 1] == '\r'))
+        {
+            *pos = i;
+            *in_quotes = false;
+            return true;
+        }
+    }
+
+    *pos = i;
+    *in_quotes = quoted;
+    return false;
+}
+
+typedef enum
+{
+    CSV_FIELD_START,            /* CSV_ST_NEW_LINE, CSV_ST_SEPARATOR */
+    CSV_FIELD_LEADING_SPACE,    /* CSV_ST_PRE_START_SPACE */
+    CSV_FIELD_UNQUOTED,         /* CSV_ST_NO_QUOTE_MODE */
+    CSV_FIELD_QUOTED,           /* CSV_ST_LEADING_QUOTE, CSV_ST_WITH_QUOTE_MODE */
+    CSV_FIELD_QUOTE,            /* CSV_ST_INTERNAL_QUOTE */
+    CSV_FIELD_TRAILING_SPACE,   /* CSV_ST_SPACE_AFTER_QUOTE */
+} CsvFieldState;
+
+static void CsvReaderAddField(CsvReader *reader, size_t *num_fields,
+                              char *field, char *field_end)
+{
+    if (*num_fields == reader->fields_capacity)
+    {
+        reader->fields_capacity *= 2;
+        reader->fields = xrealloc(reader->fields,
+                                  reader->fields_capacity * sizeof(StringRef));
+    }
+
+    /* At most over the separator, see CsvReaderParseRecord(). */
+    *field_end = '\0';
+    reader->fields[*num_fields].data = field;
+    reader->fields[*num_fields].len = field_end - field;
+    (*num_fields)++;
+}
+
+/**
+ * Splits the record into fields like LaunchCsvAutomata() does, but in place:
+ * the unquoted data of the fields is written over the record (it's never
+ * longer than the input) and terminated with a NUL byte where the separator
+ * (or something before it) was.
+ *
+ * @warning data[len] must be writable.
+ */
+static bool CsvReaderParseRecord(CsvReader *reader, char *data, size_t len,
+                                 size_t *num_fields)
+{
+    /* LaunchCsvAutomata() stops at the first NUL byte */
+    const char *nul = memchr(data, '\0', len);
+    const char *const end = (nul != NULL) ? nul : data + len;
+
+    const char *in = data;
+    char *out = data;
+    char *field = out;
+    CsvFieldState state = CSV_FIELD_START;
+    *num_fields = 0;
+
+    while (in < end)
+    {
+        const char c = *(in++);
+        switch (state)
+        {
+        case CSV_FIELD_START:
+        case CSV_FIELD_LEADING_SPACE:
+            if (CSVCL_SEP(c))
+            {
+                CsvReaderAddField(reader, num_fields, field, out);
+                field = ++out;
+                state = CSV_FIELD_START;
+            }
+            else if (CSVCL_QUOTE(c))
+            {
+                /* leading space before a quote is dropped */
+                out = field;
+                state = CSV_FIELD_QUOTED;
+            }
+            else
+            {
+                *(out++) = c;
+                state = CSVCL_BLANK(c) ? CSV_FIELD_LEADING_SPACE : CSV_FIELD_UNQUOTED;
+            }
+            break;
+
+        case CSV_FIELD_UNQUOTED:
+            if (CSVCL_SEP(c))
+            {
+                CsvReaderAddField(reader, num_fields, field, out);
+                field = ++out;
+                state = CSV_FIELD_START;
+            }
+            else if (CSVCL_QUOTE(c))
+            {
+                return false;
+            }
+            else
+            {
+                /* copy the rest of the plain data in one go */
+                const char *plain = in - 1;
+                while ((in < end) && !CSVCL_SEP(*in) && !CSVCL_QUOTE(*in))
+                {
+                    in++;
+                }
+                if (out != plain)
+                {
+                    memmove(out, plain, in - plain);
+                }
+                out += in - plain;
+            }
+            break;
+
+        case CSV_FIELD_QUOTED:
+            if (CSVCL_QUOTE(c))
+            {
+                state = CSV_FIELD_QUOTE;
+            }
+            else
+            {
+                const char *plain = in - 1;
+                while ((in < end) && !CSVCL_QUOTE(*in))
+                {
+                    in++;
+                }
+                if (out != plain)
+                {
+                    memmove(out, plain, in - plain);
+                }
+                out += in - plain;
+            }
+            break;
+
+        case CSV_FIELD_QUOTE:
+            if (CSVCL_SEP(c))
+            {
+                CsvReaderAddField(reader, num_fields, field, out);
+                field = ++out;
+                state = CSV_FIELD_START;
+            }
+            else if (CSVCL_BLANK(c))
+            {
+                state = CSV_FIELD_TRAILING_SPACE;
+            }
+            else if (CSVCL_QUOTE(c))
+            {
+                /* escaped quote */
+                *(out++) = c;
+                state = CSV_FIELD_QUOTED;
+            }
+            else
+            {
+                return false;
+            }
+            break;
+
+        case CSV_FIELD_TRAILING_SPACE:
+            if (CSVCL_SEP(c))
+            {
+                CsvReaderAddField(reader, num_fields, field, out);
+                field = ++out;
+                state = CSV_FIELD_START;
+            }
+            else if (!CSVCL_BLANK(c))
+            {
+                return false;
+            }
+            break;
+        }
+    }
+
+    if (state == CSV_FIELD_QUOTED)
+    {
+        /* unterminated quote */
+        return false;
+    }
+
+    /* Trim trailing CRLF. */
+    if ((state == CSV_FIELD_UNQUOTED || state == CSV_FIELD_LEADING_SPACE) &&
+        (out - field > 1) && (out[-2] == '\r') && (out[-1] == '\n'))
+    {
+        out -= 2;
+    }
+
+    /* out can only be at data + len here if the record doesn't end with CRLF,
+     * i.e. at the end of the input, where there's always an extra byte. */
+    CsvReaderAddField(reader, num_fields, field, out);
+    return true;
+}
+
+/**
+ * Reads more data into the buffer, moving the unprocessed data to the front
+ * and growing the buffer if it's full.
+ *
+ * @return Whether data was read (false at EOF or on error).
+ */
+static bool CsvReaderFill(CsvReader *reader, bool *error)
+{
+    if (reader->start > 0)
+    {
+        memmove(reader->buffer, reader->buffer + reader->start,
+                reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+
+    /* Always keep one byte for the terminating NUL of the last field. */
+    if (reader->end + 1 >= reader->buffer_size)
+    {
+        reader->buffer_size *= 2;
+        reader->buffer = xrealloc(reader->buffer, reader->buffer_size);
+    }
+
+    ssize_t n_read;
+    do
+    {
+        n_read = read(reader->fd, reader->buffer + reader->end,
+                      reader->buffer_size - reader->end - 1);
+    } while ((n_read < 0) && (errno == EINTR));
+
+    if (n_read < 0)
+    {
+        *error = true;
+        return false;
+    }
+    if (n_read == 0)
+    {
+        reader->eof = true;
+        return false;
+    }
+
+    reader->end += n_read;
+    return true;
+}
+
+CsvRecordStatus CsvReaderNext(CsvReader *reader, CsvRecord *record)
+{
+    assert(reader != NULL);
+    assert(record != NULL);
+
+    size_t size;
+    while (true)
+    {
+        const size_t available = reader->end - reader->start;
+        if (CsvFindRecordEnd(reader->buffer + reader->start, available,
+                             &reader->scan_pos, &reader->scan_in_quotes))
+        {
+            size = reader->scan_pos;
+            break;
+        }
+
+        bool error = false;
+        if (reader->eof || !CsvReaderFill(reader, &error))
+        {
+            if (error)
+            {
+                return CSV_RECORD_ERROR;
+            }
+            if ((reader->end == reader->start) || reader->drop_incomplete)
+            {
+                return CSV_RECORD_EOF;
+            }
+
+            /* the rest of the data is the last record */
+            size = reader->end - reader->start;
+            break;
+        }
+    }
+
+    char *data = reader->buffer + reader->start;
+    reader->start += size;
+    reader->scan_pos = 0;
+    reader->scan_in_quotes = false;
+
+    record->size = size;
+    if (!CsvReaderParseRecord(reader, data, size, &record->num_fields))
+    {
+        record->num_fields = 0;
+        record->fields = NULL;
+        return CSV_RECORD_MALFORMED;
+    }
+    record->fields = reader->fields;
+    return CSV_RECORD_OK;
+}
+
+Seq *CsvRecordToSeq(const CsvRecord *record)
+{
+    assert(record != NULL);
+
+    Seq *fields = SeqNew(record->num_fields, free);
+    for (size_t i = 0; i < record->num_fields; i++)
+    {
+        SeqAppend(fields, xstrndup(record->fields[i].data, record->fields[i].len));
+    }
+    return fields;
+}
+
+void CsvSplitData(const char *data, size_t len, size_t n_chunks, size_t *chunk_ends)
+{
+    assert(data != NULL);
+    assert(n_chunks > 0);
+    assert(chunk_ends != NULL);
+
+    /* Whether a position is inside quotes only depends on the number of
+     * quotes before it (see GetCsvLineNext()), counting them is much cheaper
+     * than splitting the data into records. */
+    size_t pos = 0;
+    bool in_quotes = false;
+    for (size_t i = 0; i < n_chunks - 1; i++)
+    {
+        size_t target = MAX(pos, (len / n_chunks) * (i + 1));
+        for (const char *quote = memchr(data + pos, '"', target - pos);
+             quote != NULL;
+             quote = memchr(quote + 1, '"', (data + target) - (quote + 1)))
+        {
+            in_quotes = !in_quotes;
+        }
+        pos = target;
+
+        if (!CsvFindRecordEnd(data, len, &pos, &in_quotes))
+        {
+            /* no more record ends, the rest is one (incomplete) record */
+            pos = len;
+        }
+        chunk_ends[i] = pos;
+    }
+    chunk_ends[n_chunks - 1] = len;
+}
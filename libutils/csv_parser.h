@@ -25,7 +25,71 @@
 #define CFENGINE_CSV_PARSER_H
 
 #include <sequence.h>
+#include <string_lib.h>                                       /* StringRef */
 
 Seq *SeqParseCsvString(const char *string);
 char *GetCsvLineNext(FILE *fp);
+
+/**
+ * Block-buffered CSV reader.
+ *
+ * Reads big blocks of data and splits them into records the same way
+ * GetCsvLineNext() does (records end with CRLF outside of quotes) and the
+ * records into fields the same way SeqParseCsvString() does. The fields are
+ * returned as slices of the internal buffer, nothing is allocated per record
+ * or field.
+ */
+typedef struct CsvReader_ CsvReader;
+
+typedef struct
+{
+    size_t size;                /* size of the record in the input (with CRLF) */
+    size_t num_fields;
+    const StringRef *fields;    /* each field is also '\0'-terminated */
+} CsvRecord;
+
+typedef enum
+{
+    CSV_RECORD_OK,
+    CSV_RECORD_MALFORMED,       /* only #size of the record is set */
+    CSV_RECORD_EOF,
+    CSV_RECORD_ERROR,           /* failed to read the input */
+} CsvRecordStatus;
+
+/**
+ * @param fd File descriptor to read from, not closed by CsvReaderDestroy().
+ */
+CsvReader *CsvReaderNew(int fd);
+
+/**
+ * @brief Create a reader for CSV data in memory.
+ * @param data The data, modified while reading. data[len] must be writable.
+ * @param at_end Whether the data is the end of the input. If not, data after
+ *               the last complete record is ignored.
+ */
+CsvReader *CsvReaderNewFromData(char *data, size_t len, bool at_end);
+
+void CsvReaderDestroy(CsvReader *reader);
+
+/**
+ * @brief Read the next record.
+ * @note The data in #record is only valid until the next call.
+ */
+CsvRecordStatus CsvReaderNext(CsvReader *reader, CsvRecord *record);
+
+/**
+ * @brief Copy the fields of a record into a new sequence of strings.
+ */
+Seq *CsvRecordToSeq(const CsvRecord *record);
+
+/**
+ * @brief Split CSV data into chunks of roughly the same size at record
+ *        boundaries, for parsing them separately.
+ * @param chunk_ends Array of #n_chunks items to store the ends of the chunks
+ *                   to; chunk i is [chunk_ends[i - 1], chunk_ends[i]) and may
+ *                   be empty. Any chunk can end at #len, not only the last
+ *                   one, when a record spans several split points.
+ */
+void CsvSplitData(const char *data, size_t len, size_t n_chunks, size_t *chunk_ends);
+
 #endif
@@ -26,16 +26,22 @@
 
 #include <alloc.h>
 
+/* Output is collected in a buffer of this size and passed on to the
+ * underlying writer when full. */
+#define CSV_WRITER_BUFFER_SIZE 8192
+
 struct CsvWriter_
 {
     Writer *w;
     bool beginning_of_line;
     bool terminate_last_line;
+    size_t used;
+    char buffer[CSV_WRITER_BUFFER_SIZE];
 };
 
 /*****************************************************************************/
 
-static void WriteCsvEscapedString(Writer *w, const char *str);
+static void CsvWriterAppendEscaped(CsvWriter *csvw, const char *str, size_t len);
 static void CsvWriterFieldVF(CsvWriter * csvw, const char *fmt, va_list ap) FUNC_ATTR_PRINTF(2, 0);
 
 /*****************************************************************************/
@@ -47,6 +53,7 @@ CsvWriter *CsvWriterOpenSpecifyTerminate(Writer *w, bool terminate_last_line)
     csvw->w = w;
     csvw->beginning_of_line = true;
     csvw->terminate_last_line = terminate_last_line;
+    csvw->used = 0;
     return csvw;
 }
 
@@ -57,29 +64,118 @@ CsvWriter *CsvWriterOpen(Writer *w)
 
 /*****************************************************************************/
 
-void CsvWriterField(CsvWriter * csvw, const char *str)
+void CsvWriterFlush(CsvWriter *csvw)
 {
     assert(csvw != NULL);
 
+    if (csvw->used > 0)
+    {
+        WriterWriteBytes(csvw->w, csvw->buffer, csvw->used);
+        csvw->used = 0;
+    }
+}
+
+static void CsvWriterAppend(CsvWriter *csvw, const char *data, size_t len)
+{
+    if (len > CSV_WRITER_BUFFER_SIZE - csvw->used)
+    {
+        CsvWriterFlush(csvw);
+        if (len >= CSV_WRITER_BUFFER_SIZE)
+        {
+            /* no point in copying it to the buffer */
+            WriterWriteBytes(csvw->w, data, len);
+            return;
+        }
+    }
+    if (len > 0)
+    {
+        /* data may be NULL for empty fields */
+        memcpy(csvw->buffer + csvw->used, data, len);
+        csvw->used += len;
+    }
+}
+
+static inline void CsvWriterAppendChar(CsvWriter *csvw, char c)
+{
+    if (csvw->used == CSV_WRITER_BUFFER_SIZE)
+    {
+        CsvWriterFlush(csvw);
+    }
+    csvw->buffer[csvw->used++] = c;
+}
+
+/*****************************************************************************/
+
+/* Word-at-a-time check for bytes with the given value, see "Determine if a
+ * word has a byte equal to n" in Bit Twiddling Hacks. */
+#define CSV_ONES UINT64_C(0x0101010101010101)
+#define CSV_HAS_ZERO_BYTE(v) (((v) - CSV_ONES) & ~(v) & (CSV_ONES * 0x80))
+#define CSV_HAS_BYTE(v, c) CSV_HAS_ZERO_BYTE((v) ^ (CSV_ONES * (uint8_t) (c)))
+
+static inline bool CsvIsSpecialChar(char c)
+{
+    return (c == '"') || (c == ',') || (c == '\r') || (c == '\n');
+}
+
+/**
+ * @return Whether the field has to be quoted, checking 8 bytes at a time.
+ */
+static bool CsvFieldNeedsQuoting(const char *str, size_t len)
+{
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t v;
+        memcpy(&v, str + i, sizeof(v));
+        if (CSV_HAS_BYTE(v, '"') | CSV_HAS_BYTE(v, ',') |
+            CSV_HAS_BYTE(v, '\r') | CSV_HAS_BYTE(v, '\n'))
+        {
+            return true;
+        }
+    }
+    for (; i < len; i++)
+    {
+        if (CsvIsSpecialChar(str[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CsvWriterFieldLen(CsvWriter *csvw, const char *str, size_t len)
+{
+    assert(csvw != NULL);
+    assert(str != NULL || len == 0);
+
+    /* Like the underlying writer, stop at NUL bytes. */
+    len = (len > 0) ? strnlen(str, len) : 0;
+
     if (csvw->beginning_of_line)
     {
         csvw->beginning_of_line = false;
     }
     else
     {
-        WriterWriteChar(csvw->w, ',');
+        CsvWriterAppendChar(csvw, ',');
     }
 
-    if (strpbrk(str, "\",\r\n"))
+    if (CsvFieldNeedsQuoting(str, len))
     {
-        WriteCsvEscapedString(csvw->w, str);
+        CsvWriterAppendEscaped(csvw, str, len);
     }
     else
     {
-        WriterWrite(csvw->w, str);
+        CsvWriterAppend(csvw, str, len);
     }
 }
 
+void CsvWriterField(CsvWriter * csvw, const char *str)
+{
+    assert(str != NULL);
+    CsvWriterFieldLen(csvw, str, strlen(str));
+}
+
 /*****************************************************************************/
 
 void CsvWriterFieldF(CsvWriter * csvw, const char *fmt, ...)
@@ -97,20 +193,47 @@ void CsvWriterNewRecord(CsvWriter * csvw)
 {
     assert(csvw != NULL);
 
-    WriterWrite(csvw->w, "\r\n");
+    CsvWriterAppend(csvw, "\r\n", 2);
     csvw->beginning_of_line = true;
 }
 
 /*****************************************************************************/
 
+void CsvWriterRecord(CsvWriter *csvw, const char *const *fields, size_t num_fields)
+{
+    assert(csvw != NULL);
+    assert(fields != NULL || num_fields == 0);
+
+    for (size_t i = 0; i < num_fields; i++)
+    {
+        CsvWriterField(csvw, fields[i]);
+    }
+    CsvWriterNewRecord(csvw);
+}
+
+void CsvWriterRecordSlices(CsvWriter *csvw, const StringRef *fields, size_t num_fields)
+{
+    assert(csvw != NULL);
+    assert(fields != NULL || num_fields == 0);
+
+    for (size_t i = 0; i < num_fields; i++)
+    {
+        CsvWriterFieldLen(csvw, fields[i].data, fields[i].len);
+    }
+    CsvWriterNewRecord(csvw);
+}
+
+/*****************************************************************************/
+
 void CsvWriterClose(CsvWriter * csvw)
 {
     assert(csvw != NULL);
 
     if (!csvw->beginning_of_line && csvw->terminate_last_line)
     {
-        WriterWrite(csvw->w, "\r\n");
+        CsvWriterAppend(csvw, "\r\n", 2);
     }
+    CsvWriterFlush(csvw);
     free(csvw);
 }
 
@@ -132,23 +255,30 @@ static void CsvWriterFieldVF(CsvWriter * csvw, const char *fmt, va_list ap)
 
 /*****************************************************************************/
 
-static void WriteCsvEscapedString(Writer *w, const char *s)
+static void CsvWriterAppendEscaped(CsvWriter *csvw, const char *str, size_t len)
 {
-    WriterWriteChar(w, '"');
-    while (*s)
+    CsvWriterAppendChar(csvw, '"');
+
+    /* copy everything up to and including each quote, then double it */
+    const char *quote;
+    while ((quote = memchr(str, '"', len)) != NULL)
     {
-        if (*s == '"')
-        {
-            WriterWriteChar(w, '"');
-        }
-        WriterWriteChar(w, *s);
-        s++;
+        size_t run = (quote - str) + 1;
+        CsvWriterAppend(csvw, str, run);
+        CsvWriterAppendChar(csvw, '"');
+        str += run;
+        len -= run;
     }
-    WriterWriteChar(w, '"');
+    CsvWriterAppend(csvw, str, len);
+
+    CsvWriterAppendChar(csvw, '"');
 }
 
 Writer *CsvWriterGetWriter(CsvWriter *csvw)
 {
     assert(csvw != NULL);
+
+    /* The caller may write to it directly. */
+    CsvWriterFlush(csvw);
     return csvw->w;
 }
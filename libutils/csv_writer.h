@@ -26,9 +26,14 @@
 
 /*
  * This writer implements CSV as in RFC 4180
+ *
+ * The output is buffered, it is passed on to the underlying writer when the
+ * buffer is full, on CsvWriterFlush(), CsvWriterGetWriter() and
+ * CsvWriterClose().
  */
 
 #include <writer.h>
+#include <string_lib.h>                                       /* StringRef */
 
 typedef struct CsvWriter_ CsvWriter;
 
@@ -36,15 +41,26 @@ CsvWriter *CsvWriterOpenSpecifyTerminate(Writer *w, bool terminate_last_line);
 CsvWriter *CsvWriterOpen(Writer *w);
 
 void CsvWriterField(CsvWriter *csvw, const char *str);
+void CsvWriterFieldLen(CsvWriter *csvw, const char *str, size_t len);
 void CsvWriterFieldF(CsvWriter *csvw, const char *fmt, ...) FUNC_ATTR_PRINTF(2, 3);
 
 void CsvWriterNewRecord(CsvWriter *csvw);
 
+/**
+ * @brief Write the fields and end the record.
+ */
+void CsvWriterRecord(CsvWriter *csvw, const char *const *fields, size_t num_fields);
+void CsvWriterRecordSlices(CsvWriter *csvw, const StringRef *fields, size_t num_fields);
+
+/* Pass the buffered output on to the underlying Writer */
+void CsvWriterFlush(CsvWriter *csvw);
+
 /* Does not close underlying Writer, but flushes all pending data */
 void CsvWriterClose(CsvWriter *csvw);
 
 /**
- * @return The instance of the underlying writer
+ * @return The instance of the underlying writer (with all pending data
+ *         flushed to it)
  */
 Writer *CsvWriterGetWriter(CsvWriter *csvw);
 
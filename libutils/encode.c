@@ -21,46 +21,470 @@
   included file COSL.txt.
 */
 
-
 #include <platform.h>
-
-#include <openssl/buffer.h>                                 /* BUF_MEM */
-#include <openssl/bio.h>                                    /* BIO_* */
-#include <openssl/evp.h>                                    /* BIO_f_base64 */
+#include <encode.h>
 
 #include <alloc.h>
 
+static const char BASE64_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Characters with a special meaning in BASE64_DECODE, all the others have
+ * their 6-bit value. */
+#define B64_INVALID    0x80
+#define B64_WHITESPACE 0x81
+#define B64_PADDING    0x82
+
+static const unsigned char BASE64_DECODE[256] =
+{
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x81, 0x81, 0x81, 0x81, 0x81, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x81, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x80, 0x80, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x82, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+/* Characters per encoded group */
+#define GROUP_CHARS 4
+
+/* Input processed per Base64EncoderWrite() chunk (a multiple of 3) */
+#define WRITE_CHUNK_SIZE (48 * 1024)
+
+/*********************************************************************/
+/* Encoding                                                          */
+/*********************************************************************/
+
+static inline char *EncodeGroup(const unsigned char *in, char *out)
+{
+    const uint32_t v = ((uint32_t) in[0] << 16) | ((uint32_t) in[1] << 8) | in[2];
+    out[0] = BASE64_ALPHABET[v >> 18];
+    out[1] = BASE64_ALPHABET[(v >> 12) & 0x3F];
+    out[2] = BASE64_ALPHABET[(v >> 6) & 0x3F];
+    out[3] = BASE64_ALPHABET[v & 0x3F];
+    return out + GROUP_CHARS;
+}
+
+/* All the pairs of characters, indexed by 12 bits of input. Encoding with
+ * two lookups per 3 bytes instead of four is about twice as fast. */
+static char base64_pairs[4096][2]; /* GLOBAL_X */
+static pthread_once_t base64_pairs_once = PTHREAD_ONCE_INIT; /* GLOBAL_T */
+
+static void Base64PairsInit(void)
+{
+    for (size_t i = 0; i < 4096; i++)
+    {
+        base64_pairs[i][0] = BASE64_ALPHABET[i >> 6];
+        base64_pairs[i][1] = BASE64_ALPHABET[i & 0x3F];
+    }
+}
+
+static char *EncodeGroups(const unsigned char *in, size_t n_groups, char *out)
+{
+    pthread_once(&base64_pairs_once, Base64PairsInit);
+
+    for (; n_groups >= 2; n_groups -= 2, in += 6)
+    {
+        const uint32_t v1 = ((uint32_t) in[0] << 16) | ((uint32_t) in[1] << 8) | in[2];
+        const uint32_t v2 = ((uint32_t) in[3] << 16) | ((uint32_t) in[4] << 8) | in[5];
+        memcpy(out, base64_pairs[v1 >> 12], 2);
+        memcpy(out + 2, base64_pairs[v1 & 0xFFF], 2);
+        memcpy(out + 4, base64_pairs[v2 >> 12], 2);
+        memcpy(out + 6, base64_pairs[v2 & 0xFFF], 2);
+        out += 2 * GROUP_CHARS;
+    }
+    if (n_groups == 1)
+    {
+        out = EncodeGroup(in, out);
+    }
+    return out;
+}
+
+/**
+ * @brief Encode whole groups, breaking lines if requested.
+ */
+static char *EncoderPutGroups(Base64Encoder *encoder, const unsigned char *in,
+                              size_t n_groups, char *out)
+{
+    if (encoder->line_length == 0)
+    {
+        return EncodeGroups(in, n_groups, out);
+    }
+
+    while (n_groups > 0)
+    {
+        if (encoder->column == encoder->line_length)
+        {
+            *(out++) = '\n';
+            encoder->column = 0;
+        }
+        size_t n = (encoder->line_length - encoder->column) / GROUP_CHARS;
+        if (n > n_groups)
+        {
+            n = n_groups;
+        }
+        out = EncodeGroups(in, n, out);
+        in += 3 * n;
+        n_groups -= n;
+        encoder->column += n * GROUP_CHARS;
+    }
+    return out;
+}
+
+void Base64EncoderInit(Base64Encoder *encoder, size_t line_length)
+{
+    assert(encoder != NULL);
+    assert(line_length % GROUP_CHARS == 0);
+
+    encoder->n_pending = 0;
+    encoder->line_length = line_length;
+    encoder->column = 0;
+}
+
+size_t Base64EncoderMaxSize(const Base64Encoder *encoder, size_t len)
+{
+    assert(encoder != NULL);
+
+    const size_t chars = ((encoder->n_pending + len) / 3) * GROUP_CHARS;
+    if (encoder->line_length == 0)
+    {
+        return chars;
+    }
+    return chars + (encoder->column + chars) / encoder->line_length;
+}
+
+size_t Base64EncoderUpdate(Base64Encoder *encoder, const void *data, size_t len,
+                           char *out)
+{
+    assert(encoder != NULL);
+    assert(data != NULL || len == 0);
+    assert(out != NULL);
+
+    const unsigned char *in = data;
+    char *const start = out;
+
+    if (encoder->n_pending > 0)
+    {
+        while (encoder->n_pending < 3 && len > 0)
+        {
+            encoder->pending[encoder->n_pending++] = *(in++);
+            len--;
+        }
+        if (encoder->n_pending < 3)
+        {
+            return 0;
+        }
+        out = EncoderPutGroups(encoder, encoder->pending, 1, out);
+        encoder->n_pending = 0;
+    }
+
+    const size_t n_groups = len / 3;
+    out = EncoderPutGroups(encoder, in, n_groups, out);
+    in += 3 * n_groups;
+    len -= 3 * n_groups;
+
+    memcpy(encoder->pending, in, len);
+    encoder->n_pending = len;
+
+    return out - start;
+}
+
+size_t Base64EncoderFinal(Base64Encoder *encoder, char *out)
+{
+    assert(encoder != NULL);
+    assert(out != NULL);
+
+    if (encoder->n_pending == 0)
+    {
+        return 0;
+    }
+
+    char *const start = out;
+    if (encoder->line_length != 0 && encoder->column == encoder->line_length)
+    {
+        *(out++) = '\n';
+        encoder->column = 0;
+    }
+
+    unsigned char group[3] = { 0 };
+    memcpy(group, encoder->pending, encoder->n_pending);
+    EncodeGroup(group, out);
+    /* 1 byte -> 2 chars + "==", 2 bytes -> 3 chars + "=" */
+    for (size_t i = encoder->n_pending + 1; i < GROUP_CHARS; i++)
+    {
+        out[i] = '=';
+    }
+    out += GROUP_CHARS;
+    encoder->column += GROUP_CHARS;
+    encoder->n_pending = 0;
+
+    return out - start;
+}
+
+void Base64EncoderWrite(Base64Encoder *encoder, Writer *writer,
+                        const void *data, size_t len)
+{
+    assert(encoder != NULL);
+    assert(writer != NULL);
+    assert(data != NULL || len == 0);
+
+    const unsigned char *in = data;
+    while (len > 0)
+    {
+        const size_t chunk = (len < WRITE_CHUNK_SIZE) ? len : WRITE_CHUNK_SIZE;
+        char *out = WriterReserve(writer, Base64EncoderMaxSize(encoder, chunk));
+        WriterCommit(writer, Base64EncoderUpdate(encoder, in, chunk, out));
+        in += chunk;
+        len -= chunk;
+    }
+}
+
+void Base64EncoderWriteFinal(Base64Encoder *encoder, Writer *writer)
+{
+    assert(encoder != NULL);
+    assert(writer != NULL);
+
+    char out[BASE64_ENCODER_FINAL_MAX_SIZE];
+    const size_t len = Base64EncoderFinal(encoder, out);
+    WriterWriteBytes(writer, out, len);
+}
+
+size_t Base64Encode(const void *data, size_t len, char *out)
+{
+    assert(data != NULL || len == 0);
+    assert(out != NULL);
+
+    Base64Encoder encoder;
+    Base64EncoderInit(&encoder, 0);
+    size_t out_len = Base64EncoderUpdate(&encoder, data, len, out);
+    out_len += Base64EncoderFinal(&encoder, out + out_len);
+    out[out_len] = '\0';
+    return out_len;
+}
 
 char *StringEncodeBase64(const char *str, size_t len)
 {
-    assert(str);
-    if (!str)
+    assert(str != NULL);
+    if (str == NULL)
     {
         return NULL;
     }
 
-    if (len == 0)
+    Base64Encoder encoder;
+    Base64EncoderInit(&encoder, 64);
+    char *out = xmalloc(Base64EncoderMaxSize(&encoder, len) +
+                        BASE64_ENCODER_FINAL_MAX_SIZE + 1);
+    size_t out_len = Base64EncoderUpdate(&encoder, str, len, out);
+    out_len += Base64EncoderFinal(&encoder, out + out_len);
+    out[out_len] = '\0';
+    return out;
+}
+
+/*********************************************************************/
+/* Decoding                                                          */
+/*********************************************************************/
+
+void Base64DecoderInit(Base64Decoder *decoder)
+{
+    assert(decoder != NULL);
+
+    decoder->bits = 0;
+    decoder->n_chars = 0;
+    decoder->padding_left = 0;
+    decoder->done = false;
+    decoder->error = false;
+}
+
+/**
+ * @brief Write the bytes from the pending characters of an incomplete
+ *        group (2 or 3 characters).
+ */
+static unsigned char *DecoderPutPartial(Base64Decoder *decoder, unsigned char *out)
+{
+    assert(decoder->n_chars == 2 || decoder->n_chars == 3);
+
+    if (decoder->n_chars == 2)
+    {
+        *(out++) = decoder->bits >> 4;
+    }
+    else
+    {
+        *(out++) = decoder->bits >> 10;
+        *(out++) = decoder->bits >> 2;
+    }
+    decoder->bits = 0;
+    decoder->n_chars = 0;
+    return out;
+}
+
+bool Base64DecoderUpdate(Base64Decoder *decoder, const char *str, size_t len,
+                         void *out_buf, size_t *out_len)
+{
+    assert(decoder != NULL);
+    assert(str != NULL || len == 0);
+    assert(out_buf != NULL);
+    assert(out_len != NULL);
+
+    *out_len = 0;
+    if (decoder->error)
     {
-        return xcalloc(1, sizeof(char));
+        return false;
     }
 
-    BIO *b64 = BIO_new(BIO_f_base64());
-    BIO *bio = BIO_new(BIO_s_mem());
-    b64 = BIO_push(b64, bio);
-    BIO_write(b64, str, len);
-    if (!BIO_flush(b64))
+    const unsigned char *in = (const unsigned char *) str;
+    const unsigned char *const end = in + len;
+    unsigned char *out = out_buf;
+
+    while (in < end)
     {
-        assert(false && "Unable to encode string to base64" && str);
-        return NULL;
+        if (decoder->n_chars == 0 && !decoder->done)
+        {
+            /* Whole groups without whitespace or padding, the values are
+             * OR-ed together so that a single check catches all the special
+             * characters. */
+            while (end - in >= GROUP_CHARS)
+            {
+                const unsigned char a = BASE64_DECODE[in[0]];
+                const unsigned char b = BASE64_DECODE[in[1]];
+                const unsigned char c = BASE64_DECODE[in[2]];
+                const unsigned char d = BASE64_DECODE[in[3]];
+                if (((a | b | c | d) & B64_INVALID) != 0)
+                {
+                    break;
+                }
+                const uint32_t v = ((uint32_t) a << 18) | ((uint32_t) b << 12) |
+                                   ((uint32_t) c << 6) | d;
+                out[0] = v >> 16;
+                out[1] = v >> 8;
+                out[2] = v;
+                out += 3;
+                in += GROUP_CHARS;
+            }
+            if (in == end)
+            {
+                break;
+            }
+        }
+
+        const unsigned char value = BASE64_DECODE[*(in++)];
+        if (value < 64)
+        {
+            if (decoder->done)
+            {
+                decoder->error = true;
+                break;
+            }
+            decoder->bits = (decoder->bits << 6) | value;
+            if (++decoder->n_chars == GROUP_CHARS)
+            {
+                out[0] = decoder->bits >> 16;
+                out[1] = decoder->bits >> 8;
+                out[2] = decoder->bits;
+                out += 3;
+                decoder->bits = 0;
+                decoder->n_chars = 0;
+            }
+        }
+        else if (value == B64_WHITESPACE)
+        {
+            continue;
+        }
+        else if (value == B64_PADDING)
+        {
+            if (decoder->done)
+            {
+                if (decoder->padding_left == 0)
+                {
+                    decoder->error = true;
+                    break;
+                }
+                decoder->padding_left--;
+            }
+            else
+            {
+                if (decoder->n_chars < 2)
+                {
+                    decoder->error = true;
+                    break;
+                }
+                decoder->padding_left = GROUP_CHARS - decoder->n_chars - 1;
+                decoder->done = true;
+                out = DecoderPutPartial(decoder, out);
+            }
+        }
+        else
+        {
+            decoder->error = true;
+            break;
+        }
     }
 
-    BUF_MEM *buffer = NULL;
-    BIO_get_mem_ptr(b64, &buffer);
-    char *out = xcalloc(1, buffer->length);
-    memcpy(out, buffer->data, buffer->length - 1);
-    out[buffer->length - 1] = '\0';
+    *out_len = out - (unsigned char *) out_buf;
+    return !decoder->error;
+}
+
+bool Base64DecoderFinal(Base64Decoder *decoder, void *out, size_t *out_len)
+{
+    assert(decoder != NULL);
+    assert(out != NULL);
+    assert(out_len != NULL);
 
-    BIO_free_all(b64);
+    *out_len = 0;
+    if (decoder->error || decoder->padding_left > 0 || decoder->n_chars == 1)
+    {
+        decoder->error = true;
+        return false;
+    }
 
+    if (decoder->n_chars > 0)
+    {
+        /* unpadded input */
+        unsigned char *end = DecoderPutPartial(decoder, out);
+        *out_len = end - (unsigned char *) out;
+    }
+    return true;
+}
+
+ssize_t Base64Decode(const char *str, size_t len, void *out)
+{
+    assert(str != NULL || len == 0);
+    assert(out != NULL);
+
+    Base64Decoder decoder;
+    Base64DecoderInit(&decoder);
+
+    size_t out_len, final_len;
+    if (!Base64DecoderUpdate(&decoder, str, len, out, &out_len) ||
+        !Base64DecoderFinal(&decoder, (unsigned char *) out + out_len, &final_len))
+    {
+        return -1;
+    }
+    return out_len + final_len;
+}
+
+char *StringDecodeBase64(const char *str, size_t len, size_t *out_len)
+{
+    assert(str != NULL || len == 0);
+    assert(out_len != NULL);
+
+    char *out = xmalloc(BASE64_DECODED_MAX_SIZE(len) + 1);
+    const ssize_t decoded = Base64Decode(str, len, out);
+    if (decoded < 0)
+    {
+        free(out);
+        return NULL;
+    }
+    out[decoded] = '\0';
+    *out_len = decoded;
     return out;
 }
@@ -21,11 +21,135 @@
   included file COSL.txt.
 */
 
-
 #ifndef CFENGINE_ENCODE_H
 #define CFENGINE_ENCODE_H
 
+#include <platform.h>
+#include <writer.h>
+
+/**
+ * @brief Base64 encode #len bytes of #str, with a line break after every
+ *        64 characters (like OpenSSL's base64 BIO).
+ * @return NUL-terminated result, caller must free it
+ */
 char *StringEncodeBase64(const char *str, size_t len);
 
+/**
+ * @brief Decode Base64 #str of #len characters (whitespace is ignored,
+ *        padding is optional).
+ * @param out_len where to store the length of the result (the result is
+ *                NUL-terminated too)
+ * @return decoded data (caller must free it) or NULL if #str is not valid
+ *         Base64
+ */
+char *StringDecodeBase64(const char *str, size_t len, size_t *out_len);
+
+/* Output size of encoding #len bytes without line breaks */
+#define BASE64_ENCODED_SIZE(len) ((((len) + 2) / 3) * 4)
+
+/* Maximum output size of decoding #len characters */
+#define BASE64_DECODED_MAX_SIZE(len) ((((len) + 3) / 4) * 3)
+
+/**
+ * @brief Base64 encode #len bytes of #data into #out without line breaks.
+ * @param out at least BASE64_ENCODED_SIZE(len) + 1 bytes, NUL-terminated
+ * @return length of the result (without the NUL byte)
+ */
+size_t Base64Encode(const void *data, size_t len, char *out);
+
+/**
+ * @brief Base64 decode #len characters of #str into #out.
+ * @param out at least BASE64_DECODED_MAX_SIZE(len) bytes, may be the same
+ *            as #str
+ * @return length of the result or -1 if #str is not valid Base64
+ */
+ssize_t Base64Decode(const char *str, size_t len, void *out);
+
+/**
+ * Incremental encoding, data can be passed in chunks of any size:
+ *
+ *     Base64Encoder encoder;
+ *     Base64EncoderInit(&encoder, 0);
+ *     while ((n = read(fd, data, sizeof(data))) > 0)
+ *     {
+ *         Base64EncoderWrite(&encoder, writer, data, n);
+ *     }
+ *     Base64EncoderWriteFinal(&encoder, writer);
+ */
+typedef struct
+{
+    unsigned char pending[3];  /* bytes not forming a whole 3-byte group yet */
+    size_t n_pending;
+    size_t line_length;
+    size_t column;
+} Base64Encoder;
+
+/* Maximum output size of Base64EncoderFinal() */
+#define BASE64_ENCODER_FINAL_MAX_SIZE 5
+
+/**
+ * @param line_length put a '\n' between lines of this many characters, must
+ *                    be a multiple of 4 (0 for no line breaks)
+ */
+void Base64EncoderInit(Base64Encoder *encoder, size_t line_length);
+
+/**
+ * @brief Maximum output size of Base64EncoderUpdate() for #len bytes.
+ */
+size_t Base64EncoderMaxSize(const Base64Encoder *encoder, size_t len);
+
+/**
+ * @brief Encode the next #len bytes of #data into #out.
+ * @param out at least Base64EncoderMaxSize(encoder, len) bytes
+ * @return number of characters written (not NUL-terminated)
+ */
+size_t Base64EncoderUpdate(Base64Encoder *encoder, const void *data, size_t len,
+                           char *out);
+
+/**
+ * @brief Encode the remaining bytes and padding.
+ * @param out at least BASE64_ENCODER_FINAL_MAX_SIZE bytes
+ * @return number of characters written (not NUL-terminated)
+ */
+size_t Base64EncoderFinal(Base64Encoder *encoder, char *out);
+
+/**
+ * @brief Same as Base64EncoderUpdate() and Base64EncoderFinal(), but
+ *        writing the output directly into #writer.
+ */
+void Base64EncoderWrite(Base64Encoder *encoder, Writer *writer,
+                        const void *data, size_t len);
+void Base64EncoderWriteFinal(Base64Encoder *encoder, Writer *writer);
+
+/**
+ * Incremental decoding, the input can be split at any character.
+ */
+typedef struct
+{
+    uint32_t bits;               /* pending 6-bit values */
+    unsigned int n_chars;        /* number of them */
+    unsigned int padding_left;   /* '=' expected to complete the group */
+    bool done;                   /* padding seen, only whitespace may follow */
+    bool error;
+} Base64Decoder;
+
+void Base64DecoderInit(Base64Decoder *decoder);
+
+/**
+ * @brief Decode the next #len characters of #str into #out.
+ * @param out at least BASE64_DECODED_MAX_SIZE(len) bytes
+ * @param out_len where to store the number of bytes written
+ * @return false if the input is not valid Base64 (then all the following
+ *         calls fail too)
+ */
+bool Base64DecoderUpdate(Base64Decoder *decoder, const char *str, size_t len,
+                         void *out, size_t *out_len);
+
+/**
+ * @brief Decode the last group if the input wasn't padded.
+ * @param out at least 2 bytes
+ * @return false if the input was not valid Base64 or was truncated
+ */
+bool Base64DecoderFinal(Base64Decoder *decoder, void *out, size_t *out_len);
 
 #endif /* CFENGINE_ENCODE_H */
@@ -33,6 +33,8 @@
 #include <logging.h>
 #include <string_lib.h>                                         /* memcchr */
 #include <path.h>
+#include <mutex.h>
+#include <threaded_queue.h>
 
 /* below are includes for the fancy efficient file/data copying on Linux */
 #ifdef __linux__
@@ -115,59 +117,40 @@ bool File_Copy(const char *src, const char *dst)
     assert(src != NULL);
     assert(dst != NULL);
 
-    Log(LOG_LEVEL_INFO, "Copying: '%s' -> '%s'", src, dst);
+    Log(LOG_LEVEL_VERBOSE, "Copying: '%s' -> '%s'", src, dst);
 
-    FILE *in = safe_fopen(src, "r");
-    if (in == NULL)
+    int sd = safe_open(src, O_RDONLY | O_BINARY);
+    if (sd < 0)
     {
         Log(LOG_LEVEL_ERR, "Could not open '%s' (%s)", src, strerror(errno));
         return false;
     }
 
-    FILE *out = safe_fopen_create_perms(dst, "w", CF_PERMS_DEFAULT);
-    if (out == NULL)
+    int dd = safe_open_create_perms(dst, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+                                    CF_PERMS_DEFAULT);
+    if (dd < 0)
     {
         Log(LOG_LEVEL_ERR, "Could not open '%s' (%s)", dst, strerror(errno));
-        fclose(in);
+        close(sd);
         return false;
     }
 
-    size_t bytes_in = 0;
-    size_t bytes_out = 0;
-    bool ret = true;
-    do
+    /* The block size only determines the granularity of the holes detected
+     * when the data is shoveled (on platforms without SEEK_DATA), the data is
+     * copied in much larger chunks (or not at all with reflinks). */
+    size_t blk_size = DEV_BSIZE;
+    struct stat sb;
+    if (fstat(dd, &sb) == 0)
     {
-#define BUFSIZE 1024
-        char buf[BUFSIZE] = {0};
-
-        bytes_in = fread(buf, sizeof(char), sizeof(buf), in);
-        bytes_out = fwrite(buf, sizeof(char), bytes_in, out);
-        while (bytes_out < bytes_in && !ferror(out))
-        {
-            bytes_out += fwrite(
-                buf + bytes_out, sizeof(char), bytes_in - bytes_out, out);
-        }
-    } while (!feof(in) && !ferror(in) && !ferror(out) &&
-             bytes_in == bytes_out);
-
-    if (ferror(in))
-    {
-        Log(LOG_LEVEL_ERR, "Error encountered while reading '%s'", src);
-        ret = false;
-    }
-    else if (ferror(out))
-    {
-        Log(LOG_LEVEL_ERR, "Error encountered while writing '%s'", dst);
-        ret = false;
-    }
-    else if (bytes_in != bytes_out)
-    {
-        Log(LOG_LEVEL_ERR, "Did not copy the whole file");
-        ret = false;
+        blk_size = ST_BLKSIZE(sb);
     }
 
-    const int i = fclose(in);
-    if (i != 0)
+    size_t total_bytes_written = 0;
+    bool last_write_was_hole = false;
+    bool ret = FileSparseCopy(sd, src, dd, dst, blk_size,
+                              &total_bytes_written, &last_write_was_hole);
+
+    if (close(sd) != 0)
     {
         Log(LOG_LEVEL_ERR,
             "Error encountered while closing '%s' (%s)",
@@ -175,13 +158,8 @@ bool File_Copy(const char *src, const char *dst)
             strerror(errno));
         ret = false;
     }
-    const int o = fclose(out);
-    if (o != 0)
+    if (!FileSparseClose(dd, dst, false, total_bytes_written, last_write_was_hole))
     {
-        Log(LOG_LEVEL_ERR,
-            "Error encountered while closing '%s' (%s)",
-            dst,
-            strerror(errno));
         ret = false;
     }
     return ret;
@@ -217,6 +195,106 @@ bool File_CopyToDir(const char *src, const char *dst_dir)
     return true;
 }
 
+Buffer *FileReadBuffer(const char *filename, size_t max_size, bool *truncated)
+{
+    int fd = safe_open(filename, O_RDONLY | O_BINARY);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    Buffer *buf = FileReadBufferFromFd(fd, max_size, truncated);
+    close(fd);
+    return buf;
+}
+
+/* Size of the first read() from files of unknown size (pipes, files in /proc,
+ * ...), the following reads fill the (doubling) rest of the buffer. */
+#define READ_CHUNK_SIZE (64 * 1024)
+
+/* Only worth the extra syscall for big files. */
+#define READ_FADVISE_THRESHOLD (1024 * 1024)
+
+Buffer *FileReadBufferFromFd(int fd, size_t max_size, bool *truncated)
+{
+    if (truncated != NULL)
+    {
+        *truncated = false;
+    }
+
+    /* For regular files we know how much data there is to read, so we can
+     * allocate the buffer with the exact size and read it all with one
+     * read() (plus one to detect EOF). Files in /proc report size 0. */
+    size_t expected = 0;
+    struct stat sb;
+    if ((fstat(fd, &sb) == 0) && S_ISREG(sb.st_mode) && (sb.st_size > 0))
+    {
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if ((offset >= 0) && (offset < sb.st_size))
+        {
+            expected = MIN((size_t) (sb.st_size - offset), max_size);
+        }
+#ifdef HAVE_POSIX_FADVISE
+        if (expected >= READ_FADVISE_THRESHOLD)
+        {
+            posix_fadvise(fd, offset, expected, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    /* Reading one more byte than allowed/expected is deliberate, it detects
+     * truncation (or EOF). */
+    const size_t to_read = MIN(max_size, SIZE_MAX - 2) + 1;
+    size_t next_read = MIN((expected > 0) ? expected + 1 : READ_CHUNK_SIZE, to_read);
+
+    Buffer *buf = BufferNewWithCapacity(next_read + 1);
+    BufferSetMode(buf, BUFFER_BEHAVIOR_BYTEARRAY);
+
+    size_t n_read = 0;
+    while (n_read < to_read)
+    {
+        char *dst = BufferReserve(buf, next_read);
+        ssize_t ret = read(fd, dst, next_read);
+        if (ret == 0)
+        {
+            /* Done. */
+            return buf;
+        }
+        else if (ret < 0)
+        {
+            if (errno != EINTR)
+            {
+                /* Something went wrong. */
+                BufferDestroy(buf);
+                return NULL;
+            }
+            /* Else: interrupted - try again. */
+            continue;
+        }
+
+        BufferCommit(buf, ret);
+        n_read += ret;
+
+        /* Use the rest of the buffer if there is any (the EOF detection byte
+         * for files of known size), otherwise let BufferReserve() double
+         * it. */
+        next_read = BufferCapacity(buf) - n_read - 1;
+        if (next_read == 0)
+        {
+            next_read = MAX(n_read, READ_CHUNK_SIZE);
+        }
+        next_read = MIN(next_read, to_read - n_read);
+    }
+
+    /* Reached limit - stop. */
+    BufferTrimToMaxLength(buf, max_size);
+    if (truncated != NULL)
+    {
+        *truncated = true;
+    }
+    return buf;
+}
+
 Writer *FileReadFromFd(int fd, size_t max_size, bool *truncated)
 {
     if (truncated)
@@ -623,6 +701,391 @@ void PathWalk(
     SeqDestroy(dirnames);
 }
 
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+typedef struct
+{
+    PathWalkAtFn *callback;
+    void *data;
+    bool follow;
+
+    /* only used in the parallel mode */
+    size_t n_threads;
+    ThreadedQueue *queue;
+    pthread_mutex_t pending_lock;
+    size_t pending;             /* directories queued or being walked */
+} PathWalkAtState;
+
+/* Directory on the path from the root to the one being walked, used to
+ * detect symlink loops when following symlinks. */
+typedef struct PathWalkAtAncestor
+{
+    dev_t dev;
+    ino_t ino;
+    const struct PathWalkAtAncestor *parent;
+} PathWalkAtAncestor;
+
+typedef struct
+{
+    char *path;
+    DIR *dir;
+    PathWalkAtAncestor *ancestors; /* heap copy of the chain, NULL if not following */
+} PathWalkAtItem;
+
+/**
+ * Open the directory #name in the directory #parent_fd (at #path).
+ */
+static DIR *PathWalkAtOpenDir(int parent_fd, const char *name, const char *path,
+                              bool follow)
+{
+#ifdef HAVE_FDOPENDIR
+    UNUSED(path);
+    int flags = O_RDONLY | O_DIRECTORY | (follow ? 0 : O_NOFOLLOW);
+    int fd = openat(parent_fd, name, flags);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL)
+    {
+        close(fd);
+    }
+    return dir;
+#else
+    UNUSED(parent_fd);
+    UNUSED(name);
+    UNUSED(follow);
+    return opendir(path);
+#endif
+}
+
+/**
+ * @return Whether the directory entry #entry in #dir_fd is a directory.
+ */
+static bool PathWalkAtIsDir(int dir_fd, const struct dirent *entry, bool follow,
+                            const char *path)
+{
+#ifdef HAVE_STRUCT_DIRENT_D_TYPE
+    switch (entry->d_type)
+    {
+    case DT_DIR:
+        return true;
+    case DT_LNK:
+        if (!follow)
+        {
+            return false;
+        }
+        break;                  /* need to stat the target */
+    case DT_UNKNOWN:
+        break;                  /* not provided by the file system */
+    default:
+        return false;
+    }
+#endif
+
+    struct stat sb;
+    if (fstatat(dir_fd, entry->d_name, &sb, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        Log(LOG_LEVEL_DEBUG, "Failed to stat file '%s': %s", path, GetErrorStr());
+        return false;
+    }
+    return S_ISDIR(sb.st_mode);
+}
+
+/**
+ * Fill #node with the device and inode of #dir, whose parent is #parent.
+ */
+static bool PathWalkAtAncestorInit(PathWalkAtAncestor *node, DIR *dir,
+                                   const PathWalkAtAncestor *parent)
+{
+    struct stat sb;
+    if (fstat(dirfd(dir), &sb) != 0)
+    {
+        return false;
+    }
+    node->dev = sb.st_dev;
+    node->ino = sb.st_ino;
+    node->parent = parent;
+    return true;
+}
+
+static bool PathWalkAtIsAncestor(const PathWalkAtAncestor *ancestors,
+                                 const PathWalkAtAncestor *node)
+{
+    for (const PathWalkAtAncestor *a = ancestors; a != NULL; a = a->parent)
+    {
+        if ((a->dev == node->dev) && (a->ino == node->ino))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Copy the chain #ancestors into one heap block (to be free()'d), so that
+ * it can be handed over to another thread.
+ */
+static PathWalkAtAncestor *PathWalkAtAncestorsCopy(const PathWalkAtAncestor *ancestors)
+{
+    if (ancestors == NULL)
+    {
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (const PathWalkAtAncestor *a = ancestors; a != NULL; a = a->parent)
+    {
+        n++;
+    }
+    PathWalkAtAncestor *copy = xmalloc(n * sizeof(PathWalkAtAncestor));
+    size_t i = 0;
+    for (const PathWalkAtAncestor *a = ancestors; a != NULL; a = a->parent, i++)
+    {
+        copy[i].dev = a->dev;
+        copy[i].ino = a->ino;
+        copy[i].parent = (i + 1 < n) ? &copy[i + 1] : NULL;
+    }
+    return copy;
+}
+
+static void PathWalkAtPending(PathWalkAtState *state, bool add)
+{
+    ThreadLock(&state->pending_lock);
+    if (add)
+    {
+        state->pending++;
+    }
+    else
+    {
+        assert(state->pending > 0);
+        state->pending--;
+        if (state->pending == 0)
+        {
+            /* Everything walked, tell the workers to stop. */
+            for (size_t i = 0; i < state->n_threads; i++)
+            {
+                ThreadedQueuePush(state->queue, NULL);
+            }
+        }
+    }
+    ThreadUnlock(&state->pending_lock);
+}
+
+/**
+ * Walk the (already open) directory #dir at #path.
+ *
+ * @param path Buffer of PATH_MAX bytes, the path of the directory is
+ *             #path_len bytes long, entries are appended to it.
+ * @param ancestors #dir and the directories above it up to the root when
+ *                  following symlinks, NULL otherwise.
+ */
+static void PathWalkAtDir(PathWalkAtState *state, DIR *dir,
+                          char *path, size_t path_len,
+                          const PathWalkAtAncestor *ancestors)
+{
+    const int dir_fd = dirfd(dir);
+    const struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        const char *const name = entry->d_name;
+        if ((name[0] == '.') &&
+            ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0'))))
+        {
+            continue;
+        }
+
+        size_t name_len = strlen(name);
+        size_t entry_len = path_len + 1 + name_len;
+        if (entry_len >= PATH_MAX)
+        {
+            Log(LOG_LEVEL_ERR, "Path too long: '%s%c%s'", path, FILE_SEPARATOR, name);
+            continue;
+        }
+        path[path_len] = FILE_SEPARATOR;
+        memcpy(path + path_len + 1, name, name_len + 1);
+
+        const bool is_dir = PathWalkAtIsDir(dir_fd, entry, state->follow, path);
+        const bool descend = state->callback(path, path + path_len + 1, dir_fd,
+                                             is_dir, state->data);
+        if (!is_dir || !descend)
+        {
+            continue;
+        }
+
+        DIR *subdir = PathWalkAtOpenDir(dir_fd, name, path, state->follow);
+        if (subdir == NULL)
+        {
+            Log(LOG_LEVEL_DEBUG,
+                "Failed to open directory '%s'. Subdirectories will not be "
+                "iterated (%s)", path, GetErrorStr());
+            continue;
+        }
+
+        /* A symlink to a directory on the current path would make us walk
+         * it again and again (until running out of fds). */
+        PathWalkAtAncestor node;
+        const PathWalkAtAncestor *sub_ancestors = NULL;
+        if (ancestors != NULL)
+        {
+            if (!PathWalkAtAncestorInit(&node, subdir, ancestors))
+            {
+                Log(LOG_LEVEL_DEBUG, "Failed to stat directory '%s' (%s)",
+                    path, GetErrorStr());
+                closedir(subdir);
+                continue;
+            }
+            if (PathWalkAtIsAncestor(ancestors, &node))
+            {
+                Log(LOG_LEVEL_VERBOSE,
+                    "Not descending into '%s', symlink loop detected", path);
+                closedir(subdir);
+                continue;
+            }
+            sub_ancestors = &node;
+        }
+
+        /* Hand the subtree over to another thread if there are idle ones
+         * (nothing queued), otherwise walk it ourselves. */
+        if ((state->queue != NULL) && ThreadedQueueIsEmpty(state->queue))
+        {
+            PathWalkAtItem *item = xmalloc(sizeof(PathWalkAtItem));
+            item->path = xstrndup(path, entry_len);
+            item->dir = subdir;
+            item->ancestors = PathWalkAtAncestorsCopy(sub_ancestors);
+            PathWalkAtPending(state, true);
+            ThreadedQueuePush(state->queue, item);
+        }
+        else
+        {
+            PathWalkAtDir(state, subdir, path, entry_len, sub_ancestors);
+            path[entry_len] = '\0';
+        }
+    }
+    path[path_len] = '\0';
+    closedir(dir);
+}
+
+static void *PathWalkAtWorker(void *arg)
+{
+    PathWalkAtState *state = arg;
+    char path[PATH_MAX];
+
+    PathWalkAtItem *item;
+    while (ThreadedQueuePop(state->queue, (void **) &item, THREAD_BLOCK_INDEFINITELY) &&
+           (item != NULL))
+    {
+        size_t path_len = strlcpy(path, item->path, sizeof(path));
+        PathWalkAtDir(state, item->dir, path, path_len, item->ancestors);
+        free(item->ancestors);
+        free(item->path);
+        free(item);
+        PathWalkAtPending(state, false);
+    }
+    return NULL;
+}
+
+bool PathWalkAt(const char *root, PathWalkAtFn callback, void *data,
+                PathWalkFlags flags, size_t n_threads)
+{
+    assert(root != NULL);
+    assert(callback != NULL);
+
+    char path[PATH_MAX];
+    size_t path_len = strlcpy(path, root, sizeof(path));
+    if (path_len >= sizeof(path))
+    {
+        Log(LOG_LEVEL_ERR, "Path too long: '%s'", root);
+        return false;
+    }
+    /* Avoid double separators when joining with the entry names (the root
+     * directory "/" becomes an empty prefix). */
+    while ((path_len > 0) && IsFileSep(path[path_len - 1]))
+    {
+        path[--path_len] = '\0';
+    }
+
+    const bool follow = ((flags & PATH_WALK_FOLLOW_SYMLINKS) != 0);
+    DIR *dir = PathWalkAtOpenDir(AT_FDCWD, root, root, true);
+    if (dir == NULL)
+    {
+        Log(LOG_LEVEL_DEBUG, "Failed to open directory '%s' (%s)", root, GetErrorStr());
+        return false;
+    }
+
+    PathWalkAtAncestor root_node;
+    const PathWalkAtAncestor *ancestors = NULL;
+    if (follow && PathWalkAtAncestorInit(&root_node, dir, NULL))
+    {
+        ancestors = &root_node;
+    }
+
+    PathWalkAtState state = {
+        .callback = callback,
+        .data = data,
+        .follow = follow,
+        .n_threads = n_threads,
+        .queue = NULL,
+        .pending = 0,
+    };
+
+    if (n_threads <= 1)
+    {
+        PathWalkAtDir(&state, dir, path, path_len, ancestors);
+        return true;
+    }
+
+    state.queue = ThreadedQueueNew(n_threads, NULL);
+    pthread_mutex_init(&state.pending_lock, NULL);
+
+    pthread_t *threads = xcalloc(n_threads, sizeof(pthread_t));
+    size_t n_started = 0;
+    for (; n_started < n_threads; n_started++)
+    {
+        if (pthread_create(&threads[n_started], NULL, PathWalkAtWorker, &state) != 0)
+        {
+            Log(LOG_LEVEL_ERR, "Failed to start a thread for walking '%s'", root);
+            break;
+        }
+    }
+
+    if (n_started == 0)
+    {
+        /* Walk it ourselves then. */
+        ThreadedQueueDestroy(state.queue);
+        state.queue = NULL;
+        PathWalkAtDir(&state, dir, path, path_len, ancestors);
+    }
+    else
+    {
+        /* Only as many stop signals as there are threads. */
+        state.n_threads = n_started;
+
+        PathWalkAtItem *item = xmalloc(sizeof(PathWalkAtItem));
+        item->path = xstrndup(path, path_len);
+        item->dir = dir;
+        item->ancestors = PathWalkAtAncestorsCopy(ancestors);
+        PathWalkAtPending(&state, true);
+        ThreadedQueuePush(state.queue, item);
+
+        for (size_t i = 0; i < n_started; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        ThreadedQueueDestroy(state.queue);
+    }
+
+    pthread_mutex_destroy(&state.pending_lock);
+    free(threads);
+    return true;
+}
+
 Seq *ListDir(const char *dir, const char *extension)
 {
     Dir *dirh = DirOpen(dir);
@@ -1560,6 +2023,47 @@ bool FileSparseWrite(int fd, const void *buf, size_t count,
 #define SMART_SYSCALLS_UNUSED
 #endif
 
+/* Size of the buffer used when the data has to be shoveled through user
+ * space, much bigger than the usual block sizes to save syscalls. */
+#define FILE_COPY_BUFSIZE (128 * 1024)
+
+/**
+ * Like FileSparseWrite(), but detects holes in every #blk_size-sized block of
+ * #buf and writes the consecutive non-zero blocks with one write().
+ */
+SMART_SYSCALLS_UNUSED static bool FileSparseWriteBlocks(int fd, const char *buf, size_t count,
+                                                        size_t blk_size, bool *wrote_hole)
+{
+    size_t offset = 0;
+    while (offset < count)
+    {
+        /* Find the run of blocks of the same kind (holes or data). */
+        const size_t first_len = MIN(blk_size, count - offset);
+        const bool hole = (memcchr(buf + offset, '\0', first_len) == NULL);
+        size_t run_len = first_len;
+        while (offset + run_len < count)
+        {
+            const size_t len = MIN(blk_size, count - offset - run_len);
+            const bool next_hole =
+                (memcchr(buf + offset + run_len, '\0', len) == NULL);
+            if (next_hole != hole)
+            {
+                break;
+            }
+            run_len += len;
+        }
+
+        /* FileSparseWrite() detects the all-zero run as a hole again,
+         * but that's cheap compared to the syscall. */
+        if (!FileSparseWrite(fd, buf + offset, run_len, wrote_hole))
+        {
+            return false;
+        }
+        offset += run_len;
+    }
+    return true;
+}
+
 SMART_SYSCALLS_UNUSED static bool FileSparseCopyShoveling(int sd, const char *src_name,
                                                           int dd, const char *dst_name,
                                                           size_t blk_size,
@@ -1569,8 +2073,9 @@ SMART_SYSCALLS_UNUSED static bool FileSparseCopyShoveling(int sd, const char *sr
     assert(total_bytes_written   != NULL);
     assert(last_write_was_a_hole != NULL);
 
-    const size_t buf_size  = blk_size;
-    void *buf              = xmalloc(buf_size);
+    blk_size = MAX(blk_size, 1);
+    const size_t buf_size  = MAX(blk_size, FILE_COPY_BUFSIZE - (FILE_COPY_BUFSIZE % blk_size));
+    char *buf              = xmalloc(buf_size);
 
     size_t n_read_total = 0;
     bool   retval       = false;
@@ -1593,8 +2098,8 @@ SMART_SYSCALLS_UNUSED static bool FileSparseCopyShoveling(int sd, const char *sr
             break;
         }
 
-        bool ret = FileSparseWrite(dd, buf, n_read,
-                                   last_write_was_a_hole);
+        bool ret = FileSparseWriteBlocks(dd, buf, n_read, blk_size,
+                                         last_write_was_a_hole);
         if (!ret)
         {
             Log(LOG_LEVEL_ERR, "Failed to copy '%s' to '%s'",
@@ -1610,6 +2115,52 @@ SMART_SYSCALLS_UNUSED static bool FileSparseCopyShoveling(int sd, const char *sr
     return retval;
 }
 
+#if SMART_FILE_COPY_SYSCALLS_AVAILABLE
+typedef enum
+{
+    FILE_COPY_METHOD_COPY_FILE_RANGE,
+    FILE_COPY_METHOD_SENDFILE,
+    FILE_COPY_METHOD_READ_WRITE,
+} FileCopyMethod;
+
+/**
+ * Whether the copy_file_range()/sendfile() failure with #error just means
+ * the method is not supported for the given files and the next one should
+ * be tried.
+ */
+static bool FileCopyMethodUnsupported(int error)
+{
+    return ((error == ENOSYS) || (error == EXDEV) || (error == EINVAL) ||
+            (error == EOPNOTSUPP) || (error == ENOTSUP) || (error == EBADF));
+}
+
+/**
+ * Copy #count bytes from the current offset of #sd to the current offset of
+ * #dd through user space with #buf of size FILE_COPY_BUFSIZE.
+ *
+ * @return Number of bytes copied (less than #count only at EOF) or -1 in case
+ *         of error
+ */
+static ssize_t FileCopyRangeReadWrite(int sd, int dd, size_t count, char *buf)
+{
+    size_t n_copied = 0;
+    while (n_copied < count)
+    {
+        ssize_t n_read = FullRead(sd, buf, MIN(count - n_copied, FILE_COPY_BUFSIZE));
+        if (n_read <= 0)
+        {
+            return (n_read < 0) ? -1 : (ssize_t) n_copied;
+        }
+        if (FullWrite(dd, buf, n_read) < 0)
+        {
+            return -1;
+        }
+        n_copied += n_read;
+    }
+    return n_copied;
+}
+#endif  /* SMART_FILE_COPY_SYSCALLS_AVAILABLE */
+
 /**
  * Copy data jumping over areas filled by '\0' greater than blk_size, so
  * files automatically become sparse if possible.
@@ -1636,6 +2187,7 @@ bool FileSparseCopy(int sd, const char *src_name,
     /* We rely on the errno value below so make sure it's not spoofed by an
      * error from outside. */
     errno = 0;
+    *total_bytes_written = 0;
 
     size_t input_size;
     struct stat in_sb;
@@ -1661,6 +2213,26 @@ bool FileSparseCopy(int sd, const char *src_name,
         *total_bytes_written = 0;
         return false;
     }
+
+    /* Pseudo-files (/proc, sysfs, pipes, ...) report no size or no blocks
+     * but do have contents, and a regular file without any blocks is all
+     * holes, so these are read until EOF. The size based fast paths below
+     * are only for regular files with data. */
+    if (!S_ISREG(in_sb.st_mode) || (in_sb.st_size == 0) || (in_sb.st_blocks == 0))
+    {
+        bool ret = FileSparseCopyShoveling(sd, src_name, dd, dst_name, blk_size,
+                                           total_bytes_written, last_write_was_a_hole);
+        /* The size is only known now. Setting it also extends the file over
+         * a trailing hole, which FileSparseClose() doesn't do with the smart
+         * syscalls, and drops stale data if #dd was not truncated. */
+        if (ret && (ftruncate(dd, *total_bytes_written) != 0))
+        {
+            Log(LOG_LEVEL_ERR, "Failed to set size for '%s': %m", dst_name);
+            ret = false;
+        }
+        *last_write_was_a_hole = false;
+        return ret;
+    }
 #if HAVE_DECL_FICLONE
     if (same_dev)
     {
@@ -1684,21 +2256,18 @@ bool FileSparseCopy(int sd, const char *src_name,
         }
     }
 #endif  /* HAVE_DECL_FICLONE */
+
+    /* Files without holes (the vast majority) can simply be copied at once,
+     * saving the syscalls needed for the sparse files handling below (see
+     * the note about st_blocks below). */
+    const bool has_holes = (in_sb.st_blocks * 512 < in_sb.st_size);
+
     if (ftruncate(dd, input_size) != 0)
     {
         Log(LOG_LEVEL_ERR, "Failed to preset size for '%s': %m", dst_name);
         *total_bytes_written = 0;
         return false;
     }
-    if (in_sb.st_blocks == 0)
-    {
-        /* Nothing to copy. */
-        Log(LOG_LEVEL_VERBOSE, "'%s' copied successfully to '%s'", src_name, dst_name);
-        *total_bytes_written = input_size;
-        *last_write_was_a_hole = false;
-        return true;
-    }
-
     /* man:inode(7) says about st_blocks:
      * This field indicates the number of blocks allocated to the file, 512-byte
      * units, (This may be smaller than st_size/512 when the file has holes.)
@@ -1708,7 +2277,8 @@ bool FileSparseCopy(int sd, const char *src_name,
      * the unit may differ on a per-filesystem basis.
      * So using 512 is the best we can do although it might not be perfect.
      */
-    if (fallocate(dd, FALLOC_FL_KEEP_SIZE|FALLOC_FL_PUNCH_HOLE, 0, in_sb.st_blocks * 512) != 0)
+    if (has_holes &&
+        (fallocate(dd, FALLOC_FL_KEEP_SIZE|FALLOC_FL_PUNCH_HOLE, 0, in_sb.st_blocks * 512) != 0))
     {
         Log((errno == EOPNOTSUPP) ? LOG_LEVEL_VERBOSE : LOG_LEVEL_ERR,
             "Failed to pre-allocate space for '%s': %m", dst_name);
@@ -1718,6 +2288,19 @@ bool FileSparseCopy(int sd, const char *src_name,
         }
     }
 
+    /* Try the fastest way of copying data first and fall back to the next
+     * one if it's not supported for the given files. copy_file_range() only
+     * works on the same device (file system), but unlike sendfile() it can
+     * actually create reflinks instead of copying the data. */
+    FileCopyMethod method = FILE_COPY_METHOD_SENDFILE;
+#ifdef HAVE_COPY_FILE_RANGE
+    if (same_dev)
+    {
+        method = FILE_COPY_METHOD_COPY_FILE_RANGE;
+    }
+#endif /* HAVE_COPY_FILE_RANGE */
+    char *buf = NULL;
+
     off_t in_pos = 0;
     off_t out_pos = 0;
     bool done = false;
@@ -1725,61 +2308,91 @@ bool FileSparseCopy(int sd, const char *src_name,
     while (!done)
     {
         error = 0;
-        in_pos = lseek(sd, in_pos, SEEK_DATA);
-        if (in_pos == -1)
+        off_t next_hole = input_size;
+        if (has_holes)
         {
-            if (errno == ENXIO)
+            in_pos = lseek(sd, in_pos, SEEK_DATA);
+            if (in_pos == -1)
             {
-                /* ENXIO means we are either seeking past the end of file or
-                   that we seek data and there is only a hole till the end of
-                   the file. IOW, we are done. */
-                done = true;
-                break;
+                if (errno == ENXIO)
+                {
+                    /* ENXIO means we are either seeking past the end of file or
+                       that we seek data and there is only a hole till the end of
+                       the file. IOW, we are done. */
+                    done = true;
+                    break;
+                }
+                else
+                {
+                    error = errno;
+                    Log(LOG_LEVEL_ERR, "Failed to seek to next data in '%s'", src_name);
+                    break;
+                }
             }
-            else
+            if (in_pos != out_pos)
+            {
+                out_pos = lseek(dd, in_pos - out_pos, SEEK_CUR);
+                if (out_pos == -1) {
+                    error = errno;
+                    Log(LOG_LEVEL_ERR, "Failed to advance descriptor in '%s'", dst_name);
+                    break;
+                }
+            }
+            next_hole = lseek(sd, in_pos, SEEK_HOLE);
+            if (next_hole == -1)
             {
                 error = errno;
-                Log(LOG_LEVEL_ERR, "Failed to seek to next data in '%s'", src_name);
+                Log(LOG_LEVEL_ERR, "Failed to find next hole in '%s'", src_name);
                 break;
             }
-        }
-        if (in_pos != out_pos)
-        {
-            out_pos = lseek(dd, in_pos - out_pos, SEEK_CUR);
-            if (out_pos == -1) {
+            if (lseek(sd, in_pos, SEEK_SET) == -1)
+            {
                 error = errno;
-                Log(LOG_LEVEL_ERR, "Failed to advance descriptor in '%s'", dst_name);
+                Log(LOG_LEVEL_ERR, "Failed to seek back to data in '%s'", src_name);
                 break;
             }
         }
-        off_t next_hole = lseek(sd, in_pos, SEEK_HOLE);
-        if (next_hole == -1)
-        {
-            error = errno;
-            Log(LOG_LEVEL_ERR, "Failed to find next hole in '%s'", src_name);
-            break;
-        }
-        if (lseek(sd, in_pos, SEEK_SET) == -1)
-        {
-            error = errno;
-            Log(LOG_LEVEL_ERR, "Failed to seek back to data in '%s'", src_name);
-            break;
-        }
+        const size_t to_copy = next_hole - in_pos;
         ssize_t n_copied;
-#ifdef HAVE_COPY_FILE_RANGE
-        /* copy_file_range() only works on the same device (file system), but
-         * unlike sendfile() it can actually create reflinks instead of copying
-         * the data. */
-        if (same_dev)
+        while (true)
         {
-            n_copied = copy_file_range(sd, NULL, dd, NULL, next_hole - in_pos, 0);
-            error = errno;
-        }
-        else
+            switch (method)
+            {
+#ifdef HAVE_COPY_FILE_RANGE
+            case FILE_COPY_METHOD_COPY_FILE_RANGE:
+                n_copied = copy_file_range(sd, NULL, dd, NULL, to_copy, 0);
+                break;
 #endif /* HAVE_COPY_FILE_RANGE */
+#ifdef HAVE_SENDFILE
+            case FILE_COPY_METHOD_SENDFILE:
+                n_copied = sendfile(dd, sd, NULL, to_copy);
+                break;
+#endif /* HAVE_SENDFILE */
+            default:
+                method = FILE_COPY_METHOD_READ_WRITE;
+                if (buf == NULL)
+                {
+                    buf = xmalloc(FILE_COPY_BUFSIZE);
+                }
+                n_copied = FileCopyRangeReadWrite(sd, dd, to_copy, buf);
+                break;
+            }
+            error = (n_copied < 0) ? errno : 0;
+
+            if ((n_copied >= 0) || (method == FILE_COPY_METHOD_READ_WRITE) ||
+                !FileCopyMethodUnsupported(error))
+            {
+                break;
+            }
+            /* Nothing was copied, try the next (slower) method. */
+            Log(LOG_LEVEL_DEBUG, "Failed to copy data from '%s' to '%s' (%s), falling back",
+                src_name, dst_name, GetErrorStrFromCode(error));
+            method++;
+        }
+        if (n_copied < 0)
         {
-            n_copied = sendfile(dd, sd, NULL, next_hole - in_pos);
-            error = errno;
+            Log(LOG_LEVEL_ERR, "Failed to copy data from '%s' to '%s' (%s)",
+                src_name, dst_name, GetErrorStrFromCode(error));
         }
         if (n_copied > 0)
         {
@@ -1789,6 +2402,7 @@ bool FileSparseCopy(int sd, const char *src_name,
         }
         done = ((n_copied <= 0) || ((size_t) in_pos == input_size));
     }
+    free(buf);
     *last_write_was_a_hole = false;
     return (error == 0);
 #endif  /* SMART_FILE_COPY_SYSCALLS_AVAILABLE */
@@ -28,6 +28,7 @@
 #include <sys/types.h> // uid_t
 #include <sys/stat.h> // lstat
 #include <writer.h>
+#include <buffer.h>
 #include <set.h>
 #include <sequence.h>
 
@@ -44,6 +45,22 @@ typedef enum
  */
 Writer *FileRead(const char *filename, size_t size_max, bool *truncated);
 
+/**
+ * Reads up to #max_size bytes from #filename into a Buffer in the
+ * BUFFER_BEHAVIOR_BYTEARRAY mode, so unlike FileRead() this is binary-safe
+ * (see BufferSize() for the length of the data, which is still followed by a
+ * '\0' byte for convenience). Regular files are read into a buffer of the
+ * exact size, with as few read() calls as possible.
+ *
+ * @return %NULL in case of error
+ */
+Buffer *FileReadBuffer(const char *filename, size_t max_size, bool *truncated);
+
+/**
+ * Same as FileReadBuffer(), but reads from the current offset of #fd.
+ */
+Buffer *FileReadBufferFromFd(int fd, size_t max_size, bool *truncated);
+
 /**
  * Reads up to max_bytes bytes from file and writes into buf.
  * Returns negative numbers in case of errors, bytes read/written otherwise.
@@ -342,4 +359,51 @@ void PathWalk(
     PathWalkCopyFn copy,
     PathWalkDestroyFn destroy);
 
+/**
+ * @brief Callback function prototype for PathWalkAt() #callback argument.
+ * @param path Path of the entry (#root joined with the relative path). Points
+ *             into a buffer reused for all the entries, so it is only valid
+ *             during the call.
+ * @param name Name of the entry (the last component of #path).
+ * @param dirfd Descriptor of the directory containing the entry which can be
+ *              used with the *at() functions, e.g. fstatat(dirfd, name, ...).
+ * @param is_dir Whether the entry is a directory.
+ * @param data Arbitrary data passed to PathWalkAt().
+ * @return Whether to descend into the directory (ignored for non-directories).
+ */
+typedef bool PathWalkAtFn(const char *path, const char *name, int dirfd,
+                          bool is_dir, void *data);
+
+typedef enum
+{
+    PATH_WALK_FOLLOW_SYMLINKS = 1 << 0, /* treat symlinks to dirs as dirs */
+} PathWalkFlags;
+
+/**
+ * @brief Recursively walks the directory tree under #root, calling #callback
+ *        for every entry (excluding '.' and '..').
+ *
+ * Unlike PathWalk(), this walker works with directory file descriptors, uses
+ * the file type from the directory entries if the file system provides it
+ * (only stat'ing entries of unknown type or symlinks) and doesn't allocate
+ * memory for every entry.
+ *
+ * With #PATH_WALK_FOLLOW_SYMLINKS, a symlink to a directory on the current
+ * path (e.g. 'a -> .') is reported to #callback but not descended into.
+ *
+ * Every directory between #root and the one being walked is kept open, so
+ * a walk uses one file descriptor per level of depth (per thread). A
+ * subdirectory that cannot be opened, e.g. because the process ran out of
+ * descriptors, is skipped.
+ *
+ * @param n_threads If greater than 1, subtrees are walked in parallel by this
+ *                  many threads, in which case the #callback has to be
+ *                  thread-safe and the order of the entries is not
+ *                  depth-first anymore.
+ * @return %false if #root cannot be opened as a directory, %true otherwise
+ *         (unreadable subdirectories are skipped).
+ */
+bool PathWalkAt(const char *root, PathWalkAtFn callback, void *data,
+                PathWalkFlags flags, size_t n_threads);
+
 #endif
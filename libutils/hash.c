@@ -32,6 +32,7 @@
 #include <misc_lib.h>
 #include <file_lib.h>
 #include <string_lib.h>
+#include <mutex.h>                                       /* ThreadLock */
 
 
 static const char *const CF_DIGEST_TYPES[10] =
@@ -113,102 +114,270 @@ void HashCalculatePrintableRepresentation(Hash *hash)
     hash->printable[4 + 2 * hash->size] = '\0';
 }
 
-/*
- * Constructors
- * All constructors call two common methods: HashBasicInit(...) and HashCalculatePrintableRepresentation(...).
- * Each constructor reads the data to create the Hash from different sources so after the basic
- * initialization and up to the point where the hash is computed, each follows its own path.
- */
-Hash *HashNew(const char *data, const unsigned int length, HashMethod method)
+/*******************************************************************/
+/* HashContext                                                     */
+/*******************************************************************/
+
+struct HashContext {
+    HashMethod method;
+    EVP_MD_CTX *initial;        /* freshly initialized, copied to start over */
+    EVP_MD_CTX *context;
+};
+
+HashContext *HashContextNew(HashMethod method)
 {
-    if (!data || (length == 0))
+    if (method >= HASH_METHOD_NONE || method == HASH_METHOD_CRYPT)
     {
         return NULL;
     }
-    if (method >= HASH_METHOD_NONE)
+
+    const EVP_MD *const md = HashDigestFromId(method);
+    if (md == NULL)
     {
+        Log(LOG_LEVEL_INFO, "Digest type %s not supported by OpenSSL library",
+            CF_DIGEST_TYPES[method]);
         return NULL;
     }
-    /*
-     * OpenSSL documentation marked EVP_DigestInit and EVP_DigestFinal functions as deprecated and
-     * recommends moving to EVP_DigestInit_ex and EVP_DigestFinal_ex.
-     */
-    const EVP_MD *md = NULL;
-    md = EVP_get_digestbyname(CF_DIGEST_TYPES[method]);
-    if (md == NULL)
+
+    HashContext *const context = xcalloc(1, sizeof(HashContext));
+    context->method = method;
+    context->initial = EVP_MD_CTX_new();
+    context->context = EVP_MD_CTX_new();
+    if (context->initial == NULL || context->context == NULL)
     {
-        Log(LOG_LEVEL_INFO, "Digest type %s not supported by OpenSSL library", CF_DIGEST_TYPES[method]);
+        Log(LOG_LEVEL_ERR, "Failed to allocate openssl hashing context");
+        HashContextDestroy(context);
         return NULL;
     }
 
-    EVP_MD_CTX *const context = EVP_MD_CTX_create();
-    if (context == NULL)
+    if (EVP_DigestInit_ex(context->initial, md, NULL) != 1 ||
+        EVP_MD_CTX_copy_ex(context->context, context->initial) != 1)
     {
-        Log(LOG_LEVEL_ERR, "Could not allocate openssl hash context");
+        Log(LOG_LEVEL_ERR, "Could not initialize openssl hash context");
+        HashContextDestroy(context);
         return NULL;
     }
-    Hash *hash = HashBasicInit(method);
-    EVP_DigestInit_ex(context, md, NULL);
-    EVP_DigestUpdate(context, data, (size_t) length);
+
+    return context;
+}
+
+void HashContextDestroy(HashContext *context)
+{
+    if (context != NULL)
+    {
+        EVP_MD_CTX_free(context->initial);
+        EVP_MD_CTX_free(context->context);
+        free(context);
+    }
+}
+
+HashMethod HashContextMethod(const HashContext *context)
+{
+    assert(context != NULL);
+    return context->method;
+}
+
+bool HashContextUpdate(HashContext *context, const void *data, size_t length)
+{
+    assert(context != NULL);
+    assert(data != NULL || length == 0);
+
+    return (EVP_DigestUpdate(context->context, data, length) == 1);
+}
+
+void HashContextReset(HashContext *context)
+{
+    assert(context != NULL);
+
+    /* Much cheaper than EVP_DigestInit_ex() which looks up the digest
+     * implementation again. */
+    EVP_MD_CTX_copy_ex(context->context, context->initial);
+}
+
+HashSize HashContextFinal(HashContext *context,
+                          unsigned char digest[EVP_MAX_MD_SIZE + 1])
+{
+    assert(context != NULL);
+    assert(digest != NULL);
+
     unsigned int digest_length;
-    EVP_DigestFinal_ex(context, hash->digest, &digest_length);
-    EVP_MD_CTX_destroy(context);
-    /* Update the printable representation */
-    HashCalculatePrintableRepresentation(hash);
+    const bool success =
+        (EVP_DigestFinal_ex(context->context, digest, &digest_length) == 1);
+    HashContextReset(context);
+
+    return success ? CF_DIGEST_SIZES[context->method] : CF_NO_HASH;
+}
+
+Hash *HashContextFinalHash(HashContext *context)
+{
+    assert(context != NULL);
 
+    unsigned char digest[EVP_MAX_MD_SIZE + 1];
+    if (HashContextFinal(context, digest) == CF_NO_HASH)
+    {
+        return NULL;
+    }
+
+    Hash *const hash = HashBasicInit(context->method);
+    memcpy(hash->digest, digest, hash->size);
+    HashCalculatePrintableRepresentation(hash);
     return hash;
 }
 
-Hash *HashNewFromDescriptor(const int descriptor, HashMethod method)
+/* Per-thread contexts, one set used by the functions in this file and one
+ * handed out by HashContextGetCached(). */
+typedef struct
 {
-    if (descriptor < 0)
+    HashContext *internal[HASH_METHOD_NONE];
+    HashContext *external[HASH_METHOD_NONE];
+} HashContextCache;
+
+static pthread_once_t context_cache_key_once = PTHREAD_ONCE_INIT; /* GLOBAL_T */
+static pthread_key_t context_cache_key; /* GLOBAL_T, initialized by pthread_key_create */
+static bool context_cache_key_created = false; /* GLOBAL_T */
+
+static void HashContextCacheDestroy(void *arg)
+{
+    HashContextCache *const cache = arg;
+    for (size_t i = 0; i < HASH_METHOD_NONE; i++)
+    {
+        HashContextDestroy(cache->internal[i]);
+        HashContextDestroy(cache->external[i]);
+    }
+    free(cache);
+}
+
+static void HashContextCacheKeyCreate(void)
+{
+    context_cache_key_created =
+        (pthread_key_create(&context_cache_key, &HashContextCacheDestroy) == 0);
+}
+
+static HashContextCache *GetHashContextCache(void)
+{
+    pthread_once(&context_cache_key_once, &HashContextCacheKeyCreate);
+    if (!context_cache_key_created)
     {
         return NULL;
     }
+
+    HashContextCache *cache = pthread_getspecific(context_cache_key);
+    if (cache == NULL)
+    {
+        cache = xcalloc(1, sizeof(HashContextCache));
+        if (pthread_setspecific(context_cache_key, cache) != 0)
+        {
+            free(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+HashContext *HashContextGetCached(HashMethod method)
+{
     if (method >= HASH_METHOD_NONE)
     {
         return NULL;
     }
 
-    const EVP_MD *const md = HashDigestFromId(method);
-    if (md == NULL)
+    HashContextCache *const cache = GetHashContextCache();
+    if (cache == NULL)
     {
-        Log(LOG_LEVEL_INFO, "Digest (type=%d) not supported by OpenSSL library", method);
         return NULL;
     }
-    EVP_MD_CTX *const context = EVP_MD_CTX_create();
-    if (context == NULL)
+    if (cache->external[method] == NULL)
     {
-        Log(LOG_LEVEL_ERR, "Could not allocate openssl hash context");
-        return NULL;
+        cache->external[method] = HashContextNew(method);
     }
+    return cache->external[method];
+}
 
-    if (EVP_DigestInit_ex(context, md, NULL) != 1)
+/**
+ * @brief Get a context for hashing one message in this file.
+ * @param owned Set to whether the caller has to destroy the context (only
+ *              if the thread's cache is not available).
+ */
+static HashContext *HashContextAcquire(HashMethod method, bool *owned)
+{
+    assert(owned != NULL);
+
+    *owned = false;
+    if (method >= HASH_METHOD_NONE)
     {
-        Log(LOG_LEVEL_ERR, "Could not initialize openssl hash context");
-        EVP_MD_CTX_destroy(context);
         return NULL;
     }
 
-    ssize_t read_count = 0;
-    char buffer[1024];
-    do
+    HashContextCache *const cache = GetHashContextCache();
+    if (cache == NULL)
     {
-        read_count = read(descriptor, buffer, 1024);
-        EVP_DigestUpdate(context, buffer, (size_t) read_count);
-    } while (read_count > 0);
+        *owned = true;
+        return HashContextNew(method);
+    }
+    if (cache->internal[method] == NULL)
+    {
+        cache->internal[method] = HashContextNew(method);
+    }
+    return cache->internal[method];
+}
 
-    Hash *const hash = HashBasicInit(method); // xcalloc, cannot be NULL
-    unsigned int md_len;
-    EVP_DigestFinal_ex(context, hash->digest, &md_len);
+static void HashContextRelease(HashContext *context, bool owned)
+{
+    if (owned)
+    {
+        HashContextDestroy(context);
+    }
+}
 
-    /* Update the printable representation */
-    HashCalculatePrintableRepresentation(hash);
+/*
+ * Constructors
+ * All constructors call two common methods: HashBasicInit(...) and HashCalculatePrintableRepresentation(...).
+ * Each constructor reads the data to create the Hash from different sources so after the basic
+ * initialization and up to the point where the hash is computed, each follows its own path.
+ */
+Hash *HashNew(const char *data, const unsigned int length, HashMethod method)
+{
+    if (!data || (length == 0))
+    {
+        return NULL;
+    }
+    if (method >= HASH_METHOD_NONE)
+    {
+        return NULL;
+    }
+
+    bool owned;
+    HashContext *const context = HashContextAcquire(method, &owned);
+    if (context == NULL)
+    {
+        return NULL;
+    }
+    HashContextUpdate(context, data, (size_t) length);
+    Hash *const hash = HashContextFinalHash(context);
+    HashContextRelease(context, owned);
 
-    EVP_MD_CTX_destroy(context);
     return hash;
 }
 
+Hash *HashNewFromDescriptor(const int descriptor, HashMethod method)
+{
+    if (descriptor < 0)
+    {
+        return NULL;
+    }
+    if (method >= HASH_METHOD_NONE)
+    {
+        return NULL;
+    }
+
+    HashFileDigests digests;
+    if (!HashDescriptorMulti(descriptor, &method, 1, &digests))
+    {
+        return NULL;
+    }
+    return digests.hashes[method];
+}
+
 Hash *HashNewFromKey(const RSA *rsa, HashMethod method)
 {
     if (rsa == NULL)
@@ -395,14 +564,21 @@ HashSize HashSizeFromId(HashMethod hash_id)
     return (hash_id >= HASH_METHOD_NONE) ? CF_NO_HASH : CF_DIGEST_SIZES[hash_id];
 }
 
+/* Files are read in big chunks, much fewer system calls than with small
+ * ones and still small enough to stay in the cache while all the digests
+ * are updated from it. */
+#define HASH_READ_BUFFER_SIZE (128 * 1024)
+
 static void HashFile_Stream(
     FILE *const file,
     unsigned char digest[EVP_MAX_MD_SIZE + 1],
     const HashMethod type)
 {
     assert(file != NULL);
-    const EVP_MD *const md = HashDigestFromId(type);
-    if (md == NULL)
+
+    bool owned;
+    HashContext *const context = HashContextAcquire(type, &owned);
+    if (context == NULL)
     {
         Log(LOG_LEVEL_ERR,
             "Could not determine function for file hashing (type=%d)",
@@ -410,27 +586,16 @@ static void HashFile_Stream(
         return;
     }
 
-    EVP_MD_CTX *const context = EVP_MD_CTX_new();
-    if (context == NULL)
-    {
-        Log(LOG_LEVEL_ERR, "Failed to allocate openssl hashing context");
-        return;
-    }
-
-    if (EVP_DigestInit(context, md) == 1)
+    unsigned char *buffer = xmalloc(HASH_READ_BUFFER_SIZE);
+    size_t len;
+    while ((len = fread(buffer, 1, HASH_READ_BUFFER_SIZE, file)))
     {
-        unsigned char buffer[1024];
-        size_t len;
-        while ((len = fread(buffer, 1, 1024, file)))
-        {
-            EVP_DigestUpdate(context, buffer, len);
-        }
-
-        unsigned int digest_length;
-        EVP_DigestFinal(context, digest, &digest_length);
+        HashContextUpdate(context, buffer, len);
     }
+    free(buffer);
 
-    EVP_MD_CTX_free(context);
+    HashContextFinal(context, digest);
+    HashContextRelease(context, owned);
 }
 
 /**
@@ -473,6 +638,285 @@ void HashFile(
 
 /*******************************************************************/
 
+void HashFileDigestsDestroy(HashFileDigests *digests)
+{
+    if (digests != NULL)
+    {
+        for (size_t i = 0; i < HASH_METHOD_NONE; i++)
+        {
+            HashDestroy(&digests->hashes[i]);
+        }
+        free(digests);
+    }
+}
+
+static void HashFileDigestsDestroy_untyped(void *digests)
+{
+    HashFileDigestsDestroy(digests);
+}
+
+TYPED_MAP_DEFINE(HashFileDigests, char *, HashFileDigests *,
+                 StringHash_untyped,
+                 StringEqual_untyped,
+                 &free,
+                 &HashFileDigestsDestroy_untyped)
+
+/**
+ * @param buffer HASH_READ_BUFFER_SIZE bytes for reading the data
+ */
+static bool HashDescriptorMultiBuffer(
+    const int descriptor,
+    const HashMethod *const methods,
+    const size_t n_methods,
+    HashFileDigests *const digests_out,
+    unsigned char *const buffer)
+{
+    EVP_MD_CTX *contexts[HASH_METHOD_NONE] = { NULL };
+    bool success = true;
+
+    for (size_t i = 0; i < n_methods && success; i++)
+    {
+        const HashMethod method = methods[i];
+        if (method >= HASH_METHOD_NONE || method == HASH_METHOD_CRYPT)
+        {
+            Log(LOG_LEVEL_ERR, "Unsupported hash method (type=%d)", (int) method);
+            success = false;
+            break;
+        }
+        if (contexts[method] != NULL)
+        {
+            continue;           /* duplicate */
+        }
+
+        const EVP_MD *const md = HashDigestFromId(method);
+        if (md == NULL)
+        {
+            Log(LOG_LEVEL_INFO, "Digest (type=%d) not supported by OpenSSL library",
+                (int) method);
+            success = false;
+            break;
+        }
+        contexts[method] = EVP_MD_CTX_new();
+        if (contexts[method] == NULL)
+        {
+            Log(LOG_LEVEL_ERR, "Failed to allocate openssl hashing context");
+            success = false;
+        }
+        else if (EVP_DigestInit_ex(contexts[method], md, NULL) != 1)
+        {
+            Log(LOG_LEVEL_ERR, "Could not initialize openssl hash context");
+            success = false;
+        }
+    }
+
+    while (success)
+    {
+        const ssize_t read_count = read(descriptor, buffer, HASH_READ_BUFFER_SIZE);
+        if (read_count == 0)
+        {
+            break;
+        }
+        if (read_count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Log(LOG_LEVEL_ERR, "Failed to read data for hashing (read: %s)",
+                GetErrorStr());
+            success = false;
+            break;
+        }
+
+        /* The same data for all the digests while it is in the cache. */
+        for (size_t i = 0; i < HASH_METHOD_NONE; i++)
+        {
+            if (contexts[i] != NULL)
+            {
+                EVP_DigestUpdate(contexts[i], buffer, (size_t) read_count);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < HASH_METHOD_NONE; i++)
+    {
+        digests_out->hashes[i] = NULL;
+        if (contexts[i] == NULL)
+        {
+            continue;
+        }
+        if (success)
+        {
+            Hash *const hash = HashBasicInit(i); // xcalloc, cannot be NULL
+            unsigned int md_len;
+            EVP_DigestFinal_ex(contexts[i], hash->digest, &md_len);
+            HashCalculatePrintableRepresentation(hash);
+            digests_out->hashes[i] = hash;
+        }
+        EVP_MD_CTX_free(contexts[i]);
+    }
+
+    return success;
+}
+
+bool HashDescriptorMulti(
+    const int descriptor,
+    const HashMethod *const methods,
+    const size_t n_methods,
+    HashFileDigests *const digests_out)
+{
+    assert(methods != NULL || n_methods == 0);
+    assert(digests_out != NULL);
+
+    unsigned char *const buffer = xmalloc(HASH_READ_BUFFER_SIZE);
+    const bool success = HashDescriptorMultiBuffer(descriptor, methods, n_methods,
+                                                   digests_out, buffer);
+    free(buffer);
+    return success;
+}
+
+static bool HashFileMultiBuffer(
+    const char *const filename,
+    const HashMethod *const methods,
+    const size_t n_methods,
+    HashFileDigests *const digests_out,
+    unsigned char *const buffer)
+{
+    const int fd = safe_open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_INFO, "Cannot open file for hashing '%s'. (open: %s)",
+            filename, GetErrorStr());
+        return false;
+    }
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    const bool success = HashDescriptorMultiBuffer(fd, methods, n_methods,
+                                                   digests_out, buffer);
+    close(fd);
+    return success;
+}
+
+bool HashFileMulti(
+    const char *const filename,
+    const HashMethod *const methods,
+    const size_t n_methods,
+    HashFileDigests *const digests_out)
+{
+    assert(filename != NULL);
+    assert(methods != NULL || n_methods == 0);
+    assert(digests_out != NULL);
+
+    unsigned char *const buffer = xmalloc(HASH_READ_BUFFER_SIZE);
+    const bool success = HashFileMultiBuffer(filename, methods, n_methods,
+                                             digests_out, buffer);
+    free(buffer);
+    return success;
+}
+
+typedef struct
+{
+    const char *const *filenames;
+    size_t n_files;
+    const HashMethod *methods;
+    size_t n_methods;
+
+    pthread_mutex_t lock;       /* protects the fields below */
+    size_t next;                /* index of the next file to hash */
+    HashFileDigestsMap *results;
+} HashFilesBatchState;
+
+static void *HashFilesBatchWorker(void *arg)
+{
+    HashFilesBatchState *const state = arg;
+    unsigned char *const buffer = xmalloc(HASH_READ_BUFFER_SIZE);
+
+    while (true)
+    {
+        ThreadLock(&state->lock);
+        const size_t i = state->next++;
+        ThreadUnlock(&state->lock);
+        if (i >= state->n_files)
+        {
+            break;
+        }
+
+        HashFileDigests *const digests = xmalloc(sizeof(HashFileDigests));
+        if (!HashFileMultiBuffer(state->filenames[i], state->methods,
+                                 state->n_methods, digests, buffer))
+        {
+            free(digests);
+            continue;
+        }
+
+        ThreadLock(&state->lock);
+        HashFileDigestsMapInsert(state->results, xstrdup(state->filenames[i]),
+                                 digests);
+        ThreadUnlock(&state->lock);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+HashFileDigestsMap *HashFilesBatch(
+    const char *const *const filenames,
+    const size_t n_files,
+    const HashMethod *const methods,
+    const size_t n_methods,
+    size_t n_threads)
+{
+    assert(filenames != NULL || n_files == 0);
+    assert(methods != NULL || n_methods == 0);
+
+    HashFilesBatchState state = {
+        .filenames = filenames,
+        .n_files = n_files,
+        .methods = methods,
+        .n_methods = n_methods,
+        .next = 0,
+        .results = HashFileDigestsMapNew(),
+    };
+    pthread_mutex_init(&state.lock, NULL);
+
+    if (n_threads > n_files)
+    {
+        n_threads = n_files;
+    }
+
+    /* The calling thread is one of the workers. */
+    const size_t n_extra = (n_threads > 1) ? (n_threads - 1) : 0;
+    pthread_t *const threads = xcalloc(MAX(n_extra, 1), sizeof(pthread_t));
+    size_t n_started = 0;
+    if (n_extra > 0)
+    {
+        for (; n_started < n_extra; n_started++)
+        {
+            if (pthread_create(&threads[n_started], NULL,
+                               HashFilesBatchWorker, &state) != 0)
+            {
+                Log(LOG_LEVEL_ERR, "Failed to start a thread for hashing files");
+                break;
+            }
+        }
+    }
+
+    HashFilesBatchWorker(&state);
+
+    for (size_t i = 0; i < n_started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&state.lock);
+
+    return state.results;
+}
+
+/*******************************************************************/
+
 void HashString(
     const char *const buffer,
     const int len,
@@ -492,8 +936,9 @@ void HashString(
         return;
     }
 
-    const EVP_MD *const md = HashDigestFromId(type);
-    if (md == NULL)
+    bool owned;
+    HashContext *const context = HashContextAcquire(type, &owned);
+    if (context == NULL)
     {
         Log(LOG_LEVEL_ERR,
             "Could not determine function for file hashing (type=%d)",
@@ -501,26 +946,9 @@ void HashString(
         return;
     }
 
-    EVP_MD_CTX *const context = EVP_MD_CTX_new();
-    if (context == NULL)
-    {
-        Log(LOG_LEVEL_ERR, "Failed to allocate openssl hashing context");
-        return;
-    }
-
-    if (EVP_DigestInit(context, md) == 1)
-    {
-        EVP_DigestUpdate(context, buffer, len);
-        EVP_DigestFinal(context, digest, NULL);
-    }
-    else
-    {
-        Log(LOG_LEVEL_ERR,
-            "Failed to initialize digest for hashing: '%s'",
-            buffer);
-    }
-
-    EVP_MD_CTX_free(context);
+    HashContextUpdate(context, buffer, len);
+    HashContextFinal(context, digest);
+    HashContextRelease(context, owned);
 }
 
 /*******************************************************************/
@@ -33,6 +33,7 @@
 
 #include <stdbool.h>
 #include <hash_method.h>                            /* HashMethod, HashSize */
+#include <map.h>
 
 
 typedef struct Hash Hash;
@@ -146,6 +147,111 @@ const EVP_MD *HashDigestFromId(HashMethod type);
   */
 HashSize HashSizeFromId(HashMethod hash_id);
 
+/**
+  @brief Incremental hashing, reusable for many messages.
+
+  Creating an OpenSSL digest context and initializing it is much more
+  expensive than hashing a short string, so a HashContext keeps an
+  initialized context around and starts each message from a copy of it.
+  */
+typedef struct HashContext HashContext;
+
+/**
+  @brief Creates a new hashing context.
+  @param method Hash method.
+  @return A new context or NULL if the method is not supported.
+  */
+HashContext *HashContextNew(HashMethod method);
+
+/**
+  @brief Destroys a hashing context.
+  @param context The context to destroy, may be NULL.
+  */
+void HashContextDestroy(HashContext *context);
+
+/**
+  @brief Hash method of a context.
+  */
+HashMethod HashContextMethod(const HashContext *context);
+
+/**
+  @brief Adds data to the message being hashed.
+  @return True if successful, false in any other case.
+  */
+bool HashContextUpdate(HashContext *context, const void *data, size_t length);
+
+/**
+  @brief Finishes the message and resets the context for the next one.
+  @param digest Where to store the digest.
+  @return The length of the digest or CF_NO_HASH in case of error.
+  */
+HashSize HashContextFinal(HashContext *context,
+                          unsigned char digest[EVP_MAX_MD_SIZE + 1]);
+
+/**
+  @brief Same as HashContextFinal(), but creating a Hash structure.
+  */
+Hash *HashContextFinalHash(HashContext *context);
+
+/**
+  @brief Discards the data added since the last HashContextFinal().
+  */
+void HashContextReset(HashContext *context);
+
+/**
+  @brief Returns a context for #method owned by the calling thread.
+
+  The context is created on the first use in each thread and destroyed when
+  the thread exits, it must not be destroyed by the caller. It is not
+  shared with the other functions in this file, so it can be kept across
+  calls to them.
+
+  @return The thread's context or NULL if the method is not supported.
+  */
+HashContext *HashContextGetCached(HashMethod method);
+
+/**
+  @brief Digests of one file, indexed by HashMethod (NULL for the methods
+         which were not requested).
+  */
+typedef struct
+{
+    Hash *hashes[HASH_METHOD_NONE];
+} HashFileDigests;
+
+void HashFileDigestsDestroy(HashFileDigests *digests);
+
+TYPED_MAP_DECLARE(HashFileDigests, char *, HashFileDigests *)
+
+/**
+  @brief Computes the digests for all the #methods reading the data only once.
+  @param descriptor File (or socket) descriptor to read until EOF.
+  @param methods Hash methods, duplicates are ignored.
+  @param digests_out Where to store the new Hash structures.
+  @return True if successful, false (and no hashes) in case of error.
+  */
+bool HashDescriptorMulti(int descriptor, const HashMethod *methods,
+                         size_t n_methods, HashFileDigests *digests_out);
+
+/**
+  @brief Same as HashDescriptorMulti() for the file #filename.
+  */
+bool HashFileMulti(const char *filename, const HashMethod *methods,
+                   size_t n_methods, HashFileDigests *digests_out);
+
+/**
+  @brief Computes the digests of many files, using up to #n_threads threads.
+  @param filenames Files to hash.
+  @param methods Hash methods to compute for each file.
+  @param n_threads Number of worker threads, 0 or 1 to hash the files in the
+                   calling thread.
+  @return Map from the file names to their digests, files which could not be
+          read are not included.
+  */
+HashFileDigestsMap *HashFilesBatch(const char *const *filenames, size_t n_files,
+                                   const HashMethod *methods, size_t n_methods,
+                                   size_t n_threads);
+
 /* Enough room for "SHA=asdfasdfasdf". */
 #define CF_HOSTKEY_STRING_SIZE (4 + 2 * EVP_MAX_MD_SIZE + 1)
 
@@ -0,0 +1,554 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <hash_cache.h>
+
+#include <sys/mman.h>                                       /* mmap */
+
+#include <alloc.h>
+#include <logging.h>
+#include <file_lib.h>                               /* FileLock, safe_open */
+#include <mutex.h>                                          /* ThreadLock */
+
+#define HASH_CACHE_MAGIC "CFHCACHE"
+#define HASH_CACHE_VERSION 1
+
+/* Slots probed for an entry, after that the first one is reused */
+#define HASH_CACHE_MAX_PROBES 16
+
+/* Files changed this recently are not stored (see HashCacheFile()) */
+#define HASH_CACHE_RACY_NS INT64_C(1000000000)
+
+/* On-disk layout, in the byte order of the host. */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t n_entries;         /* power of 2 */
+    char reserved[40];
+} HashCacheHeader;
+
+typedef struct
+{
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+    uint8_t used;
+    uint8_t method;
+    uint8_t digest_len;
+    char reserved[5];
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    char reserved2[16];
+} HashCacheEntry;
+
+struct HashCache
+{
+    char *path;
+    FileLock lock;              /* lock.fd is the open cache file */
+    pthread_mutex_t mutex;
+    void *map;
+    size_t map_size;
+    HashCacheEntry *entries;
+    size_t n_entries;
+
+    HashCacheStats stats;
+};
+
+/* fcntl() locks don't exclude threads of the same process from each other
+ * and closing any fd of a file drops all the locks the process holds on
+ * it. Opening (and possibly replacing) and closing cache files is thus
+ * serialized within the process. */
+static pthread_mutex_t open_close_mutex = PTHREAD_MUTEX_INITIALIZER; /* GLOBAL_T */
+
+static inline int64_t TimespecToNs(time_t sec, long nsec)
+{
+    return (int64_t) sec * INT64_C(1000000000) + nsec;
+}
+
+static int64_t StatMtimeNs(const struct stat *sb)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+    return TimespecToNs(sb->st_mtim.tv_sec, sb->st_mtim.tv_nsec);
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return TimespecToNs(sb->st_mtimespec.tv_sec, sb->st_mtimespec.tv_nsec);
+#else
+    return TimespecToNs(sb->st_mtime, 0);
+#endif
+}
+
+static int64_t StatCtimeNs(const struct stat *sb)
+{
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+    return TimespecToNs(sb->st_ctim.tv_sec, sb->st_ctim.tv_nsec);
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return TimespecToNs(sb->st_ctimespec.tv_sec, sb->st_ctimespec.tv_nsec);
+#else
+    return TimespecToNs(sb->st_ctime, 0);
+#endif
+}
+
+static bool HashCacheHeaderValid(const HashCacheHeader *header, off_t file_size)
+{
+    return (memcmp(header->magic, HASH_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+            header->version == HASH_CACHE_VERSION &&
+            header->entry_size == sizeof(HashCacheEntry) &&
+            header->n_entries > 0 &&
+            (header->n_entries & (header->n_entries - 1)) == 0 &&
+            (uint64_t) file_size == sizeof(HashCacheHeader) +
+                                    header->n_entries * sizeof(HashCacheEntry));
+}
+
+/**
+ * @return The size of the cache file #fd if it is valid, 0 if it is empty
+ *         (just created) and -1 otherwise.
+ */
+static off_t HashCacheValidSize(int fd)
+{
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+        return -1;
+    }
+    if (sb.st_size == 0)
+    {
+        return 0;
+    }
+
+    HashCacheHeader header;
+    if ((size_t) sb.st_size >= sizeof(header) &&
+        pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        HashCacheHeaderValid(&header, sb.st_size))
+    {
+        return sb.st_size;
+    }
+    return -1;
+}
+
+/**
+ * @brief Turn the empty file #fd into a cache with #n_entries entries.
+ *
+ * The file only grows, so this is safe even if it's mapped elsewhere, and
+ * it's sparse until the entries are used.
+ *
+ * @return The size of the file or -1 in case of error.
+ */
+static off_t HashCacheInitFile(int fd, const char *path, size_t n_entries)
+{
+    size_t n = 1;
+    while (n < n_entries)
+    {
+        n <<= 1;
+    }
+
+    HashCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HASH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = HASH_CACHE_VERSION;
+    header.entry_size = sizeof(HashCacheEntry);
+    header.n_entries = n;
+
+    const off_t size = sizeof(header) + n * sizeof(HashCacheEntry);
+    if (ftruncate(fd, size) != 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+    {
+        Log(LOG_LEVEL_ERR, "Failed to initialize hash cache '%s' (%s)",
+            path, GetErrorStr());
+        return -1;
+    }
+    return size;
+}
+
+/**
+ * @brief Open #path and lock it exclusively.
+ *
+ * The file may have been replaced (see HashCacheReplaceFile()) while
+ * waiting for the lock, in that case the new one is opened.
+ *
+ * @return True if successful, with #lock holding the file.
+ */
+static bool HashCacheOpenLocked(const char *path, FileLock *lock)
+{
+    for (int tries = 0; tries < 16; tries++)
+    {
+        const int fd = safe_open_create_perms(path, O_RDWR | O_CREAT | O_BINARY, 0600);
+        if (fd < 0)
+        {
+            Log(LOG_LEVEL_ERR, "Failed to open hash cache '%s' (open: %s)",
+                path, GetErrorStr());
+            return false;
+        }
+
+        lock->fd = fd;
+        if (ExclusiveFileLock(lock, true) != 0)
+        {
+            Log(LOG_LEVEL_ERR, "Failed to lock hash cache '%s'", path);
+            close(fd);
+            return false;
+        }
+
+        struct stat fd_sb, path_sb;
+        if (fstat(fd, &fd_sb) == 0 && stat(path, &path_sb) == 0 &&
+            fd_sb.st_dev == path_sb.st_dev && fd_sb.st_ino == path_sb.st_ino)
+        {
+            return true;
+        }
+        ExclusiveFileUnlock(lock, true);
+    }
+
+    Log(LOG_LEVEL_ERR, "Failed to open hash cache '%s' (keeps being replaced)", path);
+    return false;
+}
+
+/**
+ * @brief Replace the invalid cache file at #path (locked by #lock) with a
+ *        new one with #n_entries entries.
+ *
+ * Other processes may still have the old file mapped (e.g. an older
+ * version), so it's not truncated, which would make them crash with SIGBUS
+ * when touching the entries. The new cache is built in a temporary file
+ * that is renamed over #path, the old one goes away once they close it.
+ *
+ * @return The size of the new file or -1 in case of error. On success,
+ *         #lock holds the new file instead of the old one.
+ */
+static off_t HashCacheReplaceFile(const char *path, size_t n_entries, FileLock *lock)
+{
+    Log(LOG_LEVEL_VERBOSE, "Reinitializing invalid hash cache '%s'", path);
+
+    char *tmp_path;
+    xasprintf(&tmp_path, "%s.%ju.tmp", path, (uintmax_t) getpid());
+
+    const int fd = safe_open_create_perms(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0600);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to create hash cache '%s' (open: %s)",
+            tmp_path, GetErrorStr());
+        free(tmp_path);
+        return -1;
+    }
+
+    /* Locked before it's visible at #path, nobody can use it before it's
+     * initialized */
+    FileLock new_lock = { .fd = fd };
+    off_t size = -1;
+    if (ExclusiveFileLock(&new_lock, true) != 0)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to lock hash cache '%s'", tmp_path);
+    }
+    else
+    {
+        size = HashCacheInitFile(fd, tmp_path, n_entries);
+        if (size >= 0 && rename(tmp_path, path) != 0)
+        {
+            Log(LOG_LEVEL_ERR, "Failed to replace hash cache '%s' (rename: %s)",
+                path, GetErrorStr());
+            size = -1;
+        }
+    }
+
+    if (size < 0)
+    {
+        unlink(tmp_path);
+        close(fd);
+    }
+    else
+    {
+        ExclusiveFileUnlock(lock, true);
+        *lock = new_lock;
+    }
+    free(tmp_path);
+    return size;
+}
+
+HashCache *HashCacheOpen(const char *path, size_t n_entries)
+{
+    assert(path != NULL);
+
+    if (n_entries == 0)
+    {
+        n_entries = HASH_CACHE_DEFAULT_ENTRIES;
+    }
+
+    ThreadLock(&open_close_mutex);
+    FileLock lock = { .fd = -1 };
+    if (!HashCacheOpenLocked(path, &lock))
+    {
+        ThreadUnlock(&open_close_mutex);
+        return NULL;
+    }
+
+    off_t size = HashCacheValidSize(lock.fd);
+    if (size == 0)
+    {
+        /* Just created, nobody can have it mapped */
+        size = HashCacheInitFile(lock.fd, path, n_entries);
+    }
+    else if (size < 0)
+    {
+        size = HashCacheReplaceFile(path, n_entries, &lock);
+    }
+    const int fd = lock.fd;
+    ExclusiveFileUnlock(&lock, false);
+    if (size < 0)
+    {
+        close(fd);
+        ThreadUnlock(&open_close_mutex);
+        return NULL;
+    }
+    ThreadUnlock(&open_close_mutex);
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to map hash cache '%s' (mmap: %s)",
+            path, GetErrorStr());
+        close(fd);
+        return NULL;
+    }
+
+    HashCache *cache = xcalloc(1, sizeof(HashCache));
+    cache->path = xstrdup(path);
+    cache->lock = lock;
+    pthread_mutex_init(&cache->mutex, NULL);
+    cache->map = map;
+    cache->map_size = size;
+    cache->entries = (HashCacheEntry *) ((char *) map + sizeof(HashCacheHeader));
+    cache->n_entries = ((const HashCacheHeader *) map)->n_entries;
+    return cache;
+}
+
+void HashCacheClose(HashCache *cache)
+{
+    if (cache != NULL)
+    {
+        munmap(cache->map, cache->map_size);
+        ThreadLock(&open_close_mutex);
+        close(cache->lock.fd);
+        ThreadUnlock(&open_close_mutex);
+        pthread_mutex_destroy(&cache->mutex);
+        free(cache->path);
+        free(cache);
+    }
+}
+
+static size_t HashCacheHomeSlot(const HashCache *cache, uint64_t dev, uint64_t ino,
+                                HashMethod method)
+{
+    /* splitmix64 finalizer */
+    uint64_t h = ino ^ (dev * UINT64_C(0x9E3779B97F4A7C15)) ^ ((uint64_t) method << 56);
+    h ^= h >> 30;
+    h *= UINT64_C(0xBF58476D1CE4E5B9);
+    h ^= h >> 27;
+    h *= UINT64_C(0x94D049BB133111EB);
+    h ^= h >> 31;
+    return h & (cache->n_entries - 1);
+}
+
+static inline bool EntryIsFor(const HashCacheEntry *entry, uint64_t dev, uint64_t ino,
+                              HashMethod method)
+{
+    return (entry->used && entry->dev == dev && entry->ino == ino &&
+            entry->method == (uint8_t) method);
+}
+
+/**
+ * @return The entry for the file or NULL if there is none.
+ */
+static HashCacheEntry *HashCacheFind(HashCache *cache, uint64_t dev, uint64_t ino,
+                                     HashMethod method)
+{
+    const size_t home = HashCacheHomeSlot(cache, dev, ino, method);
+    for (size_t i = 0; i < HASH_CACHE_MAX_PROBES; i++)
+    {
+        HashCacheEntry *const entry = &cache->entries[(home + i) & (cache->n_entries - 1)];
+        if (!entry->used)
+        {
+            return NULL;
+        }
+        if (EntryIsFor(entry, dev, ino, method))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @return The slot to store the entry for the file in: its current one,
+ *         the first free one, or the home slot if all the probed slots
+ *         are taken by other files.
+ */
+static HashCacheEntry *HashCacheSlotFor(HashCache *cache, uint64_t dev, uint64_t ino,
+                                        HashMethod method)
+{
+    const size_t home = HashCacheHomeSlot(cache, dev, ino, method);
+    for (size_t i = 0; i < HASH_CACHE_MAX_PROBES; i++)
+    {
+        HashCacheEntry *const entry = &cache->entries[(home + i) & (cache->n_entries - 1)];
+        if (!entry->used || EntryIsFor(entry, dev, ino, method))
+        {
+            return entry;
+        }
+    }
+    return &cache->entries[home];
+}
+
+static bool EntryMatchesStat(const HashCacheEntry *entry, const struct stat *sb)
+{
+    return (entry->size == (uint64_t) sb->st_size &&
+            entry->mtime_ns == StatMtimeNs(sb) &&
+            entry->ctime_ns == StatCtimeNs(sb));
+}
+
+static bool SameStat(const struct stat *a, const struct stat *b)
+{
+    return (a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+            a->st_size == b->st_size &&
+            StatMtimeNs(a) == StatMtimeNs(b) && StatCtimeNs(a) == StatCtimeNs(b));
+}
+
+static bool IsRacy(const struct stat *sb)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    const int64_t limit = TimespecToNs(now.tv_sec, now.tv_nsec) - HASH_CACHE_RACY_NS;
+    return (StatMtimeNs(sb) >= limit || StatCtimeNs(sb) >= limit);
+}
+
+bool HashCacheFile(HashCache *cache, const char *filename, HashMethod method,
+                   unsigned char digest[EVP_MAX_MD_SIZE + 1])
+{
+    assert(cache != NULL);
+    assert(filename != NULL);
+    assert(digest != NULL);
+
+    memset(digest, 0, EVP_MAX_MD_SIZE + 1);
+
+    const HashSize digest_len = HashSizeFromId(method);
+    if (method >= HASH_METHOD_NONE || method == HASH_METHOD_CRYPT ||
+        digest_len == CF_NO_HASH || digest_len > EVP_MAX_MD_SIZE)
+    {
+        Log(LOG_LEVEL_ERR, "Unsupported hash method (type=%d)", (int) method);
+        return false;
+    }
+
+    const int fd = safe_open(filename, O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_INFO, "Cannot open file for hashing '%s'. (open: %s)",
+            filename, GetErrorStr());
+        return false;
+    }
+
+    struct stat before;
+    if (fstat(fd, &before) != 0)
+    {
+        Log(LOG_LEVEL_INFO, "Cannot stat file for hashing '%s'. (fstat: %s)",
+            filename, GetErrorStr());
+        close(fd);
+        return false;
+    }
+
+    bool hit = false;
+    ThreadLock(&cache->mutex);
+    if (SharedFileLock(&cache->lock, true) == 0)
+    {
+        const HashCacheEntry *const entry =
+            HashCacheFind(cache, before.st_dev, before.st_ino, method);
+        if (entry != NULL && EntryMatchesStat(entry, &before) &&
+            entry->digest_len == digest_len)
+        {
+            memcpy(digest, entry->digest, digest_len);
+            hit = true;
+        }
+        SharedFileUnlock(&cache->lock, false);
+    }
+    ThreadUnlock(&cache->mutex);
+
+    if (hit)
+    {
+        close(fd);
+        __atomic_add_fetch(&cache->stats.hits, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    __atomic_add_fetch(&cache->stats.misses, 1, __ATOMIC_RELAXED);
+
+    HashFileDigests digests;
+    const bool hashed = HashDescriptorMulti(fd, &method, 1, &digests);
+    struct stat after;
+    const bool unchanged = (fstat(fd, &after) == 0 && SameStat(&before, &after));
+    close(fd);
+    if (!hashed)
+    {
+        Log(LOG_LEVEL_INFO, "Failed to hash file '%s'", filename);
+        return false;
+    }
+
+    unsigned int length;
+    memcpy(digest, HashData(digests.hashes[method], &length), digest_len);
+    HashDestroy(&digests.hashes[method]);
+
+    /* Only store digests which certainly belong to the metadata. */
+    if (!unchanged || IsRacy(&after))
+    {
+        return true;
+    }
+
+    ThreadLock(&cache->mutex);
+    if (ExclusiveFileLock(&cache->lock, true) == 0)
+    {
+        HashCacheEntry *const entry =
+            HashCacheSlotFor(cache, after.st_dev, after.st_ino, method);
+        /* Marked as used only when complete, a crash in between can't
+         * leave a new digest with stale metadata behind. */
+        entry->used = 0;
+        entry->dev = after.st_dev;
+        entry->ino = after.st_ino;
+        entry->method = method;
+        entry->size = after.st_size;
+        entry->mtime_ns = StatMtimeNs(&after);
+        entry->ctime_ns = StatCtimeNs(&after);
+        entry->digest_len = digest_len;
+        memcpy(entry->digest, digest, digest_len);
+        __atomic_store_n(&entry->used, 1, __ATOMIC_RELEASE);
+        ExclusiveFileUnlock(&cache->lock, false);
+        __atomic_add_fetch(&cache->stats.stores, 1, __ATOMIC_RELAXED);
+    }
+    ThreadUnlock(&cache->mutex);
+
+    return true;
+}
+
+void HashCacheGetStats(const HashCache *cache, HashCacheStats *stats)
+{
+    assert(cache != NULL);
+    assert(stats != NULL);
+
+    stats->hits = __atomic_load_n(&cache->stats.hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&cache->stats.misses, __ATOMIC_RELAXED);
+    stats->stores = __atomic_load_n(&cache->stats.stores, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,85 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_HASH_CACHE_H
+#define CFENGINE_HASH_CACHE_H
+
+#include <hash.h>
+
+/**
+ * Persistent cache of file digests.
+ *
+ * The digests are stored in a memory-mapped table keyed by the device and
+ * inode number of the file (and the hash method) together with its size,
+ * modification and status change times. A file whose metadata didn't change
+ * since it was hashed is not read again.
+ *
+ * The table can be shared by several processes, lookups are done under a
+ * shared lock and updates under an exclusive lock of the file, threads of
+ * one process are serialized by a mutex.
+ *
+ * A process should open a given cache file only once and share the
+ * HashCache between its threads: the file locks of two HashCache objects
+ * of one process don't exclude each other.
+ */
+typedef struct HashCache HashCache;
+
+typedef struct
+{
+    size_t hits;        /* digests taken from the cache */
+    size_t misses;      /* digests computed */
+    size_t stores;      /* digests added to or updated in the cache */
+} HashCacheStats;
+
+/* Number of entries of a new cache file if not specified */
+#define HASH_CACHE_DEFAULT_ENTRIES (256 * 1024)
+
+/**
+ * @brief Open the cache file #path, creating it if it doesn't exist.
+ * @param n_entries Number of entries when a new file is created (0 for the
+ *                  default), ignored for an existing valid file.
+ * @return The cache or NULL in case of error (logged).
+ */
+HashCache *HashCacheOpen(const char *path, size_t n_entries);
+
+void HashCacheClose(HashCache *cache);
+
+/**
+ * @brief Get the #method digest of #filename, from the cache if the file
+ *        didn't change, otherwise computing it and updating the cache.
+ *
+ * Files modified less than a second ago are hashed but not stored, their
+ * timestamps could still be the same after another modification.
+ *
+ * @param digest Where to store the digest.
+ * @return True if successful, false if the file could not be hashed.
+ */
+bool HashCacheFile(HashCache *cache, const char *filename, HashMethod method,
+                   unsigned char digest[EVP_MAX_MD_SIZE + 1]);
+
+/**
+ * @brief Statistics of the lookups done through #cache since it was opened.
+ */
+void HashCacheGetStats(const HashCache *cache, HashCacheStats *stats);
+
+#endif /* CFENGINE_HASH_CACHE_H */
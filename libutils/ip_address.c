@@ -28,10 +28,6 @@
 #include <ip_address.h>
 #include <alloc.h>
 
-#ifdef WITH_PCRE2
-#include <regex.h>
-#endif
-
 struct IPV4Address {
     uint8_t octets[4];
     uint16_t port;
@@ -961,32 +957,26 @@ IPAddress *IPAddressNew(Buffer *source)
     }
     IPAddress *address = NULL;
     const char *pad = BufferData(source);
-    struct IPV4Address *ipv4 = NULL;
-    struct IPV6Address *ipv6 = NULL;
-    ipv4 = (struct IPV4Address *)xmalloc(sizeof(struct IPV4Address));
-    ipv6 = (struct IPV6Address *)xmalloc(sizeof(struct IPV6Address));
+    struct IPV4Address ipv4;
+    struct IPV6Address ipv6;
 
-    if (IPV4_parser(pad, ipv4) == 0)
+    if (IPV4_parser(pad, &ipv4) == 0)
     {
-        free (ipv6);
         address = (IPAddress *)xmalloc(sizeof(IPAddress));
         address->type = IP_ADDRESS_TYPE_IPV4;
-        address->address = (void *)ipv4;
+        address->address = xmemdup(&ipv4, sizeof(ipv4));
     }
-    else if (IPV6_parser(pad, ipv6) == 0)
+    else if (IPV6_parser(pad, &ipv6) == 0)
     {
-        free (ipv4);
         address = (IPAddress *)xmalloc(sizeof(IPAddress));
         address->type = IP_ADDRESS_TYPE_IPV6;
-        address->address = (void *)ipv6;
+        address->address = xmemdup(&ipv6, sizeof(ipv6));
     }
     else
     {
         /*
          * It was not a valid IP address.
          */
-        free (ipv4);
-        free (ipv6);
         return NULL;
     }
     return address;
@@ -1000,32 +990,26 @@ IPAddress *IPAddressNewHex(Buffer *source)
     }
     IPAddress *address = NULL;
     const char *pad = BufferData(source);
-    struct IPV4Address *ipv4 = NULL;
-    struct IPV6Address *ipv6 = NULL;
-    ipv4 = (struct IPV4Address *)xmalloc(sizeof(struct IPV4Address));
-    ipv6 = (struct IPV6Address *)xmalloc(sizeof(struct IPV6Address));
+    struct IPV4Address ipv4;
+    struct IPV6Address ipv6;
 
-    if (IPV4_hex_parser(pad, ipv4) == 0)
+    if (IPV4_hex_parser(pad, &ipv4) == 0)
     {
-        free (ipv6);
         address = (IPAddress *)xmalloc(sizeof(IPAddress));
         address->type = IP_ADDRESS_TYPE_IPV4;
-        address->address = (void *)ipv4;
+        address->address = xmemdup(&ipv4, sizeof(ipv4));
     }
-    else if (IPV6_hex_parser(pad, ipv6) == 0)
+    else if (IPV6_hex_parser(pad, &ipv6) == 0)
     {
-        free (ipv4);
         address = (IPAddress *)xmalloc(sizeof(IPAddress));
         address->type = IP_ADDRESS_TYPE_IPV6;
-        address->address = (void *)ipv6;
+        address->address = xmemdup(&ipv6, sizeof(ipv6));
     }
     else
     {
         /*
          * It was not a valid IP address.
          */
-        free (ipv4);
-        free (ipv6);
         return NULL;
     }
     return address;
@@ -1277,50 +1261,25 @@ bool IPAddressIsIPAddress(Buffer *source, IPAddress **address)
     {
         return false;
     }
-    bool create_object = false;
-    if (address)
-    {
-        create_object = true;
-    }
     const char *pad = BufferData(source);
-    struct IPV4Address *ipv4 = NULL;
-    struct IPV6Address *ipv6 = NULL;
-    ipv4 = (struct IPV4Address *)xmalloc(sizeof(struct IPV4Address));
-    ipv6 = (struct IPV6Address *)xmalloc(sizeof(struct IPV6Address));
-    if (IPV4_parser(pad, ipv4) == 0)
+    struct IPV4Address ipv4;
+    struct IPV6Address ipv6;
+    if (IPV4_parser(pad, &ipv4) == 0)
     {
-        free (ipv6);
-        if (create_object)
+        if (address)
         {
             *address = (IPAddress *)xmalloc(sizeof(IPAddress));
             (*address)->type = IP_ADDRESS_TYPE_IPV4;
-            (*address)->address = (void *)ipv4;
-        }
-        else
-        {
-            /*
-             * We know it is a valid IPV4 address and we know we don't need the
-             * IPV4 structure.
-             */
-            free (ipv4);
+            (*address)->address = xmemdup(&ipv4, sizeof(ipv4));
         }
     }
-    else if (IPV6_parser(pad, ipv6) == 0)
+    else if (IPV6_parser(pad, &ipv6) == 0)
     {
-        free (ipv4);
-        if (create_object)
+        if (address)
         {
             *address = (IPAddress *)xmalloc(sizeof(IPAddress));
             (*address)->type = IP_ADDRESS_TYPE_IPV6;
-            (*address)->address = (void *)ipv6;
-        }
-        else
-        {
-            /*
-             * We know it is a valid IPV6 address and we know we don't need the
-             * IPV6 structure.
-             */
-            free (ipv6);
+            (*address)->address = xmemdup(&ipv6, sizeof(ipv6));
         }
     }
     else
@@ -1328,25 +1287,604 @@ bool IPAddressIsIPAddress(Buffer *source, IPAddress **address)
         /*
          * It was not a valid IP address.
          */
-        free (ipv4);
-        free (ipv6);
         return false;
     }
     return true;
 }
 
-#ifdef WITH_PCRE2
 bool StringIsLocalHostIP(const char *str)
 {
-    const char *regex =
-        "("
-            // IPv4
-            "(0*127(\\.0*((2[0-5][0-5])|(1?[0-9]?[0-9]))){3}"
-        "|"
-            // Ipv6
-            "0*(((:0+){6})|((:0+){0,5}:)|((:0+){0,4}:(:0+))|((:0+){0,3}:(:0+){2})|((:0+){0,2}:(:0+){3})|((:0+)?:(:0+){4})|(:(:0+){5})):0*1)"
-        ")";
-
-    return StringMatchFull(regex, str);
+    assert(str != NULL);
+
+    /* No brackets or ports, only the plain address forms */
+    if (str[0] == '[')
+    {
+        return false;
+    }
+
+    IPAddressValue value;
+    if (strchr(str, ':') == NULL)
+    {
+        /* 127.0.0.0/8 */
+        return IPAddressValueParse(str, strlen(str), &value, NULL) &&
+               (value.bytes[12] == 127);
+    }
+
+    /* The regex this replaced accepted any number of leading zeros in the
+     * groups (e.g. "00000:00::000:00:00001"), which IPAddressValueParse()
+     * doesn't, so drop the redundant ones first. */
+    char buf[64];
+    size_t len = 0;
+    for (const char *p = str; *p != '\0'; p++)
+    {
+        const bool group_start = (p == str) || (p[-1] == ':');
+        if (group_start)
+        {
+            while (p[0] == '0' && isxdigit((unsigned char) p[1]))
+            {
+                p++;
+            }
+        }
+        if (len == sizeof(buf) - 1)
+        {
+            return false;
+        }
+        buf[len++] = *p;
+    }
+    buf[len] = '\0';
+
+    if (!IPAddressValueParse(buf, len, &value, NULL))
+    {
+        return false;
+    }
+
+    static const IPAddressValue loopback = {
+        .bytes = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 }
+    };
+    return IPAddressValueEqual(&value, &loopback);
+}
+
+/*
+ * IPAddressValue
+ *
+ * These parsers work on a (pointer, end) slice, so they can be used on
+ * substrings without copying, and write straight into the 16 bytes.
+ */
+
+static const uint8_t IPV4_MAPPED_PREFIX[12] =
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+static inline int HexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    c |= 0x20; /* lower case */
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/*
+ * Parse "a.b.c.d" from [p, end) into out[4]. Stops after the last octet and
+ * returns a pointer to the first unparsed byte, or NULL on error.
+ */
+static const char *ParseIPv4Octets(const char *p, const char *end, uint8_t out[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (i > 0)
+        {
+            if (p == end || *p != '.')
+            {
+                return NULL;
+            }
+            p++;
+        }
+
+        const char *const start = p;
+        unsigned int octet = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            octet = octet * 10 + (*p - '0');
+            if (octet > 255)
+            {
+                return NULL;
+            }
+            p++;
+        }
+        if (p == start)
+        {
+            return NULL;
+        }
+        out[i] = octet;
+    }
+    return p;
+}
+
+/*
+ * Parse a complete IPv6 address, [p, end) must contain nothing else.
+ */
+static bool ParseIPv6Bytes(const char *p, const char *end, uint8_t out[16])
+{
+    uint8_t bytes[16];
+    int n_bytes = 0;
+    int gap = -1;               /* position of "::" in bytes, if any */
+
+    if (p < end && *p == ':')
+    {
+        if (end - p < 2 || p[1] != ':')
+        {
+            return false;
+        }
+        p += 2;
+        gap = 0;
+    }
+
+    while (p < end)
+    {
+        const char *const start = p;
+        unsigned int group = 0;
+        int digit;
+        while (p < end && (digit = HexDigitValue(*p)) >= 0)
+        {
+            /* At most 4 hex digits per group (RFC 4291, section 2.2) */
+            if (p - start == 4)
+            {
+                return false;
+            }
+            group = (group << 4) | digit;
+            p++;
+        }
+        if (p == start)
+        {
+            return false;
+        }
+
+        if (p < end && *p == '.')
+        {
+            /* Trailing dotted IPv4 part, as in ::ffff:1.2.3.4 */
+            if (n_bytes > 12 || ParseIPv4Octets(start, end, bytes + n_bytes) != end)
+            {
+                return false;
+            }
+            n_bytes += 4;
+            break;
+        }
+        if (n_bytes == 16)
+        {
+            return false;
+        }
+        bytes[n_bytes++] = group >> 8;
+        bytes[n_bytes++] = group & 0xff;
+
+        if (p == end)
+        {
+            break;
+        }
+        if (*p != ':')
+        {
+            return false;
+        }
+        p++;
+        if (p < end && *p == ':')
+        {
+            if (gap >= 0)
+            {
+                return false;
+            }
+            gap = n_bytes;
+            p++;
+        }
+        else if (p == end)
+        {
+            return false;       /* trailing single ':' */
+        }
+    }
+
+    if (gap >= 0)
+    {
+        /* "::" stands for at least one group of zeros */
+        if (n_bytes == 16)
+        {
+            return false;
+        }
+        const int tail = n_bytes - gap;
+        memset(out, 0, 16);
+        memcpy(out, bytes, gap);
+        memcpy(out + 16 - tail, bytes + gap, tail);
+    }
+    else
+    {
+        if (n_bytes != 16)
+        {
+            return false;
+        }
+        memcpy(out, bytes, 16);
+    }
+    return true;
+}
+
+static bool ParsePort(const char *p, const char *end, int *port_out)
+{
+    if (p == end || end - p > 5)
+    {
+        return false;
+    }
+    int port = 0;
+    for (; p < end; p++)
+    {
+        if (*p < '0' || *p > '9')
+        {
+            return false;
+        }
+        port = port * 10 + (*p - '0');
+    }
+    if (port > 65535)
+    {
+        return false;
+    }
+    *port_out = port;
+    return true;
+}
+
+bool IPAddressValueParse(const char *str, size_t len,
+                         IPAddressValue *value_out, int *port_out)
+{
+    assert(str != NULL || len == 0);
+    assert(value_out != NULL);
+
+    const char *const end = str + len;
+    uint8_t bytes[16];
+    int port = -1;
+
+    if (len > 0 && str[0] == '[')
+    {
+        const char *const close = memchr(str, ']', len);
+        if (close == NULL || !ParseIPv6Bytes(str + 1, close, bytes))
+        {
+            return false;
+        }
+        if (close + 1 < end)
+        {
+            if (close[1] != ':' || !ParsePort(close + 2, end, &port))
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        memcpy(bytes, IPV4_MAPPED_PREFIX, 12);
+        const char *const rest = ParseIPv4Octets(str, end, bytes + 12);
+        if (rest == end)
+        {
+            /* a.b.c.d */
+        }
+        else if (rest != NULL && *rest == ':')
+        {
+            if (!ParsePort(rest + 1, end, &port))
+            {
+                return false;
+            }
+        }
+        else if (!ParseIPv6Bytes(str, end, bytes))
+        {
+            return false;
+        }
+    }
+
+    if (port != -1 && port_out == NULL)
+    {
+        return false;
+    }
+    if (port_out != NULL)
+    {
+        *port_out = port;
+    }
+    memcpy(value_out->bytes, bytes, 16);
+    return true;
+}
+
+static inline char *FormatIPv4Octet(char *buf, unsigned int octet)
+{
+    if (octet >= 100)
+    {
+        *buf++ = '0' + octet / 100;
+        octet %= 100;
+        *buf++ = '0' + octet / 10;
+    }
+    else if (octet >= 10)
+    {
+        *buf++ = '0' + octet / 10;
+    }
+    *buf++ = '0' + octet % 10;
+    return buf;
+}
+
+static char *FormatIPv4Octets(char *buf, const uint8_t octets[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (i > 0)
+        {
+            *buf++ = '.';
+        }
+        buf = FormatIPv4Octet(buf, octets[i]);
+    }
+    return buf;
+}
+
+size_t IPAddressValueFormat(const IPAddressValue *value, char *buf)
+{
+    assert(value != NULL);
+    assert(buf != NULL);
+
+    static const char hex_digits[] = "0123456789abcdef";
+    char *p = buf;
+
+    if (IPAddressValueIsIPv4(value))
+    {
+        p = FormatIPv4Octets(p, value->bytes + 12);
+        *p = '\0';
+        return p - buf;
+    }
+
+    unsigned int groups[8];
+    for (int i = 0; i < 8; i++)
+    {
+        groups[i] = (value->bytes[2 * i] << 8) | value->bytes[2 * i + 1];
+    }
+
+    /* RFC 5952: compress the first longest run of two or more zero groups */
+    int best_start = -1, best_len = 1;
+    for (int i = 0; i < 8; )
+    {
+        if (groups[i] != 0)
+        {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j < 8 && groups[j] == 0)
+        {
+            j++;
+        }
+        if (j - i > best_len)
+        {
+            best_start = i;
+            best_len = j - i;
+        }
+        i = j;
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        if (i == best_start)
+        {
+            *p++ = ':';
+            if (i == 0)
+            {
+                *p++ = ':';
+            }
+            i += best_len - 1;
+            continue;
+        }
+
+        const unsigned int group = groups[i];
+        for (int shift = 12; shift > 0; shift -= 4)
+        {
+            if (group >> shift)
+            {
+                *p++ = hex_digits[(group >> shift) & 0xf];
+            }
+        }
+        *p++ = hex_digits[group & 0xf];
+        if (i < 7)
+        {
+            *p++ = ':';
+        }
+    }
+
+    *p = '\0';
+    return p - buf;
+}
+
+void IPAddressValueFromIPv4(uint32_t ipv4, IPAddressValue *value_out)
+{
+    assert(value_out != NULL);
+
+    memcpy(value_out->bytes, IPV4_MAPPED_PREFIX, 12);
+    value_out->bytes[12] = ipv4 >> 24;
+    value_out->bytes[13] = (ipv4 >> 16) & 0xff;
+    value_out->bytes[14] = (ipv4 >> 8) & 0xff;
+    value_out->bytes[15] = ipv4 & 0xff;
+}
+
+bool IPAddressValueIsIPv4(const IPAddressValue *value)
+{
+    assert(value != NULL);
+    return memcmp(value->bytes, IPV4_MAPPED_PREFIX, 12) == 0;
+}
+
+uint32_t IPAddressValueGetIPv4(const IPAddressValue *value)
+{
+    assert(value != NULL);
+    return ((uint32_t) value->bytes[12] << 24) | ((uint32_t) value->bytes[13] << 16) |
+        ((uint32_t) value->bytes[14] << 8) | value->bytes[15];
+}
+
+int IPAddressValueCompare(const IPAddressValue *a, const IPAddressValue *b)
+{
+    assert(a != NULL && b != NULL);
+    return memcmp(a->bytes, b->bytes, 16);
+}
+
+bool IPAddressValueEqual(const IPAddressValue *a, const IPAddressValue *b)
+{
+    assert(a != NULL && b != NULL);
+    return memcmp(a->bytes, b->bytes, 16) == 0;
+}
+
+unsigned int IPAddressValueHash(const IPAddressValue *value, unsigned int seed)
+{
+    assert(value != NULL);
+
+    uint64_t high, low;
+    memcpy(&high, value->bytes, 8);
+    memcpy(&low, value->bytes + 8, 8);
+
+    /* Two rounds of multiply-xorshift, enough to spread the low (IPv4)
+     * bytes over the whole result. */
+    uint64_t h = (high ^ seed) * UINT64_C(0x9E3779B97F4A7C15);
+    h = (h ^ (h >> 29) ^ low) * UINT64_C(0xBF58476D1CE4E5B9);
+    h ^= h >> 32;
+    return (unsigned int) h;
+}
+
+void IPAddressPrefixMake(const IPAddressValue *address, unsigned int length,
+                         IPAddressPrefix *prefix_out)
+{
+    assert(address != NULL);
+    assert(length <= 128);
+    assert(prefix_out != NULL);
+
+    const unsigned int full_bytes = length / 8;
+    const unsigned int rest_bits = length % 8;
+
+    memcpy(prefix_out->address.bytes, address->bytes, full_bytes);
+    if (full_bytes < 16)
+    {
+        prefix_out->address.bytes[full_bytes] =
+            address->bytes[full_bytes] & (uint8_t) (0xff00 >> rest_bits);
+        memset(prefix_out->address.bytes + full_bytes + 1, 0, 15 - full_bytes);
+    }
+    prefix_out->length = length;
+}
+
+bool IPAddressPrefixContains(const IPAddressPrefix *prefix, const IPAddressValue *address)
+{
+    assert(prefix != NULL);
+    assert(address != NULL);
+
+    const unsigned int full_bytes = prefix->length / 8;
+    const unsigned int rest_bits = prefix->length % 8;
+
+    if (memcmp(prefix->address.bytes, address->bytes, full_bytes) != 0)
+    {
+        return false;
+    }
+    return rest_bits == 0 ||
+        ((prefix->address.bytes[full_bytes] ^ address->bytes[full_bytes]) &
+         (uint8_t) (0xff00 >> rest_bits)) == 0;
+}
+
+bool IPAddressPrefixParse(const char *str, size_t len, IPAddressPrefix *prefix_out)
+{
+    assert(str != NULL || len == 0);
+    assert(prefix_out != NULL);
+
+    const char *const slash = memchr(str, '/', len);
+    const size_t address_len = (slash != NULL) ? (size_t) (slash - str) : len;
+
+    IPAddressValue address;
+    if (address_len == 0 || str[0] == '[' ||
+        !IPAddressValueParse(str, address_len, &address, NULL))
+    {
+        return false;
+    }
+
+    const bool is_ipv4 = (memchr(str, ':', address_len) == NULL);
+    const unsigned int max_length = is_ipv4 ? 32 : 128;
+    unsigned int length = max_length;
+
+    if (slash != NULL)
+    {
+        const char *p = slash + 1;
+        const char *const end = str + len;
+        if (p == end || end - p > 3)
+        {
+            return false;
+        }
+        length = 0;
+        for (; p < end; p++)
+        {
+            if (*p < '0' || *p > '9')
+            {
+                return false;
+            }
+            length = length * 10 + (*p - '0');
+        }
+        if (length > max_length)
+        {
+            return false;
+        }
+    }
+
+    IPAddressPrefixMake(&address, is_ipv4 ? length + 96 : length, prefix_out);
+    return true;
+}
+
+size_t IPAddressPrefixFormat(const IPAddressPrefix *prefix, char *buf)
+{
+    assert(prefix != NULL);
+    assert(buf != NULL);
+
+    const size_t len = IPAddressValueFormat(&prefix->address, buf);
+    unsigned int length = prefix->length;
+
+    /* Prefixes shorter than 96 bits have the ::ffff part cleared, so this
+     * is an IPv4 network. */
+    if (IPAddressValueIsIPv4(&prefix->address))
+    {
+        assert(length >= 96);
+        length -= 96;
+    }
+
+    char *p = buf + len;
+    *p++ = '/';
+    if (length >= 100)
+    {
+        *p++ = '0' + length / 100;
+        length %= 100;
+        *p++ = '0' + length / 10;
+    }
+    else if (length >= 10)
+    {
+        *p++ = '0' + length / 10;
+    }
+    *p++ = '0' + length % 10;
+    *p = '\0';
+    return p - buf;
+}
+
+bool IPAddressGetValue(const IPAddress *address, IPAddressValue *value_out)
+{
+    assert(value_out != NULL);
+
+    if (address == NULL || address->address == NULL)
+    {
+        return false;
+    }
+    if (address->type == IP_ADDRESS_TYPE_IPV4)
+    {
+        const struct IPV4Address *ipv4 = address->address;
+        memcpy(value_out->bytes, IPV4_MAPPED_PREFIX, 12);
+        memcpy(value_out->bytes + 12, ipv4->octets, 4);
+        return true;
+    }
+    if (address->type == IP_ADDRESS_TYPE_IPV6)
+    {
+        const struct IPV6Address *ipv6 = address->address;
+        for (int i = 0; i < 8; i++)
+        {
+            value_out->bytes[2 * i] = ipv6->sixteen[i] >> 8;
+            value_out->bytes[2 * i + 1] = ipv6->sixteen[i] & 0xff;
+        }
+        return true;
+    }
+    return false;
 }
-#endif
@@ -106,4 +106,106 @@ bool IPAddressCompareLess(IPAddress *a, IPAddress *b);
  */
 bool StringIsLocalHostIP(const char *str);
 
+/**
+ * @brief An IPv4 or IPv6 address as a plain 16-byte value.
+ *
+ *        Bytes are in network order, IPv4 addresses are stored IPv4-mapped
+ *        (::ffff:a.b.c.d). The functions below never allocate, so values can
+ *        be kept in arrays, copied, memcmp()'d and used as map keys.
+ */
+typedef struct
+{
+    uint8_t bytes[16];
+} IPAddressValue;
+
+/* "ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255" */
+#define IP_ADDRESS_VALUE_BUFSIZE 46
+
+/**
+ * @brief Parse an IPv4 or IPv6 address from the first #len bytes of #str.
+ *
+ *        Accepts "a.b.c.d", "a.b.c.d:port", any RFC 4291 IPv6 text form
+ *        (including "::" compression and a trailing dotted IPv4 part, in
+ *        either case), "[ipv6]" and "[ipv6]:port". Numbers may have
+ *        redundant leading zeros.
+ * @param port_out set to the port or -1 if there is none, if NULL, an
+ *                 address with a port is rejected
+ * @return true on success, false if #str is not a valid address (in which
+ *         case #value_out is left untouched)
+ */
+bool IPAddressValueParse(const char *str, size_t len,
+                         IPAddressValue *value_out, int *port_out);
+
+/**
+ * @brief Format #value as text: dotted quad for IPv4(-mapped) addresses,
+ *        RFC 5952 canonical form otherwise.
+ * @param buf at least IP_ADDRESS_VALUE_BUFSIZE bytes, NUL-terminated
+ * @return length of the result (without the NUL byte)
+ */
+size_t IPAddressValueFormat(const IPAddressValue *value, char *buf);
+
+/**
+ * @param ipv4 address in host byte order, e.g. 0x7f000001 for 127.0.0.1
+ */
+void IPAddressValueFromIPv4(uint32_t ipv4, IPAddressValue *value_out);
+bool IPAddressValueIsIPv4(const IPAddressValue *value);
+/**
+ * @return the IPv4 address in host byte order (only meaningful if
+ *         IPAddressValueIsIPv4())
+ */
+uint32_t IPAddressValueGetIPv4(const IPAddressValue *value);
+
+/**
+ * @brief Total order on addresses (numeric on the 16-byte form, so IPv4
+ *        addresses sort together, between ::ffff:0:0 and ::ffff:ffff:ffff).
+ * @return <0, 0 or >0 like memcmp()
+ */
+int IPAddressValueCompare(const IPAddressValue *a, const IPAddressValue *b);
+bool IPAddressValueEqual(const IPAddressValue *a, const IPAddressValue *b);
+unsigned int IPAddressValueHash(const IPAddressValue *value, unsigned int seed);
+
+/**
+ * @brief A network: the first #length bits of #address (the remaining bits
+ *        are always zero). IPv4 networks are stored IPv4-mapped, so their
+ *        #length is 96 + the IPv4 prefix length.
+ */
+typedef struct
+{
+    IPAddressValue address;
+    uint8_t length;
+} IPAddressPrefix;
+
+/* "ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255/128" */
+#define IP_ADDRESS_PREFIX_BUFSIZE 50
+
+/**
+ * @brief Parse CIDR notation ("10.0.0.0/8", "2001:db8::/32") from the first
+ *        #len bytes of #str. An address without "/length" is a host prefix.
+ *        Bits beyond the prefix length are cleared, so "10.1.2.3/8" is the
+ *        same network as "10.0.0.0/8".
+ * @return true on success, false if #str is not a valid prefix
+ */
+bool IPAddressPrefixParse(const char *str, size_t len, IPAddressPrefix *prefix_out);
+
+/**
+ * @brief Format #prefix in CIDR notation, using IPv4 prefix lengths for
+ *        IPv4(-mapped) networks.
+ * @param buf at least IP_ADDRESS_PREFIX_BUFSIZE bytes, NUL-terminated
+ * @return length of the result (without the NUL byte)
+ */
+size_t IPAddressPrefixFormat(const IPAddressPrefix *prefix, char *buf);
+
+/**
+ * @brief Set #prefix_out to the first #length bits of #address.
+ */
+void IPAddressPrefixMake(const IPAddressValue *address, unsigned int length,
+                         IPAddressPrefix *prefix_out);
+bool IPAddressPrefixContains(const IPAddressPrefix *prefix, const IPAddressValue *address);
+
+/**
+ * @brief Convert an IPAddress object to its value form (the port is dropped).
+ * @return false if #address is NULL or invalid
+ */
+bool IPAddressGetValue(const IPAddress *address, IPAddressValue *value_out);
+
 #endif // CFENGINE_IP_ADDRESS_H
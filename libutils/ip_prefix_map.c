@@ -0,0 +1,471 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <ip_prefix_map.h>
+#include <alloc.h>
+
+/*
+ * Keys are the 16 address bytes as two 64-bit integers in host byte order,
+ * so that masking, comparing and picking bit N are plain integer
+ * operations. Bit 0 is the most significant bit of key[0].
+ */
+typedef struct
+{
+    uint64_t key[2];            /* bits past length are always 0 */
+    uint32_t child[2];          /* 0 if none (the root is never a child) */
+    uint8_t length;
+    bool has_value;             /* the value is in IPPrefixMap::values */
+} IPPrefixMapNode;
+
+struct IPPrefixMap
+{
+    IPPrefixMapNode *nodes;     /* nodes[0] is the root, ::/0 */
+    void **values;              /* by node index, kept apart to keep nodes
+                                 * at 32 bytes */
+    size_t n_nodes;
+    size_t capacity;
+    size_t n_prefixes;
+    MapDestroyDataFn destroy_value_fn;
+};
+
+static inline void KeyFromBytes(const uint8_t bytes[16], uint64_t key[2])
+{
+    for (int half = 0; half < 2; half++)
+    {
+        uint64_t k = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            k = (k << 8) | bytes[8 * half + i];
+        }
+        key[half] = k;
+    }
+}
+
+static inline void KeyToBytes(const uint64_t key[2], uint8_t bytes[16])
+{
+    for (int half = 0; half < 2; half++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            bytes[8 * half + i] = key[half] >> (56 - 8 * i);
+        }
+    }
+}
+
+/* The top #bits bits set, 0 <= bits <= 64 */
+static inline uint64_t Mask64(unsigned int bits)
+{
+    return (bits == 0) ? 0 : ~UINT64_C(0) << (64 - bits);
+}
+
+static inline void KeyMask(const uint64_t key[2], unsigned int length, uint64_t out[2])
+{
+    if (length <= 64)
+    {
+        out[0] = key[0] & Mask64(length);
+        out[1] = 0;
+    }
+    else
+    {
+        out[0] = key[0];
+        out[1] = key[1] & Mask64(length - 64);
+    }
+}
+
+static inline unsigned int KeyBit(const uint64_t key[2], unsigned int pos)
+{
+    assert(pos < 128);
+    return (pos < 64) ? (key[0] >> (63 - pos)) & 1 : (key[1] >> (127 - pos)) & 1;
+}
+
+static inline unsigned int KeyCommonLength(const uint64_t a[2], const uint64_t b[2])
+{
+    if (a[0] != b[0])
+    {
+        return __builtin_clzll(a[0] ^ b[0]);
+    }
+    if (a[1] != b[1])
+    {
+        return 64 + __builtin_clzll(a[1] ^ b[1]);
+    }
+    return 128;
+}
+
+static inline bool NodeMatches(const IPPrefixMapNode *node, const uint64_t key[2])
+{
+    if (node->length <= 64)
+    {
+        return ((key[0] ^ node->key[0]) & Mask64(node->length)) == 0;
+    }
+    return key[0] == node->key[0] &&
+        ((key[1] ^ node->key[1]) & Mask64(node->length - 64)) == 0;
+}
+
+static uint32_t AddNode(IPPrefixMap *map)
+{
+    if (map->n_nodes == map->capacity)
+    {
+        map->capacity *= 2;
+        map->nodes = xrealloc(map->nodes, map->capacity * sizeof(IPPrefixMapNode));
+        map->values = xrealloc(map->values, map->capacity * sizeof(void *));
+    }
+    assert(map->n_nodes < UINT32_MAX);
+
+    memset(&map->nodes[map->n_nodes], 0, sizeof(IPPrefixMapNode));
+    map->values[map->n_nodes] = NULL;
+    return map->n_nodes++;
+}
+
+static IPPrefixMap *IPPrefixMapNewWithCapacity(size_t capacity,
+                                               MapDestroyDataFn destroy_value_fn)
+{
+    IPPrefixMap *map = xmalloc(sizeof(IPPrefixMap));
+    map->nodes = xmalloc(capacity * sizeof(IPPrefixMapNode));
+    map->values = xmalloc(capacity * sizeof(void *));
+    map->n_nodes = 0;
+    map->capacity = capacity;
+    map->n_prefixes = 0;
+    map->destroy_value_fn = destroy_value_fn;
+
+    /* The root always exists, so lookups and inserts need no special case
+     * for an empty map and the root never has to be split. */
+    NDEBUG_UNUSED const uint32_t root = AddNode(map);
+    assert(root == 0);
+    return map;
+}
+
+IPPrefixMap *IPPrefixMapNew(MapDestroyDataFn destroy_value_fn)
+{
+    return IPPrefixMapNewWithCapacity(64, destroy_value_fn);
+}
+
+void IPPrefixMapDestroy(IPPrefixMap *map)
+{
+    if (map == NULL)
+    {
+        return;
+    }
+    if (map->destroy_value_fn != NULL)
+    {
+        for (size_t i = 0; i < map->n_nodes; i++)
+        {
+            if (map->nodes[i].has_value)
+            {
+                map->destroy_value_fn(map->values[i]);
+            }
+        }
+    }
+    free(map->nodes);
+    free(map->values);
+    free(map);
+}
+
+static bool SetNodeValue(IPPrefixMap *map, uint32_t index, void *value)
+{
+    IPPrefixMapNode *node = &map->nodes[index];
+    const bool replaced = node->has_value;
+    if (replaced)
+    {
+        if (map->destroy_value_fn != NULL && map->values[index] != value)
+        {
+            map->destroy_value_fn(map->values[index]);
+        }
+    }
+    else
+    {
+        map->n_prefixes++;
+    }
+    node->has_value = true;
+    map->values[index] = value;
+    return replaced;
+}
+
+static uint32_t AddLeaf(IPPrefixMap *map, const uint64_t key[2], unsigned int length,
+                        void *value)
+{
+    const uint32_t leaf = AddNode(map);
+    IPPrefixMapNode *node = &map->nodes[leaf];
+    node->key[0] = key[0];
+    node->key[1] = key[1];
+    node->length = length;
+    SetNodeValue(map, leaf, value);
+    return leaf;
+}
+
+bool IPPrefixMapInsert(IPPrefixMap *map, const IPAddressPrefix *prefix, void *value)
+{
+    assert(map != NULL);
+    assert(prefix != NULL && prefix->length <= 128);
+
+    const unsigned int length = prefix->length;
+    uint64_t key[2];
+    KeyFromBytes(prefix->address.bytes, key);
+    KeyMask(key, length, key);
+
+    uint32_t index = 0;
+    while (true)
+    {
+        const IPPrefixMapNode *node = &map->nodes[index];
+        const unsigned int node_length = node->length;
+        const unsigned int common =
+            MIN(KeyCommonLength(key, node->key), MIN(length, node_length));
+
+        if (common < node_length)
+        {
+            /* The new prefix branches off within this node's prefix: move
+             * the node down and make its slot the branching point, so the
+             * parent's child index stays valid. */
+            const uint32_t moved = AddNode(map);
+            map->nodes[moved] = map->nodes[index];
+            map->values[moved] = map->values[index];
+
+            IPPrefixMapNode *branch = &map->nodes[index];
+            KeyMask(key, common, branch->key);
+            branch->length = common;
+            branch->has_value = false;
+            map->values[index] = NULL;
+            branch->child[0] = 0;
+            branch->child[1] = 0;
+            branch->child[KeyBit(map->nodes[moved].key, common)] = moved;
+
+            if (length == common)
+            {
+                SetNodeValue(map, index, value);
+            }
+            else
+            {
+                const uint32_t leaf = AddLeaf(map, key, length, value);
+                map->nodes[index].child[KeyBit(key, common)] = leaf;
+            }
+            return false;
+        }
+
+        if (length == node_length)
+        {
+            return SetNodeValue(map, index, value);
+        }
+
+        const unsigned int bit = KeyBit(key, node_length);
+        const uint32_t next = node->child[bit];
+        if (next == 0)
+        {
+            const uint32_t leaf = AddLeaf(map, key, length, value);
+            map->nodes[index].child[bit] = leaf;
+            return false;
+        }
+        index = next;
+    }
+}
+
+bool IPPrefixMapLookup(const IPPrefixMap *map, const IPAddressValue *address,
+                       IPAddressPrefix *prefix_out, void **value_out)
+{
+    assert(map != NULL);
+    assert(address != NULL);
+
+    uint64_t key[2];
+    KeyFromBytes(address->bytes, key);
+
+    const IPPrefixMapNode *const nodes = map->nodes;
+    const IPPrefixMapNode *best = NULL;
+    uint32_t index = 0;
+    do
+    {
+        const IPPrefixMapNode *node = &nodes[index];
+        if (!NodeMatches(node, key))
+        {
+            break;
+        }
+        if (node->has_value)
+        {
+            best = node;
+        }
+        if (node->length == 128)
+        {
+            break;
+        }
+        index = node->child[KeyBit(key, node->length)];
+    } while (index != 0);
+
+    if (best == NULL)
+    {
+        return false;
+    }
+    if (prefix_out != NULL)
+    {
+        KeyToBytes(best->key, prefix_out->address.bytes);
+        prefix_out->length = best->length;
+    }
+    if (value_out != NULL)
+    {
+        *value_out = map->values[best - nodes];
+    }
+    return true;
+}
+
+void *IPPrefixMapGet(const IPPrefixMap *map, const IPAddressValue *address)
+{
+    void *value = NULL;
+    IPPrefixMapLookup(map, address, NULL, &value);
+    return value;
+}
+
+size_t IPPrefixMapSize(const IPPrefixMap *map)
+{
+    assert(map != NULL);
+    return map->n_prefixes;
+}
+
+/* Bulk build */
+
+typedef struct
+{
+    uint64_t key[2];
+    uint8_t length;
+    size_t index;               /* into the prefixes/values arrays */
+} BuildEntry;
+
+static int BuildEntryCompare(const void *a, const void *b)
+{
+    const BuildEntry *x = a, *y = b;
+    if (x->key[0] != y->key[0])
+    {
+        return (x->key[0] < y->key[0]) ? -1 : 1;
+    }
+    if (x->key[1] != y->key[1])
+    {
+        return (x->key[1] < y->key[1]) ? -1 : 1;
+    }
+    if (x->length != y->length)
+    {
+        return (x->length < y->length) ? -1 : 1;
+    }
+    return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+/* Length of the longest prefix shared by all of entries[lo, hi) */
+static unsigned int BuildRangeLength(const BuildEntry *entries, size_t lo, size_t hi)
+{
+    assert(lo < hi);
+
+    /* The entries are sorted, so the first and last differ earliest */
+    unsigned int length = KeyCommonLength(entries[lo].key, entries[hi - 1].key);
+    for (size_t i = lo; i < hi; i++)
+    {
+        length = MIN(length, entries[i].length);
+    }
+    return length;
+}
+
+/*
+ * Fill in node #index for entries[lo, hi), which all share the first
+ * #length bits, and recursively its subtree. Sorting puts the entry of
+ * exactly #length bits (if any) first, and the entries with a 0 at bit
+ * #length before those with a 1.
+ */
+static void BuildNode(IPPrefixMap *map, const BuildEntry *entries, void *const *values,
+                      size_t lo, size_t hi, uint32_t index, unsigned int length)
+{
+    KeyMask(entries[lo].key, length, map->nodes[index].key);
+    map->nodes[index].length = length;
+
+    if (lo < hi && entries[lo].length == length)
+    {
+        SetNodeValue(map, index, (values != NULL) ? values[entries[lo].index] : NULL);
+        lo++;
+    }
+    if (lo == hi)
+    {
+        return;
+    }
+
+    assert(length < 128);
+    size_t mid = lo;
+    while (mid < hi && KeyBit(entries[mid].key, length) == 0)
+    {
+        mid++;
+    }
+
+    const size_t bounds[3] = { lo, mid, hi };
+    for (int bit = 0; bit < 2; bit++)
+    {
+        if (bounds[bit] < bounds[bit + 1])
+        {
+            const uint32_t child = AddNode(map);
+            map->nodes[index].child[bit] = child;
+            BuildNode(map, entries, values, bounds[bit], bounds[bit + 1], child,
+                      BuildRangeLength(entries, bounds[bit], bounds[bit + 1]));
+        }
+    }
+}
+
+IPPrefixMap *IPPrefixMapNewFromPrefixes(const IPAddressPrefix *prefixes,
+                                        void *const *values, size_t n_prefixes,
+                                        MapDestroyDataFn destroy_value_fn)
+{
+    assert(prefixes != NULL || n_prefixes == 0);
+
+    if (n_prefixes == 0)
+    {
+        return IPPrefixMapNew(destroy_value_fn);
+    }
+
+    BuildEntry *entries = xmalloc(n_prefixes * sizeof(BuildEntry));
+    for (size_t i = 0; i < n_prefixes; i++)
+    {
+        assert(prefixes[i].length <= 128);
+        KeyFromBytes(prefixes[i].address.bytes, entries[i].key);
+        KeyMask(entries[i].key, prefixes[i].length, entries[i].key);
+        entries[i].length = prefixes[i].length;
+        entries[i].index = i;
+    }
+    qsort(entries, n_prefixes, sizeof(BuildEntry), BuildEntryCompare);
+
+    /* Drop duplicates, keeping the last one given */
+    size_t n_entries = 0;
+    for (size_t i = 0; i < n_prefixes; i++)
+    {
+        if (i + 1 < n_prefixes && entries[i + 1].length == entries[i].length &&
+            entries[i + 1].key[0] == entries[i].key[0] &&
+            entries[i + 1].key[1] == entries[i].key[1])
+        {
+            if (destroy_value_fn != NULL && values != NULL &&
+                values[entries[i].index] != values[entries[i + 1].index])
+            {
+                destroy_value_fn(values[entries[i].index]);
+            }
+            continue;
+        }
+        entries[n_entries++] = entries[i];
+    }
+
+    /* At most one node per prefix plus one branching node less, and the
+     * root. */
+    IPPrefixMap *map = IPPrefixMapNewWithCapacity(2 * n_entries + 1, destroy_value_fn);
+    BuildNode(map, entries, values, 0, n_entries, 0, 0);
+    assert(map->n_nodes <= map->capacity);
+
+    free(entries);
+    return map;
+}
@@ -0,0 +1,86 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_IP_PREFIX_MAP_H
+#define CFENGINE_IP_PREFIX_MAP_H
+
+#include <ip_address.h>
+#include <map_common.h>         /* MapDestroyDataFn */
+
+/**
+ * @brief Longest-prefix match from IPv4/IPv6 networks to values.
+ *
+ *        A path-compressed binary (Patricia) trie over the 128-bit
+ *        IPAddressValue form, kept in one array of nodes. Lookups cost at
+ *        most one node per distinct prefix length on the path, and never
+ *        allocate.
+ */
+typedef struct IPPrefixMap IPPrefixMap;
+
+/**
+ * @param destroy_value_fn called on values when replaced and when the map
+ *                         is destroyed, may be NULL
+ */
+IPPrefixMap *IPPrefixMapNew(MapDestroyDataFn destroy_value_fn);
+
+/**
+ * @brief Build a map from #n_prefixes prefixes at once.
+ *
+ *        Sorts the prefixes and lays the nodes out in depth-first order,
+ *        so lookups near each other touch nearby memory. If a
+ *        prefix occurs more than once, the last one wins (the other values
+ *        are destroyed).
+ * @param values value for each prefix, or NULL to map all prefixes to NULL
+ */
+IPPrefixMap *IPPrefixMapNewFromPrefixes(const IPAddressPrefix *prefixes,
+                                        void *const *values, size_t n_prefixes,
+                                        MapDestroyDataFn destroy_value_fn);
+
+void IPPrefixMapDestroy(IPPrefixMap *map);
+
+/**
+ * @return true if the prefix was already in the map (and its value was
+ *         replaced)
+ */
+bool IPPrefixMapInsert(IPPrefixMap *map, const IPAddressPrefix *prefix, void *value);
+
+/**
+ * @brief Find the longest prefix in #map containing #address.
+ * @param prefix_out if not NULL, set to the matching prefix
+ * @param value_out if not NULL, set to the value of the matching prefix
+ * @return false if no prefix in #map contains #address
+ */
+bool IPPrefixMapLookup(const IPPrefixMap *map, const IPAddressValue *address,
+                       IPAddressPrefix *prefix_out, void **value_out);
+
+/**
+ * @return the value of the longest prefix containing #address, or NULL
+ */
+void *IPPrefixMapGet(const IPPrefixMap *map, const IPAddressValue *address);
+
+/**
+ * @return the number of prefixes in #map
+ */
+size_t IPPrefixMapSize(const IPPrefixMap *map);
+
+#endif
@@ -24,7 +24,7 @@
 #include <platform.h>
 #include <json-utils.h>
 #include <logging.h>    // Log()
-#include <file_lib.h>   // safe_fopen()
+#include <file_lib.h>   // safe_fopen(), safe_open()
 #include <string_lib.h> // TrimWhitespace()
 #include <csv_parser.h>
 #include <json-yaml.h>  // JsonParseYamlFile()
@@ -233,88 +233,227 @@ bool JsonParseEnvFile(const char *input_path, size_t size_max, JsonElement **jso
     return true;
 }
 
-bool JsonParseCsvFile(const char *input_path, size_t size_max, JsonElement **json_out)
+static void JsonArrayAppendCsvRecord(JsonElement *json, const CsvRecord *record)
 {
-    assert(json_out != NULL);
+    JsonElement *line_arr = JsonArrayCreate(record->num_fields);
+
+    for (size_t i = 0; i < record->num_fields; i++)
+    {
+        JsonArrayAppendString(line_arr, record->fields[i].data);
+    }
+
+    JsonArrayAppendArray(json, line_arr);
+}
+
+static void LogCsvNothingParsed(const char *myname, const char *input_path)
+{
+    Log(LOG_LEVEL_WARNING,
+        "%s: CSV file '%s' is not empty, but nothing was parsed",
+        myname, input_path);
+    Log(LOG_LEVEL_WARNING,
+        "Make sure the file contains DOS (CRLF) line endings");
+}
 
+static bool JsonParseCsvFd(int fd, const char *input_path, size_t size_max,
+                           JsonElement **json_out)
+{
     const char *myname = "JsonParseCsvFile";
-    char *line;
     size_t byte_count = 0;
 
     int linenumber = 0;
 
-    FILE *fin = safe_fopen(input_path, "r");
-    if (fin == NULL)
-    {
-        Log(LOG_LEVEL_VERBOSE, "%s cannot open the csv file '%s' (fopen: %s)",
-            myname, input_path, GetErrorStr());
-        return false;
-    }
-
     JsonElement *const json = JsonArrayCreate(50);
+    CsvReader *reader = CsvReaderNew(fd);
 
-    if (feof(fin))
-    {
-        *json_out = json;
-        Log(LOG_LEVEL_VERBOSE,
-            "%s: CSV file '%s' was empty, so nothing was parsed",
-            myname, input_path);
-        return true;
-    }
-
-    while ((line = GetCsvLineNext(fin)) != NULL)
+    CsvRecord record;
+    CsvRecordStatus status;
+    while ((status = CsvReaderNext(reader, &record)) != CSV_RECORD_EOF &&
+           status != CSV_RECORD_ERROR)
     {
         ++linenumber;
 
-        byte_count += strlen(line);
+        byte_count += record.size;
         if (byte_count > size_max)
         {
             Log(LOG_LEVEL_VERBOSE, "%s: CSV file '%s' exceeded byte limit %zu at line %d",
                 myname, input_path, size_max, linenumber);
             Log(LOG_LEVEL_VERBOSE, "Done with CSV file, the rest will not be parsed");
-            free(line);
             break;
         }
 
-        Seq *list = SeqParseCsvString(line);
-        free(line);
-
-        if (list != NULL)
+        if (status == CSV_RECORD_OK)
         {
-            JsonElement *line_arr = JsonArrayCreate(SeqLength(list));
+            JsonArrayAppendCsvRecord(json, &record);
+        }
+    }
 
-            for (size_t i = 0; i < SeqLength(list); i++)
-            {
-                JsonArrayAppendString(line_arr, SeqAt(list, i));
-            }
+    CsvReaderDestroy(reader);
+
+    if (status == CSV_RECORD_ERROR)
+    {
+        Log(LOG_LEVEL_ERR,
+            "%s: unable to read line from CSV file '%s'. (read: %s)",
+            myname, input_path, GetErrorStr());
+        JsonDestroy(json);
+        return false;
+    }
+
+    if (JsonLength(json) == 0)
+    {
+        LogCsvNothingParsed(myname, input_path);
+    }
+
+    *json_out = json;
+    return true;
+}
+
+bool JsonParseCsvFile(const char *input_path, size_t size_max, JsonElement **json_out)
+{
+    assert(json_out != NULL);
+
+    int fd = safe_open(input_path, O_RDONLY);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_VERBOSE, "JsonParseCsvFile cannot open the csv file '%s' (open: %s)",
+            input_path, GetErrorStr());
+        return false;
+    }
+
+    bool success = JsonParseCsvFd(fd, input_path, size_max, json_out);
+    close(fd);
+    return success;
+}
+
+typedef struct
+{
+    char *data;
+    size_t len;
+    bool at_end;
+    JsonElement *json;
+} CsvChunk;
+
+static void *CsvChunkParse(void *arg)
+{
+    CsvChunk *chunk = arg;
+    chunk->json = JsonArrayCreate(50);
 
-            SeqDestroy(list);
-            JsonArrayAppendArray(json, line_arr);
+    CsvReader *reader = CsvReaderNewFromData(chunk->data, chunk->len, chunk->at_end);
+    CsvRecord record;
+    CsvRecordStatus status;
+    while ((status = CsvReaderNext(reader, &record)) != CSV_RECORD_EOF)
+    {
+        /* no reading from memory can fail */
+        assert(status != CSV_RECORD_ERROR);
+        if (status == CSV_RECORD_OK)
+        {
+            JsonArrayAppendCsvRecord(chunk->json, &record);
         }
     }
+    CsvReaderDestroy(reader);
 
-    bool reached_eof = feof(fin);
+    return NULL;
+}
 
-    if (!reached_eof && byte_count <= size_max)
+bool JsonParseCsvFileParallel(const char *input_path, size_t size_max,
+                              size_t n_threads, JsonElement **json_out)
+{
+    assert(json_out != NULL);
+
+    const char *myname = "JsonParseCsvFile";
+
+    int fd = safe_open(input_path, O_RDONLY);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_VERBOSE, "%s cannot open the csv file '%s' (open: %s)",
+            myname, input_path, GetErrorStr());
+        return false;
+    }
+
+    struct stat sb;
+    if ((n_threads <= 1) || (fstat(fd, &sb) != 0) || !S_ISREG(sb.st_mode) ||
+        (sb.st_size < JSON_CSV_PARALLEL_THRESHOLD))
+    {
+        bool success = JsonParseCsvFd(fd, input_path, size_max, json_out);
+        close(fd);
+        return success;
+    }
+
+    bool truncated = false;
+    Buffer *data = FileReadBufferFromFd(fd, size_max, &truncated);
+    close(fd);
+    if (data == NULL)
     {
         Log(LOG_LEVEL_ERR,
-            "%s: unable to read line from CSV file '%s'. (fread: %s)",
+            "%s: unable to read CSV file '%s'. (read: %s)",
             myname, input_path, GetErrorStr());
-        JsonDestroy(json);
-        fclose(fin);
         return false;
     }
+    if (truncated)
+    {
+        /* The records are only parsed up to the limit, like in
+         * JsonParseCsvFd(), the incomplete record at the end is dropped. */
+        Log(LOG_LEVEL_VERBOSE, "%s: CSV file '%s' exceeded byte limit %zu",
+            myname, input_path, size_max);
+        Log(LOG_LEVEL_VERBOSE, "Done with CSV file, the rest will not be parsed");
+    }
+
+    char *const bytes = (char *) BufferData(data);
+    const size_t len = BufferSize(data);
+    const size_t n_chunks = MIN(n_threads, MAX(1, len / JSON_CSV_PARALLEL_MIN_CHUNK));
+
+    size_t *chunk_ends = xmalloc(n_chunks * sizeof(size_t));
+    CsvSplitData(bytes, len, n_chunks, chunk_ends);
+
+    CsvChunk *chunks = xcalloc(n_chunks, sizeof(CsvChunk));
+    pthread_t *threads = xcalloc(n_chunks, sizeof(pthread_t));
+    bool *started = xcalloc(n_chunks, sizeof(bool));
+    for (size_t i = 0; i < n_chunks; i++)
+    {
+        size_t start = (i == 0) ? 0 : chunk_ends[i - 1];
+        chunks[i].data = bytes + start;
+        chunks[i].len = chunk_ends[i] - start;
+        /* Not only the last chunk by index reaches the end: when no record
+         * ends after a split point, that chunk takes the rest of the data and
+         * the following ones are empty. */
+        chunks[i].at_end = (chunk_ends[i] == len) && !truncated;
+
+        /* Chunk 0 is parsed by this thread, also the fallback if a thread
+         * cannot be started. */
+        if (i > 0)
+        {
+            started[i] = (pthread_create(&threads[i], NULL, CsvChunkParse, &chunks[i]) == 0);
+        }
+    }
+
+    for (size_t i = 0; i < n_chunks; i++)
+    {
+        if (!started[i])
+        {
+            CsvChunkParse(&chunks[i]);
+        }
+    }
+
+    JsonElement *json = chunks[0].json;
+    for (size_t i = 1; i < n_chunks; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+        JsonArrayExtend(json, chunks[i].json);
+    }
+
+    free(started);
+    free(threads);
+    free(chunks);
+    free(chunk_ends);
+    BufferDestroy(data);
 
     if (JsonLength(json) == 0)
     {
-        Log(LOG_LEVEL_WARNING,
-            "%s: CSV file '%s' is not empty, but nothing was parsed",
-            myname, input_path);
-        Log(LOG_LEVEL_WARNING,
-            "Make sure the file contains DOS (CRLF) line endings");
+        LogCsvNothingParsed(myname, input_path);
     }
 
-    fclose(fin);
     *json_out = json;
     return true;
 }
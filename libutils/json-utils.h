@@ -37,6 +37,19 @@ typedef enum {
 void ParseEnvLine(char *raw_line, char **key_out, char **value_out, const char *filename_for_log, int linenumber);
 bool JsonParseEnvFile(const char *input_path, size_t size_max, JsonElement **json_out);
 bool JsonParseCsvFile(const char *path, size_t size_max, JsonElement **json_out);
+
+/* Files smaller than this are parsed by JsonParseCsvFileParallel() in a
+ * single thread, and each thread gets at least the given chunk size. */
+#define JSON_CSV_PARALLEL_THRESHOLD (8 * 1024 * 1024)
+#define JSON_CSV_PARALLEL_MIN_CHUNK (1 * 1024 * 1024)
+
+/**
+ * @brief Same as JsonParseCsvFile(), but splits big files into chunks at
+ *        record boundaries and parses them into JSON with up to #n_threads
+ *        threads.
+ */
+bool JsonParseCsvFileParallel(const char *path, size_t size_max, size_t n_threads,
+                              JsonElement **json_out);
 JsonElement *JsonReadDataFile(
         const char *log_identifier,
         const char *input_path,
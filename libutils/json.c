@@ -32,6 +32,7 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <string_lib.h>
+#include <number_lib.h>
 #include <misc_lib.h>
 #include <file_lib.h>
 #include <printsize.h>
@@ -982,39 +983,40 @@ void JsonEncodeStringWriter(
 {
     assert(unescaped_string != NULL);
 
+    /* Runs of characters not needing escaping are written at once. */
+    const char *run = unescaped_string;
     for (const char *c = unescaped_string; *c != '\0'; c++)
     {
+        char escaped[2] = { '\\', '\0' };
         switch (*c)
         {
         case '\"':
         case '\\':
-            WriterWriteChar(writer, '\\');
-            WriterWriteChar(writer, *c);
+            escaped[1] = *c;
             break;
         case '\b':
-            WriterWriteChar(writer, '\\');
-            WriterWriteChar(writer, 'b');
+            escaped[1] = 'b';
             break;
         case '\f':
-            WriterWriteChar(writer, '\\');
-            WriterWriteChar(writer, 'f');
+            escaped[1] = 'f';
             break;
         case '\n':
-            WriterWriteChar(writer, '\\');
-            WriterWriteChar(writer, 'n');
+            escaped[1] = 'n';
             break;
         case '\r':
-            WriterWriteChar(writer, '\\');
-            WriterWriteChar(writer, 'r');
+            escaped[1] = 'r';
             break;
         case '\t':
-            WriterWriteChar(writer, '\\');
-            WriterWriteChar(writer, 't');
+            escaped[1] = 't';
             break;
         default:
-            WriterWriteChar(writer, *c);
+            continue;
         }
+        WriterWriteBytes(writer, run, c - run);
+        WriterWriteBytes(writer, escaped, 2);
+        run = c + 1;
     }
+    WriterWriteBytes(writer, run, strlen(run));
 }
 
 char *JsonEncodeString(const char *const unescaped_string)
@@ -1393,6 +1395,32 @@ JsonElement *JsonObjectGet(
     return SeqLookup(object->container.children, key, JsonElementHasProperty);
 }
 
+static int JsonElementHasPropertyRef(
+    const void *const propertyName,
+    const void *const jsonElement,
+    ARG_UNUSED void *const user_data)
+{
+    assert(propertyName != NULL);
+
+    const StringRef *const key = propertyName;
+    const JsonElement *element = jsonElement;
+
+    assert(element->propertyName != NULL);
+
+    return StringRefEqualCString(*key, element->propertyName) ? 0 : -1;
+}
+
+JsonElement *JsonObjectGetRef(
+    const JsonElement *const object, const StringRef key)
+{
+    assert(object != NULL);
+    assert(object->type == JSON_ELEMENT_TYPE_CONTAINER);
+    assert(object->container.type == JSON_CONTAINER_TYPE_OBJECT);
+    assert(key.data != NULL || key.len == 0);
+
+    return SeqLookup(object->container.children, &key, JsonElementHasPropertyRef);
+}
+
 // *******************************************************************************************
 // JsonArray Functions
 // *******************************************************************************************
@@ -1583,18 +1611,16 @@ JsonElement *JsonStringCreate(const char *const value)
 
 JsonElement *JsonIntegerCreate(const int value)
 {
-    char *buffer;
-    xasprintf(&buffer, "%d", value);
-
-    return JsonElementCreatePrimitive(JSON_PRIMITIVE_TYPE_INTEGER, buffer);
+    return JsonIntegerCreate64(value);
 }
 
 JsonElement *JsonIntegerCreate64(const int64_t value)
 {
-    char *buffer;
-    xasprintf(&buffer, "%" PRIi64, value);
+    char buffer[NUMBER_INT64_BUFSIZE];
+    const size_t len = NumberFormatInt64(value, buffer);
 
-    return JsonElementCreatePrimitive(JSON_PRIMITIVE_TYPE_INTEGER, buffer);
+    return JsonElementCreatePrimitive(
+        JSON_PRIMITIVE_TYPE_INTEGER, xmemdup(buffer, len + 1));
 }
 
 JsonElement *JsonRealCreate(double value)
@@ -1604,10 +1630,11 @@ JsonElement *JsonRealCreate(double value)
         value = 0.0;
     }
 
-    char *buffer = xcalloc(32, sizeof(char));
-    snprintf(buffer, 32, "%.4f", value);
+    char buffer[NUMBER_DOUBLE_FIXED_BUFSIZE(4)];
+    const size_t len = NumberFormatDoubleFixed(value, 4, buffer);
 
-    return JsonElementCreatePrimitive(JSON_PRIMITIVE_TYPE_REAL, buffer);
+    return JsonElementCreatePrimitive(
+        JSON_PRIMITIVE_TYPE_REAL, xmemdup(buffer, len + 1));
 }
 
 JsonElement *JsonBoolCreate(const bool value)
@@ -1648,12 +1675,14 @@ static bool IsDigit(const char ch)
 
 static void PrintIndent(Writer *const writer, const int num)
 {
-    int i = 0;
-
-    for (i = 0; i < num * SPACES_PER_INDENT; i++)
+    if (num <= 0)
     {
-        WriterWriteChar(writer, ' ');
+        return;
     }
+
+    const size_t len = num * SPACES_PER_INDENT;
+    memset(WriterReserve(writer, len), ' ', len);
+    WriterCommit(writer, len);
 }
 
 static void JsonPrimitiveWrite(
@@ -1669,11 +1698,9 @@ static void JsonPrimitiveWrite(
     if (primitiveElement->primitive.type == JSON_PRIMITIVE_TYPE_STRING)
     {
         PrintIndent(writer, indent_level);
-        {
-            char *encoded = JsonEncodeString(value);
-            WriterWriteF(writer, "\"%s\"", encoded);
-            free(encoded);
-        }
+        WriterWriteChar(writer, '"');
+        JsonEncodeStringWriter(value, writer);
+        WriterWriteChar(writer, '"');
     }
     else
     {
@@ -2203,7 +2230,7 @@ JsonParseError JsonParseAsNumber(
     assert(*data != NULL);
     assert(json_out != NULL);
 
-    Writer *writer = StringWriter();
+    const char *const start = *data;
 
     bool zero_started = false;
     bool seen_dot = false;
@@ -2220,7 +2247,6 @@ JsonParseError JsonParseAsNumber(
             if (prev_char != 0 && prev_char != 'e' && prev_char != 'E')
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_EXPONENT_NEGATIVE;
             }
             break;
@@ -2229,7 +2255,6 @@ JsonParseError JsonParseAsNumber(
             if (prev_char != 'e' && prev_char != 'E')
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_EXPONENT_POSITIVE;
             }
             break;
@@ -2238,7 +2263,6 @@ JsonParseError JsonParseAsNumber(
             if (zero_started && !seen_dot && !seen_exponent)
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_DUPLICATE_ZERO;
             }
             if (prev_char == 0)
@@ -2251,13 +2275,11 @@ JsonParseError JsonParseAsNumber(
             if (seen_dot)
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_MULTIPLE_DOTS;
             }
             if (prev_char != '0' && !IsDigit(prev_char))
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_NO_DIGIT;
             }
             seen_dot = true;
@@ -2268,13 +2290,11 @@ JsonParseError JsonParseAsNumber(
             if (seen_exponent)
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_EXPONENT_DUPLICATE;
             }
             else if (!IsDigit(prev_char) && prev_char != '0')
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_EXPONENT_DIGIT;
             }
             seen_exponent = true;
@@ -2284,42 +2304,40 @@ JsonParseError JsonParseAsNumber(
             if (zero_started && !seen_dot && !seen_exponent)
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_EXPONENT_FOLLOW_LEADING_ZERO;
             }
 
             if (!IsDigit(**data))
             {
                 *json_out = NULL;
-                WriterClose(writer);
                 return JSON_PARSE_ERROR_NUMBER_BAD_SYMBOL;
             }
             break;
         }
-
-        WriterWriteChar(writer, **data);
     }
 
     if (prev_char != '0' && !IsDigit(prev_char))
     {
         *json_out = NULL;
-        WriterClose(writer);
         return JSON_PARSE_ERROR_NUMBER_DIGIT_END;
     }
 
+    // the number is copied in one go instead of char by char
+    char *const number = xstrndup(start, *data - start);
+
     // rewind 1 char so caller will see separator next
     *data = *data - 1;
 
     if (seen_dot)
     {
         *json_out = JsonElementCreatePrimitive(
-            JSON_PRIMITIVE_TYPE_REAL, StringWriterClose(writer));
+            JSON_PRIMITIVE_TYPE_REAL, number);
         return JSON_PARSE_OK;
     }
     else
     {
         *json_out = JsonElementCreatePrimitive(
-            JSON_PRIMITIVE_TYPE_INTEGER, StringWriterClose(writer));
+            JSON_PRIMITIVE_TYPE_INTEGER, number);
         return JSON_PARSE_OK;
     }
 }
@@ -25,6 +25,7 @@
 #define CFENGINE_JSON_H
 
 #include <writer.h>
+#include <string_lib.h> // StringRef
 #include <inttypes.h> // int64_t
 #include <assert.h>
 
@@ -397,6 +398,12 @@ JsonElement *JsonObjectGetAsArray(JsonElement *object, const char *key);
 
 JsonElement *JsonObjectGet(const JsonElement *object, const char *key);
 
+/**
+  @brief Same as JsonObjectGet(), but with a key which doesn't have to be
+         NUL-terminated.
+  */
+JsonElement *JsonObjectGetRef(const JsonElement *object, StringRef key);
+
 /**
   @brief Remove key from the object
   @param object containing the key property
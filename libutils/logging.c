@@ -28,6 +28,7 @@
 #include <misc_lib.h>
 #include <cleanup.h>
 #include <sequence.h>
+#include <logging_recorder.h>
 
 #if defined(HAVE_SYSTEMD_SD_JOURNAL_H) && defined(HAVE_LIBSYSTEMD)
 #include <systemd/sd-journal.h> /* sd_journal_sendv() */
@@ -42,6 +43,15 @@ static bool TIMESTAMPS = false;
 
 static LogLevel global_level = LOG_LEVEL_NOTICE; /* GLOBAL_X */
 static LogLevel global_system_log_level = LOG_LEVEL_NOTHING; /* default value that means not set */
+static LogLevel recorder_level = LOG_LEVEL_NOTHING; /* GLOBAL_X, not recording by default */
+
+LogLevel LOG_ENABLED_LEVEL = LOG_LEVEL_NOTICE; /* GLOBAL_X */
+
+/* Number of threads whose logging context enables messages up to each level,
+ * see LoggingContextEnabledLevel(). Protected by enabled_level_lock together
+ * with the updates of LOG_ENABLED_LEVEL. */
+static size_t thread_enabled_levels[LOG_LEVEL_DEBUG + 1]; /* GLOBAL_X */
+static pthread_mutex_t enabled_level_lock = PTHREAD_MUTEX_INITIALIZER; /* GLOBAL_T */
 
 static pthread_once_t log_context_init_once = PTHREAD_ONCE_INIT; /* GLOBAL_T */
 static pthread_key_t log_context_key; /* GLOBAL_T, initialized by pthread_key_create */
@@ -57,9 +67,11 @@ typedef struct LogEntry_
     char *msg;
 } LogEntry;
 
+static void LoggingContextDestroy(void *lctx);
+
 static void LoggingInitializeOnce(void)
 {
-    if (pthread_key_create(&log_context_key, &free) != 0)
+    if (pthread_key_create(&log_context_key, &LoggingContextDestroy) != 0)
     {
         /* There is no way to signal error out of pthread_once callback.
          * However if pthread_key_create fails we are pretty much guaranteed
@@ -70,6 +82,100 @@ static void LoggingInitializeOnce(void)
     }
 }
 
+static void LogEnabledLevelSet(LogLevel level)
+{
+#if defined(__GNUC__)
+    __atomic_store_n(&LOG_ENABLED_LEVEL, level, __ATOMIC_RELAXED);
+#else
+    LOG_ENABLED_LEVEL = level;
+#endif
+}
+
+/**
+ * Recompute the LOG_ENABLED_LEVEL bound from the global levels and the levels
+ * of all the threads' logging contexts. Threads which already have their
+ * logging context keep their levels when the global levels are lowered, so
+ * their messages must still pass the LOG_LAZY() macros.
+ *
+ * @note enabled_level_lock must be held.
+ */
+static void LogEnabledLevelUpdateLocked(void)
+{
+    /* Messages at VERBOSE and DEBUG levels never go to syslog. */
+    LogLevel level = MAX(global_level,
+                         MIN(global_system_log_level, LOG_LEVEL_INFO));
+    level = MAX(level, LogGetRecorderLevel());
+
+    for (LogLevel thread_level = LOG_LEVEL_DEBUG; thread_level > level; thread_level--)
+    {
+        if (thread_enabled_levels[thread_level] > 0)
+        {
+            level = thread_level;
+            break;
+        }
+    }
+    LogEnabledLevelSet(level);
+}
+
+static void LogEnabledLevelUpdate(void)
+{
+    pthread_mutex_lock(&enabled_level_lock);
+    LogEnabledLevelUpdateLocked();
+    pthread_mutex_unlock(&enabled_level_lock);
+}
+
+/**
+ * @return The most verbose level of messages the thread with the logging
+ *         context #lctx may log (see WouldLog()), not counting the recorder.
+ */
+static LogLevel LoggingContextEnabledLevel(const LoggingContext *lctx)
+{
+    /* Messages at VERBOSE and DEBUG levels never go to syslog. */
+    LogLevel level = MAX(MIN(lctx->log_level, LOG_LEVEL_INFO),
+                         lctx->report_level);
+    if ((lctx->pctx != NULL) && (lctx->pctx->log_hook != NULL))
+    {
+        level = MAX(level, lctx->pctx->force_hook_level);
+    }
+    return MIN(level, LOG_LEVEL_DEBUG);
+}
+
+/**
+ * Account for the thread with the logging context #lctx logging messages up
+ * to #level (%LOG_LEVEL_NOTHING for a thread going away) in the
+ * LOG_ENABLED_LEVEL bound.
+ */
+static void LoggingContextSetEnabledLevel(LoggingContext *lctx, LogLevel level)
+{
+    if (level == lctx->enabled_level)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&enabled_level_lock);
+    if (lctx->enabled_level > LOG_LEVEL_NOTHING)
+    {
+        assert(thread_enabled_levels[lctx->enabled_level] > 0);
+        thread_enabled_levels[lctx->enabled_level]--;
+    }
+    if (level > LOG_LEVEL_NOTHING)
+    {
+        thread_enabled_levels[level]++;
+    }
+    lctx->enabled_level = level;
+    LogEnabledLevelUpdateLocked();
+    pthread_mutex_unlock(&enabled_level_lock);
+}
+
+static void LoggingContextDestroy(void *lctx)
+{
+    if (lctx != NULL)
+    {
+        LoggingContextSetEnabledLevel(lctx, LOG_LEVEL_NOTHING);
+        free(lctx);
+    }
+}
+
 LoggingContext *GetCurrentThreadContext(void)
 {
     pthread_once(&log_context_init_once, &LoggingInitializeOnce);
@@ -81,7 +187,9 @@ LoggingContext *GetCurrentThreadContext(void)
                            global_system_log_level :
                            global_level);
         lctx->report_level = global_level;
+        lctx->enabled_level = LOG_LEVEL_NOTHING;
         pthread_setspecific(log_context_key, lctx);
+        LoggingContextSetEnabledLevel(lctx, LoggingContextEnabledLevel(lctx));
     }
     return lctx;
 }
@@ -95,7 +203,7 @@ void LoggingFreeCurrentThreadContext(void)
         return;
     }
     // lctx->pctx is usually stack allocated and shouldn't be freed
-    FREE_AND_NULL(lctx);
+    LoggingContextDestroy(lctx);
     pthread_setspecific(log_context_key, NULL);
 }
 
@@ -113,6 +221,8 @@ void LoggingPrivSetContext(LoggingPrivContext *pctx)
 {
     LoggingContext *lctx = GetCurrentThreadContext();
     lctx->pctx = pctx;
+
+    LoggingContextSetEnabledLevel(lctx, LoggingContextEnabledLevel(lctx));
 }
 
 LoggingPrivContext *LoggingPrivGetContext(void)
@@ -126,6 +236,8 @@ void LoggingPrivSetLevels(LogLevel log_level, LogLevel report_level)
     LoggingContext *lctx = GetCurrentThreadContext();
     lctx->log_level = log_level;
     lctx->report_level = report_level;
+
+    LoggingContextSetEnabledLevel(lctx, LoggingContextEnabledLevel(lctx));
 }
 
 const char *LogLevelToString(LogLevel level)
@@ -421,8 +533,9 @@ bool WouldLog(LogLevel level)
     bool force_hook     = (lctx->pctx &&
                            lctx->pctx->log_hook &&
                            lctx->pctx->force_hook_level >= level);
+    bool record         = (level <= LogGetRecorderLevel());
 
-    return (log_to_console || log_to_syslog || force_hook);
+    return (log_to_console || log_to_syslog || force_hook || record);
 }
 
 /**
@@ -432,7 +545,8 @@ bool WouldLog(LogLevel level)
  *
  * @see LogNoFormat()
  */
-static void VLogNoFormat(LogLevel level, const char *fmt_msg, va_list ap, bool no_format)
+static void VLogNoFormat(LogLevel level, enum LogModule mod,
+                         const char *fmt_msg, va_list ap, bool no_format)
 {
     LoggingContext *lctx = GetCurrentThreadContext();
 
@@ -443,6 +557,16 @@ static void VLogNoFormat(LogLevel level, const char *fmt_msg, va_list ap, bool n
                             lctx->pctx->log_hook &&
                             lctx->pctx->force_hook_level >= level );
 
+    /* Messages from the log buffer (no_format) were recorded when they were
+     * logged into the buffer. */
+    if (!no_format && (level <= LogGetRecorderLevel()))
+    {
+        va_list aq;
+        va_copy(aq, ap);
+        LogRecorderAppendV(level, mod, fmt_msg, aq);
+        va_end(aq);
+    }
+
     /* NEEDS TO BE IN SYNC WITH THE CONDITION IN WouldLog() ABOVE! */
     if (!log_to_console && !log_to_syslog && !force_hook)
     {
@@ -517,7 +641,7 @@ static void VLogNoFormat(LogLevel level, const char *fmt_msg, va_list ap, bool n
 
 void VLog(LogLevel level, const char *fmt, va_list ap)
 {
-    VLogNoFormat(level, fmt, ap, false);
+    VLogNoFormat(level, LOG_MOD_NONE, fmt, ap, false);
 }
 
 /**
@@ -534,7 +658,8 @@ void LogRaw(LogLevel level, const char *prefix, const void *buf, size_t buflen)
     }
 
     LoggingContext *lctx = GetCurrentThreadContext();
-    if (level <= lctx->report_level || level <= lctx->log_level)
+    if (level <= lctx->report_level || level <= lctx->log_level ||
+        level <= LogGetRecorderLevel())
     {
         const unsigned char *src = buf;
         unsigned char dst[CF_BUFSIZE+1];
@@ -579,7 +704,7 @@ static void LogNoFormat(LogLevel level, const char *msg, ...)
 {
     va_list ap;
     va_start(ap, msg);
-    VLogNoFormat(level, msg, ap, true);
+    VLogNoFormat(level, LOG_MOD_NONE, msg, ap, true);
     va_end(ap);
 }
 
@@ -691,6 +816,12 @@ bool LogEnableModulesFromString(char *s)
     return retval;
 }
 
+const char *LogModuleToString(enum LogModule mod)
+{
+    assert(mod < LOG_MOD_MAX);
+    return log_modules[mod];
+}
+
 bool LogModuleEnabled(enum LogModule mod)
 {
     assert(mod > LOG_MOD_NONE);
@@ -717,7 +848,7 @@ void LogDebug(enum LogModule mod, const char *fmt, ...)
     {
         va_list ap;
         va_start(ap, fmt);
-        VLog(LOG_LEVEL_DEBUG, fmt, ap);
+        VLogNoFormat(LOG_LEVEL_DEBUG, mod, fmt, ap, false);
         va_end(ap);
         /* VLog(LOG_LEVEL_DEBUG, "%s: ...", */
         /*      debug_modules_description[mod_order], ...); */
@@ -728,6 +859,7 @@ void LogDebug(enum LogModule mod, const char *fmt, ...)
 void LogSetGlobalLevel(LogLevel level)
 {
     global_level = level;
+    LogEnabledLevelUpdate();
     if (global_system_log_level == LOG_LEVEL_NOTHING)
     {
         LoggingPrivSetLevels(level, level);
@@ -763,12 +895,14 @@ void LogSetGlobalSystemLogLevel(LogLevel level)
     assert(level != LOG_LEVEL_NOTHING);
 
     global_system_log_level = level;
+    LogEnabledLevelUpdate();
     LoggingPrivSetLevels(level, global_level);
 }
 
 void LogUnsetGlobalSystemLogLevel(void)
 {
     global_system_log_level = LOG_LEVEL_NOTHING;
+    LogEnabledLevelUpdate();
     LoggingPrivSetLevels(global_level, global_level);
 }
 
@@ -777,6 +911,17 @@ LogLevel LogGetGlobalSystemLogLevel(void)
     return global_system_log_level;
 }
 
+void LogSetRecorderLevel(LogLevel level)
+{
+    recorder_level = level;
+    LogEnabledLevelUpdate();
+}
+
+LogLevel LogGetRecorderLevel(void)
+{
+    return recorder_level;
+}
+
 void LoggingSetColor(bool enabled)
 {
     LoggingContext *lctx = GetCurrentThreadContext();
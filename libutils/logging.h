@@ -78,6 +78,9 @@ typedef struct
     bool color;
 
     LoggingPrivContext *pctx;
+
+    /* level this thread is accounted for in LOG_ENABLED_LEVEL */
+    LogLevel enabled_level;
 } LoggingContext;
 
 const char *LogLevelToString(LogLevel level);
@@ -105,6 +108,70 @@ void LogDebug(enum LogModule mod, const char *fmt, ...) FUNC_ATTR_PRINTF(2, 3);
 void LogRaw(LogLevel level, const char *prefix, const void *buf, size_t buflen);
 void VLog(LogLevel level, const char *fmt, va_list ap);
 
+/**
+ * Least severe log level that is compiled in by the LOG_LAZY() and
+ * LOG_DEBUG_LAZY() macros. Messages with a higher (more verbose) level are
+ * removed by the compiler, including the evaluation of their arguments.
+ *
+ * Define it on the command line of the consumer, e.g.
+ * -DLOG_COMPILE_LEVEL=LOG_LEVEL_VERBOSE for release builds without debug
+ * logging.
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/**
+ * Upper bound of the levels at which any thread may currently log, updated
+ * whenever the global or per-thread levels change. Only meant to be read
+ * through LogLevelMaybeEnabled().
+ */
+extern LogLevel LOG_ENABLED_LEVEL; /* GLOBAL_X */
+
+/**
+ * Cheap check for whether a message with level #level could be logged by some
+ * thread. Unlike WouldLog(), it doesn't need the thread's logging context, so
+ * it may return %true for messages that end up being dropped by Log(), but
+ * never returns %false for messages the current thread would log (except for
+ * levels only forced to the log hook with LoggingPrivContext::force_hook_level
+ * raised after LoggingPrivSetContext()).
+ */
+static inline bool LogLevelMaybeEnabled(LogLevel level)
+{
+#if defined(__GNUC__)
+    return (level <= __atomic_load_n(&LOG_ENABLED_LEVEL, __ATOMIC_RELAXED));
+#else
+    return (level <= LOG_ENABLED_LEVEL);
+#endif
+}
+
+/**
+ * Lazy front-ends for Log() and LogDebug(). The level is checked against
+ * #LOG_COMPILE_LEVEL at build time and against LogLevelMaybeEnabled() at run
+ * time *before* the arguments are evaluated, so disabled messages cost one
+ * relaxed load and a comparison. Don't pass arguments with side effects.
+ */
+#define LOG_LAZY(level, ...)                                            \
+    do                                                                  \
+    {                                                                   \
+        if (((level) <= LOG_COMPILE_LEVEL) &&                           \
+            LogLevelMaybeEnabled(level))                                \
+        {                                                               \
+            Log((level), __VA_ARGS__);                                  \
+        }                                                               \
+    } while (0)
+
+#define LOG_DEBUG_LAZY(mod, ...)                                        \
+    do                                                                  \
+    {                                                                   \
+        if ((LOG_LEVEL_DEBUG <= LOG_COMPILE_LEVEL) &&                   \
+            LogLevelMaybeEnabled(LOG_LEVEL_DEBUG) &&                    \
+            LogModuleEnabled(mod))                                      \
+        {                                                               \
+            LogDebug((mod), __VA_ARGS__);                               \
+        }                                                               \
+    } while (0)
+
 void LoggingSetAgentType(const char *type);
 void LoggingEnableTimestamps(bool enable);
 
@@ -124,6 +191,14 @@ void LogUnsetGlobalSystemLogLevel(void);
 
 void LoggingSetColor(bool enabled);
 
+/**
+ * Record messages with level #level and more severe into the in-memory
+ * flight recorder (see logging_recorder.h), regardless of whether they are
+ * logged or not. %LOG_LEVEL_NOTHING (the default) disables recording.
+ */
+void LogSetRecorderLevel(LogLevel level);
+LogLevel LogGetRecorderLevel(void);
+
 /*
  * Portable syslog()
  */
@@ -171,6 +246,7 @@ const char *GetErrorStr(void);
 const char *GetErrorStrFromCode(int error_code);
 
 void LogModuleHelp(void);
+const char *LogModuleToString(enum LogModule mod);
 bool LogModuleEnabled(enum LogModule mod);
 void LogEnableModule(enum LogModule mod);
 bool LogEnableModulesFromString(char *s);
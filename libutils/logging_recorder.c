@@ -0,0 +1,444 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <logging_recorder.h>
+#include <alloc.h>
+#include <misc_lib.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>        /* SYS_gettid */
+#endif
+
+/* We rely on the __atomic builtins (GCC >= 4.7, clang) here, the writer of
+ * a ring is always its owner thread, the readers (dumps) use the per-record
+ * sequence numbers to detect records overwritten while being read. */
+
+typedef struct
+{
+    uint64_t seq;               /* 1 + index of the record, 0 while written */
+    uint64_t timestamp;         /* nanoseconds since the Epoch */
+    uint32_t tid;
+    int8_t level;
+    uint8_t module;
+    uint16_t length;
+    char message[LOG_RECORDER_MESSAGE_SIZE];
+} LogRecord;
+
+typedef struct
+{
+    int in_use;                 /* owned by a running thread */
+    uint32_t tid;
+    size_t capacity;            /* power of 2 */
+    uint64_t head;              /* number of records appended so far */
+    LogRecord records[];
+} LogRecorderRing;
+
+static size_t ring_capacity = LOG_RECORDER_DEFAULT_RECORDS;
+
+static LogRecorderRing *rings[LOG_RECORDER_MAX_THREADS]; /* GLOBAL_X */
+static size_t n_rings = 0;      /* slots reserved in rings */
+static size_t n_dropped = 0;
+
+static pthread_once_t ring_key_init_once = PTHREAD_ONCE_INIT; /* GLOBAL_T */
+static pthread_key_t ring_key; /* GLOBAL_T, initialized by pthread_key_create */
+
+/* Used by the dump, static so that it doesn't eat the stack of a crashed
+ * thread. */
+static LogRecord dump_current[LOG_RECORDER_MAX_THREADS];
+static uint64_t dump_cursor[LOG_RECORDER_MAX_THREADS];
+static uint64_t dump_end[LOG_RECORDER_MAX_THREADS];
+static int dump_in_progress = 0;
+
+static char crash_dump_path[PATH_MAX];
+
+static void RingRelease(void *ring)
+{
+    __atomic_store_n(&((LogRecorderRing *) ring)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void RingKeyInitializeOnce(void)
+{
+    if (pthread_key_create(&ring_key, &RingRelease) != 0)
+    {
+        /* No way to report errors from here, the recorder then just
+         * doesn't record anything. */
+        __atomic_store_n(&n_rings, LOG_RECORDER_MAX_THREADS, __ATOMIC_RELAXED);
+    }
+}
+
+static uint32_t CurrentThreadId(void)
+{
+#ifdef __linux__
+    return (uint32_t) syscall(SYS_gettid);
+#else
+    static uint32_t next_thread_id = 1;
+    return __atomic_fetch_add(&next_thread_id, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+void LogRecorderSetCapacity(size_t records_per_thread)
+{
+    size_t capacity = 1;
+    while (capacity < records_per_thread)
+    {
+        capacity <<= 1;
+    }
+    __atomic_store_n(&ring_capacity, capacity, __ATOMIC_RELAXED);
+}
+
+static LogRecorderRing *GetCurrentThreadRing(void)
+{
+    pthread_once(&ring_key_init_once, &RingKeyInitializeOnce);
+
+    LogRecorderRing *ring = pthread_getspecific(ring_key);
+    if (ring != NULL)
+    {
+        return ring;
+    }
+
+    /* Try to reuse a ring of a finished thread first (keeping its records
+     * until they are overwritten). */
+    const size_t n = MIN(__atomic_load_n(&n_rings, __ATOMIC_ACQUIRE),
+                         LOG_RECORDER_MAX_THREADS);
+    for (size_t i = 0; (ring == NULL) && (i < n); i++)
+    {
+        LogRecorderRing *candidate = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        int free_ring = 0;
+        if ((candidate != NULL) &&
+            __atomic_compare_exchange_n(&candidate->in_use, &free_ring, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            ring = candidate;
+        }
+    }
+
+    if (ring == NULL)
+    {
+        const size_t idx = __atomic_fetch_add(&n_rings, 1, __ATOMIC_ACQ_REL);
+        if (idx >= LOG_RECORDER_MAX_THREADS)
+        {
+            return NULL;
+        }
+
+        const size_t capacity = __atomic_load_n(&ring_capacity, __ATOMIC_RELAXED);
+        ring = xcalloc(1, sizeof(LogRecorderRing) + capacity * sizeof(LogRecord));
+        ring->capacity = capacity;
+        ring->in_use = 1;
+        __atomic_store_n(&rings[idx], ring, __ATOMIC_RELEASE);
+    }
+
+    ring->tid = CurrentThreadId();
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+static LogRecord *RecordStart(LogLevel level, enum LogModule mod)
+{
+    LogRecorderRing *ring = GetCurrentThreadRing();
+    if (ring == NULL)
+    {
+        __atomic_fetch_add(&n_dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    LogRecord *rec = &ring->records[ring->head & (ring->capacity - 1)];
+
+    /* Invalidate the slot before overwriting it, see RecordRead(). */
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->timestamp = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+    rec->tid = ring->tid;
+    rec->level = level;
+    rec->module = mod;
+    return rec;
+}
+
+static void RecordFinish(LogRecord *rec, size_t length)
+{
+    LogRecorderRing *ring = pthread_getspecific(ring_key);
+    assert(ring != NULL);
+
+    /* Remove ending EOLN, like Log() does. */
+    if ((length > 0) && (rec->message[length - 1] == '\n'))
+    {
+        length--;
+    }
+    rec->length = length;
+
+    __atomic_store_n(&rec->seq, ring->head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+void LogRecorderAppend(LogLevel level, enum LogModule mod, const char *msg)
+{
+    LogRecord *rec = RecordStart(level, mod);
+    if (rec != NULL)
+    {
+        /* Same limit as with vsnprintf() in LogRecorderAppendV() */
+        const size_t length = strnlen(msg, LOG_RECORDER_MESSAGE_SIZE - 1);
+        memcpy(rec->message, msg, length);
+        RecordFinish(rec, length);
+    }
+}
+
+void LogRecorderAppendV(LogLevel level, enum LogModule mod,
+                        const char *fmt, va_list ap)
+{
+    LogRecord *rec = RecordStart(level, mod);
+    if (rec != NULL)
+    {
+        int ret = vsnprintf(rec->message, sizeof(rec->message), fmt, ap);
+        size_t length = (ret < 0) ? 0 : MIN((size_t) ret, sizeof(rec->message) - 1);
+        RecordFinish(rec, length);
+    }
+}
+
+size_t LogRecorderDroppedCount(void)
+{
+    return __atomic_load_n(&n_dropped, __ATOMIC_RELAXED);
+}
+
+/**
+ * Copy the record with the index #idx from #ring into #dst.
+ * @return %false if the record was (or is being) overwritten
+ */
+static bool RecordRead(const LogRecorderRing *ring, uint64_t idx, LogRecord *dst)
+{
+    const LogRecord *rec = &ring->records[idx & (ring->capacity - 1)];
+    const uint64_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+    if (seq != idx + 1)
+    {
+        return false;
+    }
+    memcpy(dst, rec, sizeof(LogRecord));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) == seq);
+}
+
+/**
+ * Load the oldest not yet dumped record of the ring #i into dump_current[i].
+ * @return %false if there are no more records in the ring
+ */
+static bool DumpAdvance(size_t i, const LogRecorderRing *ring)
+{
+    while (dump_cursor[i] < dump_end[i])
+    {
+        const uint64_t idx = dump_cursor[i]++;
+        if (RecordRead(ring, idx, &dump_current[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* async-signal-safe write() of all the data */
+static bool WriteAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+static size_t FormatUInt(char *dst, uint64_t value, int min_digits)
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (n < min_digits)
+    {
+        digits[n++] = '0';
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        dst[i] = digits[n - i - 1];
+    }
+    return n;
+}
+
+static size_t FormatString(char *dst, const char *str)
+{
+    size_t len = strlen(str);
+    memcpy(dst, str, len);
+    return len;
+}
+
+static bool DumpRecord(int fd, const LogRecord *rec)
+{
+    /* timestamp + tid + level/module + message */
+    char line[64 + 64 + LOG_RECORDER_MESSAGE_SIZE];
+    size_t len = 0;
+
+    len += FormatUInt(line + len, rec->timestamp / 1000000000, 1);
+    line[len++] = '.';
+    len += FormatUInt(line + len, rec->timestamp % 1000000000, 9);
+    line[len++] = ' ';
+    line[len++] = '[';
+    len += FormatUInt(line + len, rec->tid, 1);
+    line[len++] = ']';
+    line[len++] = ' ';
+    if ((rec->level >= LOG_LEVEL_CRIT) && (rec->level <= LOG_LEVEL_DEBUG))
+    {
+        len += FormatString(line + len, LogLevelToString(rec->level));
+    }
+    if ((rec->module > LOG_MOD_NONE) && (rec->module < LOG_MOD_MAX))
+    {
+        line[len++] = '/';
+        len += FormatString(line + len, LogModuleToString(rec->module));
+    }
+    line[len++] = ':';
+    line[len++] = ' ';
+
+    const size_t msg_len = MIN(rec->length, LOG_RECORDER_MESSAGE_SIZE);
+    memcpy(line + len, rec->message, msg_len);
+    len += msg_len;
+    line[len++] = '\n';
+
+    return WriteAll(fd, line, len);
+}
+
+bool LogRecorderDump(int fd)
+{
+    int not_dumping = 0;
+    if (!__atomic_compare_exchange_n(&dump_in_progress, &not_dumping, 1, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        /* Another thread is dumping (or crashed while dumping). */
+        return false;
+    }
+
+    const size_t n = MIN(__atomic_load_n(&n_rings, __ATOMIC_ACQUIRE),
+                         LOG_RECORDER_MAX_THREADS);
+    bool has_record[LOG_RECORDER_MAX_THREADS];
+    for (size_t i = 0; i < n; i++)
+    {
+        const LogRecorderRing *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        has_record[i] = false;
+        if (ring != NULL)
+        {
+            const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            dump_end[i] = head;
+            dump_cursor[i] = (head > ring->capacity) ? head - ring->capacity : 0;
+            has_record[i] = DumpAdvance(i, ring);
+        }
+    }
+
+    /* Merge the rings by the timestamps of the records. */
+    bool success = true;
+    while (success)
+    {
+        size_t oldest = n;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (has_record[i] &&
+                ((oldest == n) ||
+                 (dump_current[i].timestamp < dump_current[oldest].timestamp)))
+            {
+                oldest = i;
+            }
+        }
+        if (oldest == n)
+        {
+            break;
+        }
+
+        success = DumpRecord(fd, &dump_current[oldest]);
+        has_record[oldest] = DumpAdvance(oldest, rings[oldest]);
+    }
+
+    __atomic_store_n(&dump_in_progress, 0, __ATOMIC_RELEASE);
+    return success;
+}
+
+bool LogRecorderDumpToFile(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool success = LogRecorderDump(fd);
+    return ((close(fd) == 0) && success);
+}
+
+#ifndef __MINGW32__
+static void CrashHandler(int signum)
+{
+    LogRecorderDumpToFile(crash_dump_path);
+
+    /* The handler was installed with SA_RESETHAND, so this terminates the
+     * process the way the signal would have without us. */
+    raise(signum);
+}
+
+bool LogRecorderDumpOnCrash(const char *path)
+{
+    if (strlcpy(crash_dump_path, path, sizeof(crash_dump_path)) >= sizeof(crash_dump_path))
+    {
+        return false;
+    }
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = CrashHandler;
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+
+    const int signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+    {
+        if (sigaction(signals[i], &sa, NULL) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+#else
+bool LogRecorderDumpOnCrash(ARG_UNUSED const char *path)
+{
+    /* No sigaction() on Windows. */
+    return false;
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_LOGGING_RECORDER_H
+#define CFENGINE_LOGGING_RECORDER_H
+
+/**
+ * In-memory flight recorder for log messages.
+ *
+ * Every thread appends its records (level, timestamp, thread ID, module and
+ * the message bytes) into its own preallocated ring of fixed-size slots, so
+ * recording needs no locks and no memory allocation (except for the ring
+ * itself, allocated once when the thread records its first message). The
+ * oldest records are overwritten when a ring is full.
+ *
+ * The contents of all the rings can be dumped, merged by time, on demand or
+ * from a signal handler when the process crashes.
+ *
+ * Messages are fed into the recorder by Log() and friends for levels up to
+ * the one set with LogSetRecorderLevel() (see logging.h), independently of
+ * the console and system log levels.
+ */
+
+#include <logging.h>
+#include <stdbool.h>
+#include <stdarg.h>                     /* va_list */
+#include <stddef.h>                     /* size_t */
+
+/* Size of the message buffer of a record (including the terminating NUL
+ * byte), longer messages are truncated. */
+#define LOG_RECORDER_MESSAGE_SIZE 232
+
+/* Maximum number of threads recording at the same time. */
+#define LOG_RECORDER_MAX_THREADS 256
+
+#define LOG_RECORDER_DEFAULT_RECORDS 1024
+
+/**
+ * Set the number of records kept per thread (rounded up to a power of 2).
+ * Only affects the rings allocated after the call.
+ */
+void LogRecorderSetCapacity(size_t records_per_thread);
+
+/**
+ * Append a message into the calling thread's ring.
+ */
+void LogRecorderAppend(LogLevel level, enum LogModule mod,
+                       const char *msg);
+void LogRecorderAppendV(LogLevel level, enum LogModule mod,
+                        const char *fmt, va_list ap) FUNC_ATTR_PRINTF(3, 0);
+
+/**
+ * Write all recorded messages, oldest first, to the file descriptor #fd as
+ * text lines in the form
+ *
+ *   <epoch seconds>.<nanoseconds> [<thread ID>] <level>[/<module>]: <message>
+ *
+ * @note Only uses async-signal-safe functions so it can be called from a
+ *       signal handler. Records being overwritten while dumping are skipped.
+ * @return %false in case of write error
+ */
+bool LogRecorderDump(int fd);
+bool LogRecorderDumpToFile(const char *path);
+
+/**
+ * Dump the recorded messages into #path when the process is killed by
+ * SIGSEGV, SIGBUS, SIGILL, SIGFPE or SIGABRT. The signal is then re-raised
+ * with its default disposition.
+ *
+ * @return %false if #path is too long or the handlers cannot be installed
+ */
+bool LogRecorderDumpOnCrash(const char *path);
+
+/**
+ * Number of messages that were not recorded because all the rings were
+ * taken by other threads.
+ */
+size_t LogRecorderDroppedCount(void);
+
+#endif
@@ -28,6 +28,8 @@
 #include <logging.h>
 #include <alloc.h>
 #include <sequence.h>
+#include <printsize.h>
+#include <misc_lib.h>                                          /* xsnprintf */
 
 typedef enum
 {
@@ -150,14 +152,16 @@ static JsonElement *LookupVariable(Seq *hash_stack, const char *name, size_t nam
 {
     assert(SeqLength(hash_stack) > 0);
 
-    size_t num_comps = StringCountTokens(name, name_len, ".");
+    StringRef rest = StringRefMake(name, name_len);
+    StringRef comp;
 
     JsonElement *base_var = NULL;
     {
-        StringRef base_comp = StringGetToken(name, name_len, 0, ".");
-        char *base_comp_str = xstrndup(base_comp.data, base_comp.len);
+        /* The first component is looked up even if there is none. */
+        const StringRef base_comp =
+            StringRefNextToken(&rest, ".", &comp) ? comp : StringRefMake("", 0);
 
-        if (strcmp("-top-", base_comp_str) == 0)
+        if (StringRefEqualCString(base_comp, "-top-"))
         {
             base_var = SeqAt(hash_stack, 0);
         }
@@ -172,7 +176,7 @@ static JsonElement *LookupVariable(Seq *hash_stack, const char *name, size_t nam
 
             if (JsonGetType(hash) == JSON_TYPE_OBJECT)
             {
-                JsonElement *var = JsonObjectGet(hash, base_comp_str);
+                JsonElement *var = JsonObjectGetRef(hash, base_comp);
                 if (var)
                 {
                     base_var = var;
@@ -180,7 +184,6 @@ static JsonElement *LookupVariable(Seq *hash_stack, const char *name, size_t nam
                 }
             }
         }
-        free(base_comp_str);
     }
 
     if (!base_var)
@@ -188,17 +191,14 @@ static JsonElement *LookupVariable(Seq *hash_stack, const char *name, size_t nam
         return NULL;
     }
 
-    for (size_t i = 1; i < num_comps; i++)
+    while (StringRefNextToken(&rest, ".", &comp))
     {
         if (JsonGetType(base_var) != JSON_TYPE_OBJECT)
         {
             return NULL;
         }
 
-        StringRef comp = StringGetToken(name, name_len, i, ".");
-        char *comp_str = xstrndup(comp.data, comp.len);
-        base_var = JsonObjectGet(base_var, comp_str);
-        free(comp_str);
+        base_var = JsonObjectGetRef(base_var, comp);
 
         if (!base_var)
         {
@@ -314,31 +314,38 @@ static Mustache NextTag(const char *input,
 
 static void RenderHTMLContent(Buffer *out, const char *input, size_t len)
 {
+    size_t run_start = 0;
     for (size_t i = 0; i < len; i++)
     {
+        const char *entity;
         switch (input[i])
         {
         case '&':
-            BufferAppendString(out, "&amp;");
+            entity = "&amp;";
             break;
 
         case '"':
-            BufferAppendString(out, "&quot;");
+            entity = "&quot;";
             break;
 
         case '<':
-            BufferAppendString(out, "&lt;");
+            entity = "&lt;";
             break;
 
         case '>':
-            BufferAppendString(out, "&gt;");
+            entity = "&gt;";
             break;
 
         default:
-            BufferAppendChar(out, input[i]);
-            break;
+            continue;
         }
+
+        /* append the run of plain characters in one go */
+        BufferAppend(out, input + run_start, i - run_start);
+        BufferAppendString(out, entity);
+        run_start = i + 1;
     }
+    BufferAppend(out, input + run_start, len - run_start);
 }
 
 static void RenderContent(Buffer *out, const char *content, size_t len, bool html, bool skip_content)
@@ -387,19 +394,13 @@ static bool RenderVariablePrimitive(Buffer *out, const JsonElement *primitive, c
         return true;
 
     case JSON_PRIMITIVE_TYPE_INTEGER:
-        {
-            char *str = StringFromLong(JsonPrimitiveGetAsInteger(primitive));
-            BufferAppendString(out, str);
-            free(str);
-        }
+        /* same format as StringFromLong(), without the temporary string */
+        BufferAppendF(out, "%ld", JsonPrimitiveGetAsInteger(primitive));
         return true;
 
     case JSON_PRIMITIVE_TYPE_REAL:
-        {
-            char *str = StringFromDouble(JsonPrimitiveGetAsReal(primitive));
-            BufferAppendString(out, str);
-            free(str);
-        }
+        /* same format as StringFromDouble() */
+        BufferAppendF(out, "%.2f", JsonPrimitiveGetAsReal(primitive));
         return true;
 
     case JSON_PRIMITIVE_TYPE_BOOL:
@@ -432,38 +433,16 @@ static bool RenderVariableContainer(Buffer *out, const JsonElement *container, b
     return true;
 }
 
-static bool RenderVariable(Buffer *out,
-                           const char *content, size_t content_len,
-                           TagType conversion,
-                           Seq *hash_stack,
-                           const char *json_key)
+static bool RenderVariableValue(Buffer *out,
+                                JsonElement *var,
+                                TagType conversion,
+                                bool item_mode, bool key_mode,
+                                const char *json_key)
 {
-    JsonElement *var = NULL;
     bool escape = conversion == TAG_TYPE_VAR;
     bool serialize = conversion == TAG_TYPE_VAR_SERIALIZED;
     bool serialize_compact = conversion == TAG_TYPE_VAR_SERIALIZED_COMPACT;
 
-    const bool item_mode = strncmp(content, ".", content_len) == 0;
-    const bool key_mode = strncmp(content, "@", content_len) == 0;
-
-    if (item_mode || key_mode)
-    {
-        var = SeqAt(hash_stack, SeqLength(hash_stack) - 1);
-
-        // Leave this in, it's really useful when debugging here but useless otherwise
-        // for (int i=1; i < SeqLength(hash_stack); i++)
-        // {
-        //     JsonElement *dump = SeqAt(hash_stack, i);
-        //     Writer *w = StringWriter();
-        //     JsonWrite(w, dump, 0);
-        //     Log(LOG_LEVEL_ERR, "RenderVariable: at hash_stack position %d, we found var '%s'", i, StringWriterClose(w));
-        // }
-    }
-    else
-    {
-        var = LookupVariable(hash_stack, content, content_len);
-    }
-
     if (key_mode && json_key == NULL)
     {
         Log(LOG_LEVEL_WARNING, "RenderVariable: {{@}} Mustache tag must be used in a context where there's a valid key or iteration position");
@@ -510,6 +489,38 @@ static bool RenderVariable(Buffer *out,
     return false;
 }
 
+static bool RenderVariable(Buffer *out,
+                           const char *content, size_t content_len,
+                           TagType conversion,
+                           Seq *hash_stack,
+                           const char *json_key)
+{
+    JsonElement *var = NULL;
+
+    const bool item_mode = strncmp(content, ".", content_len) == 0;
+    const bool key_mode = strncmp(content, "@", content_len) == 0;
+
+    if (item_mode || key_mode)
+    {
+        var = SeqAt(hash_stack, SeqLength(hash_stack) - 1);
+
+        // Leave this in, it's really useful when debugging here but useless otherwise
+        // for (int i=1; i < SeqLength(hash_stack); i++)
+        // {
+        //     JsonElement *dump = SeqAt(hash_stack, i);
+        //     Writer *w = StringWriter();
+        //     JsonWrite(w, dump, 0);
+        //     Log(LOG_LEVEL_ERR, "RenderVariable: at hash_stack position %d, we found var '%s'", i, StringWriterClose(w));
+        // }
+    }
+    else
+    {
+        var = LookupVariable(hash_stack, content, content_len);
+    }
+
+    return RenderVariableValue(out, var, conversion, item_mode, key_mode, json_key);
+}
+
 static bool SetDelimiters(const char *content, size_t content_len,
                           char *delim_start, size_t *delim_start_len,
                           char *delim_end, size_t *delim_end_len)
@@ -917,3 +928,564 @@ bool MustacheRender(Buffer *out, const char *input, const JsonElement *hash)
 
     return success;
 }
+
+/*********************************************************************/
+/* Compiled templates                                                */
+/*********************************************************************/
+
+/* A compiled template is a flat array of nodes. The body of a section is the
+ * range of nodes following the section node up to (excluding) its #end, so
+ * rendering needs no parsing, no delimiter handling and no allocations except
+ * for the growth of the output buffer. The interpretation of the data is kept
+ * identical to Render() above, only the delimiters are resolved lexically
+ * (i.e. they don't change between iterations of a section). */
+
+typedef enum
+{
+    NODE_TYPE_TEXT,
+    NODE_TYPE_VAR,
+    NODE_TYPE_SECTION,
+} NodeType;
+
+typedef struct
+{
+    char **comps;               /* the dot-separated components of the name */
+    size_t num_comps;
+    bool top;                   /* the first component is "-top-" */
+    bool item_mode;             /* {{.}} */
+    bool key_mode;              /* {{@}} */
+} VarPath;
+
+typedef struct
+{
+    NodeType type;
+    TagType tag_type;           /* conversion of a variable, type of a section */
+
+    /* NODE_TYPE_TEXT */
+    size_t text_offset;         /* into MustacheTemplate_::text */
+    size_t text_len;
+
+    /* NODE_TYPE_VAR, NODE_TYPE_SECTION */
+    VarPath path;
+
+    /* NODE_TYPE_SECTION */
+    char *name;
+    size_t end;                 /* index of the first node after the section */
+    bool iterate_object;        /* see ShouldIterateObject() */
+} Node;
+
+struct MustacheTemplate_
+{
+    Node *nodes;
+    size_t num_nodes;
+    char *text;                 /* all the literal text of the template */
+};
+
+typedef struct
+{
+    MustacheTemplate *tmpl;
+    size_t nodes_capacity;
+    Buffer *text;
+    bool merge_text;            /* can text be appended to the last node */
+} Compiler;
+
+static Node *CompilerAddNode(Compiler *compiler, NodeType type)
+{
+    MustacheTemplate *tmpl = compiler->tmpl;
+    if (tmpl->num_nodes == compiler->nodes_capacity)
+    {
+        compiler->nodes_capacity = MAX(16, 2 * compiler->nodes_capacity);
+        tmpl->nodes = xrealloc(tmpl->nodes, compiler->nodes_capacity * sizeof(Node));
+    }
+
+    Node *node = tmpl->nodes + tmpl->num_nodes;
+    tmpl->num_nodes++;
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+
+    compiler->merge_text = (type == NODE_TYPE_TEXT);
+    return node;
+}
+
+static void CompilerAddText(Compiler *compiler, const char *text, size_t len)
+{
+    /* Only up to the terminating NUL byte, like BufferAppend() in Render(). */
+    len = strnlen(text, len);
+    if (len == 0)
+    {
+        return;
+    }
+
+    if (compiler->merge_text)
+    {
+        /* Literal text around comments, delimiter changes, etc. */
+        compiler->tmpl->nodes[compiler->tmpl->num_nodes - 1].text_len += len;
+    }
+    else
+    {
+        Node *node = CompilerAddNode(compiler, NODE_TYPE_TEXT);
+        node->text_offset = BufferSize(compiler->text);
+        node->text_len = len;
+    }
+    BufferAppend(compiler->text, text, len);
+}
+
+static void CompileVarPath(VarPath *path, const char *name, size_t name_len)
+{
+    path->item_mode = (name_len == 1) && (name[0] == '.');
+    path->key_mode = (name_len == 1) && (name[0] == '@');
+
+    /* The first component is always looked up, see LookupVariable(). */
+    path->num_comps = MAX(StringCountTokens(name, name_len, "."), 1);
+    path->comps = xmalloc(path->num_comps * sizeof(char *));
+    StringRef rest = StringRefMake(name, name_len);
+    for (size_t i = 0; i < path->num_comps; i++)
+    {
+        StringRef comp;
+        path->comps[i] = StringRefNextToken(&rest, ".", &comp) ?
+            xstrndup(comp.data, comp.len) : xstrdup("");
+    }
+    path->top = StringEqual(path->comps[0], "-top-");
+}
+
+/**
+ * Same as LookupVariable(), but with an already split name.
+ */
+static JsonElement *LookupVariablePath(Seq *hash_stack, const VarPath *path)
+{
+    assert(SeqLength(hash_stack) > 0);
+
+    JsonElement *base_var = NULL;
+    if (path->top)
+    {
+        base_var = SeqAt(hash_stack, 0);
+    }
+
+    for (ssize_t i = SeqLength(hash_stack) - 1; i >= 0; i--)
+    {
+        JsonElement *hash = SeqAt(hash_stack, i);
+        if ((hash != NULL) && (JsonGetType(hash) == JSON_TYPE_OBJECT))
+        {
+            JsonElement *var = JsonObjectGet(hash, path->comps[0]);
+            if (var)
+            {
+                base_var = var;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 1; (base_var != NULL) && (i < path->num_comps); i++)
+    {
+        if (JsonGetType(base_var) != JSON_TYPE_OBJECT)
+        {
+            return NULL;
+        }
+        base_var = JsonObjectGet(base_var, path->comps[i]);
+    }
+
+    return base_var;
+}
+
+/**
+ * Walks the template the same way Render() does, recording the literal text
+ * and the tags instead of rendering them.
+ */
+static bool Compile(Compiler *compiler, const char *input)
+{
+    char delim_start[MUSTACHE_MAX_DELIM_SIZE] = "{{";
+    size_t delim_start_len = strlen(delim_start);
+
+    char delim_end[MUSTACHE_MAX_DELIM_SIZE] = "}}";
+    size_t delim_end_len = strlen(delim_end);
+
+    const char *const start = input;
+
+    /* indices of the sections not closed yet */
+    size_t *open_sections = NULL;
+    size_t num_open_sections = 0;
+    size_t open_sections_capacity = 0;
+
+    bool success = false;
+    while (true)
+    {
+        Mustache tag = NextTag(input, delim_start, delim_start_len, delim_end, delim_end_len);
+
+        if (tag.type == TAG_TYPE_NONE)
+        {
+            CompilerAddText(compiler, input, strlen(input));
+            if (num_open_sections > 0)
+            {
+                Log(LOG_LEVEL_ERR, "Unexpected end to Mustache template");
+                break;
+            }
+            success = true;
+            break;
+        }
+
+        {
+            const char *line_begin = NULL;
+            const char *line_end = NULL;
+            if (!IsTagTypeRenderable(tag.type)
+                && tag.end != NULL
+                && IsTagStandalone(start, tag.begin, tag.end, &line_begin, &line_end))
+            {
+                if (line_begin > input)
+                {
+                    CompilerAddText(compiler, input, line_begin - input);
+                }
+                input = line_end;
+            }
+            else
+            {
+                CompilerAddText(compiler, input, tag.begin - input);
+                input = tag.end;
+            }
+        }
+
+        if (tag.type == TAG_TYPE_ERR)
+        {
+            break;
+        }
+        else if (tag.type == TAG_TYPE_DELIM)
+        {
+            if (!SetDelimiters(tag.content, tag.content_len,
+                               delim_start, &delim_start_len,
+                               delim_end, &delim_end_len))
+            {
+                break;
+            }
+        }
+        else if (tag.type == TAG_TYPE_SECTION || tag.type == TAG_TYPE_INVERTED)
+        {
+            Node *node = CompilerAddNode(compiler, NODE_TYPE_SECTION);
+            node->tag_type = tag.type;
+            node->name = xstrndup(tag.content, tag.content_len);
+            CompileVarPath(&node->path, tag.content, tag.content_len);
+            node->iterate_object = ShouldIterateObject(input,
+                                                       delim_start, delim_start_len,
+                                                       delim_end, delim_end_len);
+
+            if (num_open_sections == open_sections_capacity)
+            {
+                open_sections_capacity = MAX(8, 2 * open_sections_capacity);
+                open_sections = xrealloc(open_sections,
+                                         open_sections_capacity * sizeof(size_t));
+            }
+            open_sections[num_open_sections++] = compiler->tmpl->num_nodes - 1;
+        }
+        else if (tag.type == TAG_TYPE_SECTION_END)
+        {
+            if (num_open_sections == 0)
+            {
+                char *varname = xstrndup(tag.content, tag.content_len);
+                Log(LOG_LEVEL_WARNING, "Unknown section close in mustache template '%s'", varname);
+                free(varname);
+                break;
+            }
+            num_open_sections--;
+            compiler->tmpl->nodes[open_sections[num_open_sections]].end =
+                compiler->tmpl->num_nodes;
+            /* text after the section must not be merged into its body */
+            compiler->merge_text = false;
+        }
+        else if (tag.type != TAG_TYPE_COMMENT)
+        {
+            /* variables */
+            if (tag.content_len > 0)
+            {
+                Node *node = CompilerAddNode(compiler, NODE_TYPE_VAR);
+                node->tag_type = tag.type;
+                CompileVarPath(&node->path, tag.content, tag.content_len);
+            }
+            else
+            {
+                CompilerAddText(compiler, delim_start, delim_start_len);
+                CompilerAddText(compiler, delim_end, delim_end_len);
+            }
+        }
+    }
+
+    free(open_sections);
+    return success;
+}
+
+MustacheTemplate *MustacheCompile(const char *input)
+{
+    assert(input != NULL);
+
+    MustacheTemplate *tmpl = xcalloc(1, sizeof(MustacheTemplate));
+    Compiler compiler = {
+        .tmpl = tmpl,
+        .nodes_capacity = 0,
+        .text = BufferNew(),
+        .merge_text = false,
+    };
+
+    bool success = Compile(&compiler, input);
+    tmpl->text = BufferClose(compiler.text);
+    if (!success)
+    {
+        MustacheTemplateDestroy(tmpl);
+        return NULL;
+    }
+    return tmpl;
+}
+
+void MustacheTemplateDestroy(MustacheTemplate *tmpl)
+{
+    if (tmpl == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < tmpl->num_nodes; i++)
+    {
+        Node *node = tmpl->nodes + i;
+        for (size_t j = 0; j < node->path.num_comps; j++)
+        {
+            free(node->path.comps[j]);
+        }
+        free(node->path.comps);
+        free(node->name);
+    }
+    free(tmpl->nodes);
+    free(tmpl->text);
+    free(tmpl);
+}
+
+/* Rendered output is passed on to the writer in chunks of (at least) this
+ * size, see MustacheRenderCompiledToWriter(). */
+#define MUSTACHE_WRITER_CHUNK_SIZE (32 * 1024)
+
+static bool RenderNodes(Buffer *out, Writer *flush_to,
+                        const MustacheTemplate *tmpl,
+                        size_t begin, size_t end,
+                        Seq *hash_stack, const char *json_key,
+                        bool skip_content);
+
+/**
+ * Passes the rendered output on to #writer if there's enough of it.
+ */
+static bool FlushOutput(Buffer *out, Writer *writer, size_t min_size)
+{
+    const size_t size = BufferSize(out);
+    if ((writer == NULL) || (size == 0) || (size < min_size))
+    {
+        return true;
+    }
+
+    size_t written = WriterWriteLen(writer, BufferData(out), size);
+    BufferClear(out);
+    if (written != size)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to write rendered Mustache template");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Renders the body of the section at #index and pops the hash stack like the
+ * section end tag does in Render().
+ */
+static bool RenderSectionBody(Buffer *out, Writer *flush_to,
+                              const MustacheTemplate *tmpl, size_t index,
+                              Seq *hash_stack, const char *json_key,
+                              bool skip_content)
+{
+    if (!RenderNodes(out, flush_to, tmpl, index + 1, tmpl->nodes[index].end,
+                     hash_stack, json_key, skip_content))
+    {
+        return false;
+    }
+    SeqRemove(hash_stack, SeqLength(hash_stack) - 1);
+    return true;
+}
+
+static bool RenderSection(Buffer *out, Writer *flush_to,
+                          const MustacheTemplate *tmpl, size_t index,
+                          Seq *hash_stack, bool skip_content)
+{
+    const Node *node = tmpl->nodes + index;
+    const bool inverted = (node->tag_type == TAG_TYPE_INVERTED);
+
+    JsonElement *var = LookupVariablePath(hash_stack, &node->path);
+    SeqAppend(hash_stack, var);
+
+    if (!var)
+    {
+        return RenderSectionBody(out, flush_to, tmpl, index, hash_stack, NULL,
+                                 skip_content || !inverted);
+    }
+
+    if (JsonGetElementType(var) == JSON_ELEMENT_TYPE_PRIMITIVE)
+    {
+        if (JsonGetPrimitiveType(var) != JSON_PRIMITIVE_TYPE_BOOL)
+        {
+            Log(LOG_LEVEL_WARNING, "Mustache sections can only take a boolean or a container (array or map) value, but section '%s' isn't getting one of those.",
+                node->name);
+            return false;
+        }
+        bool skip = skip_content || (!JsonPrimitiveGetAsBool(var) ^ inverted);
+        return RenderSectionBody(out, flush_to, tmpl, index, hash_stack, NULL, skip);
+    }
+
+    const bool is_object = (JsonGetContainerType(var) == JSON_CONTAINER_TYPE_OBJECT);
+    if (is_object && !node->iterate_object)
+    {
+        return RenderSectionBody(out, flush_to, tmpl, index, hash_stack, NULL,
+                                 skip_content || inverted);
+    }
+
+    const size_t length = JsonLength(var);
+    if (length == 0)
+    {
+        return RenderSectionBody(out, flush_to, tmpl, index, hash_stack, NULL, !inverted);
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        JsonElement *child_hash = JsonAt(var, i);
+        SeqAppend(hash_stack, child_hash);
+
+        char index_str[PRINTSIZE(i)];
+        const char *key;
+        if (is_object)
+        {
+            key = JsonElementGetPropertyName(child_hash);
+        }
+        else
+        {
+            xsnprintf(index_str, sizeof(index_str), "%zu", i);
+            key = index_str;
+        }
+
+        if (!RenderSectionBody(out, flush_to, tmpl, index, hash_stack, key,
+                               skip_content || inverted))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RenderNodes(Buffer *out, Writer *flush_to,
+                        const MustacheTemplate *tmpl,
+                        size_t begin, size_t end,
+                        Seq *hash_stack, const char *json_key,
+                        bool skip_content)
+{
+    size_t i = begin;
+    while (i < end)
+    {
+        const Node *node = tmpl->nodes + i;
+        switch (node->type)
+        {
+        case NODE_TYPE_TEXT:
+            if (!skip_content)
+            {
+                BufferAppend(out, tmpl->text + node->text_offset, node->text_len);
+            }
+            i++;
+            break;
+
+        case NODE_TYPE_VAR:
+            if (!skip_content)
+            {
+                const VarPath *path = &node->path;
+                JsonElement *var;
+                if (path->item_mode || path->key_mode)
+                {
+                    var = SeqAt(hash_stack, SeqLength(hash_stack) - 1);
+                }
+                else
+                {
+                    var = LookupVariablePath(hash_stack, path);
+                }
+
+                if (!RenderVariableValue(out, var, node->tag_type,
+                                         path->item_mode, path->key_mode, json_key))
+                {
+                    return false;
+                }
+            }
+            i++;
+            break;
+
+        case NODE_TYPE_SECTION:
+            if (!RenderSection(out, flush_to, tmpl, i, hash_stack, skip_content))
+            {
+                return false;
+            }
+            i = node->end;
+            break;
+
+        default:
+            assert(false);
+            return false;
+        }
+
+        if (!FlushOutput(out, flush_to, MUSTACHE_WRITER_CHUNK_SIZE))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RenderCompiled(Buffer *out, Writer *flush_to,
+                           const MustacheTemplate *tmpl,
+                           const JsonElement *hash)
+{
+    Seq *hash_stack = SeqNew(10, NULL);
+    SeqAppend(hash_stack, (JsonElement*)hash);
+
+    bool success = RenderNodes(out, flush_to, tmpl, 0, tmpl->num_nodes,
+                               hash_stack, NULL, false);
+
+    SeqDestroy(hash_stack);
+
+    return success;
+}
+
+bool MustacheRenderCompiled(Buffer *out, const MustacheTemplate *tmpl,
+                            const JsonElement *hash)
+{
+    assert(out != NULL);
+    assert(tmpl != NULL);
+
+    return RenderCompiled(out, NULL, tmpl, hash);
+}
+
+bool MustacheRenderCompiledToWriter(Writer *out, const MustacheTemplate *tmpl,
+                                    const JsonElement *hash)
+{
+    assert(out != NULL);
+    assert(tmpl != NULL);
+
+    /* Twice the chunk size so that it rarely needs to grow. */
+    Buffer *buffer = BufferNewWithCapacity(2 * MUSTACHE_WRITER_CHUNK_SIZE);
+    bool success = (RenderCompiled(buffer, out, tmpl, hash) &&
+                    FlushOutput(buffer, out, 0));
+    BufferDestroy(buffer);
+
+    return success;
+}
+
+bool MustacheRenderToWriter(Writer *out, const char *input, const JsonElement *hash)
+{
+    assert(out != NULL);
+    assert(input != NULL);
+
+    MustacheTemplate *tmpl = MustacheCompile(input);
+    if (tmpl == NULL)
+    {
+        return false;
+    }
+
+    bool success = MustacheRenderCompiledToWriter(out, tmpl, hash);
+    MustacheTemplateDestroy(tmpl);
+
+    return success;
+}
@@ -25,7 +25,52 @@
 
 #include <json.h>
 #include <buffer.h>
+#include <writer.h>
+
+typedef struct MustacheTemplate_ MustacheTemplate;
 
 bool MustacheRender(Buffer *out, const char *input, const JsonElement *hash);
 
+/**
+ * @brief Parse a Mustache template for rendering it multiple times.
+ *
+ * The template is split into literal text, variables with pre-split names and
+ * sections with resolved bodies, so that MustacheRenderCompiled() doesn't
+ * need to look at the template text again. Changes of delimiters apply to the
+ * text following them, as they would in a single pass of MustacheRender().
+ *
+ * @param input The template (doesn't need to outlive the result).
+ * @return The compiled template or %NULL if the template is broken (unknown
+ *         section close, unterminated tag, unclosed section,...).
+ * @note The compiled template is never modified, so it can be rendered by
+ *       multiple threads at the same time.
+ */
+MustacheTemplate *MustacheCompile(const char *input);
+
+void MustacheTemplateDestroy(MustacheTemplate *tmpl);
+
+/**
+ * @brief Render a compiled template, see MustacheRender().
+ */
+bool MustacheRenderCompiled(Buffer *out, const MustacheTemplate *tmpl,
+                            const JsonElement *hash);
+
+/**
+ * @brief Render a template into a writer.
+ *
+ * The output is passed on to #out in chunks as it is rendered, so only a
+ * fixed-size buffer is used no matter how big the output is (unless a single
+ * variable expands to more than that).
+ *
+ * @return Whether the template was successfully rendered and written. In case
+ *         of failure, part of the output may have already been written.
+ */
+bool MustacheRenderToWriter(Writer *out, const char *input, const JsonElement *hash);
+
+/**
+ * @brief Render a compiled template into a writer, see MustacheRenderToWriter().
+ */
+bool MustacheRenderCompiledToWriter(Writer *out, const MustacheTemplate *tmpl,
+                                    const JsonElement *hash);
+
 #endif
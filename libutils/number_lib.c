@@ -0,0 +1,704 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <number_lib.h>
+
+#include <alloc.h>
+#include <float.h>                                 /* FLT_EVAL_METHOD, DBL_MIN */
+
+static const char DIGIT_PAIRS[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*********************************************************************/
+/* Integers                                                          */
+/*********************************************************************/
+
+size_t NumberFormatUint64(uint64_t value, char *buf)
+{
+    assert(buf != NULL);
+
+    /* Two digits at a time, from the end. */
+    char tmp[NUMBER_INT64_BUFSIZE];
+    char *p = tmp + sizeof(tmp);
+    while (value >= 100)
+    {
+        const unsigned int pair = value % 100;
+        value /= 100;
+        p -= 2;
+        memcpy(p, DIGIT_PAIRS + 2 * pair, 2);
+    }
+    if (value >= 10)
+    {
+        p -= 2;
+        memcpy(p, DIGIT_PAIRS + 2 * value, 2);
+    }
+    else
+    {
+        *(--p) = '0' + value;
+    }
+
+    const size_t len = (tmp + sizeof(tmp)) - p;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return len;
+}
+
+size_t NumberFormatInt64(int64_t value, char *buf)
+{
+    assert(buf != NULL);
+
+    if (value < 0)
+    {
+        buf[0] = '-';
+        /* unsigned negation works for INT64_MIN too */
+        return 1 + NumberFormatUint64(UINT64_C(0) - (uint64_t) value, buf + 1);
+    }
+    return NumberFormatUint64(value, buf);
+}
+
+static inline bool IsDecimalDigit(char c)
+{
+    return (c >= '0' && c <= '9');
+}
+
+/* Byte order independent, compilers turn this into a single load on
+ * little-endian machines. */
+static inline uint64_t Load8(const char *str)
+{
+    const unsigned char *p = (const unsigned char *) str;
+    return ((uint64_t) p[0])       | ((uint64_t) p[1] << 8)  |
+           ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+           ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+           ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline bool AllDigits8(uint64_t v)
+{
+    /* Every byte is 0x30-0x39: high nibbles are 3 and adding 6 doesn't
+     * carry into them. */
+    return ((v & UINT64_C(0xF0F0F0F0F0F0F0F0)) == UINT64_C(0x3030303030303030)) &&
+        (((v + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0)) ==
+         UINT64_C(0x3030303030303030));
+}
+
+/* Value of 8 digits loaded by Load8(), combining pairs, then quads, then
+ * the two halves with multiplications instead of one digit at a time. */
+static inline uint32_t ParseDigits8(uint64_t v)
+{
+    v = ((v & UINT64_C(0x0F0F0F0F0F0F0F0F)) * 2561) >> 8;
+    v = ((v & UINT64_C(0x00FF00FF00FF00FF)) * 6553601) >> 16;
+    return (uint32_t) (((v & UINT64_C(0x0000FFFF0000FFFF)) * UINT64_C(42949672960001)) >> 32);
+}
+
+/**
+ * @return Index after the digits starting at #i.
+ */
+static size_t SkipDigits(const char *str, size_t len, size_t i)
+{
+    while (len - i >= 8 && AllDigits8(Load8(str + i)))
+    {
+        i += 8;
+    }
+    while (i < len && IsDecimalDigit(str[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief Value of the (at most 19) digits str[start:end].
+ */
+static uint64_t ParseDigits(const char *str, size_t start, size_t end)
+{
+    assert(end - start <= 19);
+
+    uint64_t value = 0;
+    size_t i = start;
+    for (; end - i >= 8; i += 8)
+    {
+        value = value * 100000000 + ParseDigits8(Load8(str + i));
+    }
+    for (; i < end; i++)
+    {
+        value = value * 10 + (str[i] - '0');
+    }
+    return value;
+}
+
+int NumberParseInt64(const char *str, size_t len, int64_t *value_out)
+{
+    assert(str != NULL || len == 0);
+    assert(value_out != NULL);
+
+    size_t i = 0;
+    while (i < len && isspace((unsigned char) str[i]))
+    {
+        i++;
+    }
+
+    bool negative = false;
+    if (i < len && (str[i] == '-' || str[i] == '+'))
+    {
+        negative = (str[i] == '-');
+        i++;
+    }
+
+    const size_t start = i;
+    const size_t end = SkipDigits(str, len, start);
+    if (end == start)
+    {
+        return -81; // No digits found
+    }
+
+    /* Range is checked before termination, like with strtoimax() */
+    size_t first = start;
+    while (first < end && str[first] == '0')
+    {
+        first++;
+    }
+    if (end - first > 19)
+    {
+        return ERANGE;
+    }
+
+    /* 19 digits always fit into uint64_t */
+    const uint64_t magnitude = ParseDigits(str, first, end);
+    if (negative)
+    {
+        if (magnitude > (uint64_t) INT64_MAX + 1)
+        {
+            return ERANGE;
+        }
+    }
+    else if (magnitude > (uint64_t) INT64_MAX)
+    {
+        return ERANGE;
+    }
+
+    if (end < len && !isspace((unsigned char) str[end]))
+    {
+        return -83; // string not properly terminated
+    }
+
+    *value_out = negative ? (int64_t) (UINT64_C(0) - magnitude) : (int64_t) magnitude;
+    return 0;
+}
+
+/*********************************************************************/
+/* Floating point                                                    */
+/*********************************************************************/
+
+/* Powers of ten exactly representable as double */
+static const double EXACT_POWERS_OF_TEN[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+#define MAX_EXACT_POWER_OF_TEN 22
+
+/* Integers up to this are exact as double */
+#define MAX_EXACT_INTEGER (UINT64_C(1) << 53)
+
+/* Exponents beyond this overflow/underflow anyway, clamping avoids integer
+ * overflow when parsing them. */
+#define MAX_PARSED_EXPONENT 100000
+
+/**
+ * @brief Convert #mantissa * 10^#exponent to double if it can be done
+ *        exactly with a single floating-point operation (Clinger's fast
+ *        path).
+ */
+static bool DecimalToDoubleFast(uint64_t mantissa, long exponent, double *value_out)
+{
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+    if (mantissa > MAX_EXACT_INTEGER)
+    {
+        return false;
+    }
+
+    if (exponent >= 0 && exponent <= MAX_EXACT_POWER_OF_TEN)
+    {
+        *value_out = (double) mantissa * EXACT_POWERS_OF_TEN[exponent];
+        return true;
+    }
+    if (exponent < 0 && exponent >= -MAX_EXACT_POWER_OF_TEN)
+    {
+        *value_out = (double) mantissa / EXACT_POWERS_OF_TEN[-exponent];
+        return true;
+    }
+    if (exponent > MAX_EXACT_POWER_OF_TEN &&
+        exponent <= MAX_EXACT_POWER_OF_TEN + 15)
+    {
+        /* e.g. 12e30 = 12000000000e22 */
+        for (long i = MAX_EXACT_POWER_OF_TEN; i < exponent; i++)
+        {
+            mantissa *= 10;
+            if (mantissa > MAX_EXACT_INTEGER)
+            {
+                return false;
+            }
+        }
+        *value_out = (double) mantissa * EXACT_POWERS_OF_TEN[MAX_EXACT_POWER_OF_TEN];
+        return true;
+    }
+    return false;
+#else
+    /* Excess precision (x87) would round twice. */
+    (void) mantissa;
+    (void) exponent;
+    (void) value_out;
+    return false;
+#endif
+}
+
+/**
+ * @brief Call strtod() on a NUL-terminated copy of str[0:len].
+ */
+static double StrtodCopy(const char *str, size_t len, size_t *parsed, int *error)
+{
+    char small[128];
+    char *copy = (len < sizeof(small)) ? small : xmalloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+
+    char *end;
+    errno = 0;
+    const double value = strtod(copy, &end);
+    *error = errno;
+    *parsed = end - copy;
+
+    if (copy != small)
+    {
+        free(copy);
+    }
+    return value;
+}
+
+int NumberParseDouble(const char *str, size_t len, double *value_out)
+{
+    assert(str != NULL || len == 0);
+    assert(value_out != NULL);
+
+    size_t i = 0;
+    while (i < len && isspace((unsigned char) str[i]))
+    {
+        i++;
+    }
+    const size_t number_start = i;
+
+    bool negative = false;
+    if (i < len && (str[i] == '-' || str[i] == '+'))
+    {
+        negative = (str[i] == '-');
+        i++;
+    }
+
+    const size_t int_start = i;
+    const size_t int_end = SkipDigits(str, len, int_start);
+    size_t frac_start = int_end, frac_end = int_end;
+    i = int_end;
+    if (i < len && str[i] == '.')
+    {
+        frac_start = i + 1;
+        frac_end = SkipDigits(str, len, frac_start);
+        i = frac_end;
+    }
+
+    if (int_end == int_start && frac_end == frac_start)
+    {
+        /* No decimal digits, maybe "inf", "nan" or hexadecimal */
+        if (int_start < len && (isalpha((unsigned char) str[int_start])))
+        {
+            size_t parsed;
+            int error;
+            const double value = StrtodCopy(str + number_start, len - number_start,
+                                            &parsed, &error);
+            if (parsed == 0)
+            {
+                return -81;
+            }
+            i = number_start + parsed;
+            if (i < len && !isspace((unsigned char) str[i]))
+            {
+                return -83;
+            }
+            *value_out = value;
+            return 0;
+        }
+        return -81; // No digits found
+    }
+
+    if ((int_end - int_start == 1) && str[int_start] == '0' &&
+        i < len && (str[i] == 'x' || str[i] == 'X'))
+    {
+        /* hexadecimal */
+        size_t parsed;
+        int error;
+        const double value = StrtodCopy(str + number_start, len - number_start,
+                                        &parsed, &error);
+        i = number_start + parsed;
+        if (i < len && !isspace((unsigned char) str[i]))
+        {
+            return -83;
+        }
+        *value_out = value;
+        return (error == ERANGE) ? ERANGE : 0;
+    }
+
+    long exponent = 0;
+    if (i < len && (str[i] == 'e' || str[i] == 'E'))
+    {
+        size_t j = i + 1;
+        bool exponent_negative = false;
+        if (j < len && (str[j] == '-' || str[j] == '+'))
+        {
+            exponent_negative = (str[j] == '-');
+            j++;
+        }
+        if (j < len && IsDecimalDigit(str[j]))
+        {
+            for (; j < len && IsDecimalDigit(str[j]); j++)
+            {
+                if (exponent < MAX_PARSED_EXPONENT)
+                {
+                    exponent = exponent * 10 + (str[j] - '0');
+                }
+            }
+            if (exponent_negative)
+            {
+                exponent = -exponent;
+            }
+            i = j;
+        }
+        /* else 'e' is not part of the number, like in strtod() */
+    }
+
+    if (i < len && !isspace((unsigned char) str[i]))
+    {
+        return -83; // string not properly terminated
+    }
+
+    /* Significant digits, ignoring the leading zeros */
+    size_t first = int_start;
+    while (first < int_end && str[first] == '0')
+    {
+        first++;
+    }
+    size_t first_frac = frac_start;
+    if (first == int_end)
+    {
+        while (first_frac < frac_end && str[first_frac] == '0')
+        {
+            first_frac++;
+        }
+    }
+    const size_t int_digits = int_end - first;
+    const size_t frac_digits = frac_end - first_frac;
+    const long scale = exponent - (long) (frac_end - frac_start);
+
+    if (int_digits + frac_digits <= 19)
+    {
+        uint64_t mantissa = ParseDigits(str, first, int_end);
+        for (size_t j = first_frac; j < frac_end; j++)
+        {
+            mantissa = mantissa * 10 + (str[j] - '0');
+        }
+
+        double value;
+        if (mantissa == 0)
+        {
+            *value_out = negative ? -0.0 : 0.0;
+            return 0;
+        }
+        if (DecimalToDoubleFast(mantissa, scale, &value))
+        {
+            *value_out = negative ? -value : value;
+            return 0;
+        }
+    }
+
+    /* Let strtod() do the rounding, on the digits without the decimal point
+     * so that the locale doesn't matter: "-12.5e3" -> "-125e2" */
+    char small[128];
+    const size_t max_len = 1 + int_digits + (frac_end - frac_start) + 2 + 24;
+    char *buf = (max_len < sizeof(small)) ? small : xmalloc(max_len);
+    char *p = buf;
+    if (negative)
+    {
+        *(p++) = '-';
+    }
+    memcpy(p, str + first, int_digits);
+    p += int_digits;
+    memcpy(p, str + frac_start, frac_end - frac_start);
+    p += frac_end - frac_start;
+    if (p == buf || (p == buf + 1 && negative))
+    {
+        *(p++) = '0';
+    }
+    *(p++) = 'e';
+    NumberFormatInt64(scale, p);
+
+    char *end;
+    errno = 0;
+    *value_out = strtod(buf, &end);
+    const int error = errno;
+    if (buf != small)
+    {
+        free(buf);
+    }
+    return (error == ERANGE) ? ERANGE : 0;
+}
+
+/*********************************************************************/
+
+/**
+ * @brief Check if #mantissa * 10^#exponent is parsed back as #value.
+ */
+static bool DecimalRoundTrips(uint64_t mantissa, int exponent, double value)
+{
+    double parsed;
+    if (!DecimalToDoubleFast(mantissa, exponent, &parsed))
+    {
+        char buf[NUMBER_INT64_BUFSIZE + NUMBER_INT64_BUFSIZE];
+        const size_t len = NumberFormatUint64(mantissa, buf);
+        buf[len] = 'e';
+        NumberFormatInt64(exponent, buf + len + 1);
+        parsed = strtod(buf, NULL);
+    }
+    return (parsed == value);
+}
+
+/**
+ * @brief The decimal digits of #value (> 0) rounded to #precision
+ *        significant digits and the decimal exponent of the first one.
+ * @return number of digits written to #digits
+ */
+static size_t DecimalDigits(double value, int precision, char *digits, int *exponent)
+{
+    /* "%.*e" is exact, only the decimal point depends on the locale. */
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*e", precision - 1, value);
+
+    size_t num_digits = 0;
+    const char *p = buf;
+    for (; *p != '\0' && *p != 'e'; p++)
+    {
+        if (IsDecimalDigit(*p))
+        {
+            digits[num_digits++] = *p;
+        }
+    }
+    assert(*p == 'e');
+
+    int64_t exp;
+    p++;
+    NDEBUG_UNUSED const int ret = NumberParseInt64(p, strlen(p), &exp);
+    assert(ret == 0);
+    *exponent = (int) exp;
+    return num_digits;
+}
+
+/**
+ * @brief The digits of #mantissa without the trailing zeros.
+ * @return number of digits, #exponent adjusted to the first one
+ */
+static size_t MantissaDigits(uint64_t mantissa, int scale, char *digits, int *exponent)
+{
+    size_t num_digits = NumberFormatUint64(mantissa, digits);
+    *exponent = scale + (int) num_digits - 1;
+    while (num_digits > 1 && digits[num_digits - 1] == '0')
+    {
+        num_digits--;
+    }
+    return num_digits;
+}
+
+/**
+ * @brief Write #num_digits #digits with the decimal point after
+ *        #point_pos digits like Number.prototype.toString() does.
+ */
+static size_t FormatDigits(char *buf, const char *digits, size_t num_digits, int point_pos)
+{
+    char *p = buf;
+    const int k = num_digits;
+    const int n = point_pos;
+
+    if (k <= n && n <= 21)
+    {
+        /* integer, "1234000" */
+        memcpy(p, digits, k);
+        p += k;
+        memset(p, '0', n - k);
+        p += n - k;
+    }
+    else if (0 < n && n <= 21)
+    {
+        /* "12.34" */
+        memcpy(p, digits, n);
+        p += n;
+        *(p++) = '.';
+        memcpy(p, digits + n, k - n);
+        p += k - n;
+    }
+    else if (-6 < n && n <= 0)
+    {
+        /* "0.001234" */
+        *(p++) = '0';
+        *(p++) = '.';
+        memset(p, '0', -n);
+        p += -n;
+        memcpy(p, digits, k);
+        p += k;
+    }
+    else
+    {
+        /* "1.234e+21" */
+        *(p++) = digits[0];
+        if (k > 1)
+        {
+            *(p++) = '.';
+            memcpy(p, digits + 1, k - 1);
+            p += k - 1;
+        }
+        *(p++) = 'e';
+        *(p++) = (n - 1 >= 0) ? '+' : '-';
+        p += NumberFormatUint64((n - 1 >= 0) ? (n - 1) : (1 - n), p);
+    }
+
+    *p = '\0';
+    return p - buf;
+}
+
+size_t NumberFormatDouble(double value, char *buf)
+{
+    assert(buf != NULL);
+
+    if (isnan(value))
+    {
+        strcpy(buf, "NaN");
+        return 3;
+    }
+
+    char *p = buf;
+    if (signbit(value))
+    {
+        *(p++) = '-';
+        value = -value;
+    }
+
+    if (isinf(value))
+    {
+        strcpy(p, "Infinity");
+        return (p - buf) + 8;
+    }
+    if (value == 0.0)
+    {
+        *(p++) = '0';
+        *p = '\0';
+        return p - buf;
+    }
+    if (value < (double) MAX_EXACT_INTEGER && value == floor(value))
+    {
+        return (p - buf) + NumberFormatUint64((uint64_t) value, p);
+    }
+
+    /*
+     * Start from the exact 17 digits (always enough to round-trip). For
+     * normal values at most one decimal with 15 significant digits can
+     * parse back as value and it is next to the 17 digits truncated to 15,
+     * the same goes for the closest of the (at most two) 16 digit ones. The
+     * candidates are checked with the exact fast path of the parser where
+     * possible, so usually no more than one call to snprintf() is needed.
+     */
+    char digits[24];
+    int exponent;
+    NDEBUG_UNUSED const size_t num_digits17 =
+        DecimalDigits(value, 17, digits, &exponent);
+    assert(num_digits17 == 17);
+
+    const int first_precision = (value < DBL_MIN) ? 1 : 15;
+    for (int precision = first_precision; precision < 17; precision++)
+    {
+        const uint64_t truncated = ParseDigits(digits, 0, precision);
+        const bool round_up = (digits[precision] >= '5');
+        /* closest first */
+        const uint64_t candidates[] = {
+            round_up ? truncated + 1 : truncated,
+            round_up ? truncated : truncated + 1,
+            truncated - 1,
+        };
+        const int scale = exponent - precision + 1;
+        for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+        {
+            if (candidates[i] != 0 && DecimalRoundTrips(candidates[i], scale, value))
+            {
+                const size_t num_digits = MantissaDigits(candidates[i], scale,
+                                                         digits, &exponent);
+                return (p - buf) + FormatDigits(p, digits, num_digits, exponent + 1);
+            }
+        }
+    }
+
+    const size_t num_digits = MantissaDigits(ParseDigits(digits, 0, 17),
+                                             exponent - 16, digits, &exponent);
+    return (p - buf) + FormatDigits(p, digits, num_digits, exponent + 1);
+}
+
+size_t NumberFormatDoubleFixed(double value, int decimals, char *buf)
+{
+    assert(decimals >= 0);
+    assert(buf != NULL);
+
+    /* "%.*f" is exact and doesn't group digits without the ' flag, so only
+     * the decimal point depends on the locale. */
+    const int len = snprintf(buf, NUMBER_DOUBLE_FIXED_BUFSIZE(decimals),
+                             "%.*f", decimals, value);
+    assert(len >= 0 && len < NUMBER_DOUBLE_FIXED_BUFSIZE(decimals));
+    if (decimals == 0 || !isfinite(value))
+    {
+        return len;
+    }
+
+    /* The decimal point is between the integer digits and the last
+     * #decimals digits */
+    const char *const fraction = buf + len - decimals;
+    char *point = (buf[0] == '-') ? buf + 1 : buf;
+    while (point < fraction && IsDecimalDigit(*point))
+    {
+        point++;
+    }
+    memmove(point + 1, fraction, decimals + 1);
+    *point = '.';
+    return (point + 1 + decimals) - buf;
+}
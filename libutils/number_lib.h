@@ -0,0 +1,101 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_NUMBER_LIB_H
+#define CFENGINE_NUMBER_LIB_H
+
+#include <stddef.h>                                           /* size_t */
+#include <stdint.h>                                           /* int64_t */
+#include <float.h>                                     /* DBL_MAX_10_EXP */
+
+/*
+ * Conversions between numbers and their decimal representation, writing
+ * into caller-provided buffers and independent of the current locale.
+ */
+
+/* Buffer sizes (including the terminating NUL byte) big enough for any
+ * value formatted by the functions below. */
+#define NUMBER_INT64_BUFSIZE 21                  /* "-9223372036854775808" */
+#define NUMBER_DOUBLE_BUFSIZE 32              /* "-2.2250738585072014e-308" */
+/* "-" + 309 digits of DBL_MAX + "." + #decimals digits, with room for the
+ * (possibly multi-byte) decimal point of the locale before it's replaced */
+#define NUMBER_DOUBLE_FIXED_BUFSIZE(decimals) (DBL_MAX_10_EXP + (decimals) + 16)
+
+/**
+ * @brief Format #value in decimal.
+ * @param buf at least NUMBER_INT64_BUFSIZE bytes, NUL-terminated
+ * @return length of the result (without the NUL byte)
+ */
+size_t NumberFormatInt64(int64_t value, char *buf);
+size_t NumberFormatUint64(uint64_t value, char *buf);
+
+/**
+ * @brief Format #value with the shortest representation parsing back to
+ *        exactly the same value.
+ *
+ * The format is the same as ECMAScript's Number.prototype.toString(), e.g.
+ * "42", "0.1", "1.5e+300" or "1e-7" ("NaN", "Infinity" and "-Infinity"
+ * for the special values), but keeping the sign of "-0".
+ *
+ * @param buf at least NUMBER_DOUBLE_BUFSIZE bytes, NUL-terminated
+ * @return length of the result (without the NUL byte)
+ */
+size_t NumberFormatDouble(double value, char *buf);
+
+/**
+ * @brief Format #value like printf("%.*f", decimals, value), but always
+ *        with '.' as the decimal point.
+ *
+ * @param buf at least NUMBER_DOUBLE_FIXED_BUFSIZE(#decimals) bytes,
+ *            NUL-terminated
+ * @return length of the result (without the NUL byte)
+ */
+size_t NumberFormatDoubleFixed(double value, int decimals, char *buf);
+
+/**
+ * @brief Parse a decimal integer from the first #len bytes of #str.
+ *
+ * Accepts the same input as StringToInt64() (optional leading whitespace,
+ * optional sign, digits, then the end or whitespace).
+ *
+ * @return 0 on success, ERANGE if the value doesn't fit, -81 if there are
+ *         no digits, -83 if the digits are followed by something else than
+ *         whitespace (same as StringToInt64()); #value_out is only set on
+ *         success
+ */
+int NumberParseInt64(const char *str, size_t len, int64_t *value_out);
+
+/**
+ * @brief Parse a floating-point number from the first #len bytes of #str.
+ *
+ * Decimal numbers (with an optional fraction and exponent) are handled
+ * directly and always with '.' as the decimal point; other forms accepted
+ * by strtod() (hexadecimal, "inf", "nan") are passed on to it.
+ *
+ * @return 0 on success, ERANGE on overflow/underflow (#value_out is set to
+ *         the value returned by strtod()), -81 if there is no number, -83
+ *         if the number is followed by something else than whitespace
+ */
+int NumberParseDouble(const char *str, size_t len, double *value_out);
+
+#endif
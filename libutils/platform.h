@@ -1001,6 +1001,10 @@ struct timespec
 # define O_TEXT 0
 #endif
 
+#if !defined O_CLOEXEC
+# define O_CLOEXEC 0
+#endif
+
 #if defined(__MINGW32__)
 /* _mkdir(3) */
 # include <direct.h>
@@ -23,6 +23,10 @@
 
 #include <platform.h>
 #include <proc_keyvalue.h>
+#include <alloc.h>
+#include <number_lib.h>
+#include <logging.h>
+#include <string_lib.h>                                    /* StringEqual */
 
 typedef struct
 {
@@ -33,15 +37,17 @@ typedef struct
 bool KeyNumericParserCallback(const char *field, const char *value, void *param)
 {
     KeyNumericParserInfo *info = param;
-    long long numeric_value;
-
-    if (sscanf(value,
+    char *end;
+    errno = 0;
+    /* Same as the "%I64d" (decimal) and "%lli" (any base) formats this
+     * used to parse with */
 #if defined(__MINGW32__)
-               "%I64d",
+    const long long numeric_value = strtoll(value, &end, 10);
 #else
-               "%lli",
+    const long long numeric_value = strtoll(value, &end, 0);
 #endif
-               &numeric_value) != 1)
+
+    if (end == value || errno == ERANGE)
     {
         /* Malformed file */
         return false;
@@ -81,3 +87,252 @@ bool ParseKeyValue(FILE *fd, KeyValueCallback callback, void *param)
 
     return (ferror(fd) == 0);
 }
+
+struct ProcKeyTable
+{
+    uint32_t seed;
+    uint32_t mask;
+    size_t n_fields;
+    ProcKeyField *slots;        /* key is NULL for empty slots */
+    uint32_t *key_lengths;
+};
+
+static inline uint32_t ProcKeyHash(const char *key, size_t len, uint32_t seed)
+{
+    /* FNV-1a, the keys are short */
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+/* Put all keys into a table of #size slots, false on a collision */
+static bool ProcKeyTableFill(ProcKeyTable *table, const ProcKeyField *fields,
+                             size_t n_fields, uint32_t size, uint32_t seed)
+{
+    memset(table->slots, 0, size * sizeof(ProcKeyField));
+    for (size_t i = 0; i < n_fields; i++)
+    {
+        const size_t len = strlen(fields[i].key);
+        const uint32_t slot = ProcKeyHash(fields[i].key, len, seed) & (size - 1);
+        if (table->slots[slot].key != NULL)
+        {
+            return false;
+        }
+        table->slots[slot] = fields[i];
+        table->key_lengths[slot] = len;
+    }
+    return true;
+}
+
+ProcKeyTable *ProcKeyTableNew(const ProcKeyField *fields, size_t n_fields)
+{
+    assert(fields != NULL || n_fields == 0);
+
+    /* A duplicate key collides with every seed and size */
+    for (size_t i = 0; i < n_fields; i++)
+    {
+        for (size_t j = i + 1; j < n_fields; j++)
+        {
+            if (StringEqual(fields[i].key, fields[j].key))
+            {
+                Log(LOG_LEVEL_ERR, "Duplicate key '%s' in /proc key table",
+                    fields[i].key);
+                return NULL;
+            }
+        }
+    }
+
+    ProcKeyTable *table = xmalloc(sizeof(ProcKeyTable));
+    table->n_fields = n_fields;
+    table->slots = NULL;
+    table->key_lengths = NULL;
+
+    /* Look for a seed without collisions, so that each lookup is one probe.
+     * With four times as many slots as keys a few tries are enough. */
+    uint32_t size = 8;
+    while (size < 4 * n_fields)
+    {
+        size *= 2;
+    }
+    while (true)
+    {
+        table->slots = xrealloc(table->slots, size * sizeof(ProcKeyField));
+        table->key_lengths = xrealloc(table->key_lengths, size * sizeof(uint32_t));
+        for (uint32_t seed = 0; seed < 64; seed++)
+        {
+            if (ProcKeyTableFill(table, fields, n_fields, size, seed))
+            {
+                table->seed = seed;
+                table->mask = size - 1;
+                for (size_t i = 0; i < size; i++)
+                {
+                    if (table->slots[i].key != NULL)
+                    {
+                        table->slots[i].key = xstrdup(table->slots[i].key);
+                    }
+                }
+                return table;
+            }
+        }
+        size *= 2;
+        assert(size < (1 << 24));   /* keys are distinct */
+    }
+}
+
+void ProcKeyTableDestroy(ProcKeyTable *table)
+{
+    if (table != NULL)
+    {
+        for (size_t i = 0; i <= table->mask; i++)
+        {
+            free((char *) table->slots[i].key);
+        }
+        free(table->slots);
+        free(table->key_lengths);
+        free(table);
+    }
+}
+
+static inline const ProcKeyField *ProcKeyTableLookup(const ProcKeyTable *table,
+                                                     const char *key, size_t len)
+{
+    const uint32_t slot = ProcKeyHash(key, len, table->seed) & table->mask;
+    const ProcKeyField *field = &table->slots[slot];
+    if (field->key != NULL && table->key_lengths[slot] == len &&
+        memcmp(field->key, key, len) == 0)
+    {
+        return field;
+    }
+    return NULL;
+}
+
+ssize_t ParseKeyNumericValueFields(const char *data, size_t size,
+                                   const ProcKeyTable *table, void *fields)
+{
+    assert(data != NULL || size == 0);
+    assert(table != NULL);
+    assert(fields != NULL);
+
+    const char *p = data;
+    const char *const end = data + size;
+    size_t n_found = 0;
+
+    while (p < end && n_found < table->n_fields)
+    {
+        const char *line_end = memchr(p, '\n', end - p);
+        if (line_end == NULL)
+        {
+            line_end = end;
+        }
+        const char *const colon = memchr(p, ':', line_end - p);
+
+        const ProcKeyField *field =
+            (colon != NULL) ? ProcKeyTableLookup(table, p, colon - p) : NULL;
+        if (field != NULL)
+        {
+            const char *start = colon + 1;
+            while (start < line_end && (*start == ' ' || *start == '\t'))
+            {
+                start++;
+            }
+            const char *digits_end = start;
+            if (digits_end < line_end && *digits_end == '-')
+            {
+                digits_end++;
+            }
+            while (digits_end < line_end && *digits_end >= '0' && *digits_end <= '9')
+            {
+                digits_end++;
+            }
+
+            int64_t value;
+            if (NumberParseInt64(start, digits_end - start, &value) != 0)
+            {
+                return -1;
+            }
+            memcpy((char *) fields + field->offset, &value, sizeof(value));
+            n_found++;
+        }
+
+        p = line_end + 1;
+    }
+
+    return n_found;
+}
+
+void ProcFileBufferDestroy(ProcFileBuffer *buffer)
+{
+    if (buffer != NULL)
+    {
+        free(buffer->data);
+        buffer->data = NULL;
+        buffer->size = 0;
+        buffer->capacity = 0;
+    }
+}
+
+#ifndef __MINGW32__
+ssize_t ProcFileReadFd(int fd, ProcFileBuffer *buffer)
+{
+    assert(buffer != NULL);
+
+    if (buffer->capacity == 0)
+    {
+        buffer->capacity = 4096;
+        buffer->data = xmalloc(buffer->capacity);
+    }
+
+    /* Always read the whole file with one pread() from offset 0. If it
+     * fills the buffer, grow it and read everything again: continuing at
+     * the old offset would mix two snapshots of a file that changed
+     * between the reads. */
+    ssize_t n;
+    while (true)
+    {
+        const size_t wanted = buffer->capacity - 1;
+        n = pread(fd, buffer->data, wanted, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+
+        /* A short read is the end of the file: regular files and the
+         * seq_file based /proc files fill the whole buffer otherwise. */
+        if ((size_t) n < wanted)
+        {
+            break;
+        }
+        buffer->capacity *= 2;
+        buffer->data = xrealloc(buffer->data, buffer->capacity);
+    }
+    const size_t total = n;
+
+    buffer->data[total] = '\0';
+    buffer->size = total;
+    return total;
+}
+
+ssize_t ProcFileRead(const char *path, ProcFileBuffer *buffer)
+{
+    assert(path != NULL);
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    const ssize_t size = ProcFileReadFd(fd, buffer);
+    const int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return size;
+}
+#endif
@@ -26,6 +26,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
 
 /*
  * Parser for line-oriented key-value formats found in Linux /proc filesystem.
@@ -45,4 +46,77 @@ typedef bool (*KeyValueCallback) (const char *field, const char *value, void *pa
  */
 bool ParseKeyValue(FILE *fd, KeyValueCallback callback, void *param);
 
+/*
+ * Selective parsing into a struct, for polling many /proc files.
+ *
+ * The wanted keys are compiled once into a ProcKeyTable (a collision-free
+ * hash table), each key naming an int64_t field of the caller's struct.
+ * The file is read whole into a reusable ProcFileBuffer, and only the
+ * values of the wanted keys are converted, stopping as soon as all of
+ * them have been found.
+ *
+ *   typedef struct { int64_t rss; int64_t threads; } Status;
+ *   static const ProcKeyField fields[] = {
+ *       { "VmRSS", offsetof(Status, rss) },
+ *       { "Threads", offsetof(Status, threads) },
+ *   };
+ *   ProcKeyTable *table = ProcKeyTableNew(fields, 2);
+ *   ...
+ *   if (ProcFileRead("/proc/self/status", &buffer) >= 0)
+ *   {
+ *       Status status = { -1, -1 };
+ *       ParseKeyNumericValueFields(buffer.data, buffer.size, table, &status);
+ *   }
+ */
+
+typedef struct
+{
+    const char *key;
+    size_t offset;              /* offsetof() an int64_t field */
+} ProcKeyField;
+
+typedef struct ProcKeyTable ProcKeyTable;
+
+/*
+ * #fields may be freed afterwards. Returns NULL (logged) if a key occurs
+ * more than once.
+ */
+ProcKeyTable *ProcKeyTableNew(const ProcKeyField *fields, size_t n_fields);
+void ProcKeyTableDestroy(ProcKeyTable *table);
+
+/*
+ * Sets the field of each wanted key found in #data[0, #size) to its value,
+ * which is the first (decimal) number after the ':', without any unit
+ * ("kB" in /proc/meminfo). Fields of keys not found are left untouched.
+ *
+ * Returns the number of fields set, or -1 on a syntax error in a line
+ * that was needed.
+ */
+ssize_t ParseKeyNumericValueFields(const char *data, size_t size,
+                                   const ProcKeyTable *table, void *fields);
+
+typedef struct
+{
+    char *data;                 /* NUL-terminated */
+    size_t size;
+    size_t capacity;
+} ProcFileBuffer;
+
+#define PROC_FILE_BUFFER_INIT { NULL, 0, 0 }
+
+void ProcFileBufferDestroy(ProcFileBuffer *buffer);
+
+#ifndef __MINGW32__
+/*
+ * Read all of a /proc file into #buffer, growing it if needed, with a
+ * single pread() once the buffer is big enough. ProcFileReadFd() reads from
+ * offset 0 of an already open file, so a file can be kept open and
+ * polled.
+ *
+ * Returns the size read, or -1 on error (with errno set).
+ */
+ssize_t ProcFileRead(const char *path, ProcFileBuffer *buffer);
+ssize_t ProcFileReadFd(int fd, ProcFileBuffer *buffer);
+#endif
+
 #endif
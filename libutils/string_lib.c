@@ -32,6 +32,8 @@
 #include <definitions.h> // CF_BUFSIZE
 #include <condition_macros.h> // nt_static_assert()
 #include <printsize.h>
+#include <string_scan.h>
+#include <number_lib.h>
 
 char *StringVFormat(const char *fmt, va_list ap)
 {
@@ -88,12 +90,20 @@ size_t StringCopy(const char *const from, char *const to, const size_t buf_size)
 unsigned int StringHash(const char *str, unsigned int seed)
 {
     assert(str != NULL);
-    unsigned const char *p = (unsigned const char *) str;
-    unsigned int h = seed;
 
     // NULL is not allowed, but we will prevent segfault anyway:
     size_t len = (str != NULL) ? strlen(str) : 0;
 
+    return StringRefHash(StringRefMake(str, len), seed);
+}
+
+unsigned int StringRefHash(StringRef ref, unsigned int seed)
+{
+    assert(ref.data != NULL || ref.len == 0);
+    unsigned const char *p = (unsigned const char *) ref.data;
+    const size_t len = ref.len;
+    unsigned int h = seed;
+
     /* https://en.wikipedia.org/wiki/Jenkins_hash_function#one-at-a-time */
     for (size_t i = 0; i < len; i++)
     {
@@ -329,22 +339,27 @@ char *SearchAndReplace(const char *source, const char *search, const char *repla
         return xstrdup(source);
     }
 
+    const size_t search_len = strlen(search);
+    const size_t replace_len = strlen(replace);
+    const char *const source_end = source + strlen(source);
+
     Writer *w = StringWriter();
 
     for (;;)
     {
-        const char *found_ptr = strstr(source_ptr, search);
+        const char *found_ptr = StringScanFind(source_ptr, source_end - source_ptr,
+                                               search, search_len);
 
         if (found_ptr == NULL)
         {
-            WriterWrite(w, source_ptr);
+            WriterWriteBytes(w, source_ptr, source_end - source_ptr);
             return StringWriterClose(w);
         }
 
-        WriterWriteLen(w, source_ptr, found_ptr - source_ptr);
-        WriterWrite(w, replace);
+        WriterWriteBytes(w, source_ptr, found_ptr - source_ptr);
+        WriterWriteBytes(w, replace, replace_len);
 
-        source_ptr += found_ptr - source_ptr + strlen(search);
+        source_ptr = found_ptr + search_len;
     }
 }
 
@@ -432,25 +447,23 @@ char *StringSubstring(const char *source, size_t source_len, int start, int len)
 
 bool StringIsNumeric(const char *s)
 {
-    for (; *s; s++)
-    {
-        if (!isdigit((unsigned char)*s))
-        {
-            return false;
-        }
-    }
-
-    return true;
+    const size_t len = strlen(s);
+    return (StringScanSpanDigits(s, len) == len);
 }
 
 bool StringIsPrintable(const char *s)
 {
-    for (; *s; s++)
+    const size_t len = strlen(s);
+    size_t i = 0;
+    while ((i += StringScanSpanPrintable(s + i, len - i)) < len)
     {
-        if (!isprint((unsigned char)*s))
+        /* Not printable ASCII, but isprint() may accept it in the current
+         * locale. */
+        if (!isprint((unsigned char) s[i]))
         {
             return false;
         }
+        i++;
     }
 
     return true;
@@ -493,34 +506,16 @@ int StringToLong(const char *str, long *value_out)
     assert(str != NULL);
     assert(value_out != NULL);
 
-    char *endptr = NULL;
-
-    errno = 0;
-    const long val = strtol(str, &endptr, 10);
-
-    if ((errno == ERANGE && (val == LONG_MAX || val == LONG_MIN)))
-    {
-        return ERANGE; // Overflow or underflow
-    }
-
-    if (endptr == str)
-    {
-        return -81; // No digits found
-    }
-
-    if (endptr == NULL)
-    {
-        return -82; // endpointer not set by strtol
-    }
-
-    if (*endptr != '\0' && !isspace(*endptr))
+    int64_t val;
+    const int ret = NumberParseInt64(str, strlen(str), &val);
+    if (ret != 0)
     {
-        return -83; // string not properly terminated
+        return ret;
     }
 
-    if (errno != 0)
+    if (val > LONG_MAX || val < LONG_MIN)
     {
-        return errno; // Unknown error
+        return ERANGE; // Overflow or underflow
     }
 
     *value_out = val;
@@ -763,44 +758,11 @@ unsigned long StringToUlongExitOnError(const char *str)
  */
 int StringToInt64(const char *str, int64_t *value_out)
 {
-    nt_static_assert(sizeof(int64_t) == sizeof(intmax_t));
     nt_static_assert(ERANGE != 0);
     assert(str != NULL);
     assert(value_out != NULL);
 
-    char *endptr = NULL;
-    int64_t val;
-
-    errno = 0;
-    val = strtoimax(str, &endptr, 10);
-
-    if ((errno == ERANGE && (val == INTMAX_MAX || val == INTMAX_MIN)))
-    {
-        return ERANGE; // Overflow or underflow
-    }
-
-    if (endptr == str)
-    {
-        return -81; // No digits found
-    }
-
-    if (endptr == NULL)
-    {
-        return -82; // endpointer not set by strtol
-    }
-
-    if (*endptr != '\0' && !isspace(*endptr))
-    {
-        return -83; // string not properly terminated
-    }
-
-    if (errno != 0)
-    {
-        return errno; // Unknown error
-    }
-
-    *value_out = val;
-    return 0;
+    return NumberParseInt64(str, strlen(str), value_out);
 }
 
 /**
@@ -875,9 +837,9 @@ long StringToLongUnsafe(const char *str)
 
 char *StringFromLong(long number)
 {
-    char *str = xcalloc(32, sizeof(char));
-    snprintf(str, 32, "%ld", number);
-    return str;
+    char buf[NUMBER_INT64_BUFSIZE];
+    const size_t len = NumberFormatInt64(number, buf);
+    return xmemdup(buf, len + 1);
 }
 
 /*********************************************************************/
@@ -886,8 +848,15 @@ double StringToDouble(const char *str)
 {
     assert(str);
 
+    double result;
+    const int ret = NumberParseDouble(str, strlen(str), &result);
+    if (ret == 0 || ret == ERANGE)
+    {
+        return result;
+    }
+
     char *end;
-    double result = strtod(str, &end);
+    result = strtod(str, &end);
 
     assert(!*end && "Failed to convert string to double");
 
@@ -972,11 +941,18 @@ int CountChar(const char *string, char sep)
         return 0;
     }
 
-    if (string && (strlen(string) == 0))
+    const size_t len = strlen(string);
+    if (len == 0)
     {
         return 0;
     }
 
+    if (memchr(string, '\\', len) == NULL)
+    {
+        /* No escaped separators, just count them. */
+        return StringScanCountChar(string, len, sep);
+    }
+
     for (const char *sp = string; *sp != '\0'; sp++)
     {
         if ((*sp == '\\') && (*(sp + 1) == sep))
@@ -1044,15 +1020,15 @@ ssize_t StringReplaceN(char *buf, size_t buf_size,
         return 0;
     }
 
-    char *p = strstr(buf, find);
+    size_t find_len = strlen(find);
+    size_t buf_len = strlen(buf);
+    const char *p = StringScanFind(buf, buf_len, find, find_len);
     if (p == NULL)
     {
         return 0;
     }
 
-    size_t find_len = strlen(find);
     size_t replace_len = strlen(replace);
-    size_t buf_len = strlen(buf);
     size_t buf_idx = 0;
     char tmp[buf_size];
     ssize_t tmp_len = 0;
@@ -1075,7 +1051,7 @@ ssize_t StringReplaceN(char *buf, size_t buf_size,
         tmp_len += replace_len;
 
         buf_idx = buf_newidx + find_len;
-        p = strstr(&buf[buf_idx], find);
+        p = StringScanFind(&buf[buf_idx], buf_len - buf_idx, find, find_len);
         n--;
     } while ((p != NULL) && (n > 0));
 
@@ -1194,6 +1170,164 @@ StringRef StringGetToken(const char *str, size_t len, size_t index, const char *
     return ref;
 }
 
+/*********************************************************************/
+
+int StringRefCompare(StringRef a, StringRef b)
+{
+    const size_t len = MIN(a.len, b.len);
+    const int cmp = (len > 0) ? memcmp(a.data, b.data, len) : 0;
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    return (a.len > b.len) - (a.len < b.len);
+}
+
+bool StringRefEqual(StringRef a, StringRef b)
+{
+    return (a.len == b.len) &&
+        ((a.len == 0) || (memcmp(a.data, b.data, a.len) == 0));
+}
+
+bool StringRefEqualCString(StringRef ref, const char *str)
+{
+    assert(str != NULL);
+    /* #ref may contain NUL bytes (strncmp() would stop there and read past
+     * the end of #str) and ref.data may be NULL if it's empty */
+    return (strnlen(str, ref.len + 1) == ref.len) &&
+        ((ref.len == 0) || (memcmp(str, ref.data, ref.len) == 0));
+}
+
+bool StringRefStartsWith(StringRef ref, StringRef prefix)
+{
+    return (ref.len >= prefix.len) &&
+        StringRefEqual(StringRefMake(ref.data, prefix.len), prefix);
+}
+
+bool StringRefEndsWith(StringRef ref, StringRef suffix)
+{
+    return (ref.len >= suffix.len) &&
+        StringRefEqual(StringRefMake(ref.data + ref.len - suffix.len, suffix.len), suffix);
+}
+
+ssize_t StringRefFindChar(StringRef ref, char c)
+{
+    if (ref.len == 0)
+    {
+        return -1;
+    }
+    const char *found = memchr(ref.data, c, ref.len);
+    return (found != NULL) ? (found - ref.data) : -1;
+}
+
+ssize_t StringRefFind(StringRef ref, StringRef sub)
+{
+    if (sub.len == 0)
+    {
+        return 0;
+    }
+    if (sub.len > ref.len)
+    {
+        return -1;
+    }
+    const char *found = memmem(ref.data, ref.len, sub.data, sub.len);
+    return (found != NULL) ? (found - ref.data) : -1;
+}
+
+StringRef StringRefSub(StringRef ref, size_t start, size_t len)
+{
+    start = MIN(start, ref.len);
+    len = MIN(len, ref.len - start);
+    return StringRefMake(ref.data + start, len);
+}
+
+StringRef StringRefTrim(StringRef ref)
+{
+    while (ref.len > 0 && isspace((unsigned char) ref.data[0]))
+    {
+        ref.data++;
+        ref.len--;
+    }
+    while (ref.len > 0 && isspace((unsigned char) ref.data[ref.len - 1]))
+    {
+        ref.len--;
+    }
+    return ref;
+}
+
+bool StringRefSplitNext(StringRef *rest, char delimiter, StringRef *field)
+{
+    assert(rest != NULL);
+    assert(field != NULL);
+
+    if (rest->data == NULL)
+    {
+        return false;
+    }
+
+    const ssize_t pos = StringRefFindChar(*rest, delimiter);
+    if (pos < 0)
+    {
+        *field = *rest;
+        *rest = StringRefNull();
+    }
+    else
+    {
+        *field = StringRefMake(rest->data, pos);
+        rest->data += pos + 1;
+        rest->len -= pos + 1;
+    }
+    return true;
+}
+
+bool StringRefNextToken(StringRef *rest, const char *seps, StringRef *token)
+{
+    assert(rest != NULL);
+    assert(seps != NULL);
+    assert(token != NULL);
+
+    if (rest->data == NULL)
+    {
+        return false;
+    }
+
+    const StringRef next = StringNextToken(rest->data, rest->len, seps);
+    if (next.data == NULL)
+    {
+        *rest = StringRefNull();
+        return false;
+    }
+
+    *token = next;
+    const size_t consumed = (next.data - rest->data) + next.len;
+    rest->data += consumed;
+    rest->len -= consumed;
+    return true;
+}
+
+int StringRefToLong(StringRef ref, long *value_out)
+{
+    assert(ref.data != NULL || ref.len == 0);
+    assert(value_out != NULL);
+
+    int64_t val;
+    const int ret = NumberParseInt64(ref.data, ref.len, &val);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    if (val > LONG_MAX || val < LONG_MIN)
+    {
+        return ERANGE; // Overflow or underflow
+    }
+
+    *value_out = val;
+    return 0;
+}
+
+/*********************************************************************/
+
 char **String2StringArray(const char *str, char separator)
 /**
  * Parse CSVs into char **.
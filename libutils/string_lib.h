@@ -30,8 +30,12 @@
 #include <stdarg.h> // va_list
 #include <compiler.h>
 #include <sys/types.h> // ssize_t
+#include <assert.h>
 
 
+/**
+ * A slice of a string, not necessarily NUL-terminated, not owning the data.
+ */
 typedef struct
 {
     const char *data;
@@ -190,6 +194,93 @@ char *EscapeCharCopy(const char *str, char to_escape, char escape_with);
 
 char *ScanPastChars(char *scanpast, char *input);
 
+/**
+ * @defgroup StringRef Functions working on string slices
+ *
+ * None of these allocate memory or need the data to be NUL-terminated.
+ * @{
+ */
+
+static inline StringRef StringRefMake(const char *data, size_t len)
+{
+    return (StringRef) { .data = data, .len = len };
+}
+
+static inline StringRef StringRefFromCString(const char *str)
+{
+    assert(str != NULL);
+    return (StringRef) { .data = str, .len = strlen(str) };
+}
+
+int  StringRefCompare(StringRef a, StringRef b);
+bool StringRefEqual(StringRef a, StringRef b);
+
+/**
+ * @brief Check if the slice #ref is equal to the NUL-terminated string #str.
+ * @note Reads at most ref.len + 1 bytes of #str.
+ */
+bool StringRefEqualCString(StringRef ref, const char *str);
+
+bool StringRefStartsWith(StringRef ref, StringRef prefix);
+bool StringRefEndsWith(StringRef ref, StringRef suffix);
+
+/**
+ * @brief Same as StringHash() on a NUL-terminated copy of #ref.
+ */
+unsigned int StringRefHash(StringRef ref, unsigned int seed);
+
+/**
+ * @return Index of the first occurrence of #c or #sub in #ref, or -1 if not
+ *         found.
+ */
+ssize_t StringRefFindChar(StringRef ref, char c);
+ssize_t StringRefFind(StringRef ref, StringRef sub);
+
+/**
+ * @brief Part of #ref starting at #start of (at most) #len bytes.
+ * @note #start and #len are clamped to the length of #ref.
+ */
+StringRef StringRefSub(StringRef ref, size_t start, size_t len);
+
+/**
+ * @brief #ref without leading and trailing whitespace.
+ */
+StringRef StringRefTrim(StringRef ref);
+
+/**
+ * @brief Split #rest on #delimiter, one field at a time.
+ *
+ * Every delimiter ends a field, so there are empty fields between adjacent
+ * delimiters and after a trailing one. Once the last field is returned,
+ * rest->data is set to NULL.
+ *
+ * @code
+ * StringRef rest = StringRefFromCString("a,,b");
+ * StringRef field;
+ * while (StringRefSplitNext(&rest, ',', &field))
+ * {
+ *     // "a", "", "b"
+ * }
+ * @endcode
+ *
+ * @return false if there are no more fields (#field is not set)
+ */
+bool StringRefSplitNext(StringRef *rest, char delimiter, StringRef *field);
+
+/**
+ * @brief Like StringRefSplitNext(), but splitting on any of #seps and
+ *        skipping empty tokens (see StringGetToken()).
+ */
+bool StringRefNextToken(StringRef *rest, const char *seps, StringRef *token);
+
+/**
+ * @brief Parse a decimal integer, see StringToLong() for the accepted input
+ *        and the return values.
+ */
+int StringRefToLong(StringRef ref, long *value_out) FUNC_WARN_UNUSED_RESULT;
+
+/** @} */
+
 /**
  * @brief Strips the newline character off a string, in place
  * @param str The string to strip
@@ -0,0 +1,358 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <string_matcher.h>
+
+#include <alloc.h>
+#include <logging.h>
+#include <string_scan.h>                        /* StringScanFindAnyChar() */
+
+#define NO_PATTERN SIZE_MAX
+
+/* The root state, also the end of the dictionary link chains */
+#define ROOT 0
+
+/* Set in transitions to states where a pattern ends */
+#define REPORT_FLAG UINT32_C(0x80000000)
+
+struct StringMatcher
+{
+    size_t n_patterns;
+    size_t *pattern_lengths;
+    size_t *next_same;          /* next pattern with the same string, or NO_PATTERN */
+
+    uint8_t byte_class[256];    /* 0 for bytes not in any pattern */
+    size_t n_classes;
+
+    /* Transitions of state s are at transitions[s * n_classes], the values
+     * are target states multiplied by n_classes too, to save a
+     * multiplication per byte, with REPORT_FLAG if the target reports
+     * matches. */
+    uint32_t *transitions;
+    size_t n_states;
+
+    size_t *output;             /* first pattern ending at the state, or NO_PATTERN */
+    uint32_t *dict_link;        /* nearest state with an output on the
+                                 * failure chain, or ROOT */
+
+    /* The bytes leaving the root state, if there are few enough of them to
+     * skip to the next one with StringScanFindAnyChar() while in it */
+    bool skip_to_start;
+    char start_bytes[STRING_SCAN_ANY_CHAR_MAX];
+    size_t n_start_bytes;
+};
+
+static void StringMatcherBuildClasses(StringMatcher *matcher,
+                                      const char *const *patterns, size_t n_patterns,
+                                      bool ignore_case)
+{
+    bool used[256] = { false };
+    for (size_t i = 0; i < n_patterns; i++)
+    {
+        for (const unsigned char *p = (const unsigned char *) patterns[i]; *p != '\0'; p++)
+        {
+            used[ignore_case ? tolower(*p) : *p] = true;
+        }
+    }
+
+    memset(matcher->byte_class, 0, sizeof(matcher->byte_class));
+    matcher->n_classes = 1;
+    for (int c = 0; c < 256; c++)
+    {
+        if (used[c])
+        {
+            matcher->byte_class[c] = matcher->n_classes++;
+        }
+    }
+    if (ignore_case)
+    {
+        for (int c = 'a'; c <= 'z'; c++)
+        {
+            matcher->byte_class[toupper(c)] = matcher->byte_class[c];
+        }
+    }
+}
+
+StringMatcher *StringMatcherNew(const char *const *patterns, size_t n_patterns,
+                                bool ignore_case)
+{
+    assert(patterns != NULL || n_patterns == 0);
+
+    StringMatcher *matcher = xcalloc(1, sizeof(StringMatcher));
+    matcher->n_patterns = n_patterns;
+    matcher->pattern_lengths = xmalloc(MAX(n_patterns, 1) * sizeof(size_t));
+    matcher->next_same = xmalloc(MAX(n_patterns, 1) * sizeof(size_t));
+    StringMatcherBuildClasses(matcher, patterns, n_patterns, ignore_case);
+    const size_t k = matcher->n_classes;
+
+    size_t max_states = 1;
+    for (size_t i = 0; i < n_patterns; i++)
+    {
+        matcher->pattern_lengths[i] = strlen(patterns[i]);
+        max_states += matcher->pattern_lengths[i];
+    }
+    if (max_states > (REPORT_FLAG - 1) / k)
+    {
+        Log(LOG_LEVEL_ERR, "Too many patterns for a string matcher (%zu bytes)",
+            max_states - 1);
+        StringMatcherDestroy(matcher);
+        return NULL;
+    }
+
+    /* Trie of the patterns, a 0 transition means no child (the root is
+     * nobody's child) */
+    matcher->transitions = xcalloc(max_states * k, sizeof(uint32_t));
+    matcher->output = xmalloc(max_states * sizeof(size_t));
+    matcher->output[ROOT] = NO_PATTERN;
+    size_t n_states = 1;
+    for (size_t i = 0; i < n_patterns; i++)
+    {
+        matcher->next_same[i] = NO_PATTERN;
+        if (matcher->pattern_lengths[i] == 0)
+        {
+            continue;
+        }
+
+        size_t state = ROOT;
+        for (const unsigned char *p = (const unsigned char *) patterns[i]; *p != '\0'; p++)
+        {
+            uint32_t *const next = &matcher->transitions[state * k + matcher->byte_class[*p]];
+            if (*next == 0)
+            {
+                matcher->output[n_states] = NO_PATTERN;
+                *next = n_states++;
+            }
+            state = *next;
+        }
+
+        /* Keep duplicates in index order */
+        size_t *last = &matcher->output[state];
+        while (*last != NO_PATTERN)
+        {
+            last = &matcher->next_same[*last];
+        }
+        *last = i;
+    }
+    matcher->n_states = n_states;
+
+    /* Breadth-first, so the failure state of a state (shorter) is complete
+     * when the state is reached: missing transitions are those of the
+     * failure state, which makes the trie a DFA. */
+    uint32_t *const fail = xmalloc(n_states * sizeof(uint32_t));
+    uint32_t *const queue = xmalloc(n_states * sizeof(uint32_t));
+    matcher->dict_link = xmalloc(n_states * sizeof(uint32_t));
+    bool *const reports = xmalloc(n_states * sizeof(bool));
+    fail[ROOT] = ROOT;
+    matcher->dict_link[ROOT] = ROOT;
+    reports[ROOT] = false;
+    size_t head = 0, tail = 0;
+    queue[tail++] = ROOT;
+    while (head < tail)
+    {
+        const uint32_t state = queue[head++];
+        uint32_t *const row = &matcher->transitions[state * k];
+        const uint32_t *const fail_row = &matcher->transitions[fail[state] * k];
+        for (size_t c = 0; c < k; c++)
+        {
+            const uint32_t child = row[c];
+            if (child == 0)
+            {
+                row[c] = (state == ROOT) ? ROOT : fail_row[c];
+                continue;
+            }
+
+            const uint32_t child_fail = (state == ROOT) ? ROOT : fail_row[c];
+            fail[child] = child_fail;
+            matcher->dict_link[child] = (matcher->output[child_fail] != NO_PATTERN)
+                                            ? child_fail
+                                            : matcher->dict_link[child_fail];
+            reports[child] = (matcher->output[child] != NO_PATTERN ||
+                              matcher->dict_link[child] != ROOT);
+            queue[tail++] = child;
+        }
+    }
+    assert(tail == n_states);
+    free(queue);
+    free(fail);
+
+    for (size_t i = 0; i < n_states * k; i++)
+    {
+        const uint32_t target = matcher->transitions[i];
+        matcher->transitions[i] = target * k | (reports[target] ? REPORT_FLAG : 0);
+    }
+    free(reports);
+
+    matcher->skip_to_start = true;
+    matcher->n_start_bytes = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        if (matcher->transitions[ROOT + matcher->byte_class[c]] == ROOT)
+        {
+            continue;
+        }
+        if (matcher->n_start_bytes == STRING_SCAN_ANY_CHAR_MAX)
+        {
+            matcher->skip_to_start = false;
+            break;
+        }
+        matcher->start_bytes[matcher->n_start_bytes++] = c;
+    }
+
+    matcher->transitions = xrealloc(matcher->transitions, n_states * k * sizeof(uint32_t));
+    matcher->output = xrealloc(matcher->output, n_states * sizeof(size_t));
+    return matcher;
+}
+
+void StringMatcherDestroy(StringMatcher *matcher)
+{
+    if (matcher != NULL)
+    {
+        free(matcher->pattern_lengths);
+        free(matcher->next_same);
+        free(matcher->transitions);
+        free(matcher->output);
+        free(matcher->dict_link);
+        free(matcher);
+    }
+}
+
+size_t StringMatcherPatternCount(const StringMatcher *matcher)
+{
+    assert(matcher != NULL);
+    return matcher->n_patterns;
+}
+
+size_t StringMatcherScan(const StringMatcher *matcher,
+                         const char *text, size_t length,
+                         StringMatcherFn fn, void *data)
+{
+    assert(matcher != NULL);
+    assert(text != NULL || length == 0);
+    assert(fn != NULL);
+
+    const unsigned char *const bytes = (const unsigned char *) text;
+    const size_t k = matcher->n_classes;
+    size_t n_matches = 0;
+    uint32_t state = ROOT;  /* multiplied by k, with REPORT_FLAG */
+    for (size_t i = 0; i < length; i++)
+    {
+        if (state == ROOT && matcher->skip_to_start)
+        {
+            /* No match can start before the next start byte */
+            i += StringScanFindAnyChar(text + i, length - i,
+                                       matcher->start_bytes, matcher->n_start_bytes);
+            if (i == length)
+            {
+                break;
+            }
+        }
+        state = matcher->transitions[(state & ~REPORT_FLAG) + matcher->byte_class[bytes[i]]];
+        if ((state & REPORT_FLAG) == 0)
+        {
+            continue;
+        }
+
+        /* The state's own patterns, then those of its proper suffixes */
+        size_t s = (state & ~REPORT_FLAG) / k;
+        if (matcher->output[s] == NO_PATTERN)
+        {
+            s = matcher->dict_link[s];
+        }
+        while (s != ROOT)
+        {
+            for (size_t p = matcher->output[s]; p != NO_PATTERN; p = matcher->next_same[p])
+            {
+                n_matches++;
+                if (!fn(p, i + 1 - matcher->pattern_lengths[p], data))
+                {
+                    return n_matches;
+                }
+            }
+            s = matcher->dict_link[s];
+        }
+    }
+    return n_matches;
+}
+
+bool StringMatcherMatches(const StringMatcher *matcher, const char *text, size_t length)
+{
+    assert(matcher != NULL);
+    assert(text != NULL || length == 0);
+
+    const unsigned char *const bytes = (const unsigned char *) text;
+    uint32_t state = ROOT;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (state == ROOT && matcher->skip_to_start)
+        {
+            i += StringScanFindAnyChar(text + i, length - i,
+                                       matcher->start_bytes, matcher->n_start_bytes);
+            if (i == length)
+            {
+                break;
+            }
+        }
+        state = matcher->transitions[(state & ~REPORT_FLAG) + matcher->byte_class[bytes[i]]];
+        if ((state & REPORT_FLAG) != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct
+{
+    bool *matched;
+    size_t n_matched;
+    size_t n_patterns;
+} MatchedPatterns;
+
+static bool MarkMatched(size_t pattern, ARG_UNUSED size_t offset, void *data)
+{
+    MatchedPatterns *const state = data;
+    if (!state->matched[pattern])
+    {
+        state->matched[pattern] = true;
+        state->n_matched++;
+    }
+    return (state->n_matched < state->n_patterns);
+}
+
+size_t StringMatcherMatchedPatterns(const StringMatcher *matcher,
+                                    const char *text, size_t length,
+                                    bool *matched)
+{
+    assert(matcher != NULL);
+    assert(matched != NULL || matcher->n_patterns == 0);
+
+    if (matcher->n_patterns == 0)
+    {
+        return 0;
+    }
+    memset(matched, 0, matcher->n_patterns * sizeof(bool));
+    MatchedPatterns state = { matched, 0, matcher->n_patterns };
+    StringMatcherScan(matcher, text, length, MarkMatched, &state);
+    return state.n_matched;
+}
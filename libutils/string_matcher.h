@@ -0,0 +1,97 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_STRING_MATCHER_H
+#define CFENGINE_STRING_MATCHER_H
+
+#include <stddef.h>                                           /* size_t */
+#include <stdbool.h>
+
+/**
+ * @brief Search a text for many literal patterns at once.
+ *
+ *        An Aho-Corasick automaton compiled into a transition table over
+ *        the bytes that occur in the patterns, so a scan is one table lookup
+ *        per byte of text whatever the number of patterns. Use it instead of
+ *        calling StringContains() once per pattern.
+ *
+ *        The table takes 4 bytes per state (at most the total length of the
+ *        patterns) and per distinct byte of the patterns.
+ *
+ *        If the patterns start with at most STRING_SCAN_ANY_CHAR_MAX
+ *        distinct bytes (both cases counted when ignoring case), the text
+ *        before the next of them is skipped with the vector kernels of
+ *        string_scan.h instead of going through the table.
+ */
+typedef struct StringMatcher StringMatcher;
+
+/**
+ * @brief Called for each match, in the order of their end in the text,
+ *        longer patterns first for the same end.
+ * @param pattern index of the pattern in the array given to
+ *                StringMatcherNew()
+ * @param offset where the match starts in the text
+ * @return false to stop the scan
+ */
+typedef bool (*StringMatcherFn)(size_t pattern, size_t offset, void *data);
+
+/**
+ * @param patterns #n_patterns NUL-terminated strings, not used after the
+ *                 call. Empty patterns never match. Patterns occurring
+ *                 more than once are reported for each index.
+ * @param ignore_case match ASCII letters regardless of case, like
+ *                    strcasecmp() in the C locale
+ * @return the matcher, or NULL if the patterns are too long for it (logged)
+ */
+StringMatcher *StringMatcherNew(const char *const *patterns, size_t n_patterns,
+                                bool ignore_case);
+
+void StringMatcherDestroy(StringMatcher *matcher);
+
+size_t StringMatcherPatternCount(const StringMatcher *matcher);
+
+/**
+ * @brief Report all the (possibly overlapping) occurrences of the patterns
+ *        in the #length bytes of #text.
+ * @return the number of calls to #fn
+ */
+size_t StringMatcherScan(const StringMatcher *matcher,
+                         const char *text, size_t length,
+                         StringMatcherFn fn, void *data);
+
+/**
+ * @return whether any pattern occurs in #text, stopping at the first one
+ */
+bool StringMatcherMatches(const StringMatcher *matcher, const char *text, size_t length);
+
+/**
+ * @brief Find which patterns occur in #text.
+ * @param matched array of StringMatcherPatternCount() flags, set to whether
+ *                each pattern occurs
+ * @return the number of patterns occurring in #text
+ */
+size_t StringMatcherMatchedPatterns(const StringMatcher *matcher,
+                                    const char *text, size_t length,
+                                    bool *matched);
+
+#endif
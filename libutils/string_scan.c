@@ -0,0 +1,763 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <string_scan.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+# define STRING_SCAN_SSE2 1
+# include <emmintrin.h>
+/* AVX2 functions are compiled with the target attribute and only used if
+ * the CPU supports them. */
+# if defined(__clang__) || (__GNUC__ >= 5)
+#  define STRING_SCAN_AVX2 1
+#  include <immintrin.h>
+# endif
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+# define STRING_SCAN_NEON 1
+# include <arm_neon.h>
+#endif
+
+typedef struct
+{
+    const char *name;
+    bool (*supported)(void);
+    const char *(*find)(const char *haystack, size_t haystack_len,
+                        const char *needle, size_t needle_len);
+    const char *(*find_case)(const char *haystack, size_t haystack_len,
+                             const char *needle, size_t needle_len);
+    size_t (*find_any_char)(const char *data, size_t len,
+                            const char *chars, size_t n_chars);
+    size_t (*count_char)(const char *data, size_t len, char c);
+    size_t (*span_digits)(const char *data, size_t len);
+    size_t (*span_printable)(const char *data, size_t len);
+} StringScanImpl;
+
+/*********************************************************************/
+/* Scalar implementation, also used for the tails of the vector ones   */
+/*********************************************************************/
+
+static inline char AsciiToLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c;
+}
+
+static inline bool AsciiEqualCaseN(const char *a, const char *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (AsciiToLower(a[i]) != AsciiToLower(b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ScalarSupported(void)
+{
+    return true;
+}
+
+/* The setup of memmem() costs more than this on short inputs. */
+#define SCALAR_FIND_SHORT_MAX 256
+
+static const char *ScalarFind(const char *haystack, size_t haystack_len,
+                              const char *needle, size_t needle_len)
+{
+    if (needle_len == 0)
+    {
+        return haystack;
+    }
+    if (needle_len > haystack_len)
+    {
+        return NULL;
+    }
+    if (haystack_len > SCALAR_FIND_SHORT_MAX)
+    {
+        return memmem(haystack, haystack_len, needle, needle_len);
+    }
+
+    const char *const end = haystack + (haystack_len - needle_len) + 1;
+    for (const char *p = haystack; p < end; p++)
+    {
+        p = memchr(p, needle[0], end - p);
+        if (p == NULL)
+        {
+            return NULL;
+        }
+        if (memcmp(p + 1, needle + 1, needle_len - 1) == 0)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const char *ScalarFindCase(const char *haystack, size_t haystack_len,
+                                  const char *needle, size_t needle_len)
+{
+    if (needle_len == 0)
+    {
+        return haystack;
+    }
+    if (needle_len > haystack_len)
+    {
+        return NULL;
+    }
+
+    const char first = AsciiToLower(needle[0]);
+    for (size_t i = 0; i <= haystack_len - needle_len; i++)
+    {
+        if (AsciiToLower(haystack[i]) == first &&
+            AsciiEqualCaseN(haystack + i + 1, needle + 1, needle_len - 1))
+        {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+/* The unused ones of the STRING_SCAN_ANY_CHAR_MAX bytes repeat the first
+ * one, so the vector kernels always compare with all of them. */
+static inline char AnyChar(const char *chars, size_t n_chars, size_t i)
+{
+    return chars[(i < n_chars) ? i : 0];
+}
+
+static size_t ScalarFindAnyChar(const char *data, size_t len,
+                                const char *chars, size_t n_chars)
+{
+    if (n_chars == 1 && len > 0)
+    {
+        const char *const p = memchr(data, chars[0], len);
+        return (p != NULL) ? (size_t) (p - data) : len;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        for (size_t j = 0; j < n_chars; j++)
+        {
+            if (data[i] == chars[j])
+            {
+                return i;
+            }
+        }
+    }
+    return len;
+}
+
+static size_t ScalarCountChar(const char *data, size_t len, char c)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        count += (data[i] == c);
+    }
+    return count;
+}
+
+static size_t ScalarSpanDigits(const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && data[i] >= '0' && data[i] <= '9')
+    {
+        i++;
+    }
+    return i;
+}
+
+static size_t ScalarSpanPrintable(const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && data[i] >= ' ' && data[i] <= '~')
+    {
+        i++;
+    }
+    return i;
+}
+
+/*********************************************************************/
+/* SSE2                                                              */
+/*********************************************************************/
+
+/*
+ * The substring search compares the first and the last character of the
+ * needle with a block of haystack positions at once and only checks the
+ * rest of the needle at positions where both match (see "SIMD-friendly
+ * algorithms for substring searching" by Wojciech Muła).
+ */
+
+#ifdef STRING_SCAN_SSE2
+
+static bool SSE2Supported(void)
+{
+    return true;
+}
+
+static inline __m128i SSE2ToLower(__m128i v)
+{
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                        _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static const char *SSE2FindCase(const char *haystack, size_t haystack_len,
+                                const char *needle, size_t needle_len)
+{
+    if (needle_len == 0 || needle_len > haystack_len)
+    {
+        return ScalarFindCase(haystack, haystack_len, needle, needle_len);
+    }
+
+    const __m128i first = _mm_set1_epi8(AsciiToLower(needle[0]));
+    const __m128i last = _mm_set1_epi8(AsciiToLower(needle[needle_len - 1]));
+    const size_t middle_len = (needle_len > 2) ? (needle_len - 2) : 0;
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16)
+    {
+        const __m128i a = SSE2ToLower(_mm_loadu_si128((const __m128i *) (haystack + i)));
+        const __m128i b = SSE2ToLower(
+            _mm_loadu_si128((const __m128i *) (haystack + i + needle_len - 1)));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                            _mm_cmpeq_epi8(b, last)));
+        while (mask != 0)
+        {
+            const unsigned int bit = __builtin_ctz(mask);
+            if (AsciiEqualCaseN(haystack + i + bit + 1, needle + 1, middle_len))
+            {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return ScalarFindCase(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+static size_t SSE2FindAnyChar(const char *data, size_t len,
+                              const char *chars, size_t n_chars)
+{
+    if (n_chars == 0)
+    {
+        return len;
+    }
+
+    const __m128i c0 = _mm_set1_epi8(AnyChar(chars, n_chars, 0));
+    const __m128i c1 = _mm_set1_epi8(AnyChar(chars, n_chars, 1));
+    const __m128i c2 = _mm_set1_epi8(AnyChar(chars, n_chars, 2));
+    const __m128i c3 = _mm_set1_epi8(AnyChar(chars, n_chars, 3));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        const __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, c0), _mm_cmpeq_epi8(v, c1)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, c2), _mm_cmpeq_epi8(v, c3)));
+        const unsigned int mask = _mm_movemask_epi8(eq);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + ScalarFindAnyChar(data + i, len - i, chars, n_chars);
+}
+
+static size_t SSE2CountChar(const char *data, size_t len, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+    }
+    return count + ScalarCountChar(data + i, len - i, c);
+}
+
+/* Signed comparisons are fine for the ranges below, bytes >= 0x80 are
+ * negative and thus outside of them. */
+static inline size_t SSE2SpanRange(const char *data, size_t len, char low, char high)
+{
+    const __m128i below = _mm_set1_epi8(low - 1);
+    const __m128i above = _mm_set1_epi8(high + 1);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        const unsigned int mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above)));
+        if (mask != 0xFFFF)
+        {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i;
+}
+
+static size_t SSE2SpanDigits(const char *data, size_t len)
+{
+    const size_t i = SSE2SpanRange(data, len, '0', '9');
+    return i + ScalarSpanDigits(data + i, len - i);
+}
+
+static size_t SSE2SpanPrintable(const char *data, size_t len)
+{
+    const size_t i = SSE2SpanRange(data, len, ' ', '~');
+    return i + ScalarSpanPrintable(data + i, len - i);
+}
+
+#endif /* STRING_SCAN_SSE2 */
+
+/*********************************************************************/
+/* AVX2, same as SSE2 with 32-byte blocks                            */
+/*********************************************************************/
+
+#ifdef STRING_SCAN_AVX2
+
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+static bool AVX2Supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+AVX2_FUNC static inline __m256i AVX2ToLower(__m256i v)
+{
+    const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+AVX2_FUNC static const char *AVX2Find(const char *haystack, size_t haystack_len,
+                                      const char *needle, size_t needle_len)
+{
+    if (needle_len < 2 || needle_len > haystack_len)
+    {
+        return (needle_len == 1 && haystack_len > 0) ?
+            memchr(haystack, needle[0], haystack_len) :
+            ScalarFind(haystack, haystack_len, needle, needle_len);
+    }
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 32 <= haystack_len; i += 32)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i *) (haystack + i));
+        const __m256i b = _mm256_loadu_si256((const __m256i *) (haystack + i + needle_len - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                              _mm256_cmpeq_epi8(b, last)));
+        while (mask != 0)
+        {
+            const unsigned int bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needle_len - 2) == 0)
+            {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return ScalarFind(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+AVX2_FUNC static const char *AVX2FindCase(const char *haystack, size_t haystack_len,
+                                          const char *needle, size_t needle_len)
+{
+    if (needle_len == 0 || needle_len > haystack_len)
+    {
+        return ScalarFindCase(haystack, haystack_len, needle, needle_len);
+    }
+
+    const __m256i first = _mm256_set1_epi8(AsciiToLower(needle[0]));
+    const __m256i last = _mm256_set1_epi8(AsciiToLower(needle[needle_len - 1]));
+    const size_t middle_len = (needle_len > 2) ? (needle_len - 2) : 0;
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 32 <= haystack_len; i += 32)
+    {
+        const __m256i a = AVX2ToLower(_mm256_loadu_si256((const __m256i *) (haystack + i)));
+        const __m256i b = AVX2ToLower(
+            _mm256_loadu_si256((const __m256i *) (haystack + i + needle_len - 1)));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                              _mm256_cmpeq_epi8(b, last)));
+        while (mask != 0)
+        {
+            const unsigned int bit = __builtin_ctz(mask);
+            if (AsciiEqualCaseN(haystack + i + bit + 1, needle + 1, middle_len))
+            {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return ScalarFindCase(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+AVX2_FUNC static size_t AVX2FindAnyChar(const char *data, size_t len,
+                                        const char *chars, size_t n_chars)
+{
+    if (n_chars == 0)
+    {
+        return len;
+    }
+
+    const __m256i c0 = _mm256_set1_epi8(AnyChar(chars, n_chars, 0));
+    const __m256i c1 = _mm256_set1_epi8(AnyChar(chars, n_chars, 1));
+    const __m256i c2 = _mm256_set1_epi8(AnyChar(chars, n_chars, 2));
+    const __m256i c3 = _mm256_set1_epi8(AnyChar(chars, n_chars, 3));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (data + i));
+        const __m256i eq = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, c0), _mm256_cmpeq_epi8(v, c1)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, c2), _mm256_cmpeq_epi8(v, c3)));
+        const uint32_t mask = _mm256_movemask_epi8(eq);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + SSE2FindAnyChar(data + i, len - i, chars, n_chars);
+}
+
+AVX2_FUNC static size_t AVX2CountChar(const char *data, size_t len, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (data + i));
+        count += __builtin_popcount((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+    }
+    return count + ScalarCountChar(data + i, len - i, c);
+}
+
+AVX2_FUNC static inline size_t AVX2SpanRange(const char *data, size_t len, char low, char high)
+{
+    const __m256i below = _mm256_set1_epi8(low - 1);
+    const __m256i above = _mm256_set1_epi8(high + 1);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (data + i));
+        const uint32_t mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpgt_epi8(v, below), _mm256_cmpgt_epi8(above, v)));
+        if (mask != UINT32_MAX)
+        {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i;
+}
+
+AVX2_FUNC static size_t AVX2SpanDigits(const char *data, size_t len)
+{
+    const size_t i = AVX2SpanRange(data, len, '0', '9');
+    return i + ScalarSpanDigits(data + i, len - i);
+}
+
+AVX2_FUNC static size_t AVX2SpanPrintable(const char *data, size_t len)
+{
+    const size_t i = AVX2SpanRange(data, len, ' ', '~');
+    return i + ScalarSpanPrintable(data + i, len - i);
+}
+
+#endif /* STRING_SCAN_AVX2 */
+
+/*********************************************************************/
+/* NEON                                                              */
+/*********************************************************************/
+
+#ifdef STRING_SCAN_NEON
+
+static bool NEONSupported(void)
+{
+    return true;
+}
+
+/* There is no movemask on NEON, narrowing gives 4 bits per byte instead. */
+static inline uint64_t NEONMask(uint8x16_t v)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+
+static inline uint8x16_t NEONToLower(uint8x16_t v)
+{
+    const uint8x16_t upper = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8('Z' - 'A'));
+    return vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+
+static const char *NEONFindImpl(const char *haystack, size_t haystack_len,
+                                const char *needle, size_t needle_len,
+                                bool ignore_case)
+{
+    const uint8x16_t first = vdupq_n_u8(
+        ignore_case ? AsciiToLower(needle[0]) : needle[0]);
+    const uint8x16_t last = vdupq_n_u8(
+        ignore_case ? AsciiToLower(needle[needle_len - 1]) : needle[needle_len - 1]);
+    const size_t middle_len = (needle_len > 2) ? (needle_len - 2) : 0;
+
+    size_t i = 0;
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16)
+    {
+        uint8x16_t a = vld1q_u8((const uint8_t *) (haystack + i));
+        uint8x16_t b = vld1q_u8((const uint8_t *) (haystack + i + needle_len - 1));
+        if (ignore_case)
+        {
+            a = NEONToLower(a);
+            b = NEONToLower(b);
+        }
+        uint64_t mask = NEONMask(vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last)));
+        while (mask != 0)
+        {
+            const unsigned int bit = __builtin_ctzll(mask) >> 2;
+            const bool match = ignore_case ?
+                AsciiEqualCaseN(haystack + i + bit + 1, needle + 1, middle_len) :
+                (memcmp(haystack + i + bit + 1, needle + 1, middle_len) == 0);
+            if (match)
+            {
+                return haystack + i + bit;
+            }
+            mask &= ~(UINT64_C(0xF) << (bit * 4));
+        }
+    }
+
+    return ignore_case ?
+        ScalarFindCase(haystack + i, haystack_len - i, needle, needle_len) :
+        ScalarFind(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+static const char *NEONFind(const char *haystack, size_t haystack_len,
+                            const char *needle, size_t needle_len)
+{
+    if (needle_len < 2 || needle_len > haystack_len)
+    {
+        return (needle_len == 1 && haystack_len > 0) ?
+            memchr(haystack, needle[0], haystack_len) :
+            ScalarFind(haystack, haystack_len, needle, needle_len);
+    }
+    return NEONFindImpl(haystack, haystack_len, needle, needle_len, false);
+}
+
+static const char *NEONFindCase(const char *haystack, size_t haystack_len,
+                                const char *needle, size_t needle_len)
+{
+    if (needle_len == 0 || needle_len > haystack_len)
+    {
+        return ScalarFindCase(haystack, haystack_len, needle, needle_len);
+    }
+    return NEONFindImpl(haystack, haystack_len, needle, needle_len, true);
+}
+
+static size_t NEONFindAnyChar(const char *data, size_t len,
+                              const char *chars, size_t n_chars)
+{
+    if (n_chars == 0)
+    {
+        return len;
+    }
+
+    const uint8x16_t c0 = vdupq_n_u8(AnyChar(chars, n_chars, 0));
+    const uint8x16_t c1 = vdupq_n_u8(AnyChar(chars, n_chars, 1));
+    const uint8x16_t c2 = vdupq_n_u8(AnyChar(chars, n_chars, 2));
+    const uint8x16_t c3 = vdupq_n_u8(AnyChar(chars, n_chars, 3));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        const uint8x16_t v = vld1q_u8((const uint8_t *) (data + i));
+        const uint8x16_t eq = vorrq_u8(vorrq_u8(vceqq_u8(v, c0), vceqq_u8(v, c1)),
+                                       vorrq_u8(vceqq_u8(v, c2), vceqq_u8(v, c3)));
+        const uint64_t mask = NEONMask(eq);
+        if (mask != 0)
+        {
+            return i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+    return i + ScalarFindAnyChar(data + i, len - i, chars, n_chars);
+}
+
+static size_t NEONCountChar(const char *data, size_t len, char c)
+{
+    const uint8x16_t needle = vdupq_n_u8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        const uint8x16_t v = vld1q_u8((const uint8_t *) (data + i));
+        count += __builtin_popcountll(NEONMask(vceqq_u8(v, needle))) / 4;
+    }
+    return count + ScalarCountChar(data + i, len - i, c);
+}
+
+static inline size_t NEONSpanRange(const char *data, size_t len, char low, char high)
+{
+    const uint8x16_t lowv = vdupq_n_u8(low);
+    const uint8x16_t width = vdupq_n_u8(high - low);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        const uint8x16_t v = vld1q_u8((const uint8_t *) (data + i));
+        const uint64_t mask = NEONMask(vcleq_u8(vsubq_u8(v, lowv), width));
+        if (mask != UINT64_MAX)
+        {
+            return i + (__builtin_ctzll(~mask) >> 2);
+        }
+    }
+    return i;
+}
+
+static size_t NEONSpanDigits(const char *data, size_t len)
+{
+    const size_t i = NEONSpanRange(data, len, '0', '9');
+    return i + ScalarSpanDigits(data + i, len - i);
+}
+
+static size_t NEONSpanPrintable(const char *data, size_t len)
+{
+    const size_t i = NEONSpanRange(data, len, ' ', '~');
+    return i + ScalarSpanPrintable(data + i, len - i);
+}
+
+#endif /* STRING_SCAN_NEON */
+
+/*********************************************************************/
+/* Runtime selection                                                 */
+/*********************************************************************/
+
+/* In the order of preference */
+static const StringScanImpl STRING_SCAN_IMPLS[] =
+{
+#ifdef STRING_SCAN_AVX2
+    { "avx2", AVX2Supported, AVX2Find, AVX2FindCase, AVX2FindAnyChar,
+      AVX2CountChar, AVX2SpanDigits, AVX2SpanPrintable },
+#endif
+#ifdef STRING_SCAN_SSE2
+    /* libc's memmem() is (at least) as fast as a 16-byte kernel */
+    { "sse2", SSE2Supported, ScalarFind, SSE2FindCase, SSE2FindAnyChar,
+      SSE2CountChar, SSE2SpanDigits, SSE2SpanPrintable },
+#endif
+#ifdef STRING_SCAN_NEON
+    { "neon", NEONSupported, NEONFind, NEONFindCase, NEONFindAnyChar,
+      NEONCountChar, NEONSpanDigits, NEONSpanPrintable },
+#endif
+    { "scalar", ScalarSupported, ScalarFind, ScalarFindCase, ScalarFindAnyChar,
+      ScalarCountChar, ScalarSpanDigits, ScalarSpanPrintable },
+};
+
+static const StringScanImpl *string_scan_impl = NULL; /* GLOBAL_X */
+static pthread_once_t string_scan_init_once = PTHREAD_ONCE_INIT; /* GLOBAL_T */
+
+static void StringScanInit(void)
+{
+    for (size_t i = 0; i < sizeof(STRING_SCAN_IMPLS) / sizeof(STRING_SCAN_IMPLS[0]); i++)
+    {
+        if (STRING_SCAN_IMPLS[i].supported())
+        {
+            string_scan_impl = &(STRING_SCAN_IMPLS[i]);
+            return;
+        }
+    }
+}
+
+static inline const StringScanImpl *StringScanGetImpl(void)
+{
+    pthread_once(&string_scan_init_once, StringScanInit);
+    return string_scan_impl;
+}
+
+const char *StringScanImplementation(void)
+{
+    return StringScanGetImpl()->name;
+}
+
+bool StringScanSetImplementation(const char *name)
+{
+    assert(name != NULL);
+    StringScanGetImpl();
+
+    for (size_t i = 0; i < sizeof(STRING_SCAN_IMPLS) / sizeof(STRING_SCAN_IMPLS[0]); i++)
+    {
+        if (strcmp(STRING_SCAN_IMPLS[i].name, name) == 0 &&
+            STRING_SCAN_IMPLS[i].supported())
+        {
+            string_scan_impl = &(STRING_SCAN_IMPLS[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*********************************************************************/
+
+const char *StringScanFind(const char *haystack, size_t haystack_len,
+                           const char *needle, size_t needle_len)
+{
+    assert(haystack != NULL || haystack_len == 0);
+    assert(needle != NULL || needle_len == 0);
+    return StringScanGetImpl()->find(haystack, haystack_len, needle, needle_len);
+}
+
+const char *StringScanFindCaseInsensitive(const char *haystack, size_t haystack_len,
+                                          const char *needle, size_t needle_len)
+{
+    assert(haystack != NULL || haystack_len == 0);
+    assert(needle != NULL || needle_len == 0);
+    return StringScanGetImpl()->find_case(haystack, haystack_len, needle, needle_len);
+}
+
+size_t StringScanFindAnyChar(const char *data, size_t len,
+                             const char *chars, size_t n_chars)
+{
+    assert(data != NULL || len == 0);
+    assert(chars != NULL || n_chars == 0);
+    assert(n_chars <= STRING_SCAN_ANY_CHAR_MAX);
+    return StringScanGetImpl()->find_any_char(data, len, chars, n_chars);
+}
+
+size_t StringScanCountChar(const char *data, size_t len, char c)
+{
+    assert(data != NULL || len == 0);
+    return StringScanGetImpl()->count_char(data, len, c);
+}
+
+size_t StringScanSpanDigits(const char *data, size_t len)
+{
+    assert(data != NULL || len == 0);
+    return StringScanGetImpl()->span_digits(data, len);
+}
+
+size_t StringScanSpanPrintable(const char *data, size_t len)
+{
+    assert(data != NULL || len == 0);
+    return StringScanGetImpl()->span_printable(data, len);
+}
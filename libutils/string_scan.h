@@ -0,0 +1,88 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_STRING_SCAN_H
+#define CFENGINE_STRING_SCAN_H
+
+#include <stddef.h>                                           /* size_t */
+#include <stdbool.h>
+
+/*
+ * Scanning kernels for strings of known length (not necessarily
+ * NUL-terminated). Depending on the CPU they use SSE2, AVX2 or NEON
+ * instructions, the implementation is selected on first use.
+ */
+
+/**
+ * @brief Find the first occurrence of #needle in #haystack (like memmem()).
+ * @return Pointer to the occurrence or NULL if not found.
+ */
+const char *StringScanFind(const char *haystack, size_t haystack_len,
+                           const char *needle, size_t needle_len);
+
+/**
+ * @brief Same as StringScanFind(), but ignoring (ASCII) case.
+ */
+const char *StringScanFindCaseInsensitive(const char *haystack, size_t haystack_len,
+                                          const char *needle, size_t needle_len);
+
+/* Maximum number of bytes StringScanFindAnyChar() looks for */
+#define STRING_SCAN_ANY_CHAR_MAX 4
+
+/**
+ * @brief Find the first byte of #data which is one of the #n_chars bytes
+ *        in #chars (at most STRING_SCAN_ANY_CHAR_MAX).
+ * @return Offset of the byte or #len if there is none.
+ */
+size_t StringScanFindAnyChar(const char *data, size_t len,
+                             const char *chars, size_t n_chars);
+
+/**
+ * @return Number of occurrences of #c in #data.
+ */
+size_t StringScanCountChar(const char *data, size_t len, char c);
+
+/**
+ * @return Length of the prefix of #data consisting of the characters '0'-'9'.
+ */
+size_t StringScanSpanDigits(const char *data, size_t len);
+
+/**
+ * @return Length of the prefix of #data consisting of printable ASCII
+ *         characters (' ' - '~').
+ */
+size_t StringScanSpanPrintable(const char *data, size_t len);
+
+/**
+ * @return Name of the implementation in use ("scalar", "sse2", "avx2" or
+ *         "neon").
+ */
+const char *StringScanImplementation(void);
+
+/**
+ * @brief Switch to the implementation #name (for tests and benchmarks).
+ * @return false if #name is not supported on this machine.
+ */
+bool StringScanSetImplementation(const char *name);
+
+#endif
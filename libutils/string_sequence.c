@@ -5,6 +5,9 @@
 #include <string.h> // strlen()
 #include <writer.h> // StringWriter()
 #include <file_lib.h> // safe_fopen()
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h> // writev()
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
 // SeqString - Sequence of strings (char *)
@@ -14,31 +17,17 @@ static void SeqStringAddSplit(Seq *seq, const char *str, char delimiter)
 {
     if (str) // TODO: remove this inconsistency, add assert(str)
     {
-        const char *prev = str;
-        const char *cur = str;
+        StringRef rest = StringRefFromCString(str);
+        StringRef field;
 
-        while (*cur != '\0')
+        while (StringRefSplitNext(&rest, delimiter, &field))
         {
-            if (*cur == delimiter)
+            /* no (empty) field after a trailing delimiter */
+            if ((rest.data == NULL) && (field.len == 0))
             {
-                size_t len = cur - prev;
-                if (len > 0)
-                {
-                    SeqAppend(seq, xstrndup(prev, len));
-                }
-                else
-                {
-                    SeqAppend(seq, xstrdup(""));
-                }
-                prev = cur + 1;
+                break;
             }
-
-            cur++;
-        }
-
-        if (cur > prev)
-        {
-            SeqAppend(seq, xstrndup(prev, cur - prev));
+            SeqAppend(seq, xstrndup(field.data, field.len));
         }
     }
 }
@@ -156,14 +145,11 @@ static long GetLengthPrefix(const char *data)
         return -1;
     }
 
-    // NOTE: This uses long because HPUX sscanf doesn't support %zu
-    long length;
-    int ret = sscanf(data, "%ld", &length);
-    if (ret != 1 || length < 0)
+    // The prefix is at most 9 digits, so this can't overflow
+    long length = 0;
+    for (size_t i = 0; i < STR_LENGTH_PREFIX_LEN && isdigit(data[i]); i++)
     {
-        // Incorrect number of items matched, or
-        // negative length prefix(invalid)
-        return -1;
+        length = length * 10 + (data[i] - '0');
     }
 
     return length;
@@ -282,6 +268,74 @@ Seq *SeqStringDeserialize(const char *const serialized)
     return seq;
 }
 
+Seq *SeqStringDeserializeSlices(char *const serialized, const size_t size)
+{
+    assert(serialized != NULL || size == 0);
+
+    Seq *seq = SeqNew(128, NULL);
+    size_t offset = 0;
+    while (offset < size)
+    {
+        if (size - offset < STR_LENGTH_PREFIX_LEN + 1)
+        {
+            SeqDestroy(seq);
+            return NULL;
+        }
+        const long length = GetLengthPrefix(serialized + offset);
+        offset += STR_LENGTH_PREFIX_LEN;
+
+        char *const str = serialized + offset;
+        if (length < 0 || (size_t) length >= size - offset ||
+            str[length] != '\n' || memchr(str, '\0', length) != NULL)
+        {
+            SeqDestroy(seq);
+            return NULL;
+        }
+        str[length] = '\0';
+        SeqAppend(seq, str);
+        offset += length + 1;
+    }
+    return seq;
+}
+
+Seq *SeqStringReadFileSlices(const char *const file, char **const backing)
+{
+    assert(file != NULL);
+    assert(backing != NULL);
+
+    const int fd = safe_open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    const size_t size = sb.st_size;
+    char *const data = xmalloc(size + 1);
+    const ssize_t bytes_read = FullRead(fd, data, size);
+    close(fd);
+    if (bytes_read < 0 || (size_t) bytes_read != size)
+    {
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+
+    Seq *const seq = SeqStringDeserializeSlices(data, size);
+    if (seq == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    *backing = data;
+    return seq;
+}
+
 int ReadLenPrefixedString(int fd, char **string)
 {
     char prefix[STR_LENGTH_PREFIX_LEN];
@@ -323,26 +377,316 @@ Seq *SeqStringReadFile(const char *file)
         return NULL;
     }
 
+    LenPrefixedReader *const reader = LenPrefixedReaderNew(fd);
     Seq *seq = SeqNew(500, &free);
-
     while (true)
     {
-        char *data;
-        int ret = ReadLenPrefixedString(fd, &data);
+        const char *data;
+        size_t length;
+        int ret = LenPrefixedReaderNext(reader, &data, &length);
         if (ret < 0)
         {
             /* error */
             SeqDestroy(seq);
-            return NULL;
+            seq = NULL;
+            break;
         }
         else if (ret == 0)
         {
             /* done (EOF) */
-            return seq;
+            break;
         }
         else
         {
-            SeqAppend(seq, data);
+            SeqAppend(seq, xmemdup(data, length + 1));
         }
     }
+
+    LenPrefixedReaderDestroy(reader);
+    close(fd);
+    return seq;
+}
+
+/* Buffered length-prefixed I/O */
+
+#define LEN_PREFIXED_BUFFER_SIZE (64 * 1024)
+
+/* Lengths that fit in the prefix, with its trailing space */
+#define LEN_PREFIXED_MAX_LENGTH 999999999
+
+struct LenPrefixedReader
+{
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t start;               /* unconsumed data is buffer[start, end) */
+    size_t end;
+};
+
+LenPrefixedReader *LenPrefixedReaderNew(int fd)
+{
+    LenPrefixedReader *reader = xmalloc(sizeof(LenPrefixedReader));
+    reader->fd = fd;
+    reader->capacity = LEN_PREFIXED_BUFFER_SIZE;
+    reader->buffer = xmalloc(reader->capacity);
+    reader->start = 0;
+    reader->end = 0;
+    return reader;
+}
+
+void LenPrefixedReaderDestroy(LenPrefixedReader *reader)
+{
+    if (reader != NULL)
+    {
+        free(reader->buffer);
+        free(reader);
+    }
+}
+
+/**
+ * Make sure there are at least #needed unconsumed bytes in the buffer,
+ * reading as much as fits.
+ *
+ * @return -1 on read error, 0 if the file ends before, 1 otherwise
+ */
+static int LenPrefixedReaderFill(LenPrefixedReader *reader, size_t needed)
+{
+    if (reader->end - reader->start >= needed)
+    {
+        return 1;
+    }
+
+    if (reader->start + needed > reader->capacity)
+    {
+        /* Move the unconsumed data to the front, grow if still too small */
+        memmove(reader->buffer, reader->buffer + reader->start,
+                reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+        if (needed > reader->capacity)
+        {
+            reader->capacity = MAX(needed, 2 * reader->capacity);
+            reader->buffer = xrealloc(reader->buffer, reader->capacity);
+        }
+    }
+
+    while (reader->end - reader->start < needed)
+    {
+        const ssize_t n = read(reader->fd, reader->buffer + reader->end,
+                               reader->capacity - reader->end);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            return 0;
+        }
+        reader->end += n;
+    }
+    return 1;
+}
+
+int LenPrefixedReaderNext(LenPrefixedReader *reader, const char **string, size_t *length)
+{
+    assert(reader != NULL);
+    assert(string != NULL);
+
+    int ret = LenPrefixedReaderFill(reader, STR_LENGTH_PREFIX_LEN);
+    if (ret <= 0)
+    {
+        // EOF is only fine between strings
+        return (ret == 0 && reader->start == reader->end) ? 0 : -1;
+    }
+
+    const long prefix_length = GetLengthPrefix(reader->buffer + reader->start);
+    if (prefix_length < 0)
+    {
+        return -1;
+    }
+
+    // Data followed by a '\n' which we replace with '\0'
+    const size_t size = STR_LENGTH_PREFIX_LEN + prefix_length + 1;
+    if (LenPrefixedReaderFill(reader, size) <= 0)
+    {
+        return -1;
+    }
+
+    char *const data = reader->buffer + reader->start + STR_LENGTH_PREFIX_LEN;
+    if (data[prefix_length] != '\n')
+    {
+        return -1;
+    }
+    data[prefix_length] = '\0';
+    reader->start += size;
+
+    *string = data;
+    if (length != NULL)
+    {
+        *length = prefix_length;
+    }
+    return 1;
+}
+
+struct LenPrefixedWriter
+{
+    int fd;
+    char *buffer;
+    size_t size;
+    bool error;
+};
+
+LenPrefixedWriter *LenPrefixedWriterNew(int fd)
+{
+    LenPrefixedWriter *writer = xmalloc(sizeof(LenPrefixedWriter));
+    writer->fd = fd;
+    writer->buffer = xmalloc(LEN_PREFIXED_BUFFER_SIZE);
+    writer->size = 0;
+    writer->error = false;
+    return writer;
+}
+
+void LenPrefixedWriterDestroy(LenPrefixedWriter *writer)
+{
+    if (writer != NULL)
+    {
+        free(writer->buffer);
+        free(writer);
+    }
+}
+
+static void FormatLengthPrefix(size_t length, char *prefix)
+{
+    // Same as "%-10zu", the number left-aligned and padded with spaces
+    char digits[STR_LENGTH_PREFIX_LEN];
+    size_t n_digits = 0;
+    do
+    {
+        digits[n_digits++] = '0' + length % 10;
+        length /= 10;
+    } while (length > 0);
+
+    for (size_t i = 0; i < n_digits; i++)
+    {
+        prefix[i] = digits[n_digits - 1 - i];
+    }
+    memset(prefix + n_digits, ' ', STR_LENGTH_PREFIX_LEN - n_digits);
+}
+
+#ifdef HAVE_SYS_UIO_H
+static bool FullWritev(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        // Skip what was written, a short write can end anywhere
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+#endif
+
+bool LenPrefixedWriterFlush(LenPrefixedWriter *writer)
+{
+    assert(writer != NULL);
+
+    if (!writer->error && writer->size > 0)
+    {
+        writer->error = (FullWrite(writer->fd, writer->buffer, writer->size) < 0);
+    }
+    writer->size = 0;
+    return !writer->error;
+}
+
+bool LenPrefixedWriterWrite(LenPrefixedWriter *writer, const char *string, size_t length)
+{
+    assert(writer != NULL);
+    assert(string != NULL || length == 0);
+
+    if (writer->error || length > LEN_PREFIXED_MAX_LENGTH)
+    {
+        return false;
+    }
+
+    const size_t size = STR_LENGTH_PREFIX_LEN + length + 1;
+    if (writer->size + size > LEN_PREFIXED_BUFFER_SIZE)
+    {
+#ifdef HAVE_SYS_UIO_H
+        if (size > LEN_PREFIXED_BUFFER_SIZE / 4)
+        {
+            // Big string: write it from where it is, with what's buffered
+            char prefix[STR_LENGTH_PREFIX_LEN];
+            FormatLengthPrefix(length, prefix);
+            struct iovec iov[4] = {
+                { writer->buffer, writer->size },
+                { prefix, STR_LENGTH_PREFIX_LEN },
+                { (char *) string, length },
+                { "\n", 1 },
+            };
+            writer->error = !FullWritev(writer->fd, iov, 4);
+            writer->size = 0;
+            return !writer->error;
+        }
+#endif
+        if (!LenPrefixedWriterFlush(writer))
+        {
+            return false;
+        }
+        if (size > LEN_PREFIXED_BUFFER_SIZE)
+        {
+            char prefix[STR_LENGTH_PREFIX_LEN];
+            FormatLengthPrefix(length, prefix);
+            writer->error = (FullWrite(writer->fd, prefix, STR_LENGTH_PREFIX_LEN) < 0 ||
+                             FullWrite(writer->fd, string, length) < 0 ||
+                             FullWrite(writer->fd, "\n", 1) < 0);
+            return !writer->error;
+        }
+    }
+
+    char *const dst = writer->buffer + writer->size;
+    FormatLengthPrefix(length, dst);
+    memcpy(dst + STR_LENGTH_PREFIX_LEN, string, length);
+    dst[STR_LENGTH_PREFIX_LEN + length] = '\n';
+    writer->size += size;
+    return true;
+}
+
+bool SeqStringWriteFd(Seq *seq, int fd)
+{
+    assert(seq != NULL);
+
+    LenPrefixedWriter *const writer = LenPrefixedWriterNew(fd);
+    const size_t length = SeqLength(seq);
+    bool success = true;
+    for (size_t i = 0; success && i < length; ++i)
+    {
+        const char *const s = SeqAt(seq, i);
+        success = LenPrefixedWriterWrite(writer, s, strlen(s));
+    }
+    success = LenPrefixedWriterFlush(writer) && success;
+    LenPrefixedWriterDestroy(writer);
+    return success;
 }
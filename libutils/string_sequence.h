@@ -110,4 +110,77 @@ Seq *SeqStringReadFile(const char *file);
  */
 Seq *SeqStringDeserialize(const char *const serialized);
 
+/**
+ * @brief Create a sequence of strings pointing into the serialized data
+ *
+ * Like SeqStringDeserialize(), but instead of copying each string, the
+ * newline after it is replaced by a NUL byte and the sequence items point
+ * into #serialized, which must outlive the sequence. The sequence has no
+ * item destroy function.
+ *
+ * @param[in,out] serialized The input data, modified in place
+ * @param[in] size Size of #serialized
+ * @return NULL on any error (#serialized may be partially modified then)
+ */
+Seq *SeqStringDeserializeSlices(char *serialized, size_t size);
+
+/**
+ * @brief Reads a file into one allocation and deserializes it in place
+ *
+ * @param[out] backing Set to the allocation the strings point into, free()
+ *                     it after destroying the sequence
+ * @return NULL on any error, empty sequence for empty file
+ */
+Seq *SeqStringReadFileSlices(const char *file, char **backing);
+
+/**
+ * @brief Buffered reading of length-prefixed strings from a file descriptor
+ *
+ * Unlike ReadLenPrefixedString(), reads ahead in big chunks, so it must be
+ * the only reader of #fd.
+ */
+typedef struct LenPrefixedReader LenPrefixedReader;
+
+LenPrefixedReader *LenPrefixedReaderNew(int fd);
+void LenPrefixedReaderDestroy(LenPrefixedReader *reader);
+
+/**
+ * @brief Read the next length-prefixed string
+ *
+ * @param[out] string NUL-terminated, valid until the next call
+ * @param[out] length Length of #string, may be NULL
+ * @return -1 in case of error, 0 in case of EOF, 1 in case of successful read
+ */
+int LenPrefixedReaderNext(LenPrefixedReader *reader, const char **string, size_t *length);
+
+/**
+ * @brief Buffered writing of length-prefixed strings to a file descriptor
+ *
+ * Strings are collected in a buffer written out when full, big strings
+ * are written straight from the caller's memory together with the
+ * buffer in one writev().
+ */
+typedef struct LenPrefixedWriter LenPrefixedWriter;
+
+LenPrefixedWriter *LenPrefixedWriterNew(int fd);
+
+/**
+ * @brief Does not flush, call LenPrefixedWriterFlush() first
+ */
+void LenPrefixedWriterDestroy(LenPrefixedWriter *writer);
+
+/**
+ * @return false on write errors (also of earlier buffered strings), or if
+ *         #length doesn't fit in the length prefix
+ */
+bool LenPrefixedWriterWrite(LenPrefixedWriter *writer, const char *string, size_t length);
+bool LenPrefixedWriterFlush(LenPrefixedWriter *writer);
+
+/**
+ * @brief Serializes a sequence of strings to a file descriptor
+ *
+ * Same format as SeqStringWrite(), using a LenPrefixedWriter.
+ */
+bool SeqStringWriteFd(Seq *seq, int fd);
+
 #endif // __STRING_SEQUENCE_H__
@@ -0,0 +1,561 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#include <platform.h>
+#include <string_snapshot.h>
+
+#ifndef __MINGW32__
+#include <sys/mman.h>                                       /* mmap */
+#endif
+
+#include <alloc.h>
+#include <logging.h>
+#include <file_lib.h>                           /* safe_open, FullWrite */
+
+#define STRING_SNAPSHOT_MAGIC "CFSSNAP"
+#define STRING_SNAPSHOT_VERSION 1
+
+#define STRING_SNAPSHOT_FLAG_MAP 0x1
+
+/* Value offset of the entries of sets, which have no values */
+#define STRING_SNAPSHOT_NO_VALUE UINT64_MAX
+
+/* On-disk layout, in the byte order of the host. Offsets in the header are
+ * from the start of the file, offsets of strings from the start of the
+ * string pool. All sections are 8 bytes aligned. */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t n_entries;
+    uint64_t n_buckets;         /* power of 2, more than n_entries */
+    uint64_t entries_offset;
+    uint64_t buckets_offset;
+    uint64_t strings_offset;
+    uint64_t file_size;
+} StringSnapshotHeader;
+
+typedef struct
+{
+    uint64_t key;
+    uint64_t value;
+    uint32_t key_len;
+    uint32_t value_len;
+} StringSnapshotEntry;
+
+typedef struct
+{
+    uint32_t hash;              /* upper half of the key's hash */
+    uint32_t entry;             /* index + 1, 0 for an empty bucket */
+} StringSnapshotBucket;
+
+struct StringSnapshot
+{
+    void *data;
+    size_t size;
+    bool mapped;
+    bool is_map;
+    size_t n_entries;
+    size_t bucket_mask;
+    const StringSnapshotEntry *entries;
+    const StringSnapshotBucket *buckets;
+    const char *strings;
+    size_t strings_size;
+};
+
+/* FNV-1a, part of the format so it must not change without the version */
+static uint64_t StringSnapshotHash(const char *key, size_t len)
+{
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) key[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return h;
+}
+
+static inline uint64_t Align8(uint64_t offset)
+{
+    return (offset + 7) & ~UINT64_C(7);
+}
+
+/* Writing */
+
+typedef struct
+{
+    const char *key;
+    const char *value;
+} SnapshotItem;
+
+static int SnapshotItemCompare(const void *a, const void *b)
+{
+    return strcmp(((const SnapshotItem *) a)->key, ((const SnapshotItem *) b)->key);
+}
+
+/**
+ * @brief Build the snapshot of the #n #items in memory.
+ * @return The file contents or NULL if a string is too long for the format.
+ */
+static char *StringSnapshotBuild(SnapshotItem *items, size_t n, bool is_map,
+                                 size_t *size)
+{
+    qsort(items, n, sizeof(SnapshotItem), SnapshotItemCompare);
+
+    size_t n_buckets = 1;
+    while (n_buckets < 2 * n)
+    {
+        n_buckets <<= 1;
+    }
+
+    uint64_t strings_size = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t key_len = strlen(items[i].key);
+        const size_t value_len = (items[i].value != NULL) ? strlen(items[i].value) : 0;
+        if (key_len >= UINT32_MAX || value_len >= UINT32_MAX)
+        {
+            return NULL;
+        }
+        strings_size += key_len + 1;
+        if (items[i].value != NULL)
+        {
+            strings_size += value_len + 1;
+        }
+    }
+
+    StringSnapshotHeader header = { .version = STRING_SNAPSHOT_VERSION };
+    memcpy(header.magic, STRING_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.flags = is_map ? STRING_SNAPSHOT_FLAG_MAP : 0;
+    header.n_entries = n;
+    header.n_buckets = n_buckets;
+    header.entries_offset = sizeof(StringSnapshotHeader);
+    header.buckets_offset = Align8(header.entries_offset + n * sizeof(StringSnapshotEntry));
+    header.strings_offset = Align8(header.buckets_offset + n_buckets * sizeof(StringSnapshotBucket));
+    header.file_size = header.strings_offset + strings_size;
+
+    char *const data = xcalloc(1, header.file_size);
+    memcpy(data, &header, sizeof(header));
+    StringSnapshotEntry *const entries = (StringSnapshotEntry *) (data + header.entries_offset);
+    StringSnapshotBucket *const buckets = (StringSnapshotBucket *) (data + header.buckets_offset);
+    char *const strings = data + header.strings_offset;
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        StringSnapshotEntry *const entry = &entries[i];
+        entry->key = offset;
+        entry->key_len = strlen(items[i].key);
+        memcpy(strings + offset, items[i].key, entry->key_len + 1);
+        offset += entry->key_len + 1;
+
+        if (items[i].value == NULL)
+        {
+            entry->value = STRING_SNAPSHOT_NO_VALUE;
+            entry->value_len = 0;
+        }
+        else
+        {
+            entry->value = offset;
+            entry->value_len = strlen(items[i].value);
+            memcpy(strings + offset, items[i].value, entry->value_len + 1);
+            offset += entry->value_len + 1;
+        }
+
+        const uint64_t hash = StringSnapshotHash(items[i].key, entry->key_len);
+        size_t slot = hash & (n_buckets - 1);
+        while (buckets[slot].entry != 0)
+        {
+            slot = (slot + 1) & (n_buckets - 1);
+        }
+        buckets[slot].hash = hash >> 32;
+        buckets[slot].entry = i + 1;
+    }
+    assert(offset == strings_size);
+
+    *size = header.file_size;
+    return data;
+}
+
+static bool StringSnapshotWrite(SnapshotItem *items, size_t n, bool is_map,
+                                const char *path)
+{
+    if (n >= UINT32_MAX)
+    {
+        Log(LOG_LEVEL_ERR, "Too many entries for string snapshot '%s'", path);
+        return false;
+    }
+
+    size_t size;
+    char *const data = StringSnapshotBuild(items, n, is_map, &size);
+    if (data == NULL)
+    {
+        Log(LOG_LEVEL_ERR, "String too long for string snapshot '%s'", path);
+        return false;
+    }
+
+    char *tmp_path;
+    xasprintf(&tmp_path, "%s.%ju.tmp", path, (uintmax_t) getpid());
+
+    bool success = false;
+    const int fd = safe_open_create_perms(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to create string snapshot '%s' (open: %s)",
+            tmp_path, GetErrorStr());
+    }
+    else
+    {
+        const bool written = (FullWrite(fd, data, size) >= 0);
+        if (close(fd) != 0 || !written)
+        {
+            Log(LOG_LEVEL_ERR, "Failed to write string snapshot '%s' (%s)",
+                tmp_path, GetErrorStr());
+        }
+        else
+        {
+#ifdef __MINGW32__
+            unlink(path);     /* rename() doesn't replace files on Windows */
+#endif
+            success = (rename(tmp_path, path) == 0);
+            if (!success)
+            {
+                Log(LOG_LEVEL_ERR, "Failed to replace string snapshot '%s' (rename: %s)",
+                    path, GetErrorStr());
+            }
+        }
+        if (!success)
+        {
+            unlink(tmp_path);
+        }
+    }
+
+    free(tmp_path);
+    free(data);
+    return success;
+}
+
+bool StringSetWriteSnapshot(StringSet *set, const char *path)
+{
+    assert(set != NULL);
+    assert(path != NULL);
+
+    const size_t n = StringSetSize(set);
+    SnapshotItem *const items = xmalloc(MAX(n, 1) * sizeof(SnapshotItem));
+    size_t i = 0;
+    StringSetIterator iter = StringSetIteratorInit(set);
+    const char *element;
+    while ((element = StringSetIteratorNext(&iter)) != NULL)
+    {
+        assert(i < n);
+        items[i].key = element;
+        items[i].value = NULL;
+        i++;
+    }
+    assert(i == n);
+
+    const bool success = StringSnapshotWrite(items, n, false, path);
+    free(items);
+    return success;
+}
+
+bool StringMapWriteSnapshot(StringMap *map, const char *path)
+{
+    assert(map != NULL);
+    assert(path != NULL);
+
+    const size_t n = StringMapSize(map);
+    SnapshotItem *const items = xmalloc(MAX(n, 1) * sizeof(SnapshotItem));
+    size_t i = 0;
+    StringMapIterator iter = StringMapIteratorInit(map);
+    const MapKeyValue *item;
+    while ((item = StringMapIteratorNext(&iter)) != NULL)
+    {
+        assert(i < n);
+        items[i].key = item->key;
+        items[i].value = item->value;
+        i++;
+    }
+    assert(i == n);
+
+    const bool success = StringSnapshotWrite(items, n, true, path);
+    free(items);
+    return success;
+}
+
+/* Reading */
+
+static bool StringSnapshotHeaderValid(const StringSnapshotHeader *header, size_t file_size)
+{
+    if (memcmp(header->magic, STRING_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != STRING_SNAPSHOT_VERSION ||
+        header->file_size != file_size)
+    {
+        return false;
+    }
+
+    /* The header is untrusted, so the sections are checked to be in order
+     * within the file first, and the counts are bounded by the section sizes
+     * with divisions, nothing is added or multiplied that could wrap. */
+    return (header->entries_offset == sizeof(StringSnapshotHeader) &&
+            header->buckets_offset >= header->entries_offset &&
+            header->buckets_offset % 8 == 0 &&
+            header->strings_offset >= header->buckets_offset &&
+            header->strings_offset <= file_size &&
+            header->n_entries <= (header->buckets_offset - header->entries_offset) /
+                                 sizeof(StringSnapshotEntry) &&
+            header->n_buckets <= (header->strings_offset - header->buckets_offset) /
+                                 sizeof(StringSnapshotBucket) &&
+            header->n_buckets > header->n_entries &&
+            (header->n_buckets & (header->n_buckets - 1)) == 0);
+}
+
+#ifdef __MINGW32__
+/**
+ * @brief Read the whole file where it can't be mapped.
+ */
+static void *StringSnapshotRead(int fd, size_t size)
+{
+    void *const data = xmalloc(size);
+    if (FullRead(fd, data, size) != (ssize_t) size)
+    {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+#endif
+
+StringSnapshot *StringSnapshotOpen(const char *path)
+{
+    assert(path != NULL);
+
+    const int fd = safe_open(path, O_RDONLY | O_BINARY);
+    if (fd < 0)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to open string snapshot '%s' (open: %s)",
+            path, GetErrorStr());
+        return NULL;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to stat string snapshot '%s' (fstat: %s)",
+            path, GetErrorStr());
+        close(fd);
+        return NULL;
+    }
+    if (sb.st_size < (off_t) sizeof(StringSnapshotHeader) || (uintmax_t) sb.st_size > SIZE_MAX)
+    {
+        Log(LOG_LEVEL_ERR, "Invalid string snapshot '%s'", path);
+        close(fd);
+        return NULL;
+    }
+    const size_t size = sb.st_size;
+
+#ifndef __MINGW32__
+    const bool mapped = true;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        data = NULL;
+    }
+#else
+    const bool mapped = false;
+    void *data = StringSnapshotRead(fd, size);
+#endif
+    if (data == NULL)
+    {
+        Log(LOG_LEVEL_ERR, "Failed to read string snapshot '%s' (%s)",
+            path, GetErrorStr());
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    const StringSnapshotHeader *const header = data;
+    if (!StringSnapshotHeaderValid(header, size))
+    {
+        Log(LOG_LEVEL_ERR, "Invalid string snapshot '%s'", path);
+#ifndef __MINGW32__
+        munmap(data, size);
+#else
+        free(data);
+#endif
+        return NULL;
+    }
+
+    StringSnapshot *const snapshot = xmalloc(sizeof(StringSnapshot));
+    snapshot->data = data;
+    snapshot->size = size;
+    snapshot->mapped = mapped;
+    snapshot->is_map = (header->flags & STRING_SNAPSHOT_FLAG_MAP) != 0;
+    snapshot->n_entries = header->n_entries;
+    snapshot->bucket_mask = header->n_buckets - 1;
+    snapshot->entries = (const StringSnapshotEntry *) ((const char *) data + header->entries_offset);
+    snapshot->buckets = (const StringSnapshotBucket *) ((const char *) data + header->buckets_offset);
+    snapshot->strings = (const char *) data + header->strings_offset;
+    snapshot->strings_size = size - header->strings_offset;
+    return snapshot;
+}
+
+void StringSnapshotClose(StringSnapshot *snapshot)
+{
+    if (snapshot != NULL)
+    {
+#ifndef __MINGW32__
+        if (snapshot->mapped)
+        {
+            munmap(snapshot->data, snapshot->size);
+        }
+        else
+#endif
+        {
+            free(snapshot->data);
+        }
+        free(snapshot);
+    }
+}
+
+bool StringSnapshotIsMap(const StringSnapshot *snapshot)
+{
+    assert(snapshot != NULL);
+    return snapshot->is_map;
+}
+
+size_t StringSnapshotSize(const StringSnapshot *snapshot)
+{
+    assert(snapshot != NULL);
+    return snapshot->n_entries;
+}
+
+/**
+ * @return The NUL-terminated string of #len bytes at #offset in the pool, or
+ *         NULL if the file is corrupted. Checked on each access rather than
+ *         when opening, so that opening doesn't depend on the size.
+ */
+static inline const char *StringSnapshotString(const StringSnapshot *snapshot,
+                                               uint64_t offset, uint32_t len)
+{
+    if (offset >= snapshot->strings_size ||
+        len >= snapshot->strings_size - offset ||
+        snapshot->strings[offset + len] != '\0')
+    {
+        return NULL;
+    }
+    return snapshot->strings + offset;
+}
+
+static bool StringSnapshotEntryValue(const StringSnapshot *snapshot,
+                                     const StringSnapshotEntry *entry,
+                                     const char **value)
+{
+    if (entry->value == STRING_SNAPSHOT_NO_VALUE)
+    {
+        *value = NULL;
+        return true;
+    }
+    *value = StringSnapshotString(snapshot, entry->value, entry->value_len);
+    return (*value != NULL);
+}
+
+bool StringSnapshotLookup(const StringSnapshot *snapshot,
+                          const char *key, size_t key_len,
+                          const char **value)
+{
+    assert(snapshot != NULL);
+    assert(key != NULL || key_len == 0);
+
+    const uint64_t hash = StringSnapshotHash(key, key_len);
+    const uint32_t hash_high = hash >> 32;
+    size_t slot = hash & snapshot->bucket_mask;
+
+    /* There is always an empty bucket, unless the file is corrupted */
+    for (size_t probes = 0; probes <= snapshot->bucket_mask; probes++)
+    {
+        const StringSnapshotBucket *const bucket = &snapshot->buckets[slot];
+        if (bucket->entry == 0)
+        {
+            return false;
+        }
+        if (bucket->hash == hash_high && bucket->entry <= snapshot->n_entries)
+        {
+            const StringSnapshotEntry *const entry = &snapshot->entries[bucket->entry - 1];
+            const char *entry_key;
+            if (entry->key_len == key_len &&
+                (entry_key = StringSnapshotString(snapshot, entry->key, entry->key_len)) != NULL &&
+                memcmp(entry_key, key, key_len) == 0)
+            {
+                const char *entry_value;
+                if (!StringSnapshotEntryValue(snapshot, entry, &entry_value))
+                {
+                    return false;
+                }
+                if (value != NULL)
+                {
+                    *value = entry_value;
+                }
+                return true;
+            }
+        }
+        slot = (slot + 1) & snapshot->bucket_mask;
+    }
+    return false;
+}
+
+bool StringSnapshotContains(const StringSnapshot *snapshot, const char *key)
+{
+    assert(key != NULL);
+    return StringSnapshotLookup(snapshot, key, strlen(key), NULL);
+}
+
+const char *StringSnapshotGet(const StringSnapshot *snapshot, const char *key)
+{
+    assert(key != NULL);
+    const char *value = NULL;
+    StringSnapshotLookup(snapshot, key, strlen(key), &value);
+    return value;
+}
+
+bool StringSnapshotAt(const StringSnapshot *snapshot, size_t index,
+                      const char **key, const char **value)
+{
+    assert(snapshot != NULL);
+    assert(index < snapshot->n_entries);
+    assert(key != NULL);
+
+    const StringSnapshotEntry *const entry = &snapshot->entries[index];
+    *key = StringSnapshotString(snapshot, entry->key, entry->key_len);
+    const char *entry_value;
+    if (*key == NULL || !StringSnapshotEntryValue(snapshot, entry, &entry_value))
+    {
+        return false;
+    }
+    if (value != NULL)
+    {
+        *value = entry_value;
+    }
+    return true;
+}
@@ -0,0 +1,104 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_STRING_SNAPSHOT_H
+#define CFENGINE_STRING_SNAPSHOT_H
+
+#include <set.h>                                            /* StringSet */
+#include <map.h>                                            /* StringMap */
+
+/**
+ * Read-only on-disk snapshot of a #StringSet or #StringMap.
+ *
+ * The file holds a precomputed hash table and a pool of NUL-terminated
+ * strings, referenced by offsets from the start of the file. Opening it maps
+ * the file and only checks the header, so it takes the same time whatever the
+ * number of entries, and lookups return pointers into the mapping instead of
+ * copies.
+ *
+ * The format uses the byte order of the host and is not meant to be moved
+ * between architectures. Entries are sorted by key, so the same set or map
+ * always gives the same file.
+ */
+typedef struct StringSnapshot StringSnapshot;
+
+/**
+ * @brief Write the elements of #set as a snapshot to #path.
+ *
+ * The snapshot is written to a temporary file renamed over #path, so
+ * snapshots of #path that are open are not affected.
+ *
+ * @return True if successful, false in case of error (logged).
+ */
+bool StringSetWriteSnapshot(StringSet *set, const char *path);
+
+/**
+ * @brief Same as StringSetWriteSnapshot() for the keys and values of #map.
+ */
+bool StringMapWriteSnapshot(StringMap *map, const char *path);
+
+/**
+ * @brief Open the snapshot file #path.
+ * @return The snapshot or NULL in case of error (logged).
+ */
+StringSnapshot *StringSnapshotOpen(const char *path);
+
+/**
+ * @note Invalidates all the strings returned for #snapshot.
+ */
+void StringSnapshotClose(StringSnapshot *snapshot);
+
+/**
+ * @return Whether #snapshot was written from a #StringMap.
+ */
+bool StringSnapshotIsMap(const StringSnapshot *snapshot);
+
+size_t StringSnapshotSize(const StringSnapshot *snapshot);
+
+bool StringSnapshotContains(const StringSnapshot *snapshot, const char *key);
+
+/**
+ * @brief Look up #key (#key_len bytes, not necessarily NUL-terminated).
+ * @param value Where to store the value (NULL for sets), may be NULL.
+ * @return Whether #key is in the snapshot.
+ */
+bool StringSnapshotLookup(const StringSnapshot *snapshot,
+                          const char *key, size_t key_len,
+                          const char **value);
+
+/**
+ * @return The value of #key or NULL if it is not in the snapshot. Entries of
+ *         sets have no value, use StringSnapshotContains() for them.
+ */
+const char *StringSnapshotGet(const StringSnapshot *snapshot, const char *key);
+
+/**
+ * @brief Iterate over the entries, in the order of their keys.
+ * @param index Less than StringSnapshotSize().
+ * @param key,value Where to store the entry, #value may be NULL.
+ * @return False if the entry is corrupted.
+ */
+bool StringSnapshotAt(const StringSnapshot *snapshot, size_t index,
+                      const char **key, const char **value);
+
+#endif /* CFENGINE_STRING_SNAPSHOT_H */
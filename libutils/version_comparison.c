@@ -1,15 +1,52 @@
+#include <platform.h>   // MIN(), MAX(), memrchr()
 #include <assert.h>     // assert()
-#include <stdio.h>      // sscanf
+#include <ctype.h>      // isspace()
+#include <limits.h>     // INT_MAX
+#include <stdint.h>     // uint64_t
+#include <stdlib.h>     // strtol()
+#include <string.h>     // memcmp()
+#include <alloc.h>      // xmalloc()
 #include <string_lib.h> // StringEqual()
 #include <version_comparison.h>
 
+/**
+ * Same as sscanf(str, "%d.%d.%d", major, minor, patch), without the cost
+ * of interpreting the format on every call.
+ */
+static int ScanVersion(const char *str, int *major, int *minor, int *patch)
+{
+    int *const components[3] = { major, minor, patch };
+    const char *p = str;
+    for (int i = 0; i < 3; i++)
+    {
+        if (i > 0)
+        {
+            if (*p != '.')
+            {
+                return i;
+            }
+            p++;
+        }
+        char *end;
+        const long value = strtol(p, &end, 10);
+        if (end == p)
+        {
+            return i;
+        }
+        *components[i] = (value > INT_MAX) ? INT_MAX :
+            (value < -INT_MAX) ? -INT_MAX : value;
+        p = end;
+    }
+    return 3;
+}
+
 VersionComparison CompareVersion(const char *a, const char *b)
 {
     int a_major = 0;
     int a_minor = 0;
     int a_patch = 0;
 
-    const int a_num = sscanf(a, "%d.%d.%d", &a_major, &a_minor, &a_patch);
+    const int a_num = ScanVersion(a, &a_major, &a_minor, &a_patch);
     if (a_num < 1 || a_num > 3)
     {
         return VERSION_ERROR;
@@ -19,7 +56,7 @@ VersionComparison CompareVersion(const char *a, const char *b)
     int b_minor = 0;
     int b_patch = 0;
 
-    const int b_num = sscanf(b, "%d.%d.%d", &b_major, &b_minor, &b_patch);
+    const int b_num = ScanVersion(b, &b_major, &b_minor, &b_patch);
     if (b_num < 1 || b_num > 3)
     {
         return VERSION_ERROR;
@@ -112,3 +149,701 @@ BooleanOrError CompareVersionExpression(
     }
     return BOOLEAN_ERROR;
 }
+
+/*
+ * Version
+ *
+ * A version is parsed into a list of tokens, split into the main part
+ * (version/upstream) and the second part (pre-release/revision/release).
+ * Comparing is then a walk over two token arrays, with no re-scanning of
+ * the strings.
+ */
+
+/* Ordered as rpmvercmp orders them, the END of a token list included */
+typedef enum
+{
+    VERSION_TOKEN_TILDE,
+    VERSION_TOKEN_END,
+    VERSION_TOKEN_CARET,
+    VERSION_TOKEN_ALPHA,
+    VERSION_TOKEN_NUMBER,
+} VersionTokenKind;
+
+/* Numbers with up to this many significant digits are kept in 'number',
+ * longer ones are compared as digit strings. */
+#define VERSION_NUMBER_MAX_DIGITS 19
+
+typedef struct
+{
+    uint64_t number;
+    uint32_t offset;            /* into Version::string */
+    uint32_t len;               /* for numbers without leading zeros */
+    uint8_t kind;               /* VersionTokenKind */
+} VersionToken;
+
+struct Version
+{
+    VersionScheme scheme;
+    uint64_t epoch;
+    size_t n_main;              /* tokens[0, n_main) */
+    size_t n_tokens;            /* tokens[n_main, n_tokens) */
+    char *string;               /* in the same allocation */
+    VersionToken tokens[];
+};
+
+static const VersionToken VERSION_TOKEN_EMPTY_STRING = { .kind = VERSION_TOKEN_ALPHA };
+static const VersionToken VERSION_TOKEN_ZERO = { .kind = VERSION_TOKEN_NUMBER };
+static const VersionToken VERSION_TOKEN_LIST_END = { .kind = VERSION_TOKEN_END };
+
+static inline bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool IsAlpha(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/* Parse the digits of str[*i, len) (possibly none, meaning 0) */
+static void ParseNumberToken(const char *str, size_t len, size_t *i, VersionToken *token)
+{
+    while (*i < len && str[*i] == '0')
+    {
+        (*i)++;
+    }
+    const size_t start = *i;
+    uint64_t number = 0;
+    while (*i < len && IsDigit(str[*i]))
+    {
+        number = number * 10 + (str[*i] - '0');
+        (*i)++;
+    }
+    token->kind = VERSION_TOKEN_NUMBER;
+    token->offset = start;
+    token->len = *i - start;
+    token->number = (token->len <= VERSION_NUMBER_MAX_DIGITS) ? number : 0;
+}
+
+static bool ParseEpoch(const char *str, size_t *i, size_t len, uint64_t *epoch)
+{
+    const char *const colon = memchr(str, ':', len);
+    *epoch = 0;
+    if (colon == NULL)
+    {
+        return true;
+    }
+    const size_t colon_pos = colon - str;
+    if (colon_pos == 0 || colon_pos > VERSION_NUMBER_MAX_DIGITS)
+    {
+        return false;
+    }
+    for (size_t j = 0; j < colon_pos; j++)
+    {
+        if (!IsDigit(str[j]))
+        {
+            return false;
+        }
+        *epoch = *epoch * 10 + (str[j] - '0');
+    }
+    *i = colon_pos + 1;
+    return true;
+}
+
+/* Debian: alternating (possibly empty) non-digit and digit runs */
+static size_t TokenizeDebian(const char *str, size_t start, size_t end,
+                             VersionToken *tokens)
+{
+    size_t n = 0;
+    size_t i = start;
+    while (i < end)
+    {
+        tokens[n].kind = VERSION_TOKEN_ALPHA;
+        tokens[n].offset = i;
+        while (i < end && !IsDigit(str[i]))
+        {
+            i++;
+        }
+        tokens[n].len = i - tokens[n].offset;
+        tokens[n].number = 0;
+        n++;
+        ParseNumberToken(str, end, &i, &tokens[n++]);
+    }
+    return n;
+}
+
+/* RPM: '~', '^', letter and digit runs, anything else only separates */
+static size_t TokenizeRPM(const char *str, size_t start, size_t end,
+                          VersionToken *tokens)
+{
+    size_t n = 0;
+    size_t i = start;
+    while (i < end)
+    {
+        const char c = str[i];
+        if (IsDigit(c))
+        {
+            ParseNumberToken(str, end, &i, &tokens[n++]);
+        }
+        else if (IsAlpha(c))
+        {
+            tokens[n].kind = VERSION_TOKEN_ALPHA;
+            tokens[n].offset = i;
+            while (i < end && IsAlpha(str[i]))
+            {
+                i++;
+            }
+            tokens[n].len = i - tokens[n].offset;
+            tokens[n].number = 0;
+            n++;
+        }
+        else
+        {
+            if (c == '~' || c == '^')
+            {
+                tokens[n].kind = (c == '~') ? VERSION_TOKEN_TILDE : VERSION_TOKEN_CARET;
+                tokens[n].offset = i;
+                tokens[n].len = 1;
+                tokens[n].number = 0;
+                n++;
+            }
+            i++;
+        }
+    }
+    return n;
+}
+
+static bool ParseDebianOrRPM(const char *str, size_t len, VersionScheme scheme,
+                             uint64_t *epoch, VersionToken *tokens,
+                             size_t *n_main, size_t *n_tokens)
+{
+    size_t start = 0;
+    if (!ParseEpoch(str, &start, len, epoch))
+    {
+        return false;
+    }
+
+    const char *const dash = memrchr(str + start, '-', len - start);
+    const size_t main_end = (dash != NULL) ? (size_t) (dash - str) : len;
+    if (main_end == start || (dash != NULL && main_end + 1 == len))
+    {
+        return false;
+    }
+    for (size_t i = start; i < len; i++)
+    {
+        if (isspace((unsigned char) str[i]) || str[i] == '\0')
+        {
+            return false;
+        }
+    }
+
+    size_t (*const tokenize)(const char *, size_t, size_t, VersionToken *) =
+        (scheme == VERSION_SCHEME_DEBIAN) ? TokenizeDebian : TokenizeRPM;
+    *n_main = tokenize(str, start, main_end, tokens);
+    *n_tokens = *n_main;
+    if (dash != NULL)
+    {
+        *n_tokens += tokenize(str, main_end + 1, len, tokens + *n_main);
+    }
+    return true;
+}
+
+static bool IsSemverIdentifierChar(char c)
+{
+    return IsDigit(c) || IsAlpha(c) || c == '-';
+}
+
+static bool ParseSemver(const char *str, size_t len, VersionToken *tokens,
+                        size_t *n_main, size_t *n_tokens)
+{
+    size_t i = 0;
+    if (i < len && (str[i] == 'v' || str[i] == 'V'))
+    {
+        i++;
+    }
+
+    size_t n = 0;
+    do
+    {
+        if (n > 0)
+        {
+            i++;                /* '.' */
+        }
+        if (i == len || !IsDigit(str[i]))
+        {
+            return false;
+        }
+        ParseNumberToken(str, len, &i, &tokens[n++]);
+    } while (i < len && str[i] == '.');
+    *n_main = n;
+
+    if (i < len && str[i] == '-')
+    {
+        do
+        {
+            i++;                /* '-' or '.' */
+            const size_t start = i;
+            bool all_digits = true;
+            while (i < len && IsSemverIdentifierChar(str[i]))
+            {
+                all_digits = all_digits && IsDigit(str[i]);
+                i++;
+            }
+            if (i == start)
+            {
+                return false;
+            }
+            if (all_digits)
+            {
+                size_t j = start;
+                ParseNumberToken(str, i, &j, &tokens[n]);
+            }
+            else
+            {
+                tokens[n].kind = VERSION_TOKEN_ALPHA;
+                tokens[n].offset = start;
+                tokens[n].len = i - start;
+                tokens[n].number = 0;
+            }
+            n++;
+        } while (i < len && str[i] == '.');
+    }
+    *n_tokens = n;
+
+    if (i < len && str[i] == '+')
+    {
+        /* Build metadata, checked but not part of the ordering */
+        do
+        {
+            i++;                /* '+' or '.' */
+            const size_t start = i;
+            while (i < len && IsSemverIdentifierChar(str[i]))
+            {
+                i++;
+            }
+            if (i == start)
+            {
+                return false;
+            }
+        } while (i < len && str[i] == '.');
+    }
+    return i == len;
+}
+
+Version *VersionParse(const char *str, VersionScheme scheme)
+{
+    assert(str != NULL);
+
+    const size_t len = strlen(str);
+    if (len == 0 || len > UINT32_MAX)
+    {
+        return NULL;
+    }
+
+    /* Every token takes at least one byte, except for the number after
+     * each Debian string run: a tokenized part of n bytes gives at most
+     * n + 2 tokens, and Debian/RPM versions have two parts (upstream and
+     * revision). */
+    VersionToken stack_tokens[32];
+    const size_t max_tokens = len + 4;
+    VersionToken *tokens = (max_tokens <= 32) ? stack_tokens :
+        xmalloc(max_tokens * sizeof(VersionToken));
+
+    uint64_t epoch = 0;
+    size_t n_main = 0, n_tokens = 0;
+    bool ok;
+    switch (scheme)
+    {
+    case VERSION_SCHEME_SEMVER:
+        ok = ParseSemver(str, len, tokens, &n_main, &n_tokens);
+        break;
+    case VERSION_SCHEME_DEBIAN:
+    case VERSION_SCHEME_RPM:
+        ok = ParseDebianOrRPM(str, len, scheme, &epoch, tokens, &n_main, &n_tokens);
+        break;
+    default:
+        ok = false;
+        break;
+    }
+
+    Version *version = NULL;
+    if (ok)
+    {
+        assert(n_tokens <= max_tokens);
+        version = xmalloc(sizeof(Version) + n_tokens * sizeof(VersionToken) + len + 1);
+        version->scheme = scheme;
+        version->epoch = epoch;
+        version->n_main = n_main;
+        version->n_tokens = n_tokens;
+        memcpy(version->tokens, tokens, n_tokens * sizeof(VersionToken));
+        version->string = (char *) (version->tokens + n_tokens);
+        memcpy(version->string, str, len + 1);
+    }
+
+    if (tokens != stack_tokens)
+    {
+        free(tokens);
+    }
+    return version;
+}
+
+void VersionDestroy(Version *version)
+{
+    free(version);
+}
+
+const char *VersionString(const Version *version)
+{
+    assert(version != NULL);
+    return version->string;
+}
+
+VersionScheme VersionGetScheme(const Version *version)
+{
+    assert(version != NULL);
+    return version->scheme;
+}
+
+static inline int CompareNumberTokens(const char *a_str, const VersionToken *a,
+                                      const char *b_str, const VersionToken *b)
+{
+    if (a->len != b->len)
+    {
+        return (a->len < b->len) ? -1 : 1;
+    }
+    if (a->len <= VERSION_NUMBER_MAX_DIGITS)
+    {
+        return (a->number < b->number) ? -1 : (a->number > b->number);
+    }
+    return memcmp(a_str + a->offset, b_str + b->offset, a->len);
+}
+
+static inline int CompareAlphaTokens(const char *a_str, const VersionToken *a,
+                                     const char *b_str, const VersionToken *b)
+{
+    const int r = memcmp(a_str + a->offset, b_str + b->offset, MIN(a->len, b->len));
+    if (r != 0)
+    {
+        return r;
+    }
+    return (a->len < b->len) ? -1 : (a->len > b->len);
+}
+
+/* dpkg's character order: '~' before the end, letters before the rest */
+static inline int DebianCharOrder(const char *str, size_t len, size_t i)
+{
+    if (i >= len)
+    {
+        return 0;
+    }
+    const unsigned char c = str[i];
+    if (IsAlpha(c))
+    {
+        return c;
+    }
+    return (c == '~') ? -1 : c + 256;
+}
+
+static int CompareDebianStringTokens(const char *a_str, const VersionToken *a,
+                                     const char *b_str, const VersionToken *b)
+{
+    const char *const a_run = a_str + a->offset;
+    const char *const b_run = b_str + b->offset;
+    const size_t len = MAX(a->len, b->len);
+    for (size_t i = 0; i < len; i++)
+    {
+        const int a_order = DebianCharOrder(a_run, a->len, i);
+        const int b_order = DebianCharOrder(b_run, b->len, i);
+        if (a_order != b_order)
+        {
+            return a_order - b_order;
+        }
+    }
+    return 0;
+}
+
+static int CompareTokens(VersionScheme scheme,
+                         const char *a_str, const VersionToken *a, size_t a_n,
+                         const char *b_str, const VersionToken *b, size_t b_n)
+{
+    const size_t n = MAX(a_n, b_n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const VersionToken *x, *y;
+        if (i < a_n && i < b_n)
+        {
+            x = &a[i];
+            y = &b[i];
+        }
+        else
+        {
+            /* What the shorter list is padded with */
+            const VersionToken *pad;
+            if (scheme == VERSION_SCHEME_RPM)
+            {
+                pad = &VERSION_TOKEN_LIST_END;
+            }
+            else if (scheme == VERSION_SCHEME_DEBIAN && i % 2 == 0)
+            {
+                pad = &VERSION_TOKEN_EMPTY_STRING;
+            }
+            else
+            {
+                pad = &VERSION_TOKEN_ZERO;
+            }
+            x = (i < a_n) ? &a[i] : pad;
+            y = (i < b_n) ? &b[i] : pad;
+        }
+
+        if (x->kind != y->kind)
+        {
+            return (x->kind < y->kind) ? -1 : 1;
+        }
+        int r = 0;
+        if (x->kind == VERSION_TOKEN_NUMBER)
+        {
+            r = CompareNumberTokens(a_str, x, b_str, y);
+        }
+        else if (x->kind == VERSION_TOKEN_ALPHA)
+        {
+            r = (scheme == VERSION_SCHEME_DEBIAN) ?
+                CompareDebianStringTokens(a_str, x, b_str, y) :
+                CompareAlphaTokens(a_str, x, b_str, y);
+        }
+        if (r != 0)
+        {
+            return r;
+        }
+    }
+    return 0;
+}
+
+static int CompareSemverPrerelease(const Version *a, const Version *b)
+{
+    const size_t a_n = a->n_tokens - a->n_main;
+    const size_t b_n = b->n_tokens - b->n_main;
+
+    /* A release is newer than any of its pre-releases */
+    if (a_n == 0 || b_n == 0)
+    {
+        return (a_n == 0) - (b_n == 0);
+    }
+
+    const VersionToken *const a_tokens = a->tokens + a->n_main;
+    const VersionToken *const b_tokens = b->tokens + b->n_main;
+    for (size_t i = 0; i < MIN(a_n, b_n); i++)
+    {
+        const VersionToken *x = &a_tokens[i], *y = &b_tokens[i];
+        if (x->kind != y->kind)
+        {
+            /* numeric identifiers sort before alphanumeric ones */
+            return (x->kind == VERSION_TOKEN_NUMBER) ? -1 : 1;
+        }
+        const int r = (x->kind == VERSION_TOKEN_NUMBER) ?
+            CompareNumberTokens(a->string, x, b->string, y) :
+            CompareAlphaTokens(a->string, x, b->string, y);
+        if (r != 0)
+        {
+            return r;
+        }
+    }
+    return (a_n < b_n) ? -1 : (a_n > b_n);
+}
+
+int VersionCompare(const Version *a, const Version *b)
+{
+    assert(a != NULL && b != NULL);
+    assert(a->scheme == b->scheme);
+
+    if (a->epoch != b->epoch)
+    {
+        return (a->epoch < b->epoch) ? -1 : 1;
+    }
+
+    const int r = CompareTokens(a->scheme, a->string, a->tokens, a->n_main,
+                                b->string, b->tokens, b->n_main);
+    if (r != 0)
+    {
+        return r;
+    }
+
+    if (a->scheme == VERSION_SCHEME_SEMVER)
+    {
+        return CompareSemverPrerelease(a, b);
+    }
+    return CompareTokens(a->scheme,
+                         a->string, a->tokens + a->n_main, a->n_tokens - a->n_main,
+                         b->string, b->tokens + b->n_main, b->n_tokens - b->n_main);
+}
+
+int VersionCompareSeq(const void *a, const void *b, ARG_UNUSED void *user_data)
+{
+    return VersionCompare(a, b);
+}
+
+/*
+ * VersionConstraint
+ */
+
+/* Which comparison results satisfy a term */
+#define VERSION_MATCH_SMALLER 1
+#define VERSION_MATCH_EQUAL   2
+#define VERSION_MATCH_GREATER 4
+
+typedef struct
+{
+    Version *version;
+    uint8_t match;              /* VERSION_MATCH_* bits */
+    bool ends_group;            /* followed by "||" or the end */
+} VersionConstraintTerm;
+
+struct VersionConstraint
+{
+    size_t n_terms;
+    VersionConstraintTerm terms[];
+};
+
+static const struct
+{
+    const char *operator;
+    uint8_t match;
+} VERSION_OPERATORS[] = {
+    /* two-character operators first, so that ">=" isn't taken for ">" */
+    { "==", VERSION_MATCH_EQUAL },
+    { "!=", VERSION_MATCH_SMALLER | VERSION_MATCH_GREATER },
+    { ">=", VERSION_MATCH_GREATER | VERSION_MATCH_EQUAL },
+    { "<=", VERSION_MATCH_SMALLER | VERSION_MATCH_EQUAL },
+    { "=", VERSION_MATCH_EQUAL },
+    { ">", VERSION_MATCH_GREATER },
+    { "<", VERSION_MATCH_SMALLER },
+};
+
+static bool ParseConstraintTerm(const char *start, const char *end, VersionScheme scheme,
+                                VersionConstraintTerm *term)
+{
+    while (start < end && isspace((unsigned char) *start))
+    {
+        start++;
+    }
+    while (end > start && isspace((unsigned char) end[-1]))
+    {
+        end--;
+    }
+
+    term->match = VERSION_MATCH_EQUAL;
+    for (size_t i = 0; i < sizeof(VERSION_OPERATORS) / sizeof(VERSION_OPERATORS[0]); i++)
+    {
+        const size_t op_len = strlen(VERSION_OPERATORS[i].operator);
+        if ((size_t) (end - start) >= op_len &&
+            memcmp(start, VERSION_OPERATORS[i].operator, op_len) == 0)
+        {
+            term->match = VERSION_OPERATORS[i].match;
+            start += op_len;
+            break;
+        }
+    }
+    while (start < end && isspace((unsigned char) *start))
+    {
+        start++;
+    }
+    if (start == end)
+    {
+        return false;
+    }
+
+    char *const version_str = xstrndup(start, end - start);
+    term->version = VersionParse(version_str, scheme);
+    free(version_str);
+    return term->version != NULL;
+}
+
+VersionConstraint *VersionConstraintParse(const char *expression, VersionScheme scheme)
+{
+    assert(expression != NULL);
+
+    size_t max_terms = 1;
+    for (const char *p = expression; *p != '\0'; p++)
+    {
+        max_terms += (*p == ',' || *p == '|');
+    }
+
+    VersionConstraint *constraint =
+        xmalloc(sizeof(VersionConstraint) + max_terms * sizeof(VersionConstraintTerm));
+    constraint->n_terms = 0;
+
+    const char *p = expression;
+    while (true)
+    {
+        const char *end = p;
+        while (*end != '\0' && *end != ',' && *end != '|')
+        {
+            end++;
+        }
+
+        VersionConstraintTerm *term = &constraint->terms[constraint->n_terms];
+        if (!ParseConstraintTerm(p, end, scheme, term))
+        {
+            VersionConstraintDestroy(constraint);
+            return NULL;
+        }
+        constraint->n_terms++;
+        term->ends_group = (*end != ',');
+
+        if (*end == '\0')
+        {
+            break;
+        }
+        if (*end == '|')
+        {
+            if (end[1] != '|')
+            {
+                VersionConstraintDestroy(constraint);
+                return NULL;
+            }
+            end++;
+        }
+        p = end + 1;
+    }
+
+    return constraint;
+}
+
+void VersionConstraintDestroy(VersionConstraint *constraint)
+{
+    if (constraint != NULL)
+    {
+        for (size_t i = 0; i < constraint->n_terms; i++)
+        {
+            VersionDestroy(constraint->terms[i].version);
+        }
+        free(constraint);
+    }
+}
+
+bool VersionConstraintMatches(const VersionConstraint *constraint, const Version *version)
+{
+    assert(constraint != NULL);
+    assert(version != NULL);
+
+    bool group_holds = true;
+    for (size_t i = 0; i < constraint->n_terms; i++)
+    {
+        const VersionConstraintTerm *term = &constraint->terms[i];
+        if (group_holds)
+        {
+            const int r = VersionCompare(version, term->version);
+            const uint8_t result = (r < 0) ? VERSION_MATCH_SMALLER :
+                (r == 0) ? VERSION_MATCH_EQUAL : VERSION_MATCH_GREATER;
+            group_holds = (term->match & result) != 0;
+        }
+        if (term->ends_group)
+        {
+            if (group_holds)
+            {
+                return true;
+            }
+            group_holds = true;
+        }
+    }
+    return false;
+}
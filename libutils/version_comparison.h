@@ -2,6 +2,7 @@
 #define CF_VERSION_COMPARISON_H
 
 #include <stdbool.h> // bool
+#include <stddef.h>  // size_t
 
 typedef enum VersionComparison
 {
@@ -34,4 +35,65 @@ BooleanOrError CompareVersionExpression(
     const char *operator,
     const char *b);
 
+/**
+  @brief How version strings are split and ordered.
+
+  VERSION_SCHEME_SEMVER: "[v]1.2.3[.4...][-pre.release][+build]", any number
+  of numeric components (missing ones are 0), a pre-release sorts before
+  the release, build metadata is ignored.
+
+  VERSION_SCHEME_DEBIAN: "[epoch:]upstream[-revision]", ordered like dpkg,
+  '~' sorts before anything, even the end of the string.
+
+  VERSION_SCHEME_RPM: "[epoch:]version[-release]", ordered like rpmvercmp,
+  '~' sorts before and '^' right after the end of the string.
+*/
+typedef enum
+{
+    VERSION_SCHEME_SEMVER,
+    VERSION_SCHEME_DEBIAN,
+    VERSION_SCHEME_RPM,
+} VersionScheme;
+
+/**
+  @brief A version string parsed once into its comparable parts, so that
+         sorting and filtering compare pre-split numbers and strings.
+*/
+typedef struct Version Version;
+
+/**
+  @return NULL if #str is not a valid version in #scheme
+*/
+Version *VersionParse(const char *str, VersionScheme scheme);
+void VersionDestroy(Version *version);
+const char *VersionString(const Version *version);
+VersionScheme VersionGetScheme(const Version *version);
+
+/**
+  @brief Compare two versions of the same scheme.
+  @return <0, 0 or >0 as #a is older, equal or newer than #b
+*/
+int VersionCompare(const Version *a, const Version *b);
+
+/**
+  @brief VersionCompare() as a SeqItemComparator, for SeqSort() and friends.
+*/
+int VersionCompareSeq(const void *a, const void *b, void *user_data);
+
+/**
+  @brief A version constraint like ">= 1.2, < 2.0 || = 3.0.1", parsed once.
+
+  Terms are an operator (one of those of CompareVersionExpression(), "="
+  if left out) and a version. Terms separated by ',' must all hold, groups
+  separated by "||" are alternatives.
+*/
+typedef struct VersionConstraint VersionConstraint;
+
+/**
+  @return NULL if #expression is not a valid constraint in #scheme
+*/
+VersionConstraint *VersionConstraintParse(const char *expression, VersionScheme scheme);
+void VersionConstraintDestroy(VersionConstraint *constraint);
+bool VersionConstraintMatches(const VersionConstraint *constraint, const Version *version);
+
 #endif
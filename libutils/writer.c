@@ -26,11 +26,21 @@
 
 #include <misc_lib.h>
 #include <alloc.h>
+#include <file_lib.h>                                         /* FullWrite */
+
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>                                         /* writev */
+#endif
+
+/* Size of the buffer of FdWriter(), data is passed to write() in chunks of
+ * (at least) this size. */
+#define FD_WRITER_BUFFER_SIZE (64 * 1024)
 
 typedef enum
 {
     WT_STRING,
     WT_FILE,
+    WT_FD,
 } WriterType;
 
 typedef struct
@@ -40,6 +50,15 @@ typedef struct
     size_t allocated;           /* Includes trailing zero */
 } StringWriterImpl;
 
+typedef struct
+{
+    int fd;
+    char *buffer;
+    size_t used;
+    size_t size;
+    bool failed;                /* write() failed, the rest is discarded */
+} FdWriterImpl;
+
 struct Writer_
 {
     WriterType type;
@@ -47,7 +66,11 @@ struct Writer_
     {
         StringWriterImpl string;
         FILE *file;
+        FdWriterImpl fd;
     };
+    /* Space handed out by WriterReserve() for FILE writers */
+    char *scratch;
+    size_t scratch_size;
 };
 
 /*********************************************************************/
@@ -63,6 +86,22 @@ Writer *FileWriter(FILE *file)
 
 /*********************************************************************/
 
+Writer *FdWriter(int fd)
+{
+    assert(fd >= 0);
+    Writer *writer = xcalloc(1, sizeof(Writer));
+
+    writer->type = WT_FD;
+    writer->fd.fd = fd;
+    writer->fd.buffer = xmalloc(FD_WRITER_BUFFER_SIZE);
+    writer->fd.size = FD_WRITER_BUFFER_SIZE;
+    writer->fd.used = 0;
+    writer->fd.failed = false;
+    return writer;
+}
+
+/*********************************************************************/
+
 Writer *StringWriter(void)
 {
     Writer *writer = xcalloc(1, sizeof(Writer));
@@ -98,11 +137,9 @@ static size_t StringWriterWriteChar(Writer *writer, char c)
     return 1;
 }
 
-static size_t StringWriterWriteLen(Writer *writer, const char *str, size_t len_)
+static size_t StringWriterWriteBytes(Writer *writer, const char *str, size_t len)
 {
     assert(writer != NULL);
-    /* NB: str[:len_] may come from read(), which hasn't '\0'-terminated */
-    size_t len = strnlen(str, len_);
 
     if (writer->string.len + len + 1 > writer->string.allocated)
     {
@@ -116,6 +153,164 @@ static size_t StringWriterWriteLen(Writer *writer, const char *str, size_t len_)
     return len;
 }
 
+static size_t StringWriterWriteLen(Writer *writer, const char *str, size_t len_)
+{
+    /* NB: str[:len_] may come from read(), which hasn't '\0'-terminated */
+    return StringWriterWriteBytes(writer, str, strnlen(str, len_));
+}
+
+static size_t StringWriterWriteVF(Writer *writer, const char *fmt, va_list ap)
+{
+    assert(writer != NULL);
+
+    /* Try formatting straight into the free space first. */
+    size_t available = writer->string.allocated - writer->string.len;
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int len = vsnprintf(writer->string.data + writer->string.len, available, fmt, ap_copy);
+    va_end(ap_copy);
+
+    if (len < 0)
+    {
+        writer->string.data[writer->string.len] = '\0';
+        return 0;
+    }
+    if ((size_t) len >= available)
+    {
+        StringWriterReallocate(writer, len);
+        vsnprintf(writer->string.data + writer->string.len, len + 1, fmt, ap);
+    }
+
+    /* Like StringWriterWriteLen(), stop at NUL bytes (e.g. from "%c"). */
+    size_t written = strnlen(writer->string.data + writer->string.len, len);
+    writer->string.len += written;
+    return written;
+}
+
+/*********************************************************************/
+
+static bool FdWriterWritev(Writer *writer, const char *data, size_t len)
+{
+    assert(writer != NULL);
+    FdWriterImpl *impl = &(writer->fd);
+
+    if (impl->failed)
+    {
+        impl->used = 0;
+        return false;
+    }
+    if (impl->used == 0 && len == 0)
+    {
+        return true;
+    }
+
+#ifdef HAVE_SYS_UIO_H
+    /* Pass the buffered data and the new data to the kernel together. */
+    struct iovec iov[2] = {
+        { .iov_base = impl->buffer, .iov_len = impl->used },
+        { .iov_base = (char *) data, .iov_len = len },
+    };
+    struct iovec *next = (impl->used > 0) ? iov : iov + 1;
+    int count = (impl->used > 0) ? 2 : 1;
+    while (count > 0)
+    {
+        ssize_t written = writev(impl->fd, next, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            impl->failed = true;
+            break;
+        }
+        while (count > 0 && (size_t) written >= next->iov_len)
+        {
+            written -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0)
+        {
+            next->iov_base = (char *) next->iov_base + written;
+            next->iov_len -= written;
+        }
+    }
+#else
+    if (FullWrite(impl->fd, impl->buffer, impl->used) < 0 ||
+        FullWrite(impl->fd, data, len) < 0)
+    {
+        impl->failed = true;
+    }
+#endif
+
+    impl->used = 0;
+    return !impl->failed;
+}
+
+static size_t FdWriterWriteBytes(Writer *writer, const char *str, size_t len)
+{
+    assert(writer != NULL);
+    FdWriterImpl *impl = &(writer->fd);
+
+    if (len > impl->size - impl->used)
+    {
+        if (len >= impl->size)
+        {
+            /* Too big to be worth copying. */
+            return FdWriterWritev(writer, str, len) ? len : 0;
+        }
+        if (!FdWriterWritev(writer, NULL, 0))
+        {
+            return 0;
+        }
+    }
+
+    memcpy(impl->buffer + impl->used, str, len);
+    impl->used += len;
+    return len;
+}
+
+static size_t FdWriterWriteVF(Writer *writer, const char *fmt, va_list ap)
+{
+    assert(writer != NULL);
+    FdWriterImpl *impl = &(writer->fd);
+
+    /* Try formatting straight into the free space first. */
+    size_t available = impl->size - impl->used;
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int len = vsnprintf(impl->buffer + impl->used, available, fmt, ap_copy);
+    va_end(ap_copy);
+
+    if (len < 0)
+    {
+        return 0;
+    }
+    if ((size_t) len < available)
+    {
+        impl->used += len;
+        return len;
+    }
+    if ((size_t) len < impl->size)
+    {
+        /* Fits into the empty buffer. */
+        if (!FdWriterWritev(writer, NULL, 0))
+        {
+            return 0;
+        }
+        vsnprintf(impl->buffer, impl->size, fmt, ap);
+        impl->used = len;
+        return len;
+    }
+
+    char *str = NULL;
+    xvasprintf(&str, fmt, ap);
+    size_t size = FdWriterWriteBytes(writer, str, len);
+    free(str);
+    return size;
+}
+
 /*********************************************************************/
 
 static size_t FileWriterWriteF(Writer *writer, const char *fmt, va_list ap)
@@ -126,10 +321,9 @@ static size_t FileWriterWriteF(Writer *writer, const char *fmt, va_list ap)
 
 /*********************************************************************/
 
-static size_t FileWriterWriteLen(Writer *writer, const char *str, size_t len_)
+static size_t FileWriterWriteBytes(Writer *writer, const char *str, size_t len)
 {
     assert(writer != NULL);
-    size_t len = strnlen(str, len_);
 
 #ifdef CFENGINE_TEST
     return CFENGINE_TEST_fwrite(str, 1, len, writer->file);
@@ -138,6 +332,11 @@ static size_t FileWriterWriteLen(Writer *writer, const char *str, size_t len_)
 #endif
 }
 
+static size_t FileWriterWriteLen(Writer *writer, const char *str, size_t len_)
+{
+    return FileWriterWriteBytes(writer, str, strnlen(str, len_));
+}
+
 /*********************************************************************/
 
 size_t WriterWriteF(Writer *writer, const char *fmt, ...)
@@ -156,18 +355,13 @@ size_t WriterWriteF(Writer *writer, const char *fmt, ...)
 size_t WriterWriteVF(Writer *writer, const char *fmt, va_list ap)
 {
     assert(writer != NULL);
-    if (writer->type == WT_STRING)
-    {
-        char *str = NULL;
-
-        xvasprintf(&str, fmt, ap);
-        size_t size = StringWriterWriteLen(writer, str, INT_MAX);
-
-        free(str);
-        return size;
-    }
-    else
+    switch (writer->type)
     {
+    case WT_STRING:
+        return StringWriterWriteVF(writer, fmt, ap);
+    case WT_FD:
+        return FdWriterWriteVF(writer, fmt, ap);
+    default:
         return FileWriterWriteF(writer, fmt, ap);
     }
 }
@@ -177,13 +371,31 @@ size_t WriterWriteVF(Writer *writer, const char *fmt, va_list ap)
 size_t WriterWriteLen(Writer *writer, const char *str, size_t len)
 {
     assert(writer != NULL);
-    if (writer->type == WT_STRING)
+    switch (writer->type)
     {
+    case WT_STRING:
         return StringWriterWriteLen(writer, str, len);
+    case WT_FD:
+        return FdWriterWriteBytes(writer, str, strnlen(str, len));
+    default:
+        return FileWriterWriteLen(writer, str, len);
     }
-    else
+}
+
+/*********************************************************************/
+
+size_t WriterWriteBytes(Writer *writer, const void *data, size_t len)
+{
+    assert(writer != NULL);
+    assert(data != NULL || len == 0);
+    switch (writer->type)
     {
-        return FileWriterWriteLen(writer, str, len);
+    case WT_STRING:
+        return StringWriterWriteBytes(writer, data, len);
+    case WT_FD:
+        return FdWriterWriteBytes(writer, data, len);
+    default:
+        return FileWriterWriteBytes(writer, data, len);
     }
 }
 
@@ -199,15 +411,97 @@ size_t WriterWrite(Writer *writer, const char *str)
 size_t WriterWriteChar(Writer *writer, char c)
 {
     assert(writer != NULL);
-    if (writer->type == WT_STRING)
+    switch (writer->type)
     {
+    case WT_STRING:
         return StringWriterWriteChar(writer, c);
-    }
-    else
+    case WT_FD:
+        if (writer->fd.used == writer->fd.size)
+        {
+            if (!FdWriterWritev(writer, NULL, 0))
+            {
+                return 0;
+            }
+        }
+        writer->fd.buffer[writer->fd.used++] = c;
+        return 1;
+    default:
     {
         char s[2] = { c, '\0' };
         return FileWriterWriteLen(writer, s, 1);
     }
+    }
+}
+
+/*********************************************************************/
+
+char *WriterReserve(Writer *writer, size_t len)
+{
+    assert(writer != NULL);
+    switch (writer->type)
+    {
+    case WT_STRING:
+        if (writer->string.len + len + 1 > writer->string.allocated)
+        {
+            StringWriterReallocate(writer, len);
+        }
+        return writer->string.data + writer->string.len;
+    case WT_FD:
+        if (len > writer->fd.size - writer->fd.used)
+        {
+            FdWriterWritev(writer, NULL, 0);
+            if (len > writer->fd.size)
+            {
+                writer->fd.buffer = xrealloc(writer->fd.buffer, len);
+                writer->fd.size = len;
+            }
+        }
+        return writer->fd.buffer + writer->fd.used;
+    default:
+        if (len > writer->scratch_size)
+        {
+            writer->scratch = xrealloc(writer->scratch, len);
+            writer->scratch_size = len;
+        }
+        return writer->scratch;
+    }
+}
+
+void WriterCommit(Writer *writer, size_t len)
+{
+    assert(writer != NULL);
+    switch (writer->type)
+    {
+    case WT_STRING:
+        assert(writer->string.len + len < writer->string.allocated);
+        writer->string.len += len;
+        writer->string.data[writer->string.len] = '\0';
+        break;
+    case WT_FD:
+        assert(writer->fd.used + len <= writer->fd.size);
+        writer->fd.used += len;
+        break;
+    default:
+        assert(len <= writer->scratch_size);
+        FileWriterWriteBytes(writer, writer->scratch, len);
+        break;
+    }
+}
+
+/*********************************************************************/
+
+bool WriterFlush(Writer *writer)
+{
+    assert(writer != NULL);
+    switch (writer->type)
+    {
+    case WT_STRING:
+        return true;
+    case WT_FD:
+        return FdWriterWritev(writer, NULL, 0);
+    default:
+        return (fflush(writer->file) == 0);
+    }
 }
 
 /*********************************************************************/
@@ -245,6 +539,12 @@ void WriterClose(Writer *writer)
     {
         free(writer->string.data);
     }
+    else if (writer->type == WT_FD)
+    {
+        FdWriterWritev(writer, NULL, 0);
+        close(writer->fd.fd);
+        free(writer->fd.buffer);
+    }
     else
     {
 #ifdef CFENGINE_TEST
@@ -253,6 +553,7 @@ void WriterClose(Writer *writer)
         fclose(writer->file);
 #endif
     }
+    free(writer->scratch);
     free(writer);
 }
 
@@ -281,10 +582,25 @@ FILE *FileWriterDetach(Writer *writer)
         ProgrammingError("Wrong writer type");
     }
     FILE *file = writer->file;
+    free(writer->scratch);
     free(writer);
     return file;
 }
 
+int FdWriterDetach(Writer *writer)
+{
+    assert(writer != NULL);
+    if (writer->type != WT_FD)
+    {
+        ProgrammingError("Wrong writer type");
+    }
+    FdWriterWritev(writer, NULL, 0);
+    int fd = writer->fd.fd;
+    free(writer->fd.buffer);
+    free(writer);
+    return fd;
+}
+
 static void WriterWriteOptions(Writer *w, const struct option options[],
                                const char *const hints[])
 {
@@ -0,0 +1,99 @@
+#include <platform.h>
+#include <csv_parser.h>
+#include <json-utils.h>
+#include <file_lib.h>
+#include <alloc.h>
+#include <load.h>
+
+/* GetCsvLineNext() + SeqParseCsvString() compared to CsvReader, and the
+ * resulting JsonParseCsvFile(), sequential and in parallel. */
+
+#define N_ROWS 200000
+
+static void CreateCsvFile(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    assert(fp != NULL);
+    fprintf(fp, "id,host,address,port,comment\r\n");
+    for (int i = 0; i < N_ROWS; i++)
+    {
+        fprintf(fp, "%d,node%d.example.com,10.%d.%d.%d,%d,\"%s\"\r\n",
+                i, i, i / 65536, (i / 256) % 256, i % 256, 1024 + (i % 60000),
+                (i % 10 == 0) ? "a \"\"quoted\"\", comment\r\nover two lines" : "plain comment");
+    }
+    fclose(fp);
+}
+
+int main(void)
+{
+    char path[] = "/tmp/csv_load.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    CreateCsvFile(path);
+
+    struct stat sb;
+    stat(path, &sb);
+
+    size_t n_fields = 0;
+    double start = LoadNow();
+    FILE *fp = fopen(path, "r");
+    char *line;
+    while ((line = GetCsvLineNext(fp)) != NULL)
+    {
+        Seq *fields = SeqParseCsvString(line);
+        if (fields != NULL)
+        {
+            n_fields += SeqLength(fields);
+            SeqDestroy(fields);
+        }
+        free(line);
+    }
+    fclose(fp);
+    LoadReport("GetCsvLineNext+SeqParseCsvString", N_ROWS + 1, sb.st_size,
+               LoadNow() - start);
+
+    size_t n_fields2 = 0;
+    start = LoadNow();
+    fd = open(path, O_RDONLY);
+    CsvReader *reader = CsvReaderNew(fd);
+    CsvRecord record;
+    CsvRecordStatus status;
+    while ((status = CsvReaderNext(reader, &record)) != CSV_RECORD_EOF)
+    {
+        n_fields2 += record.num_fields;
+    }
+    CsvReaderDestroy(reader);
+    close(fd);
+    LoadReport("CsvReaderNext", N_ROWS + 1, sb.st_size, LoadNow() - start);
+
+    if (n_fields != n_fields2)
+    {
+        fprintf(stderr, "Different number of fields: %zu != %zu\n", n_fields, n_fields2);
+        return 1;
+    }
+
+    JsonElement *json = NULL;
+    start = LoadNow();
+    JsonParseCsvFile(path, SIZE_MAX, &json);
+    LoadReport("JsonParseCsvFile", N_ROWS + 1, sb.st_size, LoadNow() - start);
+    JsonDestroy(json);
+
+    /* Only runs in parallel for files over JSON_CSV_PARALLEL_THRESHOLD. */
+    for (size_t n_threads = 2; n_threads <= 8; n_threads *= 2)
+    {
+        char label[64];
+        snprintf(label, sizeof(label), "JsonParseCsvFileParallel (%zu threads)", n_threads);
+        start = LoadNow();
+        JsonParseCsvFileParallel(path, SIZE_MAX, n_threads, &json);
+        LoadReport(label, N_ROWS + 1, sb.st_size, LoadNow() - start);
+        JsonDestroy(json);
+    }
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <platform.h>
+#include <csv_writer.h>
+#include <alloc.h>
+#include <load.h>
+
+/* CsvWriter compared to the previous implementation writing every field (and
+ * every character of the quoted ones) to the Writer directly. */
+
+#define N_ROWS 200000
+#define N_COLUMNS 5
+#define N_DISTINCT_ROWS 1000
+
+static void OldWriteEscaped(Writer *w, const char *s)
+{
+    WriterWriteChar(w, '"');
+    while (*s)
+    {
+        if (*s == '"')
+        {
+            WriterWriteChar(w, '"');
+        }
+        WriterWriteChar(w, *s);
+        s++;
+    }
+    WriterWriteChar(w, '"');
+}
+
+static void OldWriteField(Writer *w, bool *beginning_of_line, const char *str)
+{
+    if (*beginning_of_line)
+    {
+        *beginning_of_line = false;
+    }
+    else
+    {
+        WriterWriteChar(w, ',');
+    }
+
+    if (strpbrk(str, "\",\r\n"))
+    {
+        OldWriteEscaped(w, str);
+    }
+    else
+    {
+        WriterWrite(w, str);
+    }
+}
+
+static void FillRow(char fields[N_COLUMNS][64], int i)
+{
+    snprintf(fields[0], 64, "%d", i);
+    snprintf(fields[1], 64, "node%d.example.com", i);
+    snprintf(fields[2], 64, "10.%d.%d.%d", i / 65536, (i / 256) % 256, i % 256);
+    snprintf(fields[3], 64, "%d", 1024 + (i % 60000));
+    snprintf(fields[4], 64, "%s",
+             (i % 10 == 0) ? "a \"quoted\", comment\r\nover two lines" : "plain comment");
+}
+
+static void WriteOld(Writer *w, const char *field_ptrs[][N_COLUMNS], int n_rows)
+{
+    for (int i = 0; i < n_rows; i++)
+    {
+        bool beginning_of_line = true;
+        for (int j = 0; j < N_COLUMNS; j++)
+        {
+            OldWriteField(w, &beginning_of_line, field_ptrs[i % N_DISTINCT_ROWS][j]);
+        }
+        WriterWrite(w, "\r\n");
+    }
+}
+
+static void WriteNew(Writer *w, const char *field_ptrs[][N_COLUMNS], int n_rows)
+{
+    CsvWriter *csvw = CsvWriterOpen(w);
+    for (int i = 0; i < n_rows; i++)
+    {
+        CsvWriterRecord(csvw, field_ptrs[i % N_DISTINCT_ROWS], N_COLUMNS);
+    }
+    CsvWriterClose(csvw);
+}
+
+int main(void)
+{
+    static char fields[N_DISTINCT_ROWS][N_COLUMNS][64];
+    const char *field_ptrs[N_DISTINCT_ROWS][N_COLUMNS];
+    for (int i = 0; i < N_DISTINCT_ROWS; i++)
+    {
+        FillRow(fields[i], i);
+        for (int j = 0; j < N_COLUMNS; j++)
+        {
+            field_ptrs[i][j] = fields[i][j];
+        }
+    }
+
+    /* Check both produce the same output first. */
+    Writer *old_w = StringWriter();
+    WriteOld(old_w, field_ptrs, N_DISTINCT_ROWS);
+    char *old_output = StringWriterClose(old_w);
+    Writer *new_w = StringWriter();
+    WriteNew(new_w, field_ptrs, N_DISTINCT_ROWS);
+    char *new_output = StringWriterClose(new_w);
+    bool same = (strcmp(old_output, new_output) == 0);
+    size_t bytes = strlen(old_output) * (N_ROWS / N_DISTINCT_ROWS);
+    free(old_output);
+    free(new_output);
+    if (!same)
+    {
+        fprintf(stderr, "Different output\n");
+        return 1;
+    }
+
+    FILE *null_file = fopen("/dev/null", "w");
+    assert(null_file != NULL);
+    Writer *w = FileWriter(null_file);
+
+    double start = LoadNow();
+    WriteOld(w, field_ptrs, N_ROWS);
+    LoadReport("unbuffered CsvWriterField", N_ROWS, bytes, LoadNow() - start);
+
+    start = LoadNow();
+    WriteNew(w, field_ptrs, N_ROWS);
+    LoadReport("buffered CsvWriterRecord", N_ROWS, bytes, LoadNow() - start);
+
+    WriterClose(w);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <platform.h>
+#include <encode.h>
+#include <alloc.h>
+#include <load.h>
+
+#ifdef WITH_OPENSSL
+#include <openssl/bio.h>
+#include <openssl/buffer.h>
+#include <openssl/evp.h>
+#endif
+
+/* Base64 encoding and decoding of small and large payloads, compared to
+ * the OpenSSL BIO chain StringEncodeBase64() used before. */
+
+#define TOTAL_BYTES (256 * 1024 * 1024)
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+#ifdef WITH_OPENSSL
+static size_t BioEncode(const char *data, size_t len)
+{
+    BIO *b64 = BIO_new(BIO_f_base64());
+    BIO *bio = BIO_new(BIO_s_mem());
+    b64 = BIO_push(b64, bio);
+    BIO_write(b64, data, len);
+    BIO_flush(b64);
+    BUF_MEM *buffer = NULL;
+    BIO_get_mem_ptr(b64, &buffer);
+    char *out = xmemdup(buffer->data, buffer->length);
+    const size_t out_len = buffer->length;
+    BIO_free_all(b64);
+    free(out);
+    return out_len;
+}
+#endif
+
+int main(void)
+{
+    static const size_t lengths[] = { 48, 64 * 1024, 16 * 1024 * 1024 };
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        const size_t len = lengths[l];
+        const size_t n_ops = TOTAL_BYTES / len;
+        char *data = xmalloc(len);
+        for (size_t i = 0; i < len; i++)
+        {
+            data[i] = (char) (i * 2654435761u >> 13);
+        }
+        char *encoded = xmalloc(BASE64_ENCODED_SIZE(len) + 1);
+        const size_t encoded_len = Base64Encode(data, len, encoded);
+        char *decoded = xmalloc(BASE64_DECODED_MAX_SIZE(encoded_len));
+        size_t result = 0;
+        char name[64];
+        double start;
+
+#ifdef WITH_OPENSSL
+        start = LoadNow();
+        for (size_t i = 0; i < n_ops; i++)
+        {
+            result += BioEncode(data, len);
+        }
+        snprintf(name, sizeof(name), "encode OpenSSL BIO %zuB", len);
+        LoadReport(name, n_ops, TOTAL_BYTES, LoadNow() - start);
+#endif
+
+        start = LoadNow();
+        for (size_t i = 0; i < n_ops; i++)
+        {
+            char *res = StringEncodeBase64(data, len);
+            result += res[0];
+            free(res);
+        }
+        snprintf(name, sizeof(name), "encode StringEncodeBase64 %zuB", len);
+        LoadReport(name, n_ops, TOTAL_BYTES, LoadNow() - start);
+
+        start = LoadNow();
+        for (size_t i = 0; i < n_ops; i++)
+        {
+            result += Base64Encode(data, len, encoded);
+        }
+        snprintf(name, sizeof(name), "encode Base64Encode %zuB", len);
+        LoadReport(name, n_ops, TOTAL_BYTES, LoadNow() - start);
+
+#ifdef WITH_OPENSSL
+        start = LoadNow();
+        for (size_t i = 0; i < n_ops; i++)
+        {
+            result += EVP_DecodeBlock((unsigned char *) decoded,
+                                      (unsigned char *) encoded, encoded_len);
+        }
+        snprintf(name, sizeof(name), "decode EVP_DecodeBlock %zuB", len);
+        LoadReport(name, n_ops, TOTAL_BYTES, LoadNow() - start);
+#endif
+
+        start = LoadNow();
+        for (size_t i = 0; i < n_ops; i++)
+        {
+            result += Base64Decode(encoded, encoded_len, decoded);
+        }
+        snprintf(name, sizeof(name), "decode Base64Decode %zuB", len);
+        LoadReport(name, n_ops, TOTAL_BYTES, LoadNow() - start);
+
+        sink = result;
+        free(decoded);
+        free(encoded);
+        free(data);
+    }
+
+    return 0;
+}
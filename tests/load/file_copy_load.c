@@ -0,0 +1,134 @@
+#include <platform.h>
+#include <file_lib.h>
+#include <alloc.h>
+#include <logging.h>
+#include <load.h>
+
+/* File_Copy() compared to the plain fread()/fwrite() loop with a 1 KiB buffer
+ * it used to be, over small, large and sparse files. */
+
+#define N_SMALL_FILES 1000
+#define SMALL_SIZE (4 * 1024)
+#define LARGE_SIZE (64 * 1024 * 1024)
+#define SPARSE_SIZE (256 * 1024 * 1024)
+#define SPARSE_DATA (1024 * 1024)
+
+static bool StdioCopy(const char *src, const char *dst)
+{
+    FILE *in = fopen(src, "r");
+    FILE *out = fopen(dst, "w");
+    if ((in == NULL) || (out == NULL))
+    {
+        return false;
+    }
+
+    char buf[1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        fwrite(buf, 1, n, out);
+    }
+    fclose(in);
+    return (fclose(out) == 0);
+}
+
+static void CreateFile(const char *path, size_t size, size_t data_size)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert(fd >= 0);
+
+    char *data = xmalloc(data_size);
+    memset(data, 'x', data_size);
+    NDEBUG_UNUSED ssize_t written = FullWrite(fd, data, data_size);
+    assert(written == (ssize_t) data_size);
+    free(data);
+
+    NDEBUG_UNUSED int ret = ftruncate(fd, size);
+    assert(ret == 0);
+    close(fd);
+}
+
+static void RunCopies(const char *name, const char *dir, size_t n_files,
+                      size_t size, bool (*copy)(const char *, const char *))
+{
+    /* Room for the directory and the longest file name in it */
+    char src[PATH_MAX + 32];
+    char dst[PATH_MAX + 32];
+
+    double start = LoadNow();
+    for (size_t i = 0; i < n_files; i++)
+    {
+        snprintf(src, sizeof(src), "%s/%s.%zu", dir, name, i);
+        snprintf(dst, sizeof(dst), "%s/%s.%zu.copy", dir, name, i);
+        if (!copy(src, dst))
+        {
+            fprintf(stderr, "Failed to copy '%s'\n", src);
+            exit(1);
+        }
+    }
+    double seconds = LoadNow() - start;
+
+    for (size_t i = 0; i < n_files; i++)
+    {
+        snprintf(dst, sizeof(dst), "%s/%s.%zu.copy", dir, name, i);
+        unlink(dst);
+    }
+
+    char label[128];
+    snprintf(label, sizeof(label), "%s (%s)", name,
+             (copy == File_Copy) ? "File_Copy" : "fread/fwrite");
+    LoadReport(label, n_files, n_files * size, seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    char dir[] = "/tmp/file_copy_load.XXXXXX";
+    const char *base = (argc > 1) ? argv[1] : NULL;
+    char dir_buf[PATH_MAX];
+    if (base != NULL)
+    {
+        /* Allow testing on a specific file system. */
+        snprintf(dir_buf, sizeof(dir_buf), "%s/file_copy_load.XXXXXX", base);
+    }
+    else
+    {
+        strlcpy(dir_buf, dir, sizeof(dir_buf));
+    }
+    if (mkdtemp(dir_buf) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    /* Room for the directory and the longest file name in it */
+    char path[PATH_MAX + 32];
+    for (size_t i = 0; i < N_SMALL_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "%s/small.%zu", dir_buf, i);
+        CreateFile(path, SMALL_SIZE, SMALL_SIZE);
+    }
+    snprintf(path, sizeof(path), "%s/large.0", dir_buf);
+    CreateFile(path, LARGE_SIZE, LARGE_SIZE);
+    snprintf(path, sizeof(path), "%s/sparse.0", dir_buf);
+    CreateFile(path, SPARSE_SIZE, SPARSE_DATA);
+
+    for (int i = 0; i < 2; i++)
+    {
+        bool (*copy)(const char *, const char *) = (i == 0) ? StdioCopy : File_Copy;
+        RunCopies("small", dir_buf, N_SMALL_FILES, SMALL_SIZE, copy);
+        RunCopies("large", dir_buf, 1, LARGE_SIZE, copy);
+        RunCopies("sparse", dir_buf, 1, SPARSE_SIZE, copy);
+    }
+
+    snprintf(path, sizeof(path), "%s/sparse.0", dir_buf);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/large.0", dir_buf);
+    unlink(path);
+    for (size_t i = 0; i < N_SMALL_FILES; i++)
+    {
+        snprintf(path, sizeof(path), "%s/small.%zu", dir_buf, i);
+        unlink(path);
+    }
+    rmdir(dir_buf);
+    return 0;
+}
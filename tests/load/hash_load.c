@@ -0,0 +1,157 @@
+#include <platform.h>
+#include <hash.h>
+#ifndef __MINGW32__
+#include <hash_cache.h>
+#endif
+#include <alloc.h>
+#include <load.h>
+
+/* Hashing many files with MD5 and SHA-256: two HashFile() calls per file
+ * (what callers did before) compared to HashFilesBatch() computing both
+ * digests in one pass, with and without worker threads. And hashing many
+ * short strings with a new OpenSSL context each time compared to
+ * HashString() and a HashContext. And the small files again through a
+ * HashCache, cold and warm. */
+
+#define N_SMALL_FILES 2000
+#define SMALL_FILE_SIZE (16 * 1024)
+#define N_BIG_FILES 4
+#define BIG_FILE_SIZE (32 * 1024 * 1024)
+#define N_FILES (N_SMALL_FILES + N_BIG_FILES)
+#define N_STRINGS (1000 * 1000)
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+int main(void)
+{
+    char dir[] = "/tmp/hash_loadXXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    char *data = xmalloc(BIG_FILE_SIZE);
+    for (size_t i = 0; i < BIG_FILE_SIZE; i++)
+    {
+        data[i] = (char) (i * 2654435761u >> 13);
+    }
+
+    char **filenames = xcalloc(N_FILES, sizeof(char *));
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < N_FILES; i++)
+    {
+        xasprintf(&filenames[i], "%s/file%zu", dir, i);
+        const size_t size = (i < N_SMALL_FILES) ? SMALL_FILE_SIZE : BIG_FILE_SIZE;
+        FILE *f = fopen(filenames[i], "wb");
+        fwrite(data, 1, size, f);
+        fclose(f);
+        total_bytes += size;
+    }
+    free(data);
+
+    size_t result = 0;
+    double start = LoadNow();
+    for (size_t i = 0; i < N_FILES; i++)
+    {
+        unsigned char digest[EVP_MAX_MD_SIZE + 1];
+        HashFile(filenames[i], digest, HASH_METHOD_MD5, false);
+        result += digest[0];
+        HashFile(filenames[i], digest, HASH_METHOD_SHA256, false);
+        result += digest[0];
+    }
+    LoadReport("HashFile MD5 + HashFile SHA256", N_FILES, total_bytes, LoadNow() - start);
+
+    const HashMethod methods[] = { HASH_METHOD_MD5, HASH_METHOD_SHA256 };
+    static const size_t threads[] = { 1, 4 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+    {
+        start = LoadNow();
+        HashFileDigestsMap *results = HashFilesBatch((const char *const *) filenames,
+                                                     N_FILES, methods, 2, threads[t]);
+        const double elapsed = LoadNow() - start;
+        result += HashFileDigestsMapSize(results);
+        HashFileDigestsMapDestroy(results);
+
+        char name[64];
+        snprintf(name, sizeof(name), "HashFilesBatch MD5+SHA256 %zu threads", threads[t]);
+        LoadReport(name, N_FILES, total_bytes, elapsed);
+    }
+
+    const char *const key = "host.example.com/some/lmdb/key/to/truncate";
+    const size_t key_len = strlen(key);
+    unsigned char digest[EVP_MAX_MD_SIZE + 1];
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_STRINGS; i++)
+    {
+        const EVP_MD *md = HashDigestFromId(HASH_METHOD_MD5);
+        EVP_MD_CTX *context = EVP_MD_CTX_new();
+        EVP_DigestInit(context, md);
+        EVP_DigestUpdate(context, key, key_len);
+        EVP_DigestFinal(context, digest, NULL);
+        EVP_MD_CTX_free(context);
+        result += digest[0];
+    }
+    LoadReport("MD5 short string, new EVP context", N_STRINGS, N_STRINGS * key_len,
+               LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_STRINGS; i++)
+    {
+        HashString(key, key_len, digest, HASH_METHOD_MD5);
+        result += digest[0];
+    }
+    LoadReport("MD5 short string, HashString", N_STRINGS, N_STRINGS * key_len,
+               LoadNow() - start);
+
+    HashContext *context = HashContextGetCached(HASH_METHOD_MD5);
+    start = LoadNow();
+    for (size_t i = 0; i < N_STRINGS; i++)
+    {
+        HashContextUpdate(context, key, key_len);
+        HashContextFinal(context, digest);
+        result += digest[0];
+    }
+    LoadReport("MD5 short string, HashContext", N_STRINGS, N_STRINGS * key_len,
+               LoadNow() - start);
+
+#ifndef __MINGW32__
+    char *cache_path;
+    xasprintf(&cache_path, "%s/cache", dir);
+    HashCache *cache = HashCacheOpen(cache_path, 0);
+
+    /* The files must be at least a second old to be stored. */
+    sleep(1);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        start = LoadNow();
+        for (size_t i = 0; i < N_SMALL_FILES; i++)
+        {
+            HashCacheFile(cache, filenames[i], HASH_METHOD_SHA256, digest);
+            result += digest[0];
+        }
+        LoadReport(pass == 0 ? "HashCacheFile SHA256 16KiB, cold" :
+                   "HashCacheFile SHA256 16KiB, warm",
+                   N_SMALL_FILES, N_SMALL_FILES * SMALL_FILE_SIZE, LoadNow() - start);
+    }
+
+    HashCacheStats stats;
+    HashCacheGetStats(cache, &stats);
+    printf("hash cache: %zu hits, %zu misses, %zu stores\n",
+           stats.hits, stats.misses, stats.stores);
+    HashCacheClose(cache);
+    unlink(cache_path);
+    free(cache_path);
+#endif
+
+    sink = result;
+    for (size_t i = 0; i < N_FILES; i++)
+    {
+        unlink(filenames[i]);
+        free(filenames[i]);
+    }
+    free(filenames);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <platform.h>
+#include <ip_address.h>
+#include <buffer.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Parsing and formatting addresses through IPAddress objects compared to
+ * the allocation-free IPAddressValue. */
+
+#define N_ADDRESSES 4096
+#define N_ROUNDS 64
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+int main(void)
+{
+    char (*strs)[IP_ADDRESS_VALUE_BUFSIZE] = xmalloc(N_ADDRESSES * IP_ADDRESS_VALUE_BUFSIZE);
+    IPAddressValue *values = xmalloc(N_ADDRESSES * sizeof(IPAddressValue));
+
+    srand(1);
+    for (size_t i = 0; i < N_ADDRESSES; i++)
+    {
+        if (i % 2 == 0)
+        {
+            IPAddressValueFromIPv4(((uint32_t) rand() << 16) ^ rand(), &values[i]);
+        }
+        else
+        {
+            for (int j = 0; j < 16; j++)
+            {
+                values[i].bytes[j] = (j < 4 || j >= 10) ? rand() : 0;
+            }
+        }
+        IPAddressValueFormat(&values[i], strs[i]);
+    }
+
+    const size_t n_ops = N_ADDRESSES * N_ROUNDS;
+    size_t result = 0;
+
+    double start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_ADDRESSES; i++)
+        {
+            Buffer *buffer = BufferNewFrom(strs[i], strlen(strs[i]));
+            IPAddress *address = IPAddressNew(buffer);
+            result += IPAddressType(address);
+            IPAddressDestroy(&address);
+            BufferDestroy(buffer);
+        }
+    }
+    LoadReport("parse IPAddressNew", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_ADDRESSES; i++)
+        {
+            IPAddressValue value;
+            result += IPAddressValueParse(strs[i], strlen(strs[i]), &value, NULL);
+            result += value.bytes[15];
+        }
+    }
+    LoadReport("parse IPAddressValueParse", n_ops, 0, LoadNow() - start);
+
+    IPAddress **addresses = xmalloc(N_ADDRESSES * sizeof(IPAddress *));
+    for (size_t i = 0; i < N_ADDRESSES; i++)
+    {
+        Buffer *buffer = BufferNewFrom(strs[i], strlen(strs[i]));
+        addresses[i] = IPAddressNew(buffer);
+        BufferDestroy(buffer);
+    }
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_ADDRESSES; i++)
+        {
+            Buffer *buffer = IPAddressGetAddress(addresses[i]);
+            result += BufferSize(buffer);
+            BufferDestroy(buffer);
+        }
+    }
+    LoadReport("format IPAddressGetAddress", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_ADDRESSES; i++)
+        {
+            char buf[IP_ADDRESS_VALUE_BUFSIZE];
+            result += IPAddressValueFormat(&values[i], buf);
+        }
+    }
+    LoadReport("format IPAddressValueFormat", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 1; i < N_ADDRESSES; i++)
+        {
+            result += IPAddressCompareLess(addresses[i - 1], addresses[i]);
+        }
+    }
+    LoadReport("compare IPAddressCompareLess", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 1; i < N_ADDRESSES; i++)
+        {
+            result += IPAddressValueCompare(&values[i - 1], &values[i]) < 0;
+        }
+    }
+    LoadReport("compare IPAddressValueCompare", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_ADDRESSES; i++)
+        {
+            result += IPAddressValueHash(&values[i], 0);
+        }
+    }
+    LoadReport("hash IPAddressValueHash", n_ops, 0, LoadNow() - start);
+
+    sink = result;
+    for (size_t i = 0; i < N_ADDRESSES; i++)
+    {
+        IPAddressDestroy(&addresses[i]);
+    }
+    free(addresses);
+    free(values);
+    free(strs);
+    return 0;
+}
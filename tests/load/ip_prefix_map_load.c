@@ -0,0 +1,112 @@
+#include <platform.h>
+#include <ip_prefix_map.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Longest-prefix match over 100k IPv4/IPv6 networks: bulk build, inserts,
+ * lookups, and a linear scan over the prefixes for comparison. */
+
+#define N_PREFIXES 100000
+#define N_LOOKUPS 1000000
+#define N_LINEAR_LOOKUPS 200
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+static void RandomPrefix(IPAddressPrefix *prefix)
+{
+    IPAddressValue address;
+    if (rand() % 4 != 0)
+    {
+        /* IPv4 networks, mostly /16 to /24 like a routing table */
+        IPAddressValueFromIPv4(((uint32_t) rand() << 16) ^ rand(), &address);
+        IPAddressPrefixMake(&address, 96 + 8 + rand() % 25, prefix);
+    }
+    else
+    {
+        /* IPv6 networks within 2000::/3 */
+        for (int i = 0; i < 16; i++)
+        {
+            address.bytes[i] = rand();
+        }
+        address.bytes[0] = 0x20 | (address.bytes[0] & 0x1f);
+        IPAddressPrefixMake(&address, 16 + rand() % 49, prefix);
+    }
+}
+
+int main(void)
+{
+    IPAddressPrefix *prefixes = xmalloc(N_PREFIXES * sizeof(IPAddressPrefix));
+    void **values = xmalloc(N_PREFIXES * sizeof(void *));
+    IPAddressValue *addresses = xmalloc(N_LOOKUPS * sizeof(IPAddressValue));
+
+    srand(1);
+    for (size_t i = 0; i < N_PREFIXES; i++)
+    {
+        RandomPrefix(&prefixes[i]);
+        values[i] = &prefixes[i];
+    }
+    for (size_t i = 0; i < N_LOOKUPS; i++)
+    {
+        /* Half inside one of the networks, half random */
+        const IPAddressPrefix *prefix = &prefixes[rand() % N_PREFIXES];
+        addresses[i] = prefix->address;
+        for (int j = (i % 2) ? 15 : 0; j < 16; j++)
+        {
+            addresses[i].bytes[j] ^= rand();
+        }
+    }
+
+    size_t result = 0;
+
+    double start = LoadNow();
+    IPPrefixMap *map = IPPrefixMapNewFromPrefixes(prefixes, values, N_PREFIXES, NULL);
+    LoadReport("IPPrefixMapNewFromPrefixes 100k", N_PREFIXES, 0, LoadNow() - start);
+    result += IPPrefixMapSize(map);
+
+    start = LoadNow();
+    IPPrefixMap *inserted = IPPrefixMapNew(NULL);
+    for (size_t i = 0; i < N_PREFIXES; i++)
+    {
+        IPPrefixMapInsert(inserted, &prefixes[i], values[i]);
+    }
+    LoadReport("IPPrefixMapInsert 100k", N_PREFIXES, 0, LoadNow() - start);
+    result += IPPrefixMapSize(inserted);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_LOOKUPS; i++)
+    {
+        result += (IPPrefixMapGet(map, &addresses[i]) != NULL);
+    }
+    LoadReport("IPPrefixMapGet, bulk built", N_LOOKUPS, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_LOOKUPS; i++)
+    {
+        result += (IPPrefixMapGet(inserted, &addresses[i]) != NULL);
+    }
+    LoadReport("IPPrefixMapGet, inserted", N_LOOKUPS, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_LINEAR_LOOKUPS; i++)
+    {
+        const IPAddressPrefix *best = NULL;
+        for (size_t j = 0; j < N_PREFIXES; j++)
+        {
+            if (IPAddressPrefixContains(&prefixes[j], &addresses[i]) &&
+                (best == NULL || prefixes[j].length > best->length))
+            {
+                best = &prefixes[j];
+            }
+        }
+        result += (best != NULL);
+    }
+    LoadReport("linear scan", N_LINEAR_LOOKUPS, 0, LoadNow() - start);
+
+    sink = result;
+    IPPrefixMapDestroy(map);
+    IPPrefixMapDestroy(inserted);
+    free(addresses);
+    free(values);
+    free(prefixes);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+  Copyright 2024 Northern.tech AS
+
+  This file is part of CFEngine 3 - written and maintained by Northern.tech AS.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  To the extent this program is licensed as part of the Enterprise
+  versions of CFEngine, the applicable Commercial Open Source License
+  (COSL) may apply to this file if you as a licensee so wish it. See
+  included file COSL.txt.
+*/
+
+#ifndef CFENGINE_LOAD_H
+#define CFENGINE_LOAD_H
+
+#include <platform.h>
+
+/**
+ * Tiny helpers shared by the load tests (micro-benchmarks).
+ */
+
+static inline double LoadNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * Print the time per operation and the throughput of a measured loop.
+ * @param bytes bytes processed in total or 0 if throughput makes no sense
+ */
+static inline void LoadReport(const char *name, size_t n_ops, size_t bytes,
+                              double seconds)
+{
+    printf("%-48s %12.2f ns/op", name, seconds * 1e9 / (double) n_ops);
+    if (bytes > 0)
+    {
+        printf(" %10.1f MiB/s", (double) bytes / seconds / (1024.0 * 1024.0));
+    }
+    printf("\n");
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include <platform.h>
+#include <logging.h>
+#include <logging_recorder.h>
+#include <load.h>
+
+/* Cost of messages that are not logged because of the log level, with and
+ * without the lazy front-ends, and of recording messages with the flight
+ * recorder. */
+
+#define N_ITERATIONS 10000000
+
+static int counter = 0;
+
+static int Expensive(void)
+{
+    /* Pretend to do some work so that the calls are not optimized out. */
+    return counter++;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t n = (argc > 1) ? (size_t) atol(argv[1]) : N_ITERATIONS;
+
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+
+    double start = LoadNow();
+    for (size_t i = 0; i < n; i++)
+    {
+        Log(LOG_LEVEL_DEBUG, "Disabled message %d", Expensive());
+    }
+    LoadReport("Log(DEBUG) disabled", n, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < n; i++)
+    {
+        LogDebug(LOG_MOD_VARS, "Disabled message %d", Expensive());
+    }
+    LoadReport("LogDebug(LOG_MOD_VARS) disabled", n, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < n; i++)
+    {
+        LOG_LAZY(LOG_LEVEL_DEBUG, "Disabled message %d", Expensive());
+    }
+    LoadReport("LOG_LAZY(DEBUG) disabled", n, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < n; i++)
+    {
+        LOG_DEBUG_LAZY(LOG_MOD_VARS, "Disabled message %d", Expensive());
+    }
+    LoadReport("LOG_DEBUG_LAZY(LOG_MOD_VARS) disabled", n, 0, LoadNow() - start);
+
+    LogSetRecorderLevel(LOG_LEVEL_VERBOSE);
+
+    start = LoadNow();
+    for (size_t i = 0; i < n; i++)
+    {
+        Log(LOG_LEVEL_VERBOSE, "Recorded message %d", Expensive());
+    }
+    LoadReport("Log(VERBOSE) recorded, not logged", n, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < n; i++)
+    {
+        LogRecorderAppend(LOG_LEVEL_VERBOSE, LOG_MOD_NONE, "Recorded message");
+    }
+    LoadReport("LogRecorderAppend()", n, 0, LoadNow() - start);
+
+    LogSetRecorderLevel(LOG_LEVEL_NOTHING);
+
+    /* Keep the side effects observable. */
+    printf("(%d argument evaluations)\n", counter);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <platform.h>
+#include <mustache.h>
+#include <json.h>
+#include <alloc.h>
+#include <load.h>
+
+/* MustacheRender() compared to rendering a template compiled once with
+ * MustacheCompile(), on a config-file-like template. */
+
+#define N_RENDERS 2000
+#define N_ITEMS 50
+
+static const char *const TEMPLATE =
+    "# Generated by {{vars.sys.fqhost}}, do not edit\n"
+    "{{#vars.settings}}\n"
+    "{{@}} = {{.}}\n"
+    "{{/vars.settings}}\n"
+    "\n"
+    "{{#hosts}}\n"
+    "  {{#enabled}}\n"
+    "host {{name}} {\n"
+    "    address {{address}}\n"
+    "    port {{port}}\n"
+    "    comment \"{{comment}}\"\n"
+    "  {{^tags}}\n"
+    "    # no tags\n"
+    "  {{/tags}}\n"
+    "}\n"
+    "  {{/enabled}}\n"
+    "{{/hosts}}\n"
+    "{{! the end }}\n";
+
+static JsonElement *CreateData(void)
+{
+    JsonElement *data = JsonObjectCreate(2);
+
+    JsonElement *vars = JsonObjectCreate(2);
+    JsonElement *sys = JsonObjectCreate(1);
+    JsonObjectAppendString(sys, "fqhost", "host.example.com");
+    JsonObjectAppendObject(vars, "sys", sys);
+    JsonElement *settings = JsonObjectCreate(4);
+    JsonObjectAppendString(settings, "timeout", "30");
+    JsonObjectAppendString(settings, "retries", "5");
+    JsonObjectAppendString(settings, "log_level", "info");
+    JsonObjectAppendString(settings, "mode", "<strict>");
+    JsonObjectAppendObject(vars, "settings", settings);
+    JsonObjectAppendObject(data, "vars", vars);
+
+    JsonElement *hosts = JsonArrayCreate(N_ITEMS);
+    for (int i = 0; i < N_ITEMS; i++)
+    {
+        char buf[64];
+        JsonElement *host = JsonObjectCreate(6);
+        snprintf(buf, sizeof(buf), "node%d", i);
+        JsonObjectAppendString(host, "name", buf);
+        snprintf(buf, sizeof(buf), "10.0.%d.%d", i / 256, i % 256);
+        JsonObjectAppendString(host, "address", buf);
+        JsonObjectAppendInteger(host, "port", 8000 + i);
+        JsonObjectAppendString(host, "comment", "Tom & Jerry's \"server\"");
+        JsonObjectAppendBool(host, "enabled", (i % 5) != 0);
+        JsonObjectAppendArray(host, "tags", JsonArrayCreate(0));
+        JsonArrayAppendObject(hosts, host);
+    }
+    JsonObjectAppendArray(data, "hosts", hosts);
+
+    return data;
+}
+
+int main(void)
+{
+    JsonElement *data = CreateData();
+    Buffer *out = BufferNew();
+
+    size_t bytes = 0;
+    double start = LoadNow();
+    for (int i = 0; i < N_RENDERS; i++)
+    {
+        BufferClear(out);
+        if (!MustacheRender(out, TEMPLATE, data))
+        {
+            fprintf(stderr, "Failed to render the template\n");
+            return 1;
+        }
+        bytes += BufferSize(out);
+    }
+    LoadReport("MustacheRender", N_RENDERS, bytes, LoadNow() - start);
+    char *expected = xstrdup(BufferData(out));
+
+    bytes = 0;
+    start = LoadNow();
+    MustacheTemplate *compiled = MustacheCompile(TEMPLATE);
+    for (int i = 0; i < N_RENDERS; i++)
+    {
+        BufferClear(out);
+        if (!MustacheRenderCompiled(out, compiled, data))
+        {
+            fprintf(stderr, "Failed to render the compiled template\n");
+            return 1;
+        }
+        bytes += BufferSize(out);
+    }
+    LoadReport("MustacheRenderCompiled", N_RENDERS, bytes, LoadNow() - start);
+
+    if (strcmp(expected, BufferData(out)) != 0)
+    {
+        fprintf(stderr, "Outputs differ\n");
+        return 1;
+    }
+
+    /* Streaming into a file, as when generating a config file. */
+    FILE *null = fopen("/dev/null", "w");
+    Writer *writer = FileWriter(null);
+    bytes = 0;
+    start = LoadNow();
+    for (int i = 0; i < N_RENDERS; i++)
+    {
+        if (!MustacheRenderCompiledToWriter(writer, compiled, data))
+        {
+            fprintf(stderr, "Failed to render the compiled template\n");
+            return 1;
+        }
+        bytes += strlen(expected);
+    }
+    LoadReport("MustacheRenderCompiledToWriter", N_RENDERS, bytes, LoadNow() - start);
+    WriterClose(writer);
+
+    free(expected);
+    MustacheTemplateDestroy(compiled);
+    BufferDestroy(out);
+    JsonDestroy(data);
+    return 0;
+}
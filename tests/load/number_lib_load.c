@@ -0,0 +1,163 @@
+#include <platform.h>
+#include <number_lib.h>
+#include <json.h>
+#include <string_lib.h>
+#include <alloc.h>
+#include <load.h>
+
+/* number_lib conversions compared to the libc functions they replace, and
+ * parsing/serializing a number-heavy JSON array. */
+
+#define N_VALUES 4096
+#define N_ROUNDS 256
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+int main(void)
+{
+    int64_t *ints = xmalloc(N_VALUES * sizeof(int64_t));
+    double *doubles = xmalloc(N_VALUES * sizeof(double));
+    char (*int_strs)[NUMBER_INT64_BUFSIZE] = xmalloc(N_VALUES * NUMBER_INT64_BUFSIZE);
+    char (*double_strs)[NUMBER_DOUBLE_BUFSIZE] = xmalloc(N_VALUES * NUMBER_DOUBLE_BUFSIZE);
+
+    srand(1);
+    for (size_t i = 0; i < N_VALUES; i++)
+    {
+        ints[i] = (((int64_t) rand() << 31) ^ rand()) >> (rand() % 50);
+        doubles[i] = (double) rand() / (double) (rand() + 1) * ((i % 2) ? 1e3 : 1e-3);
+        NumberFormatInt64(ints[i], int_strs[i]);
+        NumberFormatDouble(doubles[i], double_strs[i]);
+    }
+
+    const size_t n_ops = N_VALUES * N_ROUNDS;
+    char buf[64];
+    size_t result = 0;
+
+    double start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            result += snprintf(buf, sizeof(buf), "%" PRIi64, ints[i]);
+        }
+    }
+    LoadReport("format int64 snprintf", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            result += NumberFormatInt64(ints[i], buf);
+        }
+    }
+    LoadReport("format int64 NumberFormatInt64", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            result += strtoll(int_strs[i], NULL, 10);
+        }
+    }
+    LoadReport("parse int64 strtoll", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            int64_t value;
+            NumberParseInt64(int_strs[i], strlen(int_strs[i]), &value);
+            result += value;
+        }
+    }
+    LoadReport("parse int64 NumberParseInt64", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS / 16; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            result += snprintf(buf, sizeof(buf), "%.17g", doubles[i]);
+        }
+    }
+    LoadReport("format double snprintf %.17g", n_ops / 16, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS / 16; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            result += NumberFormatDouble(doubles[i], buf);
+        }
+    }
+    LoadReport("format double NumberFormatDouble (shortest)", n_ops / 16, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            result += (size_t) strtod(double_strs[i], NULL);
+        }
+    }
+    LoadReport("parse double strtod", n_ops, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS; r++)
+    {
+        for (size_t i = 0; i < N_VALUES; i++)
+        {
+            double value;
+            NumberParseDouble(double_strs[i], strlen(double_strs[i]), &value);
+            result += (size_t) value;
+        }
+    }
+    LoadReport("parse double NumberParseDouble", n_ops, 0, LoadNow() - start);
+
+    /* JSON array of numbers: parse, read the values back and serialize */
+    JsonElement *array = JsonArrayCreate(N_VALUES);
+    for (size_t i = 0; i < N_VALUES; i++)
+    {
+        JsonArrayAppendElement(array, (i % 2) ? JsonIntegerCreate64(ints[i]) :
+                               JsonRealCreate(doubles[i]));
+    }
+    Writer *writer = StringWriter();
+    JsonWriteCompact(writer, array);
+    char *json = StringWriterClose(writer);
+    const size_t json_len = strlen(json);
+    JsonDestroy(array);
+
+    start = LoadNow();
+    for (size_t r = 0; r < N_ROUNDS / 16; r++)
+    {
+        JsonElement *parsed;
+        const char *data = json;
+        JsonParse(&data, &parsed);
+        const size_t length = JsonLength(parsed);
+        for (size_t i = 0; i < length; i++)
+        {
+            const JsonElement *element = JsonArrayGet(parsed, i);
+            result += (JsonGetPrimitiveType(element) == JSON_PRIMITIVE_TYPE_INTEGER) ?
+                (size_t) JsonPrimitiveGetAsInt64DefaultOnError(element, 0) :
+                (size_t) JsonPrimitiveGetAsReal(element);
+        }
+        writer = StringWriter();
+        JsonWriteCompact(writer, parsed);
+        result += StringWriterLength(writer);
+        WriterClose(writer);
+        JsonDestroy(parsed);
+    }
+    LoadReport("JSON numbers parse+get+write", N_ROUNDS / 16, (N_ROUNDS / 16) * json_len,
+               LoadNow() - start);
+
+    sink = result;
+    free(json);
+    free(ints);
+    free(doubles);
+    free(int_strs);
+    free(double_strs);
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <platform.h>
+#include <file_lib.h>
+#include <alloc.h>
+#include <sequence.h>
+#include <load.h>
+
+/* PathWalk() compared to the fd-based PathWalkAt(), single-threaded and with
+ * multiple threads. Walks a generated tree, or the directory given as the
+ * first argument. */
+
+#define N_DIRS 40
+#define N_SUBDIRS 20
+#define N_FILES 10
+
+static void PathWalkCount(const char *dirpath, Seq *dirnames,
+                          const Seq *filenames, void *data)
+{
+    UNUSED(dirpath);
+    size_t *count = data;
+    *count += SeqLength(dirnames) + SeqLength(filenames);
+}
+
+static bool PathWalkAtCount(const char *path, const char *name, int dirfd,
+                            bool is_dir, void *data)
+{
+    UNUSED(path);
+    UNUSED(name);
+    UNUSED(dirfd);
+    UNUSED(is_dir);
+    __atomic_add_fetch((size_t *) data, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void CreateTree(const char *root)
+{
+    char path[PATH_MAX];
+    for (int i = 0; i < N_DIRS; i++)
+    {
+        snprintf(path, sizeof(path), "%s/d%d", root, i);
+        mkdir(path, 0700);
+        for (int j = 0; j < N_SUBDIRS; j++)
+        {
+            snprintf(path, sizeof(path), "%s/d%d/s%d", root, i, j);
+            mkdir(path, 0700);
+            for (int k = 0; k < N_FILES; k++)
+            {
+                snprintf(path, sizeof(path), "%s/d%d/s%d/f%d", root, i, j, k);
+                int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+                assert(fd >= 0);
+                close(fd);
+            }
+        }
+    }
+}
+
+static void RemoveTree(const char *root)
+{
+    char path[PATH_MAX];
+    for (int i = 0; i < N_DIRS; i++)
+    {
+        for (int j = 0; j < N_SUBDIRS; j++)
+        {
+            for (int k = 0; k < N_FILES; k++)
+            {
+                snprintf(path, sizeof(path), "%s/d%d/s%d/f%d", root, i, j, k);
+                unlink(path);
+            }
+            snprintf(path, sizeof(path), "%s/d%d/s%d", root, i, j);
+            rmdir(path);
+        }
+        snprintf(path, sizeof(path), "%s/d%d", root, i);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+int main(int argc, char *argv[])
+{
+    char tmp_dir[] = "/tmp/path_walk_load.XXXXXX";
+    const char *root = (argc > 1) ? argv[1] : NULL;
+    if (root == NULL)
+    {
+        if (mkdtemp(tmp_dir) == NULL)
+        {
+            perror("mkdtemp");
+            return 1;
+        }
+        CreateTree(tmp_dir);
+        root = tmp_dir;
+    }
+
+    size_t count = 0;
+    double start = LoadNow();
+    PathWalk(root, PathWalkCount, &count, NULL, NULL);
+    LoadReport("PathWalk", count, 0, LoadNow() - start);
+
+    const size_t threads[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    {
+        char label[64];
+        snprintf(label, sizeof(label), "PathWalkAt (%zu threads)", threads[i]);
+
+        count = 0;
+        start = LoadNow();
+        PathWalkAt(root, PathWalkAtCount, &count, PATH_WALK_FOLLOW_SYMLINKS,
+                   threads[i]);
+        LoadReport(label, count, 0, LoadNow() - start);
+    }
+
+    if (root == tmp_dir)
+    {
+        RemoveTree(tmp_dir);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <platform.h>
+#include <proc_keyvalue.h>
+#include <string_lib.h>
+#include <load.h>
+
+/* Polling a few fields of /proc/self/status and /proc/meminfo: fopen() and
+ * ParseKeyNumericValue() with a callback picking the fields, compared to a
+ * kept-open fd, ProcFileReadFd() and ParseKeyNumericValueFields(). */
+
+#define N_ROUNDS 20000
+
+typedef struct
+{
+    int64_t rss;
+    int64_t threads;
+    int64_t voluntary_switches;
+} Status;
+
+static const ProcKeyField STATUS_FIELDS[] = {
+    { "VmRSS", offsetof(Status, rss) },
+    { "Threads", offsetof(Status, threads) },
+    { "voluntary_ctxt_switches", offsetof(Status, voluntary_switches) },
+};
+
+static bool StatusCallback(const char *field, off_t value, void *param)
+{
+    Status *status = param;
+    if (StringEqual(field, "VmRSS"))
+    {
+        status->rss = value;
+    }
+    else if (StringEqual(field, "Threads"))
+    {
+        status->threads = value;
+    }
+    else if (StringEqual(field, "voluntary_ctxt_switches"))
+    {
+        status->voluntary_switches = value;
+    }
+    return true;
+}
+
+static bool StatusStringCallback(const char *field, const char *value, void *param)
+{
+    if (StringEqual(field, "VmRSS") || StringEqual(field, "Threads") ||
+        StringEqual(field, "voluntary_ctxt_switches"))
+    {
+        return StatusCallback(field, strtoll(value, NULL, 10), param);
+    }
+    return true;
+}
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+int main(void)
+{
+#ifndef __linux__
+    printf("proc_keyvalue_load needs /proc\n");
+    return 0;
+#else
+    const char *const path = "/proc/self/status";
+    size_t result = 0;
+
+    /* ParseKeyNumericValue() fails on the non-numeric lines of status, so
+     * time ParseKeyValue() plus converting the wanted fields. */
+    double start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        FILE *file = fopen(path, "r");
+        Status status = { 0 };
+        ParseKeyValue(file, StatusStringCallback, &status);
+        fclose(file);
+        result += status.rss;
+    }
+    LoadReport("status fopen+ParseKeyValue", N_ROUNDS, 0, LoadNow() - start);
+
+    ProcKeyTable *table = ProcKeyTableNew(STATUS_FIELDS, 3);
+    ProcFileBuffer buffer = PROC_FILE_BUFFER_INIT;
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        Status status = { 0 };
+        ProcFileRead(path, &buffer);
+        ParseKeyNumericValueFields(buffer.data, buffer.size, table, &status);
+        result += status.rss;
+    }
+    LoadReport("status ProcFileRead+Fields", N_ROUNDS, 0, LoadNow() - start);
+
+    const int fd = open(path, O_RDONLY);
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        Status status = { 0 };
+        ProcFileReadFd(fd, &buffer);
+        ParseKeyNumericValueFields(buffer.data, buffer.size, table, &status);
+        result += status.rss;
+    }
+    LoadReport("status open fd ProcFileReadFd+Fields", N_ROUNDS, 0, LoadNow() - start);
+    close(fd);
+
+    /* Parsing alone, on the same data */
+    FILE *file = fmemopen(buffer.data, buffer.size, "r");
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        Status status = { 0 };
+        rewind(file);
+        ParseKeyValue(file, StatusStringCallback, &status);
+        result += status.threads;
+    }
+    LoadReport("status parse ParseKeyValue", N_ROUNDS, buffer.size * N_ROUNDS,
+               LoadNow() - start);
+    fclose(file);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        Status status = { 0 };
+        ParseKeyNumericValueFields(buffer.data, buffer.size, table, &status);
+        result += status.threads;
+    }
+    LoadReport("status parse Fields", N_ROUNDS, buffer.size * N_ROUNDS, LoadNow() - start);
+
+    /* meminfo is all numeric, so the old callback API works on it */
+    const char *const meminfo = "/proc/meminfo";
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        FILE *mem_file = fopen(meminfo, "r");
+        Status status = { 0 };
+        if (mem_file != NULL)
+        {
+            ParseKeyNumericValue(mem_file, StatusCallback, &status);
+            fclose(mem_file);
+        }
+        result += status.rss;
+    }
+    LoadReport("meminfo fopen+ParseKeyNumericValue", N_ROUNDS, 0, LoadNow() - start);
+
+    static const ProcKeyField MEMINFO_FIELDS[] = {
+        { "MemTotal", 0 }, { "MemAvailable", sizeof(int64_t) },
+    };
+    ProcKeyTable *mem_table = ProcKeyTableNew(MEMINFO_FIELDS, 2);
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        int64_t values[2] = { 0, 0 };
+        ProcFileRead(meminfo, &buffer);
+        ParseKeyNumericValueFields(buffer.data, buffer.size, mem_table, values);
+        result += values[0];
+    }
+    LoadReport("meminfo ProcFileRead+Fields", N_ROUNDS, 0, LoadNow() - start);
+
+    sink = result;
+    ProcKeyTableDestroy(mem_table);
+    ProcKeyTableDestroy(table);
+    ProcFileBufferDestroy(&buffer);
+    return 0;
+#endif
+}
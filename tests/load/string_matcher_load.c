@@ -0,0 +1,104 @@
+#include <platform.h>
+#include <string_matcher.h>
+#include <string_lib.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Filtering log lines against many literals: StringContains() (or
+ * strcasestr()) once per pattern, compared to one StringMatcher scan. */
+
+#define N_PATTERNS 2000
+#define N_LINES 2000
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+static bool CountMatch(ARG_UNUSED size_t pattern, ARG_UNUSED size_t offset, void *data)
+{
+    (*(size_t *) data)++;
+    return true;
+}
+
+int main(void)
+{
+    char **patterns = xmalloc(N_PATTERNS * sizeof(char *));
+    for (size_t i = 0; i < N_PATTERNS; i++)
+    {
+        patterns[i] = StringFormat("host%zu.example.com", i * 7919 % 100000);
+    }
+    char **lines = xmalloc(N_LINES * sizeof(char *));
+    size_t bytes = 0;
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        lines[i] = StringFormat("2024-05-01T12:00:%02zu cf-serverd[%zu]: connection from "
+                                "host%zu.example.com (10.0.%zu.%zu) accepted",
+                                i % 60, 1000 + i, i * 31, i % 256, i * 7 % 256);
+        bytes += strlen(lines[i]);
+    }
+
+    size_t result = 0;
+    double start = LoadNow();
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        for (size_t j = 0; j < N_PATTERNS; j++)
+        {
+            if (StringContains(lines[i], patterns[j]))
+            {
+                result++;
+                break;
+            }
+        }
+    }
+    LoadReport("any StringContains per pattern", N_LINES, bytes, LoadNow() - start);
+
+    StringMatcher *matcher = StringMatcherNew((const char *const *) patterns, N_PATTERNS, false);
+    start = LoadNow();
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        result += StringMatcherMatches(matcher, lines[i], strlen(lines[i]));
+    }
+    LoadReport("any StringMatcherMatches", N_LINES, bytes, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        StringMatcherScan(matcher, lines[i], strlen(lines[i]), CountMatch, &result);
+    }
+    LoadReport("all StringMatcherScan", N_LINES, bytes, LoadNow() - start);
+    StringMatcherDestroy(matcher);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        for (size_t j = 0; j < N_PATTERNS; j++)
+        {
+            if (strcasestr(lines[i], patterns[j]) != NULL)
+            {
+                result++;
+                break;
+            }
+        }
+    }
+    LoadReport("any strcasestr per pattern", N_LINES, bytes, LoadNow() - start);
+
+    matcher = StringMatcherNew((const char *const *) patterns, N_PATTERNS, true);
+    start = LoadNow();
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        result += StringMatcherMatches(matcher, lines[i], strlen(lines[i]));
+    }
+    LoadReport("any StringMatcherMatches ignore case", N_LINES, bytes, LoadNow() - start);
+    StringMatcherDestroy(matcher);
+
+    sink = result;
+    for (size_t i = 0; i < N_PATTERNS; i++)
+    {
+        free(patterns[i]);
+    }
+    for (size_t i = 0; i < N_LINES; i++)
+    {
+        free(lines[i]);
+    }
+    free(patterns);
+    free(lines);
+    return 0;
+}
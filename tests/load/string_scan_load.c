@@ -0,0 +1,147 @@
+#include <platform.h>
+#include <string_scan.h>
+#include <alloc.h>
+#include <load.h>
+
+/* The string_scan kernels (in all implementations supported by the CPU)
+ * compared to the libc functions and the byte loops used before, on short
+ * and long inputs. */
+
+#define TOTAL_BYTES (256 * 1024 * 1024)
+
+static const char *const IMPLEMENTATIONS[] = { "scalar", "sse2", "avx2", "neon" };
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+static size_t OldCountChar(const char *s, char c)
+{
+    size_t count = 0;
+    for (; *s != '\0'; s++)
+    {
+        count += (*s == c);
+    }
+    return count;
+}
+
+static bool OldIsNumeric(const char *s)
+{
+    for (; *s; s++)
+    {
+        if (!isdigit((unsigned char) *s))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool OldIsPrintable(const char *s)
+{
+    for (; *s; s++)
+    {
+        if (!isprint((unsigned char) *s))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef enum
+{
+    OP_FIND,
+    OP_FIND_CASE,
+    OP_COUNT,
+    OP_NUMERIC,
+    OP_PRINTABLE,
+} Op;
+
+static const char *const OP_NAMES[] = { "find", "find-case", "count", "numeric", "printable" };
+
+/* impl == NULL means the old (libc/loop) implementation */
+static void Run(Op op, const char *impl, const char *text, const char *digits, size_t len)
+{
+    static const char needle[] = "needle in a haystack";
+    const size_t needle_len = sizeof(needle) - 1;
+    const size_t n_ops = TOTAL_BYTES / len;
+
+    if (impl != NULL && !StringScanSetImplementation(impl))
+    {
+        return;
+    }
+
+    size_t result = 0;
+    double start = LoadNow();
+    for (size_t i = 0; i < n_ops; i++)
+    {
+        switch (op)
+        {
+        case OP_FIND:
+            result += (impl == NULL) ?
+                (strstr(text, needle) != NULL) :
+                (StringScanFind(text, len, needle, needle_len) != NULL);
+            break;
+        case OP_FIND_CASE:
+            result += (impl == NULL) ?
+                (strcasestr(text, needle) != NULL) :
+                (StringScanFindCaseInsensitive(text, len, needle, needle_len) != NULL);
+            break;
+        case OP_COUNT:
+            result += (impl == NULL) ?
+                OldCountChar(text, 'e') :
+                StringScanCountChar(text, len, 'e');
+            break;
+        case OP_NUMERIC:
+            result += (impl == NULL) ?
+                OldIsNumeric(digits) :
+                (StringScanSpanDigits(digits, len) == len);
+            break;
+        case OP_PRINTABLE:
+            result += (impl == NULL) ?
+                OldIsPrintable(text) :
+                (StringScanSpanPrintable(text, len) == len);
+            break;
+        }
+    }
+    double elapsed = LoadNow() - start;
+    sink = result;
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s %s %zuB", OP_NAMES[op],
+             (impl == NULL) ? "old" : impl, len);
+    LoadReport(name, n_ops, n_ops * len, elapsed);
+}
+
+int main(void)
+{
+    static const size_t lengths[] = { 32, 64 * 1024 };
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        const size_t len = lengths[l];
+        char *text = xmalloc(len + 1);
+        char *digits = xmalloc(len + 1);
+        for (size_t i = 0; i < len; i++)
+        {
+            /* no match for the needle, but many for its first character */
+            text[i] = "the quick brown fox jumps over nine lazy dogs "[i % 46];
+            digits[i] = '0' + (i % 10);
+        }
+        text[len] = '\0';
+        digits[len] = '\0';
+
+        for (Op op = OP_FIND; op <= OP_PRINTABLE; op++)
+        {
+            Run(op, NULL, text, digits, len);
+            for (size_t i = 0; i < sizeof(IMPLEMENTATIONS) / sizeof(IMPLEMENTATIONS[0]); i++)
+            {
+                Run(op, IMPLEMENTATIONS[i], text, digits, len);
+            }
+        }
+
+        free(text);
+        free(digits);
+    }
+
+    return 0;
+}
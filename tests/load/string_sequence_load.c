@@ -0,0 +1,107 @@
+#include <platform.h>
+#include <string_sequence.h>
+#include <string_lib.h>
+#include <file_lib.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Length-prefixed string files: unbuffered ReadLenPrefixedString() (two
+ * read() calls and a malloc() per string) and the FILE based writer,
+ * compared to LenPrefixedReader / LenPrefixedWriter and reading the whole
+ * file into one buffer with SeqStringReadFileSlices(). */
+
+#define N_STRINGS 200000
+#define N_ROUNDS 5
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+int main(void)
+{
+    const char *const path = "string_sequence_load.tmp";
+
+    Seq *seq = SeqNew(N_STRINGS, free);
+    size_t bytes = 0;
+    for (size_t i = 0; i < N_STRINGS; i++)
+    {
+        char *s = StringFormat("/var/cfengine/inputs/lib/file_%zu.cf", i * 7919);
+        bytes += strlen(s) + 11;
+        SeqAppend(seq, s);
+    }
+
+    double start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        SeqStringWriteFile(seq, path);
+    }
+    LoadReport("write SeqStringWriteFile", N_ROUNDS * N_STRINGS, N_ROUNDS * bytes,
+               LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        SeqStringWriteFd(seq, fd);
+        close(fd);
+    }
+    LoadReport("write SeqStringWriteFd", N_ROUNDS * N_STRINGS, N_ROUNDS * bytes,
+               LoadNow() - start);
+
+    size_t result = 0;
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        const int fd = open(path, O_RDONLY);
+        char *data;
+        while (ReadLenPrefixedString(fd, &data) > 0)
+        {
+            result += data[0];
+            free(data);
+        }
+        close(fd);
+    }
+    LoadReport("read ReadLenPrefixedString", N_ROUNDS * N_STRINGS, N_ROUNDS * bytes,
+               LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        const int fd = open(path, O_RDONLY);
+        LenPrefixedReader *reader = LenPrefixedReaderNew(fd);
+        const char *data;
+        while (LenPrefixedReaderNext(reader, &data, NULL) > 0)
+        {
+            result += data[0];
+        }
+        LenPrefixedReaderDestroy(reader);
+        close(fd);
+    }
+    LoadReport("read LenPrefixedReader", N_ROUNDS * N_STRINGS, N_ROUNDS * bytes,
+               LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        Seq *read = SeqStringReadFile(path);
+        result += SeqLength(read);
+        SeqDestroy(read);
+    }
+    LoadReport("read SeqStringReadFile", N_ROUNDS * N_STRINGS, N_ROUNDS * bytes,
+               LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        char *backing;
+        Seq *read = SeqStringReadFileSlices(path, &backing);
+        result += SeqLength(read);
+        SeqDestroy(read);
+        free(backing);
+    }
+    LoadReport("read SeqStringReadFileSlices", N_ROUNDS * N_STRINGS, N_ROUNDS * bytes,
+               LoadNow() - start);
+
+    sink = result;
+    SeqDestroy(seq);
+    unlink(path);
+    return 0;
+}
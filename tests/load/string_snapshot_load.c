@@ -0,0 +1,105 @@
+#include <platform.h>
+#include <string_snapshot.h>
+#include <string_sequence.h>
+#include <string_lib.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Reloading a big StringSet: reading a length-prefixed file and adding every
+ * string to a new set, compared to opening a snapshot. Then lookups in
+ * both. */
+
+#define N_ELEMENTS 200000
+#define N_ROUNDS 5
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+int main(void)
+{
+    const char *const seq_path = "string_snapshot_load.seq";
+    const char *const snapshot_path = "string_snapshot_load.snapshot";
+
+    StringSet *set = StringSetNew();
+    Seq *seq = SeqNew(N_ELEMENTS, NULL);
+    for (size_t i = 0; i < N_ELEMENTS; i++)
+    {
+        char *s = StringFormat("/var/cfengine/inputs/lib/file_%zu.cf", i * 7919);
+        StringSetAdd(set, s);
+        SeqAppend(seq, s);
+    }
+    SeqStringWriteFile(seq, seq_path);
+
+    double start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        StringSetWriteSnapshot(set, snapshot_path);
+    }
+    LoadReport("StringSetWriteSnapshot", N_ROUNDS * N_ELEMENTS, 0, LoadNow() - start);
+
+    size_t result = 0;
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        Seq *read = SeqStringReadFile(seq_path);
+        StringSet *loaded = StringSetNew();
+        for (size_t j = 0; j < SeqLength(read); j++)
+        {
+            StringSetAdd(loaded, SeqAt(read, j));
+        }
+        SeqSoftDestroy(read);
+        result += StringSetSize(loaded);
+        StringSetDestroy(loaded);
+    }
+    LoadReport("load SeqStringReadFile+StringSetAdd", N_ROUNDS, 0, LoadNow() - start);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        StringSnapshot *snapshot = StringSnapshotOpen(snapshot_path);
+        result += StringSnapshotSize(snapshot);
+        StringSnapshotClose(snapshot);
+    }
+    LoadReport("load StringSnapshotOpen", N_ROUNDS, 0, LoadNow() - start);
+
+    /* Half hits, half misses */
+    char **probes = xmalloc(N_ELEMENTS * sizeof(char *));
+    for (size_t i = 0; i < N_ELEMENTS; i++)
+    {
+        probes[i] = (i % 2 == 0) ? xstrdup(SeqAt(seq, i))
+                                 : StringFormat("/var/cfengine/inputs/lib/file_%zu.cf", i * 7919 + 1);
+    }
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        for (size_t j = 0; j < N_ELEMENTS; j++)
+        {
+            result += StringSetContains(set, probes[j]);
+        }
+    }
+    LoadReport("lookup StringSetContains", N_ROUNDS * N_ELEMENTS, 0, LoadNow() - start);
+
+    StringSnapshot *snapshot = StringSnapshotOpen(snapshot_path);
+    start = LoadNow();
+    for (size_t i = 0; i < N_ROUNDS; i++)
+    {
+        for (size_t j = 0; j < N_ELEMENTS; j++)
+        {
+            result += StringSnapshotContains(snapshot, probes[j]);
+        }
+    }
+    LoadReport("lookup StringSnapshotContains", N_ROUNDS * N_ELEMENTS, 0, LoadNow() - start);
+    StringSnapshotClose(snapshot);
+
+    sink = result;
+    for (size_t i = 0; i < N_ELEMENTS; i++)
+    {
+        free(probes[i]);
+    }
+    free(probes);
+    SeqDestroy(seq);
+    StringSetDestroy(set);
+    unlink(seq_path);
+    unlink(snapshot_path);
+    return 0;
+}
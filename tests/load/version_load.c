@@ -0,0 +1,83 @@
+#include <platform.h>
+#include <version_comparison.h>
+#include <sequence.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Sorting and filtering a package inventory by version: the string-based
+ * CompareVersion() functions compared to parsed Versions and a compiled
+ * VersionConstraint. */
+
+#define N_VERSIONS 50000
+
+static volatile size_t sink; /* keeps the compiler from dropping the loops */
+
+static int CompareVersionSeq(const void *a, const void *b, ARG_UNUSED void *user_data)
+{
+    const VersionComparison r = CompareVersion(a, b);
+    return (r == VERSION_SMALLER) ? -1 : (r == VERSION_GREATER);
+}
+
+int main(void)
+{
+    char **strs = xmalloc(N_VERSIONS * sizeof(char *));
+    srand(1);
+    for (size_t i = 0; i < N_VERSIONS; i++)
+    {
+        xasprintf(&strs[i], "%d.%d.%d", rand() % 20, rand() % 30, rand() % 100);
+    }
+
+    size_t result = 0;
+
+    Seq *seq = SeqNew(N_VERSIONS, NULL);
+    for (size_t i = 0; i < N_VERSIONS; i++)
+    {
+        SeqAppend(seq, strs[i]);
+    }
+    double start = LoadNow();
+    SeqSort(seq, CompareVersionSeq, NULL);
+    LoadReport("SeqSort CompareVersion 50k", N_VERSIONS, 0, LoadNow() - start);
+    SeqDestroy(seq);
+
+    start = LoadNow();
+    Seq *versions = SeqNew(N_VERSIONS, VersionDestroy);
+    for (size_t i = 0; i < N_VERSIONS; i++)
+    {
+        SeqAppend(versions, VersionParse(strs[i], VERSION_SCHEME_SEMVER));
+    }
+    LoadReport("VersionParse", N_VERSIONS, 0, LoadNow() - start);
+
+    start = LoadNow();
+    SeqSort(versions, VersionCompareSeq, NULL);
+    LoadReport("SeqSort VersionCompare 50k", N_VERSIONS, 0, LoadNow() - start);
+
+    /* Put them back in random order for the filters */
+    SeqShuffle(versions, 1);
+
+    start = LoadNow();
+    for (size_t i = 0; i < N_VERSIONS; i++)
+    {
+        result += (CompareVersionExpression(strs[i], ">=", "3.15.0") == BOOLEAN_TRUE &&
+                   CompareVersionExpression(strs[i], "<", "10.0.0") == BOOLEAN_TRUE);
+    }
+    LoadReport("filter CompareVersionExpression", N_VERSIONS, 0, LoadNow() - start);
+
+    VersionConstraint *constraint =
+        VersionConstraintParse(">= 3.15.0, < 10.0.0", VERSION_SCHEME_SEMVER);
+    start = LoadNow();
+    for (size_t i = 0; i < N_VERSIONS; i++)
+    {
+        result += VersionConstraintMatches(constraint, SeqAt(versions, i));
+    }
+    LoadReport("filter VersionConstraintMatches", N_VERSIONS, 0, LoadNow() - start);
+    VersionConstraintDestroy(constraint);
+
+    sink = result;
+    SeqDestroy(versions);
+    for (size_t i = 0; i < N_VERSIONS; i++)
+    {
+        free(strs[i]);
+    }
+    free(strs);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <platform.h>
+#include <writer.h>
+#include <json.h>
+#include <alloc.h>
+#include <load.h>
+
+/* Writer paths: small writes through WriterWriteLen(), WriterWriteBytes(),
+ * WriterWriteChar(), WriterWriteF() and WriterReserve()/WriterCommit() on a
+ * StringWriter, a FileWriter and an FdWriter (the latter two on /dev/null),
+ * and JSON serialization on top of them. */
+
+#define N_OPS 5000000
+#define N_JSON_ROWS 100000
+
+static const char *WriterKindName(int kind)
+{
+    switch (kind)
+    {
+    case 0:
+        return "StringWriter";
+    case 1:
+        return "FileWriter";
+    default:
+        return "FdWriter";
+    }
+}
+
+static Writer *NewWriter(int kind)
+{
+    switch (kind)
+    {
+    case 0:
+        return StringWriter();
+    case 1:
+        return FileWriter(fopen("/dev/null", "w"));
+    default:
+        return FdWriter(open("/dev/null", O_WRONLY));
+    }
+}
+
+static void Run(int kind, const char *what, int op)
+{
+    static const char token[] = "some_token";
+    const size_t token_len = sizeof(token) - 1;
+
+    Writer *w = NewWriter(kind);
+    size_t bytes = 0;
+    double start = LoadNow();
+    for (int i = 0; i < N_OPS; i++)
+    {
+        switch (op)
+        {
+        case 0:
+            bytes += WriterWriteLen(w, token, token_len);
+            break;
+        case 1:
+            bytes += WriterWriteBytes(w, token, token_len);
+            break;
+        case 2:
+            bytes += WriterWriteChar(w, 'x');
+            break;
+        case 3:
+            bytes += WriterWriteF(w, "%d,", i);
+            break;
+        default:
+            memcpy(WriterReserve(w, token_len), token, token_len);
+            WriterCommit(w, token_len);
+            bytes += token_len;
+            break;
+        }
+    }
+    WriterFlush(w);
+    double elapsed = LoadNow() - start;
+    WriterClose(w);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s %s", WriterKindName(kind), what);
+    LoadReport(name, N_OPS, bytes, elapsed);
+}
+
+static JsonElement *CreateJson(void)
+{
+    JsonElement *json = JsonArrayCreate(N_JSON_ROWS);
+    for (int i = 0; i < N_JSON_ROWS; i++)
+    {
+        JsonElement *row = JsonObjectCreate(4);
+        JsonObjectAppendInteger(row, "id", i);
+        JsonObjectAppendString(row, "host", "node.example.com");
+        JsonObjectAppendString(row, "comment",
+                               (i % 10 == 0) ? "a \"quoted\"\tcomment\n" : "plain comment");
+        JsonObjectAppendBool(row, "enabled", (i % 2) == 0);
+        JsonArrayAppendObject(json, row);
+    }
+    return json;
+}
+
+int main(void)
+{
+    static const char *const whats[] = {
+        "WriterWriteLen", "WriterWriteBytes", "WriterWriteChar",
+        "WriterWriteF", "WriterReserve+Commit",
+    };
+
+    for (int kind = 0; kind < 3; kind++)
+    {
+        for (int op = 0; op < 5; op++)
+        {
+            Run(kind, whats[op], op);
+        }
+    }
+
+    JsonElement *json = CreateJson();
+    for (int kind = 0; kind < 3; kind++)
+    {
+        Writer *w = NewWriter(kind);
+        double start = LoadNow();
+        JsonWrite(w, json, 0);
+        WriterFlush(w);
+        double elapsed = LoadNow() - start;
+        WriterClose(w);
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s JsonWrite", WriterKindName(kind));
+        LoadReport(name, N_JSON_ROWS, 0, elapsed);
+    }
+    JsonDestroy(json);
+
+    return 0;
+}
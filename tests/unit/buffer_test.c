@@ -257,6 +257,29 @@ static void test_appendBuffer(void)
     free(element2);
 }
 
+static void test_reserve_commit(void)
+{
+    Buffer *buffer = BufferNewWithCapacity(4);
+    BufferAppend(buffer, "ab", 2);
+
+    char *dst = BufferReserve(buffer, 10);
+    assert_true(BufferCapacity(buffer) > 12);
+    memcpy(dst, "cd\0ef", 5);
+    BufferCommit(buffer, 5);
+    /* CString mode stops at '\0' */
+    assert_int_equal(BufferSize(buffer), 4);
+    assert_string_equal(BufferData(buffer), "abcd");
+
+    BufferSetMode(buffer, BUFFER_BEHAVIOR_BYTEARRAY);
+    dst = BufferReserve(buffer, 3);
+    memcpy(dst, "g\0h", 3);
+    BufferCommit(buffer, 3);
+    assert_int_equal(BufferSize(buffer), 7);
+    assert_memory_equal(BufferData(buffer), "abcdg\0h", 8);
+
+    BufferDestroy(buffer);
+}
+
 static void test_append_boundaries(void)
 {
     /*
@@ -611,6 +634,7 @@ int main()
         unit_test(test_copyCompareBuffer),
         unit_test(test_setBuffer),
         unit_test(test_appendBuffer),
+        unit_test(test_reserve_commit),
         unit_test(test_append_boundaries),
         unit_test(test_printf),
         unit_test(test_vprintf)
@@ -4,6 +4,8 @@
 #include <alloc.h>
 #include <csv_parser.h>
 #include <writer.h>
+#include <file_lib.h>
+#include <json-utils.h>
 
 static void test_new_csv_reader_empty_string()
 {
@@ -304,6 +306,225 @@ static void test_new_csv_reader_carriage_return()
     SeqDestroy(list);
 }
 
+/* Reads the file with GetCsvLineNext() + SeqParseCsvString() and with a
+ * CsvReader and checks that the results are the same.
+ * Returns the number of well-formed records. */
+static size_t check_csv_reader_same_as_line_parser(const char *path)
+{
+    size_t num_ok = 0;
+    FILE *fp = fopen(path, "r");
+    assert_true(fp != NULL);
+    int fd = open(path, O_RDONLY);
+    assert_true(fd >= 0);
+    CsvReader *reader = CsvReaderNew(fd);
+
+    char *line;
+    CsvRecord record;
+    while ((line = GetCsvLineNext(fp)) != NULL)
+    {
+        Seq *list = SeqParseCsvString(line);
+        CsvRecordStatus status = CsvReaderNext(reader, &record);
+        assert_int_equal(record.size, strlen(line));
+        if (list == NULL)
+        {
+            assert_int_equal(status, CSV_RECORD_MALFORMED);
+        }
+        else
+        {
+            assert_int_equal(status, CSV_RECORD_OK);
+            num_ok++;
+            assert_int_equal(record.num_fields, SeqLength(list));
+            for (size_t i = 0; i < SeqLength(list); i++)
+            {
+                assert_int_equal(record.fields[i].len, strlen(SeqAt(list, i)));
+                assert_string_equal(record.fields[i].data, SeqAt(list, i));
+            }
+            SeqDestroy(list);
+        }
+        free(line);
+    }
+    assert_int_equal(CsvReaderNext(reader, &record), CSV_RECORD_EOF);
+
+    CsvReaderDestroy(reader);
+    close(fd);
+    fclose(fp);
+
+    return num_ok;
+}
+
+static void test_csv_reader_data_files()
+{
+    check_csv_reader_same_as_line_parser("./data/csv_file.csv");
+    check_csv_reader_same_as_line_parser("./data/csv_file_edge_cases.csv");
+}
+
+/* Writes #n_records records with all kinds of quoting and blanks, with a
+ * record bigger than the initial buffer of CsvReader and an incomplete
+ * record at the end. */
+static void write_generated_csv(const char *path, int n_records)
+{
+    static const char *const records[] = {
+        "plain,fields,here\r\n",
+        " leading, space ,trailing \r\n",
+        "\"quoted\",\"with,comma\",\"with \"\"quotes\"\"\"\r\n",
+        "\"multi\r\nline\nfield\",x\r\n",
+        "  \"space before quote\"  ,\"space after\" \r\n",
+        ",,\r\n",
+        "\r\n",
+        "lf\nonly\nlines\r\n",
+        "bad\"quote,x\r\n",
+        "\"bad\"x,y\r\n",
+        "\"\"\"\",\"\",\r\n",
+    };
+    const size_t n = sizeof(records) / sizeof(records[0]);
+
+    FILE *fp = fopen(path, "w");
+    assert_true(fp != NULL);
+    for (int i = 0; i < n_records; i++)
+    {
+        fputs(records[i % n], fp);
+        if (i == 1000)
+        {
+            char *big = xmalloc(600 * 1024);
+            memset(big, 'x', 600 * 1024);
+            big[0] = '"';
+            big[300 * 1024] = ',';
+            memcpy(big + 600 * 1024 - 3, "\"\r\n", 3);
+            assert_int_equal(fwrite(big, 1, 600 * 1024, fp), 600 * 1024);
+            free(big);
+        }
+    }
+    fputs("last,without crlf", fp);
+    assert_int_equal(fclose(fp), 0);
+}
+
+static void test_csv_reader_generated()
+{
+    char path[] = "/tmp/csv_parser_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+
+    /* Enough data to need multiple reads */
+    write_generated_csv(path, 20000);
+
+    size_t num_ok = check_csv_reader_same_as_line_parser(path);
+    assert_true(num_ok > 5000);
+
+    JsonElement *json = NULL;
+    assert_true(JsonParseCsvFile(path, SIZE_MAX, &json));
+    assert_int_equal(JsonLength(json), num_ok);
+    JsonDestroy(json);
+
+    unlink(path);
+}
+
+static void test_csv_parallel()
+{
+    char path[] = "/tmp/csv_parser_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+
+    /* Over the threshold for parsing in parallel */
+    write_generated_csv(path, 450000);
+    struct stat sb;
+    assert_int_equal(stat(path, &sb), 0);
+    assert_true(sb.st_size > JSON_CSV_PARALLEL_THRESHOLD);
+
+    /* Chunks split at record boundaries give the same records. */
+    bool truncated;
+    Buffer *whole = FileReadBuffer(path, SIZE_MAX, &truncated);
+    Buffer *copy = BufferCopy(whole);
+    size_t chunk_ends[7];
+    CsvSplitData(BufferData(copy), BufferSize(copy), 7, chunk_ends);
+
+    CsvReader *whole_reader = CsvReaderNewFromData((char *) BufferData(whole),
+                                                   BufferSize(whole), true);
+    CsvRecord record, chunk_record;
+    CsvRecordStatus status;
+    for (size_t i = 0; i < 7; i++)
+    {
+        size_t start = (i == 0) ? 0 : chunk_ends[i - 1];
+        assert_true(chunk_ends[i] >= start);
+        CsvReader *reader = CsvReaderNewFromData((char *) BufferData(copy) + start,
+                                                 chunk_ends[i] - start, (i == 6));
+        while ((status = CsvReaderNext(reader, &chunk_record)) != CSV_RECORD_EOF)
+        {
+            assert_int_equal(CsvReaderNext(whole_reader, &record), status);
+            assert_int_equal(record.size, chunk_record.size);
+            assert_int_equal(record.num_fields, chunk_record.num_fields);
+            for (size_t j = 0; j < record.num_fields; j++)
+            {
+                assert_string_equal(record.fields[j].data, chunk_record.fields[j].data);
+            }
+        }
+        CsvReaderDestroy(reader);
+    }
+    assert_int_equal(CsvReaderNext(whole_reader, &record), CSV_RECORD_EOF);
+    CsvReaderDestroy(whole_reader);
+    BufferDestroy(copy);
+    BufferDestroy(whole);
+
+    /* Same JSON as when parsed sequentially, also with a size limit. */
+    const size_t limits[] = { SIZE_MAX, 5 * 1000 * 1000 };
+    for (size_t i = 0; i < 2; i++)
+    {
+        JsonElement *json = NULL;
+        JsonElement *json_parallel = NULL;
+        assert_true(JsonParseCsvFile(path, limits[i], &json));
+        assert_true(JsonParseCsvFileParallel(path, limits[i], 4, &json_parallel));
+        assert_true(JsonLength(json) > 50000);
+        assert_int_equal(JsonLength(json), JsonLength(json_parallel));
+        assert_int_equal(JsonCompare(json, json_parallel), 0);
+        JsonDestroy(json);
+        JsonDestroy(json_parallel);
+    }
+
+    unlink(path);
+}
+
+static void test_csv_parallel_long_last_record()
+{
+    char path[] = "/tmp/csv_parser_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+
+    /* Over the parallel threshold, with a last record without CRLF longer
+     * than a chunk, so that it spans several split points */
+    FILE *fp = fopen(path, "w");
+    assert_true(fp != NULL);
+    size_t n_records = 0;
+    for (size_t size = 0; size < JSON_CSV_PARALLEL_THRESHOLD - 1024 * 1024; n_records++)
+    {
+        size += fprintf(fp, "record,%zu,some data\r\n", n_records);
+    }
+    fputs("last,", fp);
+    const size_t last_len = 3 * JSON_CSV_PARALLEL_MIN_CHUNK;
+    for (size_t i = 0; i < last_len; i++)
+    {
+        fputc('x', fp);
+    }
+    assert_int_equal(fclose(fp), 0);
+
+    JsonElement *json = NULL;
+    JsonElement *json_parallel = NULL;
+    assert_true(JsonParseCsvFile(path, SIZE_MAX, &json));
+    assert_true(JsonParseCsvFileParallel(path, SIZE_MAX, 4, &json_parallel));
+    assert_int_equal(JsonLength(json), n_records + 1);
+    assert_int_equal(JsonLength(json_parallel), n_records + 1);
+    assert_int_equal(JsonCompare(json, json_parallel), 0);
+
+    const JsonElement *last = JsonArrayGet(json_parallel, n_records);
+    assert_string_equal(JsonPrimitiveGetAsString(JsonArrayGet(last, 0)), "last");
+    assert_int_equal(strlen(JsonPrimitiveGetAsString(JsonArrayGet(last, 1))), last_len);
+
+    JsonDestroy(json);
+    JsonDestroy(json_parallel);
+    unlink(path);
+}
+
 int main()
 {
     PRINT_TEST_BANNER();
@@ -320,6 +541,10 @@ int main()
         unit_test(test_get_next_line_edge_cases),
         unit_test(test_new_csv_reader_zd3151_ENT3023),
         unit_test(test_new_csv_reader_carriage_return),
+        unit_test(test_csv_reader_data_files),
+        unit_test(test_csv_reader_generated),
+        unit_test(test_csv_parallel),
+        unit_test(test_csv_parallel_long_last_record),
     };
 
     return run_tests(tests);
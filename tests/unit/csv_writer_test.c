@@ -158,6 +158,97 @@ void test_no_terminate(void)
     }
 }
 
+void test_record(void)
+{
+    Writer *w = StringWriter();
+    CsvWriter *c = CsvWriterOpen(w);
+
+    const char *const fields[] = { "a", "b,c", "d\"e" };
+    CsvWriterRecord(c, fields, 3);
+    CsvWriterRecord(c, fields, 0);
+
+    const StringRef slices[] = {
+        { .data = "first,ignored", .len = 5 },
+        { .data = "x\"\"y", .len = 4 },
+        { .data = NULL, .len = 0 },
+    };
+    CsvWriterRecordSlices(c, slices, 3);
+
+    CsvWriterClose(c);
+    char *result_string = StringWriterClose(w);
+    assert_string_equal(result_string,
+                        "a,\"b,c\",\"d\"\"e\"\r\n"
+                        "\r\n"
+                        "first,\"x\"\"\"\"y\",\r\n");
+    free(result_string);
+}
+
+void test_large_output(void)
+{
+    Writer *w = StringWriter();
+    CsvWriter *c = CsvWriterOpen(w);
+    Writer *expected = StringWriter();
+
+    /* Long fields (bigger than the internal buffer) and many short ones,
+     * clean ones and ones that need quoting. */
+    char long_field[20000];
+    for (size_t i = 0; i < sizeof(long_field) - 1; i++)
+    {
+        long_field[i] = 'a' + (i % 26);
+    }
+    long_field[sizeof(long_field) - 1] = '\0';
+
+    for (int i = 0; i < 1000; i++)
+    {
+        CsvWriterFieldF(c, "%d", i);
+        WriterWriteF(expected, "%d", i);
+        if (i % 7 == 0)
+        {
+            CsvWriterField(c, "quote\"d, field");
+            WriterWrite(expected, ",\"quote\"\"d, field\"");
+        }
+        if (i % 100 == 0)
+        {
+            CsvWriterField(c, long_field);
+            WriterWriteF(expected, ",%s", long_field);
+
+            long_field[1000] = '"';
+            CsvWriterField(c, long_field);
+            long_field[1000] = '\0';
+            WriterWriteF(expected, ",\"%s\"\"%s\"", long_field, long_field + 1001);
+            long_field[1000] = 'a' + (1000 % 26);
+        }
+        CsvWriterNewRecord(c);
+        WriterWrite(expected, "\r\n");
+    }
+
+    CsvWriterClose(c);
+    char *result_string = StringWriterClose(w);
+    char *expected_string = StringWriterClose(expected);
+    assert_string_equal(result_string, expected_string);
+    free(result_string);
+    free(expected_string);
+}
+
+void test_get_writer_flushes(void)
+{
+    Writer *w = StringWriter();
+    CsvWriter *c = CsvWriterOpen(w);
+
+    CsvWriterField(c, "a");
+    CsvWriterField(c, "b");
+    WriterWrite(CsvWriterGetWriter(c), ",raw");
+    CsvWriterNewRecord(c);
+    CsvWriterField(c, "c");
+    CsvWriterFlush(c);
+    assert_string_equal(StringWriterData(w), "a,b,raw\r\nc");
+
+    CsvWriterClose(c);
+    char *result_string = StringWriterClose(w);
+    assert_string_equal(result_string, "a,b,raw\r\nc\r\n");
+    free(result_string);
+}
+
 int main()
 {
     PRINT_TEST_BANNER();
@@ -172,6 +263,9 @@ int main()
         unit_test(test_escape),
         unit_test(test_terminate),
         unit_test(test_no_terminate),
+        unit_test(test_record),
+        unit_test(test_large_output),
+        unit_test(test_get_writer_flushes),
     };
 
     return run_tests(tests);
@@ -0,0 +1,185 @@
+#include <test.h>
+
+#include <encode.h>
+#include <alloc.h>
+
+static void test_encode(void)
+{
+    char out[64];
+    assert_int_equal(Base64Encode("", 0, out), 0);
+    assert_string_equal(out, "");
+    assert_int_equal(Base64Encode("f", 1, out), 4);
+    assert_string_equal(out, "Zg==");
+    assert_int_equal(Base64Encode("fo", 2, out), 4);
+    assert_string_equal(out, "Zm8=");
+    assert_int_equal(Base64Encode("foo", 3, out), 4);
+    assert_string_equal(out, "Zm9v");
+    Base64Encode("foobar", 6, out);
+    assert_string_equal(out, "Zm9vYmFy");
+    Base64Encode("\xff\xfe\x00\x01\xfb", 5, out);
+    assert_string_equal(out, "//4AAfs=");
+}
+
+static void test_encode_lines(void)
+{
+    /* 64 character lines, like the OpenSSL BIO used before */
+    char data[100];
+    memset(data, 'a', sizeof(data));
+    char *res = StringEncodeBase64(data, 48);
+    assert_string_equal(res, "YWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFh");
+    free(res);
+
+    res = StringEncodeBase64(data, 49);
+    assert_string_equal(res, "YWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFh\n"
+                             "YQ==");
+    free(res);
+
+    res = StringEncodeBase64(data, 96);
+    assert_string_equal(res, "YWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFh\n"
+                             "YWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFh");
+    free(res);
+}
+
+static void test_decode(void)
+{
+    size_t len;
+    char *res = StringDecodeBase64("Zm9vYmFy", 8, &len);
+    assert_int_equal(len, 6);
+    assert_string_equal(res, "foobar");
+    free(res);
+
+    res = StringDecodeBase64("", 0, &len);
+    assert_int_equal(len, 0);
+    free(res);
+
+    /* whitespace and missing padding */
+    res = StringDecodeBase64(" Zm9v\r\nYmE= ", 12, &len);
+    assert_int_equal(len, 5);
+    assert_memory_equal(res, "fooba", 5);
+    free(res);
+    res = StringDecodeBase64("Zm9vYg", 6, &len);
+    assert_int_equal(len, 4);
+    assert_memory_equal(res, "foob", 4);
+    free(res);
+    res = StringDecodeBase64("//4AAfs=", 8, &len);
+    assert_int_equal(len, 5);
+    assert_memory_equal(res, "\xff\xfe\x00\x01\xfb", 5);
+    free(res);
+
+    /* invalid */
+    assert_true(StringDecodeBase64("Zm9v!mFy", 8, &len) == NULL);
+    assert_true(StringDecodeBase64("Zm9vY", 5, &len) == NULL);
+    assert_true(StringDecodeBase64("Zg=", 3, &len) == NULL);
+    assert_true(StringDecodeBase64("Zg===", 5, &len) == NULL);
+    assert_true(StringDecodeBase64("Z===", 4, &len) == NULL);
+    assert_true(StringDecodeBase64("Zg==Zg==", 8, &len) == NULL);
+    assert_true(StringDecodeBase64("=", 1, &len) == NULL);
+
+    /* in place */
+    char buf[] = "Zm9vYmFy";
+    assert_int_equal(Base64Decode(buf, 8, buf), 6);
+    assert_memory_equal(buf, "foobar", 6);
+}
+
+static void test_round_trip_chunks(void)
+{
+    unsigned char data[1000];
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = rand();
+    }
+
+    for (int iteration = 0; iteration < 200; iteration++)
+    {
+        const size_t len = rand() % sizeof(data);
+        const size_t line_length = 4 * (rand() % 20);
+
+        /* encode in random chunks */
+        Base64Encoder encoder;
+        Base64EncoderInit(&encoder, line_length);
+        Writer *writer = StringWriter();
+        for (size_t pos = 0; pos < len;)
+        {
+            const size_t max_chunk = rand() % 20;
+            const size_t chunk = MIN(len - pos, max_chunk);
+            if (iteration % 2 == 0)
+            {
+                Base64EncoderWrite(&encoder, writer, data + pos, chunk);
+            }
+            else
+            {
+                char out[64];
+                const size_t max_size = Base64EncoderMaxSize(&encoder, chunk);
+                assert_true(max_size <= sizeof(out));
+                const size_t n = Base64EncoderUpdate(&encoder, data + pos, chunk, out);
+                assert_true(n <= max_size);
+                WriterWriteBytes(writer, out, n);
+            }
+            pos += chunk;
+        }
+        Base64EncoderWriteFinal(&encoder, writer);
+        const size_t encoded_len = StringWriterLength(writer);
+        char *encoded = StringWriterClose(writer);
+
+        /* same as one-shot encoding without the line breaks */
+        char *expected = xmalloc(BASE64_ENCODED_SIZE(len) + 1);
+        assert_int_equal(Base64Encode(data, len, expected), BASE64_ENCODED_SIZE(len));
+        char *stripped = xmalloc(encoded_len + 1);
+        size_t stripped_len = 0;
+        for (size_t i = 0; i < encoded_len; i++)
+        {
+            if (encoded[i] != '\n')
+            {
+                stripped[stripped_len++] = encoded[i];
+            }
+            else
+            {
+                assert_true(line_length > 0);
+                assert_int_equal((i + 1) % (line_length + 1), 0);
+            }
+        }
+        stripped[stripped_len] = '\0';
+        assert_string_equal(stripped, expected);
+
+        /* decode in random chunks */
+        Base64Decoder decoder;
+        Base64DecoderInit(&decoder);
+        unsigned char *decoded = xmalloc(BASE64_DECODED_MAX_SIZE(encoded_len) + 2);
+        size_t decoded_len = 0;
+        for (size_t pos = 0; pos < encoded_len;)
+        {
+            const size_t max_chunk = rand() % 30;
+            const size_t chunk = MIN(encoded_len - pos, max_chunk);
+            size_t n;
+            assert_true(Base64DecoderUpdate(&decoder, encoded + pos, chunk,
+                                            decoded + decoded_len, &n));
+            assert_true(n <= BASE64_DECODED_MAX_SIZE(chunk));
+            decoded_len += n;
+            pos += chunk;
+        }
+        size_t n;
+        assert_true(Base64DecoderFinal(&decoder, decoded + decoded_len, &n));
+        decoded_len += n;
+        assert_int_equal(decoded_len, len);
+        assert_memory_equal(decoded, data, len);
+
+        free(decoded);
+        free(stripped);
+        free(expected);
+        free(encoded);
+    }
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_encode),
+        unit_test(test_encode_lines),
+        unit_test(test_decode),
+        unit_test(test_round_trip_chunks),
+    };
+
+    return run_tests(tests);
+}
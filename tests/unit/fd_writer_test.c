@@ -0,0 +1,138 @@
+#include <test.h>
+
+#include <platform.h>
+#include <writer.h>
+#include <file_lib.h>
+#include <alloc.h>
+
+static char *ReadWhole(int fd)
+{
+    lseek(fd, 0, SEEK_SET);
+    bool truncated;
+    Buffer *buf = FileReadBufferFromFd(fd, SIZE_MAX, &truncated);
+    assert_true(buf != NULL);
+    return BufferClose(buf);
+}
+
+static int TempFd(void)
+{
+    char path[] = "/tmp/fd_writer_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    unlink(path);
+    return fd;
+}
+
+static void test_empty(void)
+{
+    int fd = TempFd();
+    Writer *w = FdWriter(fd);
+    assert_true(WriterFlush(w));
+    assert_int_equal(FdWriterDetach(w), fd);
+
+    char *data = ReadWhole(fd);
+    assert_string_equal(data, "");
+    free(data);
+    close(fd);
+}
+
+static void test_write(void)
+{
+    int fd = TempFd();
+    Writer *w = FdWriter(fd);
+
+    WriterWrite(w, "123");
+    WriterWriteChar(w, '4');
+    WriterWriteLen(w, "56\0" "7", 4);
+    WriterWriteBytes(w, "7\0" "8", 3);
+    WriterWriteF(w, "%d%s", 9, "ab");
+    memcpy(WriterReserve(w, 10), "cdxx", 4);
+    WriterCommit(w, 2);
+
+    /* nothing written before flush */
+    char *data = ReadWhole(fd);
+    assert_string_equal(data, "");
+    free(data);
+
+    assert_true(WriterFlush(w));
+    data = ReadWhole(fd);
+    assert_memory_equal(data, "1234567\0" "89abcd", 14);
+    free(data);
+
+    FdWriterDetach(w);
+    close(fd);
+}
+
+static void test_write_large(void)
+{
+    int fd = TempFd();
+    Writer *w = FdWriter(fd);
+    Writer *expected = StringWriter();
+
+    /* Mix small writes, formatted ones and ones bigger than the buffer. */
+    const size_t big_size = 200 * 1024;
+    char *big = xmalloc(big_size + 1);
+    for (size_t i = 0; i < big_size; i++)
+    {
+        big[i] = 'a' + (i % 26);
+    }
+    big[big_size] = '\0';
+
+    for (int i = 0; i < 20000; i++)
+    {
+        WriterWriteF(w, "%d,", i);
+        WriterWriteF(expected, "%d,", i);
+        WriterWriteChar(w, '|');
+        WriterWriteChar(expected, '|');
+        if (i % 5000 == 0)
+        {
+            WriterWriteBytes(w, big, big_size);
+            WriterWrite(expected, big);
+            WriterWriteF(w, "<%s>", big);
+            WriterWriteF(expected, "<%s>", big);
+            char *space = WriterReserve(w, big_size);
+            memcpy(space, big, big_size);
+            WriterCommit(w, big_size);
+            WriterWrite(expected, big);
+        }
+    }
+    free(big);
+
+    FdWriterDetach(w);
+    char *data = ReadWhole(fd);
+    assert_string_equal(data, StringWriterData(expected));
+    free(data);
+    WriterClose(expected);
+    close(fd);
+}
+
+static void test_write_error(void)
+{
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    close(fds[0]);
+
+    /* avoid being killed by SIGPIPE */
+    signal(SIGPIPE, SIG_IGN);
+
+    Writer *w = FdWriter(fds[1]);
+    WriterWrite(w, "lost");
+    assert_false(WriterFlush(w));
+    WriterWrite(w, "also lost");
+    assert_false(WriterFlush(w));
+    WriterClose(w);
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_empty),
+        unit_test(test_write),
+        unit_test(test_write_large),
+        unit_test(test_write_error),
+    };
+
+    return run_tests(tests);
+}
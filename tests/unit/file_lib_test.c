@@ -1577,6 +1577,172 @@ static void test_file_copy(void)
     return_to_test_dir();
 }
 
+static void test_file_copy_large_sparse(void)
+{
+    setup_tempfiles();
+
+    /* data, a big hole, data and a hole at the end, bigger than the copy
+     * buffers */
+    const size_t data_size = 300 * 1024;
+    const off_t hole_size = 4 * 1024 * 1024;
+    char *data = xmalloc(data_size);
+    for (size_t i = 0; i < data_size; i++)
+    {
+        data[i] = 'a' + (i % 26);
+    }
+
+    int fd = safe_open_create_perms("sparse_file", O_WRONLY | O_CREAT | O_TRUNC,
+                                    0600);
+    assert_true(fd >= 0);
+    assert_int_equal(FullWrite(fd, data, data_size), data_size);
+    assert_true(lseek(fd, hole_size, SEEK_CUR) != (off_t) -1);
+    assert_int_equal(FullWrite(fd, data, data_size), data_size);
+    const off_t total_size = 2 * data_size + 2 * hole_size;
+    assert_int_equal(ftruncate(fd, total_size), 0);
+    assert_int_equal(close(fd), 0);
+
+    assert_true(File_Copy("sparse_file", "new_sparse_file"));
+
+    struct stat sb;
+    assert_int_equal(stat("new_sparse_file", &sb), 0);
+    assert_int_equal(sb.st_size, total_size);
+
+    fd = safe_open("new_sparse_file", O_RDONLY);
+    assert_true(fd >= 0);
+    char *copied = xmalloc(total_size);
+    assert_int_equal(FullRead(fd, copied, total_size), total_size);
+    close(fd);
+
+    assert_memory_equal(copied, data, data_size);
+    assert_true(memcchr(copied + data_size, '\0', hole_size) == NULL);
+    assert_memory_equal(copied + data_size + hole_size, data, data_size);
+    assert_true(memcchr(copied + 2 * data_size + hole_size, '\0', hole_size) == NULL);
+
+    /* The fallback used on platforms without the smart syscalls. */
+    int sd = safe_open("sparse_file", O_RDONLY);
+    assert_true(sd >= 0);
+    int dd = safe_open_create_perms("shoveled_file", O_WRONLY | O_CREAT | O_TRUNC,
+                                    0600);
+    assert_true(dd >= 0);
+    size_t n_written = 0;
+    bool last_hole = false;
+    assert_true(FileSparseCopyShoveling(sd, "sparse_file", dd, "shoveled_file",
+                                        4096, &n_written, &last_hole));
+    assert_int_equal(n_written, total_size);
+    assert_true(last_hole);
+    close(sd);
+    /* FileSparseClose() may rely on smart syscalls, do what the fallback
+     * one does */
+    assert_int_equal(FullWrite(dd, "", 1), 1);
+    assert_int_equal(ftruncate(dd, n_written), 0);
+    assert_int_equal(close(dd), 0);
+
+    fd = safe_open("shoveled_file", O_RDONLY);
+    assert_true(fd >= 0);
+    memset(copied, 'x', total_size);
+    assert_int_equal(FullRead(fd, copied, total_size), total_size);
+    close(fd);
+    assert_memory_equal(copied, data, data_size);
+    assert_true(memcchr(copied + data_size, '\0', hole_size) == NULL);
+    assert_memory_equal(copied + data_size + hole_size, data, data_size);
+    assert_true(memcchr(copied + 2 * data_size + hole_size, '\0', hole_size) == NULL);
+
+    free(copied);
+    free(data);
+    assert_int_equal(unlink("sparse_file"), 0);
+    assert_int_equal(unlink("new_sparse_file"), 0);
+    assert_int_equal(unlink("shoveled_file"), 0);
+
+    return_to_test_dir();
+}
+
+static void test_file_copy_pseudo_file(void)
+{
+#ifdef __linux__
+    setup_tempfiles();
+
+    /* Files in /proc report size 0 and no blocks, but do have contents */
+    assert_true(File_Copy("/proc/self/status", "status_copy"));
+
+    int fd = safe_open("status_copy", O_RDONLY);
+    assert_true(fd >= 0);
+    char buf[64];
+    const ssize_t n_read = FullRead(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    assert_true(n_read > 5);
+    buf[n_read] = '\0';
+    assert_true(StringStartsWith(buf, "Name:"));
+
+    assert_int_equal(unlink("status_copy"), 0);
+
+    /* A regular empty file is still copied as empty */
+    fd = safe_open_create_perms("empty_file", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_true(fd >= 0);
+    close(fd);
+    assert_true(File_Copy("empty_file", "empty_copy"));
+    struct stat sb;
+    assert_int_equal(stat("empty_copy", &sb), 0);
+    assert_int_equal(sb.st_size, 0);
+    assert_int_equal(unlink("empty_file"), 0);
+    assert_int_equal(unlink("empty_copy"), 0);
+
+    /* And a file that is all hole keeps its size */
+    fd = safe_open_create_perms("hole_file", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_true(fd >= 0);
+    assert_int_equal(ftruncate(fd, 1024 * 1024), 0);
+    close(fd);
+    assert_true(File_Copy("hole_file", "hole_copy"));
+    assert_int_equal(stat("hole_copy", &sb), 0);
+    assert_int_equal(sb.st_size, 1024 * 1024);
+    assert_int_equal(unlink("hole_file"), 0);
+    assert_int_equal(unlink("hole_copy"), 0);
+
+    return_to_test_dir();
+#endif
+}
+
+/* FileSparseCopy() into a destination with old, longer contents must not
+ * leave them at the end */
+static void CheckSparseCopyOverLonger(const char *src_path)
+{
+    char old_contents[8192];
+    memset(old_contents, 'x', sizeof(old_contents));
+    int dd = safe_open_create_perms("longer_copy", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_true(dd >= 0);
+    assert_int_equal(FullWrite(dd, old_contents, sizeof(old_contents)),
+                     sizeof(old_contents));
+    close(dd);
+
+    int sd = safe_open(src_path, O_RDONLY);
+    assert_true(sd >= 0);
+    dd = safe_open("longer_copy", O_WRONLY);
+    assert_true(dd >= 0);
+    size_t total = 0;
+    bool hole = false;
+    assert_true(FileSparseCopy(sd, src_path, dd, "longer_copy", 4096, &total, &hole));
+    assert_true(FileSparseClose(dd, "longer_copy", false, total, hole));
+    close(sd);
+
+    assert_true(total > 0);
+    assert_true(total < sizeof(old_contents));
+    struct stat sb;
+    assert_int_equal(stat("longer_copy", &sb), 0);
+    assert_int_equal(sb.st_size, total);
+    assert_int_equal(unlink("longer_copy"), 0);
+}
+
+static void test_file_sparse_copy_over_longer(void)
+{
+    setup_tempfiles();
+
+    CheckSparseCopyOverLonger(TEST_FILE);
+#ifdef __linux__
+    CheckSparseCopyOverLonger("/proc/self/status");
+#endif
+
+    return_to_test_dir();
+}
+
 static void test_file_copy_to_dir(void)
 {
     setup_tempfiles();
@@ -1620,6 +1786,195 @@ static void test_file_read(void)
     return_to_test_dir();
 }
 
+static void test_file_read_buffer(void)
+{
+    setup_tempfiles();
+
+    {
+        bool truncated = true;
+        Buffer *buf = FileReadBuffer(TEST_FILE, 1024, &truncated);
+        assert_true(buf != NULL);
+        assert_false(truncated);
+        assert_int_equal(BufferSize(buf), strlen(TEST_STRING));
+        assert_string_equal(BufferData(buf), TEST_STRING);
+        BufferDestroy(buf);
+    }
+
+    {
+        bool truncated = false;
+        Buffer *buf = FileReadBuffer(TEST_FILE, 4, &truncated);
+        assert_true(truncated);
+        assert_int_equal(BufferSize(buf), 4);
+        assert_string_equal(BufferData(buf), "BLUE");
+        BufferDestroy(buf);
+    }
+
+    assert_true(FileReadBuffer("no_such_file", 1024, NULL) == NULL);
+
+    /* Binary data with NUL bytes, bigger than the read chunks */
+    const size_t size = 300 * 1024 + 7;
+    char *data = xmalloc(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (char) (i % 251);
+    }
+    int fd = safe_open_create_perms("binary_file", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_true(fd >= 0);
+    assert_int_equal(FullWrite(fd, data, size), size);
+    assert_int_equal(close(fd), 0);
+
+    {
+        bool truncated = true;
+        Buffer *buf = FileReadBuffer("binary_file", size, &truncated);
+        assert_false(truncated);
+        assert_int_equal(BufferSize(buf), size);
+        /* exact size (+ the EOF detection byte and the terminating '\0') */
+        assert_int_equal(BufferCapacity(buf), size + 2);
+        assert_memory_equal(BufferData(buf), data, size);
+        BufferDestroy(buf);
+    }
+
+    /* From a non-zero offset */
+    fd = safe_open("binary_file", O_RDONLY);
+    assert_true(fd >= 0);
+    assert_int_equal(lseek(fd, 1000, SEEK_SET), 1000);
+    {
+        bool truncated = false;
+        Buffer *buf = FileReadBufferFromFd(fd, size, &truncated);
+        assert_false(truncated);
+        assert_int_equal(BufferSize(buf), size - 1000);
+        assert_memory_equal(BufferData(buf), data + 1000, size - 1000);
+        BufferDestroy(buf);
+    }
+    close(fd);
+
+    /* Unknown size (pipe) */
+    int pipe_fds[2];
+    assert_int_equal(pipe(pipe_fds), 0);
+    assert_int_equal(FullWrite(pipe_fds[1], data, 4000), 4000);
+    close(pipe_fds[1]);
+    {
+        bool truncated = false;
+        Buffer *buf = FileReadBufferFromFd(pipe_fds[0], 3000, &truncated);
+        assert_true(truncated);
+        assert_int_equal(BufferSize(buf), 3000);
+        assert_memory_equal(BufferData(buf), data, 3000);
+        BufferDestroy(buf);
+    }
+    close(pipe_fds[0]);
+
+    free(data);
+    assert_int_equal(unlink("binary_file"), 0);
+
+    return_to_test_dir();
+}
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t n_files;
+    size_t n_dirs;
+    size_t n_bad;
+    bool prune;
+} PathWalkAtTestData;
+
+static bool path_walk_at_test_cb(const char *path, const char *name, int dirfd,
+                                 bool is_dir, void *data)
+{
+    PathWalkAtTestData *counts = data;
+
+    /* name is the last component of path and is usable with dirfd */
+    struct stat sb;
+    bool bad = ((strncmp(path, TEMP_DIR "/", strlen(TEMP_DIR "/")) != 0) ||
+                (strcmp(Path_Basename(path), name) != 0) ||
+                (fstatat(dirfd, name, &sb, AT_SYMLINK_NOFOLLOW) != 0));
+
+    ThreadLock(&counts->lock);
+    if (is_dir)
+    {
+        counts->n_dirs++;
+    }
+    else
+    {
+        counts->n_files++;
+    }
+    if (bad)
+    {
+        counts->n_bad++;
+    }
+    ThreadUnlock(&counts->lock);
+
+    return !counts->prune;
+}
+
+static void test_path_walk_at(void)
+{
+    setup_tempfiles();
+    assert_int_equal(symlink(TEST_SUBDIR, TEMP_DIR "/" TEST_LINK), 0);
+
+    for (size_t n_threads = 1; n_threads <= 4; n_threads += 3)
+    {
+        PathWalkAtTestData counts = { .lock = PTHREAD_MUTEX_INITIALIZER };
+        assert_true(PathWalkAt(TEMP_DIR, path_walk_at_test_cb, &counts, 0, n_threads));
+        /* TEST_FILE, TEST_LINK, TEST_SUBDIR/TEST_FILE, TEST_SUBSUBDIR/TEST_FILE */
+        assert_int_equal(counts.n_files, 4);
+        /* TEST_SUBDIR, TEST_SUBSUBDIR */
+        assert_int_equal(counts.n_dirs, 2);
+        assert_int_equal(counts.n_bad, 0);
+
+        memset(&counts, 0, sizeof(counts));
+        pthread_mutex_init(&counts.lock, NULL);
+        assert_true(PathWalkAt(TEMP_DIR "/", path_walk_at_test_cb, &counts,
+                               PATH_WALK_FOLLOW_SYMLINKS, n_threads));
+        /* The link to TEST_SUBDIR is walked as a directory now. */
+        assert_int_equal(counts.n_files, 5);
+        assert_int_equal(counts.n_dirs, 4);
+        assert_int_equal(counts.n_bad, 0);
+
+        memset(&counts, 0, sizeof(counts));
+        pthread_mutex_init(&counts.lock, NULL);
+        counts.prune = true;
+        assert_true(PathWalkAt(TEMP_DIR, path_walk_at_test_cb, &counts, 0, n_threads));
+        assert_int_equal(counts.n_files, 2);
+        assert_int_equal(counts.n_dirs, 1);
+    }
+
+    assert_false(PathWalkAt(TEMP_DIR "/no_such_dir", path_walk_at_test_cb, NULL, 0, 1));
+
+    return_to_test_dir();
+}
+
+static void test_path_walk_at_symlink_loops(void)
+{
+    setup_tempfiles();
+    assert_int_equal(symlink(TEST_SUBDIR, TEMP_DIR "/" TEST_LINK), 0);
+    assert_int_equal(symlink(".", TEMP_DIR "/loop"), 0);
+    assert_int_equal(symlink("..", TEMP_DIR "/" TEST_SUBDIR "/up"), 0);
+
+    for (size_t n_threads = 1; n_threads <= 4; n_threads += 3)
+    {
+        PathWalkAtTestData counts = { .lock = PTHREAD_MUTEX_INITIALIZER };
+        assert_true(PathWalkAt(TEMP_DIR, path_walk_at_test_cb, &counts,
+                               PATH_WALK_FOLLOW_SYMLINKS, n_threads));
+        /* The loops are reported as directories (loop, TEST_SUBDIR/up and
+         * TEST_LINK/up), but not walked. */
+        assert_int_equal(counts.n_files, 5);
+        assert_int_equal(counts.n_dirs, 7);
+        assert_int_equal(counts.n_bad, 0);
+
+        memset(&counts, 0, sizeof(counts));
+        pthread_mutex_init(&counts.lock, NULL);
+        assert_true(PathWalkAt(TEMP_DIR, path_walk_at_test_cb, &counts, 0, n_threads));
+        assert_int_equal(counts.n_files, 6);
+        assert_int_equal(counts.n_dirs, 2);
+        assert_int_equal(counts.n_bad, 0);
+    }
+
+    unlink(TEMP_DIR "/loop");
+    unlink(TEMP_DIR "/" TEST_SUBDIR "/up");
+    return_to_test_dir();
+}
+
 static void test_read_file_stream_to_buffer(void)
 {
     setup_tempfiles();
@@ -1972,8 +2327,14 @@ int main(int argc, char **argv)
 
             unit_test(test_file_can_open),
             unit_test(test_file_copy),
+            unit_test(test_file_copy_large_sparse),
+            unit_test(test_file_copy_pseudo_file),
+            unit_test(test_file_sparse_copy_over_longer),
             unit_test(test_file_copy_to_dir),
             unit_test(test_file_read),
+            unit_test(test_file_read_buffer),
+            unit_test(test_path_walk_at),
+            unit_test(test_path_walk_at_symlink_loops),
             unit_test(test_read_file_stream_to_buffer),
             unit_test(test_full_read_write),
             unit_test(test_is_dir_real),
@@ -0,0 +1,211 @@
+#include <test.h>
+
+#include <hash_cache.h>
+#include <alloc.h>
+
+#include <sys/mman.h>                                       /* mmap */
+
+static char cache_dir[] = "/tmp/hash_cache_testXXXXXX";
+static char *cache_path = NULL;
+
+static void WriteFile(const char *path, const char *contents)
+{
+    FILE *f = fopen(path, "w");
+    assert_true(f != NULL);
+    fputs(contents, f);
+    fclose(f);
+}
+
+/* Set the times to the past so that the digest gets stored. */
+static void MakeOld(const char *path)
+{
+    struct timeval times[2] = { { .tv_sec = time(NULL) - 100 }, { .tv_sec = time(NULL) - 100 } };
+    assert_int_equal(utimes(path, times), 0);
+}
+
+static void CheckDigest(HashCache *cache, const char *path, HashMethod method)
+{
+    unsigned char expected[EVP_MAX_MD_SIZE + 1];
+    HashFile(path, expected, method, false);
+    unsigned char digest[EVP_MAX_MD_SIZE + 1];
+    assert_true(HashCacheFile(cache, path, method, digest));
+    assert_memory_equal(digest, expected, HashSizeFromId(method));
+}
+
+static void CheckStats(HashCache *cache, size_t hits, size_t misses, size_t stores)
+{
+    HashCacheStats stats;
+    HashCacheGetStats(cache, &stats);
+    assert_int_equal(stats.hits, hits);
+    assert_int_equal(stats.misses, misses);
+    assert_int_equal(stats.stores, stores);
+}
+
+static void test_hash_cache(void)
+{
+    char *file1, *file2;
+    xasprintf(&file1, "%s/file1", cache_dir);
+    xasprintf(&file2, "%s/file2", cache_dir);
+    WriteFile(file1, "some contents");
+    WriteFile(file2, "other contents");
+
+    HashCache *cache = HashCacheOpen(cache_path, 64);
+    assert_true(cache != NULL);
+
+    /* ctime is recent, hashed but not stored */
+    CheckDigest(cache, file1, HASH_METHOD_SHA256);
+    CheckDigest(cache, file1, HASH_METHOD_SHA256);
+    CheckStats(cache, 0, 2, 0);
+
+    /* wait until the ctime is old enough */
+    sleep(2);
+    CheckDigest(cache, file1, HASH_METHOD_SHA256);
+    CheckDigest(cache, file1, HASH_METHOD_SHA256);
+    CheckDigest(cache, file1, HASH_METHOD_MD5);
+    CheckDigest(cache, file1, HASH_METHOD_MD5);
+    CheckDigest(cache, file2, HASH_METHOD_SHA256);
+    CheckStats(cache, 2, 5, 3);
+
+    /* persistent, also for another process */
+    HashCacheClose(cache);
+    cache = HashCacheOpen(cache_path, 0);
+    assert_true(cache != NULL);
+    CheckDigest(cache, file1, HASH_METHOD_SHA256);
+    CheckDigest(cache, file2, HASH_METHOD_SHA256);
+    CheckStats(cache, 2, 0, 0);
+
+    /* modified, same size */
+    WriteFile(file1, "SOME CONTENTS");
+    MakeOld(file1);
+    CheckDigest(cache, file1, HASH_METHOD_SHA256);
+    CheckStats(cache, 2, 1, 0);   /* ctime is recent again */
+
+    /* Negative cases */
+    unsigned char digest[EVP_MAX_MD_SIZE + 1];
+    assert_false(HashCacheFile(cache, "/nonexistent/file", HASH_METHOD_MD5, digest));
+    assert_false(HashCacheFile(cache, file1, HASH_METHOD_CRYPT, digest));
+    HashCacheClose(cache);
+
+    /* an invalid file is reinitialized, without truncating it under
+     * somebody who has it mapped */
+    WriteFile(cache_path, "garbage");
+    struct stat old_sb;
+    assert_int_equal(stat(cache_path, &old_sb), 0);
+    int old_fd = open(cache_path, O_RDONLY);
+    assert_true(old_fd >= 0);
+    char *old_map = mmap(NULL, old_sb.st_size, PROT_READ, MAP_SHARED, old_fd, 0);
+    assert_true(old_map != MAP_FAILED);
+
+    cache = HashCacheOpen(cache_path, 16);
+    assert_true(cache != NULL);
+    assert_memory_equal(old_map, "garbage", 7);
+    struct stat new_sb;
+    assert_int_equal(stat(cache_path, &new_sb), 0);
+    assert_true(new_sb.st_ino != old_sb.st_ino);
+    munmap(old_map, old_sb.st_size);
+    close(old_fd);
+    CheckDigest(cache, file2, HASH_METHOD_SHA256);
+    CheckStats(cache, 0, 1, 1);
+    HashCacheClose(cache);
+
+    unlink(file1);
+    unlink(file2);
+    free(file1);
+    free(file2);
+}
+
+static void test_hash_cache_full(void)
+{
+    /* many more files than entries, the cache must stay correct */
+    unlink(cache_path);
+    HashCache *cache = HashCacheOpen(cache_path, 4);
+    assert_true(cache != NULL);
+
+    char *files[40];
+    for (size_t i = 0; i < 40; i++)
+    {
+        xasprintf(&files[i], "%s/many%zu", cache_dir, i);
+        char contents[32];
+        snprintf(contents, sizeof(contents), "file number %zu", i);
+        WriteFile(files[i], contents);
+    }
+    sleep(2);
+    for (int round = 0; round < 3; round++)
+    {
+        for (size_t i = 0; i < 40; i++)
+        {
+            CheckDigest(cache, files[i], HASH_METHOD_MD5);
+        }
+    }
+    HashCacheStats stats;
+    HashCacheGetStats(cache, &stats);
+    assert_int_equal(stats.hits + stats.misses, 120);
+
+    HashCacheClose(cache);
+    for (size_t i = 0; i < 40; i++)
+    {
+        unlink(files[i]);
+        free(files[i]);
+    }
+}
+
+static void *OpenThread(void *arg)
+{
+    HashCache **cache = arg;
+    *cache = HashCacheOpen(cache_path, 16);
+    return NULL;
+}
+
+static void test_hash_cache_open_threads(void)
+{
+    /* threads replacing the same invalid file at the same time */
+    for (int round = 0; round < 20; round++)
+    {
+        WriteFile(cache_path, "garbage");
+
+        pthread_t threads[8];
+        HashCache *caches[8];
+        for (size_t i = 0; i < 8; i++)
+        {
+            assert_int_equal(pthread_create(&threads[i], NULL, OpenThread, &caches[i]), 0);
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            assert_int_equal(pthread_join(threads[i], NULL), 0);
+        }
+        for (size_t i = 0; i < 8; i++)
+        {
+            assert_true(caches[i] != NULL);
+            HashCacheClose(caches[i]);
+        }
+
+        /* no temporary file left behind */
+        char *tmp_path;
+        xasprintf(&tmp_path, "%s.%ju.tmp", cache_path, (uintmax_t) getpid());
+        assert_int_equal(access(tmp_path, F_OK), -1);
+        free(tmp_path);
+    }
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    if (mkdtemp(cache_dir) == NULL)
+    {
+        return 1;
+    }
+    xasprintf(&cache_path, "%s/cache", cache_dir);
+
+    const UnitTest tests[] =
+    {
+        unit_test(test_hash_cache),
+        unit_test(test_hash_cache_full),
+        unit_test(test_hash_cache_open_threads),
+    };
+    const int ret = run_tests(tests);
+
+    unlink(cache_path);
+    free(cache_path);
+    rmdir(cache_dir);
+    return ret;
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <string_lib.h>
 #include <hash.h>
+#include <alloc.h>
 #include <openssl/rsa.h>
 #include <openssl/evp.h>
 #include <openssl/bn.h>
@@ -263,6 +264,161 @@ static void test_StringCopyTruncateAndHashIfNecessary(void)
     assert_true(StringEqual(buf, "#MD5=9e107d9d372bb6826bd81d3542a419d6"));
 }
 
+static void *GetCachedContextThread(void *arg)
+{
+    return HashContextGetCached(*(HashMethod *) arg);
+}
+
+static void test_HashContext(void)
+{
+    HashContext *context = HashContextNew(HASH_METHOD_SHA256);
+    assert_true(context != NULL);
+    assert_int_equal(HashContextMethod(context), HASH_METHOD_SHA256);
+
+    /* same digest when hashed in pieces, repeatedly */
+    Hash *expected = HashNew(message, message_length, HASH_METHOD_SHA256);
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < message_length; i += 5)
+        {
+            assert_true(HashContextUpdate(context, message + i, MIN(5, message_length - i)));
+        }
+        Hash *hash = HashContextFinalHash(context);
+        assert_true(HashEqual(hash, expected));
+        HashDestroy(&hash);
+    }
+
+    /* reset discards the data */
+    assert_true(HashContextUpdate(context, "garbage", 7));
+    HashContextReset(context);
+    assert_true(HashContextUpdate(context, message, message_length));
+    unsigned char digest[EVP_MAX_MD_SIZE + 1];
+    assert_int_equal(HashContextFinal(context, digest), CF_SHA256_LEN);
+    unsigned int length;
+    assert_memory_equal(digest, HashData(expected, &length), CF_SHA256_LEN);
+    HashDestroy(&expected);
+    HashContextDestroy(context);
+
+    /* cached per thread */
+    HashMethod method = HASH_METHOD_MD5;
+    HashContext *cached = HashContextGetCached(method);
+    assert_true(cached != NULL);
+    assert_true(HashContextGetCached(method) == cached);
+    assert_true(HashContextGetCached(HASH_METHOD_SHA1) != cached);
+    pthread_t thread;
+    void *other = NULL;
+    assert_int_equal(pthread_create(&thread, NULL, GetCachedContextThread, &method), 0);
+    pthread_join(thread, &other);
+    assert_true(other != NULL && other != cached);
+
+    /* kept across HashString() */
+    assert_true(HashContextUpdate(cached, message, 4));
+    HashString(message, message_length, digest, HASH_METHOD_MD5);
+    assert_true(HashContextUpdate(cached, message + 4, message_length - 4));
+    unsigned char cached_digest[EVP_MAX_MD_SIZE + 1];
+    assert_int_equal(HashContextFinal(cached, cached_digest), CF_MD5_LEN);
+    assert_memory_equal(digest, cached_digest, CF_MD5_LEN);
+
+    /* Negative cases */
+    assert_true(HashContextNew(HASH_METHOD_NONE) == NULL);
+    assert_true(HashContextNew(HASH_METHOD_CRYPT) == NULL);
+    assert_true(HashContextGetCached(HASH_METHOD_NONE) == NULL);
+}
+
+static void test_HashFileMulti(void)
+{
+    /* bigger than the read buffer */
+    const size_t size = 300 * 1024 + 17;
+    char *data = xmalloc(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (char) (i * 31 + (i >> 10));
+    }
+
+    char path[] = "/tmp/hash_multiXXXXXX";
+    int tmp_fd = mkstemp(path);
+    assert_true(tmp_fd >= 0);
+    assert_int_equal(write(tmp_fd, data, size), size);
+    close(tmp_fd);
+
+    const HashMethod methods[] = { HASH_METHOD_SHA256, HASH_METHOD_MD5, HASH_METHOD_SHA256 };
+    HashFileDigests digests;
+    assert_true(HashFileMulti(path, methods, 3, &digests));
+
+    for (size_t i = 0; i < HASH_METHOD_NONE; i++)
+    {
+        if (i != HASH_METHOD_MD5 && i != HASH_METHOD_SHA256)
+        {
+            assert_true(digests.hashes[i] == NULL);
+            continue;
+        }
+        Hash *expected = HashNew(data, size, i);
+        assert_true(HashEqual(digests.hashes[i], expected));
+        assert_string_equal(HashPrintable(digests.hashes[i]), HashPrintable(expected));
+        HashDestroy(&expected);
+        HashDestroy(&digests.hashes[i]);
+    }
+
+    /* Negative cases */
+    const HashMethod crypt = HASH_METHOD_CRYPT;
+    assert_false(HashFileMulti(path, &crypt, 1, &digests));
+    assert_false(HashFileMulti("/nonexistent/file", methods, 2, &digests));
+
+    unlink(path);
+    free(data);
+}
+
+static void test_HashFilesBatch(void)
+{
+    char paths[20][32];
+    const char *filenames[21];
+    for (size_t i = 0; i < 20; i++)
+    {
+        strcpy(paths[i], "/tmp/hash_batchXXXXXX");
+        int tmp_fd = mkstemp(paths[i]);
+        assert_true(tmp_fd >= 0);
+        for (size_t j = 0; j < i * 1000; j++)
+        {
+            assert_int_equal(write(tmp_fd, message, message_length), message_length);
+        }
+        close(tmp_fd);
+        filenames[i] = paths[i];
+    }
+    filenames[20] = "/nonexistent/file";
+
+    const HashMethod methods[] = { HASH_METHOD_MD5, HASH_METHOD_SHA1 };
+    for (size_t n_threads = 0; n_threads <= 4; n_threads += 2)
+    {
+        HashFileDigestsMap *results = HashFilesBatch(filenames, 21, methods, 2, n_threads);
+        assert_int_equal(HashFileDigestsMapSize(results), 20);
+        for (size_t i = 0; i < 20; i++)
+        {
+            HashFileDigests *digests = HashFileDigestsMapGet(results, paths[i]);
+            assert_true(digests != NULL);
+
+            unsigned char md5[EVP_MAX_MD_SIZE + 1];
+            HashFile(paths[i], md5, HASH_METHOD_MD5, false);
+            unsigned int length;
+            const unsigned char *data = HashData(digests->hashes[HASH_METHOD_MD5], &length);
+            assert_int_equal(length, CF_MD5_LEN);
+            assert_memory_equal(data, md5, CF_MD5_LEN);
+
+            unsigned char sha1[EVP_MAX_MD_SIZE + 1];
+            HashFile(paths[i], sha1, HASH_METHOD_SHA1, false);
+            data = HashData(digests->hashes[HASH_METHOD_SHA1], &length);
+            assert_int_equal(length, CF_SHA1_LEN);
+            assert_memory_equal(data, sha1, CF_SHA1_LEN);
+        }
+        assert_false(HashFileDigestsMapHasKey(results, "/nonexistent/file"));
+        HashFileDigestsMapDestroy(results);
+    }
+
+    for (size_t i = 0; i < 20; i++)
+    {
+        unlink(paths[i]);
+    }
+}
+
 /*
  * Main routine
  * Notice the calls to both setup and teardown.
@@ -279,6 +435,9 @@ int main()
         unit_test(test_HashCopy),
         unit_test(test_HashesMatch),
         unit_test(test_StringCopyTruncateAndHashIfNecessary),
+        unit_test(test_HashContext),
+        unit_test(test_HashFileMulti),
+        unit_test(test_HashFilesBatch),
     };
     int result = run_tests(tests);
     tests_teardown();
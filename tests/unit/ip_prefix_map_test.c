@@ -0,0 +1,222 @@
+#include <test.h>
+
+#include <ip_prefix_map.h>
+#include <alloc.h>
+
+#define N_RANDOM_PREFIXES 2000
+#define N_RANDOM_LOOKUPS 20000
+
+static IPAddressPrefix ParsePrefix(const char *str)
+{
+    IPAddressPrefix prefix;
+    assert_true(IPAddressPrefixParse(str, strlen(str), &prefix));
+    return prefix;
+}
+
+static const char *LookupStr(const IPPrefixMap *map, const char *address_str)
+{
+    IPAddressValue address;
+    assert_true(IPAddressValueParse(address_str, strlen(address_str), &address, NULL));
+    return IPPrefixMapGet(map, &address);
+}
+
+static void test_lookup(void)
+{
+    const char *const networks[] = {
+        "10.0.0.0/8", "10.1.0.0/16", "10.1.2.0/24", "10.1.2.3",
+        "192.168.0.0/16", "2001:db8::/32", "2001:db8:1::/48", "::1",
+    };
+    const size_t n_networks = sizeof(networks) / sizeof(networks[0]);
+
+    IPAddressPrefix prefixes[sizeof(networks) / sizeof(networks[0])];
+    for (size_t i = 0; i < n_networks; i++)
+    {
+        prefixes[i] = ParsePrefix(networks[i]);
+    }
+
+    for (int bulk = 0; bulk < 2; bulk++)
+    {
+        IPPrefixMap *map;
+        if (bulk)
+        {
+            map = IPPrefixMapNewFromPrefixes(prefixes, (void *const *) networks,
+                                             n_networks, NULL);
+        }
+        else
+        {
+            map = IPPrefixMapNew(NULL);
+            for (size_t i = 0; i < n_networks; i++)
+            {
+                assert_false(IPPrefixMapInsert(map, &prefixes[i], (void *) networks[i]));
+            }
+        }
+        assert_int_equal(IPPrefixMapSize(map), n_networks);
+
+        assert_string_equal(LookupStr(map, "10.200.0.1"), "10.0.0.0/8");
+        assert_string_equal(LookupStr(map, "10.1.200.1"), "10.1.0.0/16");
+        assert_string_equal(LookupStr(map, "10.1.2.4"), "10.1.2.0/24");
+        assert_string_equal(LookupStr(map, "10.1.2.3"), "10.1.2.3");
+        assert_string_equal(LookupStr(map, "192.168.255.255"), "192.168.0.0/16");
+        assert_string_equal(LookupStr(map, "2001:db8:2::1"), "2001:db8::/32");
+        assert_string_equal(LookupStr(map, "2001:db8:1:2::1"), "2001:db8:1::/48");
+        assert_string_equal(LookupStr(map, "::1"), "::1");
+        assert_true(LookupStr(map, "11.0.0.0") == NULL);
+        assert_true(LookupStr(map, "9.255.255.255") == NULL);
+        assert_true(LookupStr(map, "::2") == NULL);
+        assert_true(LookupStr(map, "2001:db9::") == NULL);
+
+        IPAddressValue address;
+        IPAddressPrefix matched;
+        void *value;
+        IPAddressValueFromIPv4(0x0a010505, &address);
+        assert_true(IPPrefixMapLookup(map, &address, &matched, &value));
+        assert_true(IPAddressValueEqual(&matched.address, &prefixes[1].address));
+        assert_int_equal(matched.length, prefixes[1].length);
+        IPAddressValueFromIPv4(0x0b000000, &address);
+        assert_false(IPPrefixMapLookup(map, &address, &matched, &value));
+
+        /* A default route matches everything else */
+        const IPAddressPrefix any = ParsePrefix("::/0");
+        assert_false(IPPrefixMapInsert(map, &any, "default"));
+        assert_string_equal(LookupStr(map, "11.0.0.0"), "default");
+        assert_string_equal(LookupStr(map, "10.1.2.3"), "10.1.2.3");
+
+        /* Replacing a value */
+        assert_true(IPPrefixMapInsert(map, &prefixes[0], "replaced"));
+        assert_string_equal(LookupStr(map, "10.200.0.1"), "replaced");
+        assert_int_equal(IPPrefixMapSize(map), n_networks + 1);
+
+        IPPrefixMapDestroy(map);
+    }
+}
+
+static void test_destroy_values(void)
+{
+    IPAddressPrefix prefixes[3] = {
+        ParsePrefix("10.0.0.0/8"), ParsePrefix("10.0.0.0/8"), ParsePrefix("::/0"),
+    };
+    void *values[3] = { xstrdup("a"), xstrdup("b"), xstrdup("c") };
+
+    /* The duplicate's value is freed, valgrind/ASAN would catch leaks */
+    IPPrefixMap *map = IPPrefixMapNewFromPrefixes(prefixes, values, 3, free);
+    assert_int_equal(IPPrefixMapSize(map), 2);
+    assert_string_equal(LookupStr(map, "10.0.0.1"), "b");
+    assert_true(IPPrefixMapInsert(map, &prefixes[2], xstrdup("d")));
+    assert_string_equal(LookupStr(map, "11.0.0.1"), "d");
+    IPPrefixMapDestroy(map);
+}
+
+static void RandomPrefix(IPAddressPrefix *prefix)
+{
+    /* Few distinct top bits, so that prefixes nest and share paths */
+    IPAddressValue address;
+    for (int i = 0; i < 16; i++)
+    {
+        address.bytes[i] = rand();
+    }
+    address.bytes[0] &= 0x21;
+    address.bytes[1] &= 0x03;
+
+    if (rand() % 2)
+    {
+        IPAddressValueFromIPv4(((uint32_t) (rand() % 4) << 30) | (rand() & 0x3fffffff),
+                               &address);
+        IPAddressPrefixMake(&address, 96 + rand() % 33, prefix);
+    }
+    else
+    {
+        IPAddressPrefixMake(&address, rand() % 129, prefix);
+    }
+}
+
+static void RandomAddressNear(const IPAddressPrefix *prefix, IPAddressValue *address)
+{
+    *address = prefix->address;
+    const int n_flips = rand() % 3;
+    for (int i = 0; i < n_flips; i++)
+    {
+        const int bit = rand() % 128;
+        address->bytes[bit / 8] ^= 0x80 >> (bit % 8);
+    }
+}
+
+static const IPAddressPrefix *LinearLookup(const IPAddressPrefix *prefixes, size_t n,
+                                           const IPAddressValue *address)
+{
+    /* Last one wins for duplicates, as in the map */
+    const IPAddressPrefix *best = NULL;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (IPAddressPrefixContains(&prefixes[i], address) &&
+            (best == NULL || prefixes[i].length >= best->length))
+        {
+            best = &prefixes[i];
+        }
+    }
+    return best;
+}
+
+static void test_random(void)
+{
+    srand(1);
+    IPAddressPrefix *prefixes = xmalloc(N_RANDOM_PREFIXES * sizeof(IPAddressPrefix));
+    for (size_t i = 0; i < N_RANDOM_PREFIXES; i++)
+    {
+        RandomPrefix(&prefixes[i]);
+    }
+    /* Some duplicates */
+    for (size_t i = 0; i < N_RANDOM_PREFIXES / 20; i++)
+    {
+        prefixes[rand() % N_RANDOM_PREFIXES] = prefixes[rand() % N_RANDOM_PREFIXES];
+    }
+
+    void **values = xmalloc(N_RANDOM_PREFIXES * sizeof(void *));
+    for (size_t i = 0; i < N_RANDOM_PREFIXES; i++)
+    {
+        values[i] = &prefixes[i];
+    }
+
+    IPPrefixMap *bulk = IPPrefixMapNewFromPrefixes(prefixes, values, N_RANDOM_PREFIXES, NULL);
+    IPPrefixMap *inserted = IPPrefixMapNew(NULL);
+    for (size_t i = 0; i < N_RANDOM_PREFIXES; i++)
+    {
+        IPPrefixMapInsert(inserted, &prefixes[i], values[i]);
+    }
+    assert_int_equal(IPPrefixMapSize(bulk), IPPrefixMapSize(inserted));
+
+    for (size_t i = 0; i < N_RANDOM_LOOKUPS; i++)
+    {
+        IPAddressValue address;
+        RandomAddressNear(&prefixes[rand() % N_RANDOM_PREFIXES], &address);
+
+        const IPAddressPrefix *expected = LinearLookup(prefixes, N_RANDOM_PREFIXES, &address);
+        assert_true(IPPrefixMapGet(bulk, &address) == expected);
+        assert_true(IPPrefixMapGet(inserted, &address) == expected);
+
+        if (expected != NULL)
+        {
+            IPAddressPrefix matched;
+            assert_true(IPPrefixMapLookup(bulk, &address, &matched, NULL));
+            assert_true(IPAddressValueEqual(&matched.address, &expected->address));
+            assert_int_equal(matched.length, expected->length);
+        }
+    }
+
+    IPPrefixMapDestroy(bulk);
+    IPPrefixMapDestroy(inserted);
+    free(values);
+    free(prefixes);
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_lookup),
+        unit_test(test_destroy_values),
+        unit_test(test_random),
+    };
+
+    return run_tests(tests);
+}
@@ -677,7 +677,6 @@ static void test_isipaddress(void)
 
 static void test_string_is_local_host_ip(void)
 {
-#ifdef WITH_PCRE2
     // Test IPv6
     assert_true(StringIsLocalHostIP("0:0:0:0:0:0:0:1"));
     assert_true(StringIsLocalHostIP("0:0:0:0:0:0::1"));
@@ -713,6 +712,7 @@ static void test_string_is_local_host_ip(void)
     assert_true(StringIsLocalHostIP("0:00:0::0000:00:00:0001"));
     assert_true(StringIsLocalHostIP("::0:00:00:00:1"));
     assert_true(StringIsLocalHostIP("::0000000001"));
+    assert_true(StringIsLocalHostIP("0000000000000000000000000000000000000000000000000000000000::1"));
 
     assert_false(StringIsLocalHostIP("0:0:1:0:0:0:0:1"));
     assert_false(StringIsLocalHostIP("ff:0:0:0:0::0:1"));
@@ -727,6 +727,8 @@ static void test_string_is_local_host_ip(void)
     assert_false(StringIsLocalHostIP("0;0;0;;1"));
     assert_false(StringIsLocalHostIP("0: :0:0:0:0:1"));
     assert_false(StringIsLocalHostIP("0:0:0:0:0:1"));
+    assert_false(StringIsLocalHostIP("::00010"));
+    assert_false(StringIsLocalHostIP("::0:"));
 
     // Test IPv4
     assert_true(StringIsLocalHostIP("127.0.0.0"));
@@ -750,9 +752,203 @@ static void test_string_is_local_host_ip(void)
     assert_false(StringIsLocalHostIP("localhost"));
     assert_false(StringIsLocalHostIP(""));
     assert_false(StringIsLocalHostIP(" "));
-#endif
 }
 
+static void check_value(const char *str, const char *expected, int expected_port)
+{
+    IPAddressValue value;
+    int port;
+    char buf[IP_ADDRESS_VALUE_BUFSIZE];
+
+    assert_true(IPAddressValueParse(str, strlen(str), &value, &port));
+    assert_int_equal(port, expected_port);
+    assert_int_equal(IPAddressValueFormat(&value, buf), strlen(expected));
+    assert_string_equal(buf, expected);
+
+    /* The canonical form parses back to the same value */
+    IPAddressValue again;
+    assert_true(IPAddressValueParse(buf, strlen(buf), &again, NULL));
+    assert_true(IPAddressValueEqual(&value, &again));
+}
+
+static void test_ip_address_value(void)
+{
+    check_value("0.0.0.0", "0.0.0.0", -1);
+    check_value("255.255.255.255", "255.255.255.255", -1);
+    check_value("10.0.0.10:5308", "10.0.0.10", 5308);
+    check_value("192.168.056.001", "192.168.56.1", -1);
+    check_value("::", "::", -1);
+    check_value("::1", "::1", -1);
+    check_value("1::", "1::", -1);
+    check_value("0:0:0:0:0:0:0:1", "::1", -1);
+    check_value("2001:DB8:0:0:1:0:0:1", "2001:db8::1:0:0:1", -1);
+    check_value("2001:db8:0:1:1:1:1:1", "2001:db8:0:1:1:1:1:1", -1);
+    check_value("2001:0db8:0000:0000:0000:ff00:0042:8329", "2001:db8::ff00:42:8329", -1);
+    check_value("0000:0000::0001", "::1", -1);
+    check_value("a:b:c:d::1", "a:b:c:d::1", -1);
+    check_value("[fe80::1]", "fe80::1", -1);
+    check_value("[fe80::1]:443", "fe80::1", 443);
+    check_value("::ffff:1.2.3.4", "1.2.3.4", -1);
+    check_value("::ffff:0102:0304", "1.2.3.4", -1);
+    check_value("64:ff9b::192.0.2.33", "64:ff9b::c000:221", -1);
+
+    const char *const invalid[] = {
+        "", "0", "0.1.2", "1.1.1.260", "1.1.1.1:", "2.3.4.5:65536",
+        "1.2.3.4.5", "a.b.c.d", " 1.2.3.4", "1.2.3.4 ", "1.2.3.4:1a",
+        ":", ":::", "1:2", "1:2:3:4:5:6:7", "1:2:3:4:5:6:7:8:9",
+        "1:2:3:4:5:6:7:8::", "1::2::3", "12345::", "1:", ":1", "1:::2",
+        "g::", "::1.2.3", "::1.2.3.4:5", "::1.2.3.4.5", "[::1", "[::1]:",
+        "[::1]x", "[1.2.3.4]", "::ffff:1.2.3.256",
+        /* more than 4 hex digits in a group */
+        "00000001::", "0000ffff::1", "1:2:3:4:5:6:7:00008", "::00001",
+        "[00000::1]:80",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        IPAddressValue value;
+        int port;
+        assert_false(IPAddressValueParse(invalid[i], strlen(invalid[i]), &value, &port));
+    }
+
+    /* Without port_out, a port is an error */
+    IPAddressValue value;
+    assert_false(IPAddressValueParse("1.2.3.4:80", 10, &value, NULL));
+    assert_false(IPAddressValueParse("[::1]:80", 8, &value, NULL));
+
+    /* Only the given slice is parsed */
+    assert_true(IPAddressValueParse("10.1.2.3/24", 8, &value, NULL));
+    assert_true(IPAddressValueIsIPv4(&value));
+    assert_int_equal(IPAddressValueGetIPv4(&value), 0x0a010203);
+
+    IPAddressValue a, b;
+    IPAddressValueFromIPv4(0x7f000001, &a);
+    assert_true(IPAddressValueParse("127.0.0.1", 9, &b, NULL));
+    assert_true(IPAddressValueEqual(&a, &b));
+    assert_int_equal(IPAddressValueHash(&a, 0), IPAddressValueHash(&b, 0));
+    assert_int_equal(IPAddressValueCompare(&a, &b), 0);
+    IPAddressValueFromIPv4(0x7f000002, &b);
+    assert_true(IPAddressValueCompare(&a, &b) < 0);
+    assert_true(IPAddressValueHash(&a, 0) != IPAddressValueHash(&b, 0));
+    assert_true(IPAddressValueParse("::1", 3, &b, NULL));
+    assert_false(IPAddressValueIsIPv4(&b));
+    assert_true(IPAddressValueCompare(&a, &b) > 0);
+
+    /* Same value as through the IPAddress objects */
+    const char *const legacy[] = { "1.2.3.4", "10.0.0.1:80", "a:b:c:d::1",
+                                   "[a:b:c:d:e:f:0:1]:8080" };
+    for (size_t i = 0; i < sizeof(legacy) / sizeof(legacy[0]); i++)
+    {
+        Buffer *buffer = BufferNewFrom(legacy[i], strlen(legacy[i]));
+        IPAddress *address = IPAddressNew(buffer);
+        assert_true(address != NULL);
+        int port;
+        assert_true(IPAddressGetValue(address, &a));
+        assert_true(IPAddressValueParse(legacy[i], strlen(legacy[i]), &b, &port));
+        assert_true(IPAddressValueEqual(&a, &b));
+        assert_int_equal(port == -1 ? 0 : port, IPAddressGetPort(address));
+        IPAddressDestroy(&address);
+        BufferDestroy(buffer);
+    }
+}
+
+static void check_prefix(const char *str, const char *expected)
+{
+    IPAddressPrefix prefix;
+    char buf[IP_ADDRESS_PREFIX_BUFSIZE];
+
+    assert_true(IPAddressPrefixParse(str, strlen(str), &prefix));
+    assert_int_equal(IPAddressPrefixFormat(&prefix, buf), strlen(expected));
+    assert_string_equal(buf, expected);
+}
+
+static void test_ip_address_prefix(void)
+{
+    check_prefix("10.0.0.0/8", "10.0.0.0/8");
+    check_prefix("10.1.2.3/8", "10.0.0.0/8");
+    check_prefix("192.168.1.1", "192.168.1.1/32");
+    check_prefix("0.0.0.0/0", "0.0.0.0/0");
+    check_prefix("172.31.255.255/12", "172.16.0.0/12");
+    check_prefix("2001:db8::/32", "2001:db8::/32");
+    check_prefix("2001:db8:ffff::1/31", "2001:db8::/31");
+    check_prefix("::/0", "::/0");
+    check_prefix("::1", "::1/128");
+    check_prefix("::ffff:10.0.0.0/104", "10.0.0.0/8");
+    check_prefix("fe80::1/10", "fe80::/10");
+
+    const char *const invalid[] = {
+        "", "/8", "10.0.0.0/", "10.0.0.0/33", "10.0.0.0/-1", "10.0.0.0/8/8",
+        "10.0.0.0:80/8", "::/129", "::/1000", "[::1]/128", "::/a", "10.0.0/8",
+        "02001:db8::/32", "::00001/128",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        IPAddressPrefix prefix;
+        assert_false(IPAddressPrefixParse(invalid[i], strlen(invalid[i]), &prefix));
+    }
+
+    IPAddressPrefix prefix;
+    IPAddressValue address;
+    assert_true(IPAddressPrefixParse("172.16.0.0/12", 13, &prefix));
+    assert_int_equal(prefix.length, 96 + 12);
+    IPAddressValueFromIPv4(0xac100000, &address);
+    assert_true(IPAddressPrefixContains(&prefix, &address));
+    IPAddressValueFromIPv4(0xac1fffff, &address);
+    assert_true(IPAddressPrefixContains(&prefix, &address));
+    IPAddressValueFromIPv4(0xac200000, &address);
+    assert_false(IPAddressPrefixContains(&prefix, &address));
+    IPAddressValueFromIPv4(0xac0fffff, &address);
+    assert_false(IPAddressPrefixContains(&prefix, &address));
+
+    assert_true(IPAddressPrefixParse("::/0", 4, &prefix));
+    assert_true(IPAddressPrefixContains(&prefix, &address));
+
+    /* Making a prefix clears the bits past its length */
+    IPAddressPrefix made;
+    IPAddressPrefixMake(&address, 96 + 12, &made);
+    IPAddressValueFromIPv4(0xac000000, &address);
+    assert_true(IPAddressValueEqual(&made.address, &address));
+    IPAddressPrefixMake(&address, 128, &made);
+    assert_true(IPAddressValueEqual(&made.address, &address));
+}
+
+#ifndef __MINGW32__
+static void test_ip_address_value_inet(void)
+{
+    /* Compare with inet_pton()/inet_ntop() on random addresses with runs
+     * of zeros in random places. */
+    srand(1);
+    for (int i = 0; i < 20000; i++)
+    {
+        IPAddressValue value;
+        for (int j = 0; j < 16; j++)
+        {
+            value.bytes[j] = rand() % 4 == 0 ? rand() : 0;
+        }
+        char buf[IP_ADDRESS_VALUE_BUFSIZE];
+        char expected[INET6_ADDRSTRLEN];
+        IPAddressValueFormat(&value, buf);
+
+        /* inet_ntop() also uses the deprecated ::a.b.c.d form for
+         * IPv4-compatible addresses, skip those. */
+        static const uint8_t zeros[12] = { 0 };
+        if (!IPAddressValueIsIPv4(&value) && memcmp(value.bytes, zeros, 12) != 0)
+        {
+            assert_true(inet_ntop(AF_INET6, value.bytes, expected, sizeof(expected)) != NULL);
+            assert_string_equal(buf, expected);
+        }
+
+        IPAddressValue parsed;
+        assert_true(IPAddressValueParse(buf, strlen(buf), &parsed, NULL));
+        assert_true(IPAddressValueEqual(&parsed, &value));
+
+        uint8_t bytes[16];
+        assert_int_equal(inet_pton(strchr(buf, ':') ? AF_INET6 : AF_INET, buf, bytes), 1);
+        const size_t offset = strchr(buf, ':') ? 0 : 12;
+        assert_memory_equal(bytes, value.bytes + offset, 16 - offset);
+    }
+}
+#endif
+
 int main()
 {
     PRINT_TEST_BANNER();
@@ -766,6 +962,11 @@ int main()
         , unit_test(test_ipv6_address_comparison)
         , unit_test(test_isipaddress)
         , unit_test(test_string_is_local_host_ip)
+        , unit_test(test_ip_address_value)
+        , unit_test(test_ip_address_prefix)
+#ifndef __MINGW32__
+        , unit_test(test_ip_address_value_inet)
+#endif
     };
 
     return run_tests(tests);
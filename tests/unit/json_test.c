@@ -8,6 +8,7 @@
 #include <alloc.h>    // xasprintf()
 
 #include <float.h>
+#include <locale.h>
 
 
 static const char *OBJECT_ARRAY =
@@ -180,6 +181,63 @@ static void test_show_object_numeric(void)
     free(output);
 }
 
+/* Use a locale with another decimal point than '.', if one is installed */
+static bool SetCommaLocale(void)
+{
+    const char *const locales[] = {
+        "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR", "German",
+    };
+    for (size_t i = 0; i < sizeof(locales) / sizeof(locales[0]); i++)
+    {
+        if (setlocale(LC_NUMERIC, locales[i]) != NULL &&
+            strcmp(localeconv()->decimal_point, ".") != 0)
+        {
+            return true;
+        }
+    }
+    setlocale(LC_NUMERIC, "C");
+    return false;
+}
+
+static void CheckShowReal(double value, const char *expected)
+{
+    JsonElement *json = JsonRealCreate(value);
+    Writer *writer = StringWriter();
+    JsonWrite(writer, json, 0);
+    char *output = StringWriterClose(writer);
+    assert_string_equal(output, expected);
+
+    /* parses back as the same number */
+    const char *data = output;
+    JsonElement *parsed = NULL;
+    assert_int_equal(JsonParse(&data, &parsed), JSON_PARSE_OK);
+    assert_true(parsed != NULL);
+    assert_int_equal(JsonGetPrimitiveType(parsed), JSON_PRIMITIVE_TYPE_REAL);
+    assert_true(JsonPrimitiveGetAsReal(parsed) == JsonPrimitiveGetAsReal(json));
+
+    JsonDestroy(parsed);
+    JsonDestroy(json);
+    free(output);
+}
+
+static void test_show_real(void)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        /* the output doesn't depend on the locale */
+        if (i == 1 && !SetCommaLocale())
+        {
+            break;
+        }
+        CheckShowReal(1234.5678, "1234.5678");
+        CheckShowReal(-0.25, "-0.2500");
+        CheckShowReal(3.0, "3.0000");
+        CheckShowReal(1e25, "10000000000000000905969664.0000");
+        CheckShowReal(NAN, "0.0000");
+    }
+    setlocale(LC_NUMERIC, "C");
+}
+
 static void test_show_object_boolean(void)
 {
     JsonElement *json = JsonObjectCreate(10);
@@ -2486,6 +2544,7 @@ int main()
         unit_test(test_show_object_compound_compact),
         unit_test(test_show_object_escaped),
         unit_test(test_show_object_numeric),
+        unit_test(test_show_real),
         unit_test(test_show_object_simple),
         unit_test(test_show_string),
         unit_test(test_string_escape),
@@ -0,0 +1,158 @@
+#include <test.h>
+
+#include <logging.h>
+#include <logging_recorder.h>
+#include <alloc.h>
+
+static char *DumpToString(void)
+{
+    FILE *tmp = tmpfile();
+    assert_true(tmp != NULL);
+    assert_true(LogRecorderDump(fileno(tmp)));
+    char *contents = file_read_string(tmp);
+    fclose(tmp);
+    return contents;
+}
+
+static size_t CountLines(const char *str)
+{
+    size_t n = 0;
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if (*c == '\n')
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void test_record_not_logged(void)
+{
+    LogSetGlobalLevel(LOG_LEVEL_ERR);
+    LogSetRecorderLevel(LOG_LEVEL_VERBOSE);
+    assert_true(WouldLog(LOG_LEVEL_VERBOSE));
+    assert_false(WouldLog(LOG_LEVEL_DEBUG));
+
+    Log(LOG_LEVEL_VERBOSE, "recorded %d\n", 42);
+    Log(LOG_LEVEL_DEBUG, "not recorded");
+
+    char *dump = DumpToString();
+    assert_true(strstr(dump, "] verbose: recorded 42\n") != NULL);
+    assert_true(strstr(dump, "not recorded") == NULL);
+    free(dump);
+
+    LogSetRecorderLevel(LOG_LEVEL_NOTHING);
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+}
+
+static void test_record_module(void)
+{
+    LogSetRecorderLevel(LOG_LEVEL_DEBUG);
+    LogEnableModule(LOG_MOD_PS);
+    LogDebug(LOG_MOD_PS, "ps debug");
+
+    char *dump = DumpToString();
+    assert_true(strstr(dump, "] debug/ps: ps debug\n") != NULL);
+    free(dump);
+
+    LogSetRecorderLevel(LOG_LEVEL_NOTHING);
+}
+
+static void test_truncated(void)
+{
+    char long_msg[2 * LOG_RECORDER_MESSAGE_SIZE];
+    memset(long_msg, 'x', sizeof(long_msg) - 1);
+    long_msg[sizeof(long_msg) - 1] = '\0';
+
+    LogRecorderAppend(LOG_LEVEL_ERR, LOG_MOD_NONE, long_msg);
+    char *dump = DumpToString();
+    long_msg[LOG_RECORDER_MESSAGE_SIZE - 1] = '\0';
+    assert_true(strstr(dump, long_msg) != NULL);
+    long_msg[LOG_RECORDER_MESSAGE_SIZE - 1] = 'x';
+    long_msg[LOG_RECORDER_MESSAGE_SIZE] = '\0';
+    assert_true(strstr(dump, long_msg) == NULL);
+    free(dump);
+}
+
+#define N_RECORDS 100
+#define N_THREADS 4
+
+static void *RecordingThread(void *arg)
+{
+    int n = *((int *) arg);
+    for (int i = 0; i < n; i++)
+    {
+        LogRecorderAppend(LOG_LEVEL_INFO, LOG_MOD_NONE, "from thread");
+    }
+    return NULL;
+}
+
+static void test_threads_wraparound(void)
+{
+    /* Only affects rings allocated from now on, so only the new threads. */
+    LogRecorderSetCapacity(N_RECORDS / 2 + 1);
+
+    pthread_t threads[N_THREADS];
+    int n = N_RECORDS;
+    for (int i = 0; i < N_THREADS; i++)
+    {
+        assert_int_equal(pthread_create(&threads[i], NULL, RecordingThread, &n), 0);
+    }
+    for (int i = 0; i < N_THREADS; i++)
+    {
+        assert_int_equal(pthread_join(threads[i], NULL), 0);
+    }
+
+    char *dump = DumpToString();
+    size_t n_from_thread = 0;
+    for (const char *c = strstr(dump, "from thread"); c != NULL;
+         c = strstr(c + 1, "from thread"))
+    {
+        n_from_thread++;
+    }
+    /* Capacity rounded up to 64, the rings of finished threads may be
+     * reused by the next ones. */
+    assert_true(n_from_thread >= 64);
+    assert_true(n_from_thread <= 64 * N_THREADS);
+    assert_true(CountLines(dump) >= n_from_thread);
+    assert_int_equal(LogRecorderDroppedCount(), 0);
+    free(dump);
+
+    LogRecorderSetCapacity(LOG_RECORDER_DEFAULT_RECORDS);
+}
+
+static void test_dump_to_file(void)
+{
+    char path[] = "/tmp/logging_recorder_test.XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+
+    LogRecorderAppend(LOG_LEVEL_NOTICE, LOG_MOD_NONE, "dumped into file");
+    assert_true(LogRecorderDumpToFile(path));
+
+    FILE *f = fopen(path, "r");
+    assert_true(f != NULL);
+    char *contents = file_read_string(f);
+    fclose(f);
+    unlink(path);
+
+    assert_true(strstr(contents, "] notice: dumped into file\n") != NULL);
+    free(contents);
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_record_not_logged),
+        unit_test(test_record_module),
+        unit_test(test_truncated),
+        unit_test(test_threads_wraparound),
+        unit_test(test_dump_to_file),
+    };
+
+    return run_tests(tests);
+}
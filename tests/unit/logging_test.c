@@ -0,0 +1,128 @@
+#include <test.h>
+
+#include <logging.h>
+
+static int n_evaluated = 0;
+
+static const char *Evaluate(void)
+{
+    n_evaluated++;
+    return "evaluated";
+}
+
+static void test_lazy_disabled_not_evaluated(void)
+{
+    LogSetGlobalLevel(LOG_LEVEL_ERR);
+    n_evaluated = 0;
+
+    LOG_LAZY(LOG_LEVEL_DEBUG, "%s", Evaluate());
+    LOG_LAZY(LOG_LEVEL_INFO, "%s", Evaluate());
+    LOG_DEBUG_LAZY(LOG_MOD_VARS, "%s", Evaluate());
+    assert_int_equal(n_evaluated, 0);
+
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+}
+
+static void test_lazy_enabled_evaluated(void)
+{
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+    n_evaluated = 0;
+
+    LOG_LAZY(LOG_LEVEL_ERR, "%s", Evaluate());
+    assert_int_equal(n_evaluated, 1);
+}
+
+static void test_enabled_level(void)
+{
+    LogSetGlobalLevel(LOG_LEVEL_WARNING);
+    assert_true(LogLevelMaybeEnabled(LOG_LEVEL_ERR));
+    assert_true(LogLevelMaybeEnabled(LOG_LEVEL_WARNING));
+    assert_false(LogLevelMaybeEnabled(LOG_LEVEL_NOTICE));
+
+    /* syslog gets at most INFO messages */
+    LogSetGlobalSystemLogLevel(LOG_LEVEL_DEBUG);
+    assert_true(LogLevelMaybeEnabled(LOG_LEVEL_INFO));
+    assert_false(LogLevelMaybeEnabled(LOG_LEVEL_VERBOSE));
+    LogUnsetGlobalSystemLogLevel();
+    assert_false(LogLevelMaybeEnabled(LOG_LEVEL_NOTICE));
+
+    /* per-thread levels raise the bound */
+    LoggingPrivSetLevels(LOG_LEVEL_WARNING, LOG_LEVEL_DEBUG);
+    assert_true(LogLevelMaybeEnabled(LOG_LEVEL_DEBUG));
+    assert_int_equal(WouldLog(LOG_LEVEL_DEBUG), true);
+
+    /* the global level resets it */
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+    assert_false(LogLevelMaybeEnabled(LOG_LEVEL_INFO));
+    assert_true(LogLevelMaybeEnabled(LOG_LEVEL_NOTICE));
+}
+
+static pthread_mutex_t stage_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stage_cond = PTHREAD_COND_INITIALIZER;
+static int stage = 0;
+
+static void SetStage(int new_stage)
+{
+    pthread_mutex_lock(&stage_lock);
+    stage = new_stage;
+    pthread_cond_broadcast(&stage_cond);
+    pthread_mutex_unlock(&stage_lock);
+}
+
+static void WaitForStage(int wanted_stage)
+{
+    pthread_mutex_lock(&stage_lock);
+    while (stage != wanted_stage)
+    {
+        pthread_cond_wait(&stage_cond, &stage_lock);
+    }
+    pthread_mutex_unlock(&stage_lock);
+}
+
+static void *RaisedLevelThread(ARG_UNUSED void *arg)
+{
+    LoggingPrivSetLevels(LOG_LEVEL_NOTICE, LOG_LEVEL_DEBUG);
+    SetStage(1);
+
+    /* the main thread lowers the global level meanwhile */
+    WaitForStage(2);
+    n_evaluated = 0;
+    LOG_LAZY(LOG_LEVEL_DEBUG, "%s", Evaluate());
+    assert_int_equal(n_evaluated, 1);
+    return NULL;
+}
+
+static void test_enabled_level_raised_thread(void)
+{
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+    stage = 0;
+
+    pthread_t thread;
+    assert_int_equal(pthread_create(&thread, NULL, RaisedLevelThread, NULL), 0);
+    WaitForStage(1);
+
+    /* lowering the global level doesn't hide the thread's messages */
+    LogSetGlobalLevel(LOG_LEVEL_ERR);
+    assert_true(LogLevelMaybeEnabled(LOG_LEVEL_DEBUG));
+    SetStage(2);
+
+    /* until the thread goes away */
+    assert_int_equal(pthread_join(thread, NULL), 0);
+    assert_false(LogLevelMaybeEnabled(LOG_LEVEL_WARNING));
+
+    LogSetGlobalLevel(LOG_LEVEL_NOTICE);
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_lazy_disabled_not_evaluated),
+        unit_test(test_lazy_enabled_evaluated),
+        unit_test(test_enabled_level),
+        unit_test(test_enabled_level_raised_thread),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,192 @@
+#include <test.h>
+
+#include <mustache.h>
+#include <file_lib.h>
+#include <string_lib.h>
+#include <misc_lib.h>
+
+static JsonElement *LoadSpec(const char *filename)
+{
+    char path[PATH_MAX];
+    xsnprintf(path, sizeof(path), "%s/%s", TESTDATADIR, filename);
+
+    Writer *w = FileRead(path, SIZE_MAX, NULL);
+    assert_true(w != NULL);
+
+    JsonElement *json = NULL;
+    const char *data = StringWriterData(w);
+    assert_int_equal(JsonParse(&data, &json), JSON_PARSE_OK);
+    WriterClose(w);
+
+    return json;
+}
+
+/**
+ * Runs the tests from a spec file through both MustacheRender() and
+ * MustacheRenderCompiled().
+ */
+static void RunSpec(const char *filename)
+{
+    JsonElement *spec = LoadSpec(filename);
+    JsonElement *tests = JsonObjectGetAsArray(spec, "tests");
+    assert_true(tests != NULL);
+
+    for (size_t i = 0; i < JsonLength(tests); i++)
+    {
+        JsonElement *test = JsonAt(tests, i);
+        const char *template = JsonObjectGetAsString(test, "template");
+        const char *expected = JsonObjectGetAsString(test, "expected");
+        const JsonElement *data = JsonObjectGet(test, "data");
+        assert_true(template != NULL);
+        assert_true(expected != NULL);
+
+        Buffer *out = BufferNew();
+        assert_true(MustacheRender(out, template, data));
+        assert_string_equal(expected, BufferData(out));
+
+        MustacheTemplate *compiled = MustacheCompile(template);
+        assert_true(compiled != NULL);
+
+        /* rendering multiple times gives the same result */
+        for (int j = 0; j < 2; j++)
+        {
+            BufferClear(out);
+            assert_true(MustacheRenderCompiled(out, compiled, data));
+            assert_string_equal(expected, BufferData(out));
+        }
+
+        MustacheTemplateDestroy(compiled);
+        BufferDestroy(out);
+
+        Writer *w = StringWriter();
+        assert_true(MustacheRenderToWriter(w, template, data));
+        assert_string_equal(expected, StringWriterData(w));
+        WriterClose(w);
+    }
+
+    JsonDestroy(spec);
+}
+
+static void test_spec_comments(void)
+{
+    RunSpec("mustache_comments.json");
+}
+
+static void test_spec_delimiters(void)
+{
+    RunSpec("mustache_delimiters.json");
+}
+
+static void test_spec_interpolation(void)
+{
+    RunSpec("mustache_interpolation.json");
+}
+
+static void test_spec_inverted(void)
+{
+    RunSpec("mustache_inverted.json");
+}
+
+static void test_spec_sections(void)
+{
+    RunSpec("mustache_sections.json");
+}
+
+static void test_spec_extra(void)
+{
+    RunSpec("mustache_extra.json");
+}
+
+static void test_compile_broken(void)
+{
+    const char *broken[] = {
+        "{{#section}}never closed",
+        "{{/section}}",
+        "{{unterminated",
+        "{{{unterminated}}",
+        "{{= a b c =}}",
+    };
+
+    JsonElement *data = JsonObjectCreate(1);
+    for (size_t i = 0; i < sizeof(broken) / sizeof(broken[0]); i++)
+    {
+        Buffer *out = BufferNew();
+        assert_false(MustacheRender(out, broken[i], data));
+        assert_true(MustacheCompile(broken[i]) == NULL);
+        BufferDestroy(out);
+    }
+    JsonDestroy(data);
+}
+
+static void test_render_errors(void)
+{
+    /* Errors depending on the data are only detected when rendering. */
+    const char *template = "{{#x}}a{{/x}}{{.}}";
+    MustacheTemplate *compiled = MustacheCompile(template);
+    assert_true(compiled != NULL);
+
+    JsonElement *data = JsonObjectCreate(1);
+    JsonObjectAppendString(data, "x", "not a bool or container");
+
+    Buffer *out = BufferNew();
+    assert_false(MustacheRender(out, template, data));
+    assert_false(MustacheRenderCompiled(out, compiled, data));
+
+    JsonObjectAppendBool(data, "x", true);
+    BufferClear(out);
+    assert_false(MustacheRender(out, template, data));
+    BufferClear(out);
+    assert_false(MustacheRenderCompiled(out, compiled, data));
+
+    BufferDestroy(out);
+    JsonDestroy(data);
+    MustacheTemplateDestroy(compiled);
+}
+
+static void test_render_to_writer_large(void)
+{
+    /* Output many times bigger than the writer chunks. */
+    const char *template = "{{#items}}{{@}}: {{name}} {{&value}}\n{{/items}}";
+    JsonElement *data = JsonObjectCreate(1);
+    JsonElement *items = JsonArrayCreate(10000);
+    for (int i = 0; i < 10000; i++)
+    {
+        JsonElement *item = JsonObjectCreate(2);
+        JsonObjectAppendString(item, "name", "<item>");
+        JsonObjectAppendInteger(item, "value", i);
+        JsonArrayAppendObject(items, item);
+    }
+    JsonObjectAppendArray(data, "items", items);
+
+    Buffer *expected = BufferNew();
+    assert_true(MustacheRender(expected, template, data));
+    assert_true(BufferSize(expected) > 128 * 1024);
+
+    Writer *w = StringWriter();
+    assert_true(MustacheRenderToWriter(w, template, data));
+    assert_int_equal(StringWriterLength(w), BufferSize(expected));
+    assert_string_equal(StringWriterData(w), BufferData(expected));
+    WriterClose(w);
+
+    BufferDestroy(expected);
+    JsonDestroy(data);
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_spec_comments),
+        unit_test(test_spec_delimiters),
+        unit_test(test_spec_interpolation),
+        unit_test(test_spec_inverted),
+        unit_test(test_spec_sections),
+        unit_test(test_spec_extra),
+        unit_test(test_compile_broken),
+        unit_test(test_render_errors),
+        unit_test(test_render_to_writer_large),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,344 @@
+#include <test.h>
+
+#include <number_lib.h>
+#include <float.h>
+#include <locale.h>
+
+static void CheckFormatInt64(int64_t value)
+{
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%" PRIi64, value);
+
+    char buf[NUMBER_INT64_BUFSIZE];
+    const size_t len = NumberFormatInt64(value, buf);
+    assert_string_equal(buf, expected);
+    assert_int_equal(len, strlen(expected));
+}
+
+static void test_format_int64(void)
+{
+    CheckFormatInt64(0);
+    CheckFormatInt64(7);
+    CheckFormatInt64(-7);
+    CheckFormatInt64(10);
+    CheckFormatInt64(99);
+    CheckFormatInt64(100);
+    CheckFormatInt64(-1234567890);
+    CheckFormatInt64(INT64_MAX);
+    CheckFormatInt64(INT64_MIN);
+
+    for (int i = 0; i < 100000; i++)
+    {
+        const int64_t value = (int64_t) (((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand());
+        CheckFormatInt64(value >> (rand() % 63));
+        CheckFormatInt64(-(value >> (rand() % 63)));
+    }
+
+    char buf[NUMBER_INT64_BUFSIZE];
+    assert_int_equal(NumberFormatUint64(UINT64_MAX, buf), 20);
+    assert_string_equal(buf, "18446744073709551615");
+}
+
+static void CheckParseInt64(const char *str, int expected_ret, int64_t expected)
+{
+    int64_t value = 12345;
+    const int ret = NumberParseInt64(str, strlen(str), &value);
+    assert_int_equal(ret, expected_ret);
+    assert_int_equal(value, (expected_ret == 0) ? expected : 12345);
+}
+
+static void test_parse_int64(void)
+{
+    CheckParseInt64("0", 0, 0);
+    CheckParseInt64("-0", 0, 0);
+    CheckParseInt64("+12", 0, 12);
+    CheckParseInt64("  \t-12345678901234 ", 0, -12345678901234);
+    CheckParseInt64("000000000000000000000000001", 0, 1);
+    CheckParseInt64("9223372036854775807", 0, INT64_MAX);
+    CheckParseInt64("-9223372036854775808", 0, INT64_MIN);
+    CheckParseInt64("9223372036854775808", ERANGE, 0);
+    CheckParseInt64("-9223372036854775809", ERANGE, 0);
+    CheckParseInt64("99999999999999999999", ERANGE, 0);
+    CheckParseInt64("99999999999999999999x", ERANGE, 0);
+    CheckParseInt64("", -81, 0);
+    CheckParseInt64("  ", -81, 0);
+    CheckParseInt64("-", -81, 0);
+    CheckParseInt64("abc", -81, 0);
+    CheckParseInt64("12abc", -83, 0);
+    CheckParseInt64("1234567890123x", -83, 0);
+    CheckParseInt64("12.5", -83, 0);
+
+    /* not NUL-terminated */
+    int64_t value;
+    assert_int_equal(NumberParseInt64("12345678901234567", 9, &value), 0);
+    assert_int_equal(value, 123456789);
+    assert_int_equal(NumberParseInt64("1234 5", 4, &value), 0);
+    assert_int_equal(value, 1234);
+
+    /* compare with strtoll() */
+    for (int i = 0; i < 100000; i++)
+    {
+        char buf[32];
+        const int64_t expected = (int64_t) (((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand());
+        snprintf(buf, sizeof(buf), "%" PRIi64, (expected >> (rand() % 63)) * ((rand() % 2) ? 1 : -1));
+        assert_int_equal(NumberParseInt64(buf, strlen(buf), &value), 0);
+        assert_int_equal(value, strtoll(buf, NULL, 10));
+    }
+}
+
+static void CheckParseDouble(const char *str, int expected_ret)
+{
+    double value = 0.0;
+    const int ret = NumberParseDouble(str, strlen(str), &value);
+    assert_int_equal(ret, expected_ret);
+    if (ret == 0 || ret == ERANGE)
+    {
+        const double expected = strtod(str, NULL);
+        assert_true(memcmp(&value, &expected, sizeof(double)) == 0 ||
+                    (isnan(value) && isnan(expected)));
+    }
+}
+
+static void test_parse_double(void)
+{
+    CheckParseDouble("0", 0);
+    CheckParseDouble("-0", 0);
+    CheckParseDouble("-0.0e10", 0);
+    CheckParseDouble("1.5", 0);
+    CheckParseDouble("  -.5 ", 0);
+    CheckParseDouble("5.", 0);
+    CheckParseDouble("0.1", 0);
+    CheckParseDouble("3.14159265358979323846264338327950288", 0);
+    CheckParseDouble("123456789012345678901234567890", 0);
+    CheckParseDouble("0.000000000000000000000000000000000000001234", 0);
+    CheckParseDouble("1e22", 0);
+    CheckParseDouble("1e23", 0);
+    CheckParseDouble("12e30", 0);
+    CheckParseDouble("2.2250738585072014e-308", 0);
+    CheckParseDouble("4.9e-324", ERANGE); /* subnormal, like strtod() */
+    CheckParseDouble("1.7976931348623157e308", 0);
+    CheckParseDouble("9007199254740993", 0);
+    CheckParseDouble("1E+2", 0);
+    CheckParseDouble("1e-99999999999999", ERANGE);
+    CheckParseDouble("1e400", ERANGE);
+    CheckParseDouble("-1e400", ERANGE);
+    CheckParseDouble("0x1p4", 0);
+    CheckParseDouble("inf", 0);
+    CheckParseDouble("-Infinity", 0);
+    CheckParseDouble("nan", 0);
+    CheckParseDouble("", -81);
+    CheckParseDouble(".", -81);
+    CheckParseDouble("-", -81);
+    CheckParseDouble("e5", -81);
+    CheckParseDouble("1e", -83);
+    CheckParseDouble("1.5x", -83);
+    CheckParseDouble("1.5.5", -83);
+    CheckParseDouble("infx", -83);
+
+    /* not NUL-terminated */
+    double value;
+    assert_int_equal(NumberParseDouble("1.25e3", 4, &value), 0);
+    assert_true(value == 1.25);
+
+    /* random digit strings compared with strtod() */
+    for (int i = 0; i < 100000; i++)
+    {
+        char buf[64];
+        size_t len = 0;
+        const int num_digits = 1 + rand() % 25;
+        const int point = rand() % (num_digits + 1);
+        for (int j = 0; j < num_digits; j++)
+        {
+            if (j == point)
+            {
+                buf[len++] = '.';
+            }
+            buf[len++] = '0' + rand() % 10;
+        }
+        if (rand() % 2)
+        {
+            len += snprintf(buf + len, sizeof(buf) - len, "e%d", rand() % 700 - 350);
+        }
+        buf[len] = '\0';
+        errno = 0;
+        strtod(buf, NULL);
+        CheckParseDouble(buf, (errno == ERANGE) ? ERANGE : 0);
+    }
+}
+
+static void CheckFormatDouble(double value, const char *expected)
+{
+    char buf[NUMBER_DOUBLE_BUFSIZE];
+    const size_t len = NumberFormatDouble(value, buf);
+    assert_string_equal(buf, expected);
+    assert_int_equal(len, strlen(expected));
+}
+
+/* The number of significant digits needed by the shortest "%.*g" that
+ * round-trips (the result of NumberFormatDouble() must not be longer). */
+static int ShortestPrecision(double value)
+{
+    char buf[64];
+    for (int precision = 1; precision < 17; precision++)
+    {
+        snprintf(buf, sizeof(buf), "%.*g", precision, value);
+        if (strtod(buf, NULL) == value)
+        {
+            return precision;
+        }
+    }
+    return 17;
+}
+
+static int SignificantDigits(const char *str)
+{
+    int digits = 0, zeros = 0;
+    bool started = false;
+    for (; *str != '\0' && *str != 'e'; str++)
+    {
+        if (*str == '0' && !started)
+        {
+            continue;
+        }
+        if (isdigit((unsigned char) *str))
+        {
+            started = true;
+            if (*str == '0')
+            {
+                zeros++;
+            }
+            else
+            {
+                digits += zeros + 1;
+                zeros = 0;
+            }
+        }
+    }
+    return digits;
+}
+
+static void test_format_double(void)
+{
+    CheckFormatDouble(0.0, "0");
+    CheckFormatDouble(-0.0, "-0");
+    CheckFormatDouble(1.0, "1");
+    CheckFormatDouble(-42.0, "-42");
+    CheckFormatDouble(0.1, "0.1");
+    CheckFormatDouble(0.3, "0.3");
+    CheckFormatDouble(0.1 + 0.2, "0.30000000000000004");
+    CheckFormatDouble(1.5, "1.5");
+    CheckFormatDouble(123.456, "123.456");
+    CheckFormatDouble(1e21, "1e+21");
+    CheckFormatDouble(1e20, "100000000000000000000");
+    CheckFormatDouble(1.5e300, "1.5e+300");
+    CheckFormatDouble(0.000001, "0.000001");
+    CheckFormatDouble(1e-7, "1e-7");
+    CheckFormatDouble(1.25e-7, "1.25e-7");
+    CheckFormatDouble(9007199254740993.0, "9007199254740992");
+    CheckFormatDouble(5e-324, "5e-324");
+    CheckFormatDouble(1.7976931348623157e308, "1.7976931348623157e+308");
+    CheckFormatDouble(2.2250738585072014e-308, "2.2250738585072014e-308");
+    CheckFormatDouble(-2.2250738585072014e-308, "-2.2250738585072014e-308");
+    CheckFormatDouble(NAN, "NaN");
+    CheckFormatDouble(INFINITY, "Infinity");
+    CheckFormatDouble(-INFINITY, "-Infinity");
+
+    /* random bit patterns must round-trip with the fewest digits */
+    for (int i = 0; i < 200000; i++)
+    {
+        uint64_t bits = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ rand();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value))
+        {
+            continue;
+        }
+        if (i % 2 == 0)
+        {
+            /* values with few digits are more interesting */
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.*g", 1 + rand() % 17, value);
+            value = strtod(buf, NULL);
+        }
+
+        char buf[NUMBER_DOUBLE_BUFSIZE];
+        const size_t len = NumberFormatDouble(value, buf);
+        assert_true(len < NUMBER_DOUBLE_BUFSIZE);
+
+        double parsed;
+        const int ret = NumberParseDouble(buf, len, &parsed);
+        assert_true(ret == 0 || (ret == ERANGE && fabs(value) < DBL_MIN));
+        assert_true(memcmp(&parsed, &value, sizeof(double)) == 0);
+        assert_true(value == 0.0 || SignificantDigits(buf) <= ShortestPrecision(value));
+    }
+}
+
+/* Use a locale with another decimal point than '.', if one is installed */
+static bool SetCommaLocale(void)
+{
+    const char *const locales[] = {
+        "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR", "German",
+    };
+    for (size_t i = 0; i < sizeof(locales) / sizeof(locales[0]); i++)
+    {
+        if (setlocale(LC_NUMERIC, locales[i]) != NULL &&
+            strcmp(localeconv()->decimal_point, ".") != 0)
+        {
+            return true;
+        }
+    }
+    setlocale(LC_NUMERIC, "C");
+    return false;
+}
+
+static void CheckFormatDoubleFixed(double value, int decimals, const char *expected)
+{
+    char buf[NUMBER_DOUBLE_FIXED_BUFSIZE(decimals)];
+    const size_t len = NumberFormatDoubleFixed(value, decimals, buf);
+    assert_string_equal(buf, expected);
+    assert_int_equal(len, strlen(expected));
+}
+
+static void test_format_double_fixed(void)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (i == 1 && !SetCommaLocale())
+        {
+            break;
+        }
+        CheckFormatDoubleFixed(3.14, 4, "3.1400");
+        CheckFormatDoubleFixed(-0.5, 4, "-0.5000");
+        CheckFormatDoubleFixed(0.0, 4, "0.0000");
+        CheckFormatDoubleFixed(1.23456789, 4, "1.2346");
+        CheckFormatDoubleFixed(1234567.0, 2, "1234567.00");
+        CheckFormatDoubleFixed(1e20, 1, "100000000000000000000.0");
+        CheckFormatDoubleFixed(0.5, 0, "0");
+        CheckFormatDoubleFixed(42.0, 0, "42");
+        CheckFormatDoubleFixed(1e-7, 3, "0.000");
+
+        char expected[NUMBER_DOUBLE_FIXED_BUFSIZE(4)];
+        char buf[NUMBER_DOUBLE_FIXED_BUFSIZE(4)];
+        const size_t len = NumberFormatDoubleFixed(-DBL_MAX, 4, buf);
+        assert_int_equal(len, 1 + 309 + 5);
+        setlocale(LC_NUMERIC, "C");
+        snprintf(expected, sizeof(expected), "%.4f", -DBL_MAX);
+        assert_string_equal(buf, expected);
+    }
+    setlocale(LC_NUMERIC, "C");
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_format_int64),
+        unit_test(test_parse_int64),
+        unit_test(test_parse_double),
+        unit_test(test_format_double),
+        unit_test(test_format_double_fixed),
+    };
+
+    return run_tests(tests);
+}
@@ -0,0 +1,192 @@
+#include <test.h>
+
+#include <proc_keyvalue.h>
+#include <alloc.h>
+#include <misc_lib.h>                                       /* xsnprintf */
+#include <string_lib.h>                                     /* StringStartsWith */
+
+typedef struct
+{
+    int64_t total;
+    int64_t free;
+    int64_t available;
+    int64_t hugepages;
+    int64_t missing;
+} MemInfo;
+
+static const ProcKeyField MEMINFO_FIELDS[] = {
+    { "MemTotal", offsetof(MemInfo, total) },
+    { "MemFree", offsetof(MemInfo, free) },
+    { "MemAvailable", offsetof(MemInfo, available) },
+    { "HugePages_Total", offsetof(MemInfo, hugepages) },
+    { "NoSuchField", offsetof(MemInfo, missing) },
+};
+
+static const char MEMINFO[] =
+    "MemTotal:       16308036 kB\n"
+    "MemFree:         1023940 kB\n"
+    "MemAvailable:    9876543 kB\n"
+    "Buffers:          654321 kB\n"
+    "Mem:                   1 kB\n"
+    "HugePages_Total:       0\n"
+    "Hugepagesize:       2048 kB";
+
+static void test_parse_fields(void)
+{
+    ProcKeyTable *table = ProcKeyTableNew(MEMINFO_FIELDS, 5);
+
+    MemInfo info = { -1, -1, -1, -1, -1 };
+    assert_int_equal(ParseKeyNumericValueFields(MEMINFO, strlen(MEMINFO), table, &info), 4);
+    assert_int_equal(info.total, 16308036);
+    assert_int_equal(info.free, 1023940);
+    assert_int_equal(info.available, 9876543);
+    assert_int_equal(info.hugepages, 0);
+    assert_int_equal(info.missing, -1l);
+
+    /* Only the given size is parsed */
+    const size_t first_line = strchr(MEMINFO, '\n') - MEMINFO;
+    info.free = -1;
+    assert_int_equal(ParseKeyNumericValueFields(MEMINFO, first_line, table, &info), 1);
+    assert_int_equal(info.free, -1l);
+
+    /* Keys are matched whole, case-sensitively */
+    const char *const similar = "Mem: 1\nmemtotal: 2\nMemTotal : 3\nMemTota: 4\n";
+    assert_int_equal(ParseKeyNumericValueFields(similar, strlen(similar), table, &info), 0);
+
+    /* Lines without a ':' and other non-numeric lines are fine as long as
+     * they are not wanted */
+    const char *const status = "Name:\tbash\nState:\tS (sleeping)\n\nMemFree:\t-42\n";
+    assert_int_equal(ParseKeyNumericValueFields(status, strlen(status), table, &info), 1);
+    assert_int_equal(info.free, -42l);
+
+    const char *const malformed = "MemTotal: 1\nMemFree: lots\n";
+    assert_int_equal(ParseKeyNumericValueFields(malformed, strlen(malformed), table, &info), -1l);
+    const char *const overflow = "MemFree: 99999999999999999999 kB\n";
+    assert_int_equal(ParseKeyNumericValueFields(overflow, strlen(overflow), table, &info), -1l);
+
+    ProcKeyTableDestroy(table);
+}
+
+static void test_many_keys(void)
+{
+    /* Enough keys to need a bigger table and a few seeds */
+    enum { N_KEYS = 300 };
+    ProcKeyField *fields = xmalloc(N_KEYS * sizeof(ProcKeyField));
+    char *data = xmalloc(N_KEYS * 32);
+    size_t size = 0;
+    for (size_t i = 0; i < N_KEYS; i++)
+    {
+        char *key;
+        xasprintf(&key, "Key%zu", i);
+        fields[i].key = key;
+        fields[i].offset = i * sizeof(int64_t);
+        xsnprintf(data + size, N_KEYS * 32 - size, "%s:\t%zu\n", key, i * 1000);
+        size += strlen(data + size);
+    }
+
+    ProcKeyTable *table = ProcKeyTableNew(fields, N_KEYS);
+    for (size_t i = 0; i < N_KEYS; i++)
+    {
+        free((char *) fields[i].key);
+    }
+    free(fields);
+
+    int64_t values[N_KEYS];
+    assert_int_equal(ParseKeyNumericValueFields(data, size, table, values), N_KEYS);
+    for (size_t i = 0; i < N_KEYS; i++)
+    {
+        assert_int_equal(values[i], i * 1000);
+    }
+
+    ProcKeyTableDestroy(table);
+    free(data);
+}
+
+#ifndef __MINGW32__
+static void test_duplicate_keys(void)
+{
+    const ProcKeyField fields[] = {
+        { "MemTotal", offsetof(MemInfo, total) },
+        { "MemFree", offsetof(MemInfo, free) },
+        { "MemTotal", offsetof(MemInfo, available) },
+    };
+    assert_true(ProcKeyTableNew(fields, 3) == NULL);
+
+    ProcKeyTable *table = ProcKeyTableNew(fields, 2);
+    assert_true(table != NULL);
+    ProcKeyTableDestroy(table);
+}
+
+static void test_read_file(void)
+{
+    char path[] = "/tmp/proc_keyvalue_test.XXXXXX";
+    const int fd = mkstemp(path);
+    assert_true(fd >= 0);
+
+    /* Bigger than the initial buffer */
+    const size_t n_lines = 2000;
+    FILE *file = fdopen(fd, "w");
+    for (size_t i = 0; i < n_lines; i++)
+    {
+        fprintf(file, "Line%zu: %zu\n", i, i);
+    }
+    fprintf(file, "MemFree: 12345 kB\n");
+    fclose(file);
+
+    ProcFileBuffer buffer = PROC_FILE_BUFFER_INIT;
+    const ssize_t size = ProcFileRead(path, &buffer);
+    assert_true(size > 4096);
+    assert_int_equal(size, buffer.size);
+    assert_int_equal(strlen(buffer.data), size);
+    assert_true(StringStartsWith(buffer.data, "Line0: 0\nLine1: 1\n"));
+    assert_true(StringEndsWith(buffer.data, "\nLine1999: 1999\nMemFree: 12345 kB\n"));
+
+    ProcKeyTable *table = ProcKeyTableNew(MEMINFO_FIELDS, 5);
+    MemInfo info = { -1, -1, -1, -1, -1 };
+    assert_int_equal(ParseKeyNumericValueFields(buffer.data, buffer.size, table, &info), 1);
+    assert_int_equal(info.free, 12345);
+
+    /* Reusing the buffer */
+    assert_int_equal(ProcFileRead(path, &buffer), size);
+    unlink(path);
+    assert_int_equal(ProcFileRead(path, &buffer), -1l);
+
+#ifdef __linux__
+    const char *const status_path = "/proc/self/status";
+    if (access(status_path, R_OK) == 0)
+    {
+        static const ProcKeyField status_fields[] = {
+            { "Pid", 0 },
+            { "Threads", sizeof(int64_t) },
+        };
+        ProcKeyTable *status_table = ProcKeyTableNew(status_fields, 2);
+        int64_t values[2] = { -1, -1 };
+        assert_true(ProcFileRead(status_path, &buffer) > 0);
+        assert_int_equal(ParseKeyNumericValueFields(buffer.data, buffer.size,
+                                                    status_table, values), 2);
+        assert_int_equal(values[0], getpid());
+        assert_true(values[1] >= 1);
+        ProcKeyTableDestroy(status_table);
+    }
+#endif
+
+    ProcKeyTableDestroy(table);
+    ProcFileBufferDestroy(&buffer);
+}
+#endif
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_parse_fields),
+        unit_test(test_many_keys),
+        unit_test(test_duplicate_keys),
+#ifndef __MINGW32__
+        unit_test(test_read_file),
+#endif
+    };
+
+    return run_tests(tests);
+}
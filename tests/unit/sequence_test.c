@@ -731,6 +731,241 @@ static void test_seq_string_empty_file(void)
     assert_true(SeqStringReadFile(path) == NULL);
 }
 
+static Seq *DeserializeSlices(const char *serialized)
+{
+    // Copy without the NUL terminator, so overreads are caught by valgrind
+    const size_t size = strlen(serialized);
+    static char buffer[64];
+    assert(size <= sizeof(buffer));
+    memcpy(buffer, serialized, size);
+    return SeqStringDeserializeSlices(buffer, size);
+}
+
+static void test_string_deserialize_slices(void)
+{
+    {
+        char two_newlines[] = "1         \n\n1         \n\n";
+        Seq *seq = SeqStringDeserializeSlices(two_newlines, strlen(two_newlines));
+        assert_true(seq != NULL);
+        assert_int_equal(SeqLength(seq), 2);
+        const char *a = SeqAt(seq, 0);
+        const char *b = SeqAt(seq, 1);
+        assert_string_equal(a, "\n");
+        assert_string_equal(b, "\n");
+        // Items point into the buffer
+        assert_true(a == two_newlines + 10);
+        assert_true(b == two_newlines + 22);
+        SeqDestroy(seq);
+    }
+    {
+        // Any invalid string should return NULL:
+        assert_true(DeserializeSlices(" ") == NULL);
+        assert_true(DeserializeSlices("1") == NULL);
+        assert_true(DeserializeSlices("1         ") == NULL);
+
+        // Missing newline:
+        assert_true(DeserializeSlices("1         A") == NULL);
+        assert_true(DeserializeSlices("2         A\n") == NULL);
+        assert_true(DeserializeSlices("1         A ") == NULL);
+
+        // NUL byte wrong (length wrong):
+        assert_true(DeserializeSlices("10000     AAAAAAAAAA\n") == NULL);
+        assert_true(DeserializeSlices("0         A\n") == NULL);
+
+        // Embedded NUL byte:
+        char nul[] = "3         A\0B\n";
+        assert_true(SeqStringDeserializeSlices(nul, sizeof(nul) - 1) == NULL);
+    }
+    {
+        // Empty String -> Empty Seq:
+        Seq *seq = SeqStringDeserializeSlices(NULL, 0);
+        assert_true(seq != NULL);
+        assert_int_equal(SeqLength(seq), 0);
+        SeqDestroy(seq);
+    }
+}
+
+static void test_seq_string_file_slices(void)
+{
+    const char *const path = "test_file_string_sequence";
+
+    Seq *const sequence = SeqNew(5, free);
+    SeqAppend(sequence, xstrdup("ABC"));
+    SeqAppend(sequence, xstrdup(""));
+    SeqAppend(sequence, xstrdup("line\nbreak"));
+    assert_true(SeqStringWriteFile(sequence, path));
+
+    char *backing = NULL;
+    Seq *const read_sequence = SeqStringReadFileSlices(path, &backing);
+    assert_true(read_sequence != NULL);
+    assert_true(backing != NULL);
+    assert_int_equal(SeqLength(read_sequence), 3);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        assert_string_equal(SeqAt(sequence, i), SeqAt(read_sequence, i));
+    }
+    SeqDestroy(read_sequence);
+    free(backing);
+
+    // Truncated file
+    assert_int_equal(truncate(path, 20), 0);
+    backing = NULL;
+    assert_true(SeqStringReadFileSlices(path, &backing) == NULL);
+    assert_true(backing == NULL);
+
+    SeqDestroy(sequence);
+    unlink(path);
+    assert_true(SeqStringReadFileSlices(path, &backing) == NULL);
+}
+
+static void test_len_prefixed_reader_writer(void)
+{
+    const char *const path = "test_file_string_sequence";
+
+    // Enough strings to go through several buffers, with a few strings
+    // smaller than, close to and bigger than the buffer size in between
+    const size_t n_strings = 20000;
+    const size_t big_sizes[] = { 16 * 1024, 64 * 1024 - 11, 64 * 1024, 300 * 1024 };
+    Seq *const sequence = SeqNew(n_strings, free);
+    for (size_t i = 0; i < n_strings; ++i)
+    {
+        if (i % 5000 == 17)
+        {
+            const size_t size = big_sizes[(i / 5000) % 4];
+            char *big = xmalloc(size + 1);
+            memset(big, 'a' + i % 26, size);
+            big[size] = '\0';
+            SeqAppend(sequence, big);
+        }
+        else
+        {
+            SeqAppend(sequence, StringFormat("string %zu", i));
+        }
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_true(fd >= 0);
+    assert_true(SeqStringWriteFd(sequence, fd));
+    close(fd);
+
+    // Same format as the unbuffered writer
+    Seq *const read_sequence = SeqStringReadFile(path);
+    assert_true(read_sequence != NULL);
+    assert_int_equal(SeqLength(read_sequence), n_strings);
+    for (size_t i = 0; i < n_strings; ++i)
+    {
+        assert_string_equal(SeqAt(sequence, i), SeqAt(read_sequence, i));
+    }
+    SeqDestroy(read_sequence);
+
+    fd = open(path, O_RDONLY);
+    assert_true(fd >= 0);
+    LenPrefixedReader *reader = LenPrefixedReaderNew(fd);
+    for (size_t i = 0; i < n_strings; ++i)
+    {
+        const char *string;
+        size_t length;
+        assert_int_equal(LenPrefixedReaderNext(reader, &string, &length), 1);
+        assert_int_equal(length, strlen(SeqAt(sequence, i)));
+        assert_string_equal(string, SeqAt(sequence, i));
+    }
+    const char *string;
+    assert_int_equal(LenPrefixedReaderNext(reader, &string, NULL), 0);
+    assert_int_equal(LenPrefixedReaderNext(reader, &string, NULL), 0);
+    LenPrefixedReaderDestroy(reader);
+    close(fd);
+
+    // Writer keeps strings buffered until flushed
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert_true(fd >= 0);
+    LenPrefixedWriter *writer = LenPrefixedWriterNew(fd);
+    assert_true(LenPrefixedWriterWrite(writer, "ABC", 3));
+    assert_true(LenPrefixedWriterWrite(writer, "", 0));
+    assert_true(LenPrefixedWriterWrite(writer, "ignored", 2));
+    struct stat statbuf;
+    assert_int_equal(stat(path, &statbuf), 0);
+    assert_int_equal(statbuf.st_size, 0);
+    assert_true(LenPrefixedWriterFlush(writer));
+    LenPrefixedWriterDestroy(writer);
+    close(fd);
+
+    char buffer[64];
+    fd = open(path, O_RDONLY);
+    assert_true(fd >= 0);
+    const ssize_t n_read = FullRead(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    assert_int_equal(n_read, 38);
+    buffer[n_read] = '\0';
+    assert_string_equal(buffer, "3         ABC\n0         \n2         ig\n");
+
+    // Truncated in the middle of a prefix and in the middle of a string
+    const off_t truncated_sizes[] = { 5, 24, 35 };
+    for (size_t i = 0; i < sizeof(truncated_sizes) / sizeof(truncated_sizes[0]); ++i)
+    {
+        assert_int_equal(truncate(path, truncated_sizes[i]), 0);
+        fd = open(path, O_RDONLY);
+        assert_true(fd >= 0);
+        reader = LenPrefixedReaderNew(fd);
+        int ret;
+        do
+        {
+            ret = LenPrefixedReaderNext(reader, &string, NULL);
+        } while (ret == 1);
+        assert_int_equal(ret, -1);
+        LenPrefixedReaderDestroy(reader);
+        close(fd);
+        assert_true(SeqStringReadFile(path) == NULL);
+    }
+
+    // Errors are sticky, and reported by flush
+    fd = open(path, O_RDONLY);
+    assert_true(fd >= 0);
+    writer = LenPrefixedWriterNew(fd);
+    assert_true(LenPrefixedWriterWrite(writer, "ABC", 3));
+    assert_false(LenPrefixedWriterFlush(writer));
+    assert_false(LenPrefixedWriterWrite(writer, "ABC", 3));
+    LenPrefixedWriterDestroy(writer);
+    close(fd);
+
+    SeqDestroy(sequence);
+    unlink(path);
+}
+
+static void test_seq_string_from_string(void)
+{
+    static const struct
+    {
+        const char *str;
+        size_t num_fields;
+        const char *const fields[4];
+    } cases[] =
+    {
+        { "", 0, { NULL } },
+        { "a", 1, { "a" } },
+        { "a,b", 2, { "a", "b" } },
+        { "a,b,", 2, { "a", "b" } },
+        { ",a", 2, { "", "a" } },
+        { "a,,b", 3, { "a", "", "b" } },
+        { ",", 1, { "" } },
+        { ",,", 2, { "", "" } },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        Seq *seq = SeqStringFromString(cases[i].str, ',');
+        assert_int_equal(SeqLength(seq), cases[i].num_fields);
+        for (size_t j = 0; j < cases[i].num_fields; j++)
+        {
+            assert_string_equal(SeqAt(seq, j), cases[i].fields[j]);
+        }
+        SeqDestroy(seq);
+    }
+
+    Seq *seq = SeqStringFromString(NULL, ',');
+    assert_int_equal(SeqLength(seq), 0);
+    SeqDestroy(seq);
+}
+
 void test_sscanf(void)
 {
     // NOTE: sscanf() on HPUX does not match %z %j %zu %ju etc.
@@ -912,6 +1147,10 @@ int main()
         unit_test(test_string_serialize),
         unit_test(test_seq_string_file),
         unit_test(test_seq_string_empty_file),
+        unit_test(test_string_deserialize_slices),
+        unit_test(test_seq_string_file_slices),
+        unit_test(test_len_prefixed_reader_writer),
+        unit_test(test_seq_string_from_string),
     };
 
     return run_tests(tests);
@@ -894,7 +894,6 @@ static void test_is_string_in_array(void)
 
 static void test_encode_base64(void)
 {
-#ifdef WITH_OPENSSL
     {
         char *res = StringEncodeBase64("", 0);
         assert_string_equal("", res);
@@ -936,9 +935,6 @@ static void test_encode_base64(void)
         assert_string_equal("dGVzdA==", res);
         free(res);
     }
-
-    // valgrind leaks should be due to crypto one-time allocations
-#endif // WITH_OPENSSL
 }
 
 
@@ -1491,6 +1487,129 @@ static void test_StringFind(void)
     assert_int_equal(StringFind(str, "CF", 8888, 0), -1l);
 }
 
+static void test_StringRef_compare(void)
+{
+    const StringRef abc = StringRefFromCString("abcdef");
+    const StringRef ab = StringRefMake("abXX", 2);
+
+    assert_true(StringRefEqual(ab, StringRefFromCString("ab")));
+    assert_false(StringRefEqual(ab, abc));
+    assert_true(StringRefEqual(StringRefMake(NULL, 0), StringRefFromCString("")));
+
+    assert_true(StringRefEqualCString(ab, "ab"));
+    assert_false(StringRefEqualCString(ab, "abX"));
+    assert_false(StringRefEqualCString(ab, "a"));
+    assert_true(StringRefEqualCString(StringRefMake(NULL, 0), ""));
+    assert_false(StringRefEqualCString(StringRefMake(NULL, 0), "a"));
+    /* A NUL byte in the slice never matches, without reading past "a" */
+    assert_false(StringRefEqualCString(StringRefMake("a\0bc", 4), "a"));
+
+    assert_int_equal(StringRefCompare(ab, ab), 0);
+    assert_true(StringRefCompare(ab, abc) < 0);
+    assert_true(StringRefCompare(abc, ab) > 0);
+    assert_true(StringRefCompare(StringRefFromCString("b"), abc) > 0);
+
+    assert_true(StringRefStartsWith(abc, ab));
+    assert_false(StringRefStartsWith(ab, abc));
+    assert_true(StringRefEndsWith(abc, StringRefFromCString("ef")));
+    assert_false(StringRefEndsWith(abc, ab));
+
+    assert_int_equal(StringRefHash(ab, 0), StringHash("ab", 0));
+    assert_int_equal(StringRefHash(abc, 42), StringHash("abcdef", 42));
+}
+
+static void test_StringRef_find(void)
+{
+    const StringRef str = StringRefMake("Hello CFEngine!!!", 14);
+
+    assert_int_equal(StringRefFindChar(str, 'C'), 6);
+    assert_int_equal(StringRefFindChar(str, '!'), -1l);
+    assert_int_equal(StringRefFindChar(StringRefMake(NULL, 0), 'a'), -1l);
+
+    assert_int_equal(StringRefFind(str, StringRefFromCString("CF")), 6);
+    assert_int_equal(StringRefFind(str, StringRefFromCString("ine")), 11);
+    assert_int_equal(StringRefFind(str, StringRefFromCString("ine!")), -1l);
+    assert_int_equal(StringRefFind(str, StringRefFromCString("")), 0);
+
+    assert_true(StringRefEqualCString(StringRefSub(str, 6, 2), "CF"));
+    assert_true(StringRefEqualCString(StringRefSub(str, 6, 100), "CFEngine"));
+    assert_true(StringRefEqualCString(StringRefSub(str, 100, 2), ""));
+
+    assert_true(StringRefEqualCString(StringRefTrim(StringRefFromCString(" \t a b\n ")), "a b"));
+    assert_true(StringRefEqualCString(StringRefTrim(StringRefFromCString("  ")), ""));
+}
+
+static void test_StringRef_split(void)
+{
+    StringRef rest = StringRefFromCString("a,,bc,");
+    StringRef field;
+    const char *const expected[] = { "a", "", "bc", "" };
+    size_t n = 0;
+    while (StringRefSplitNext(&rest, ',', &field))
+    {
+        assert_true(n < 4);
+        assert_true(StringRefEqualCString(field, expected[n]));
+        n++;
+    }
+    assert_int_equal(n, 4);
+    assert_false(StringRefSplitNext(&rest, ',', &field));
+
+    rest = StringRefFromCString("");
+    assert_true(StringRefSplitNext(&rest, ',', &field));
+    assert_int_equal(field.len, 0);
+    assert_false(StringRefSplitNext(&rest, ',', &field));
+
+    /* same tokens as StringGetToken() */
+    const char *const str = "..a.b..cd.";
+    rest = StringRefFromCString(str);
+    n = 0;
+    while (StringRefNextToken(&rest, ".", &field))
+    {
+        StringRef token = StringGetToken(str, strlen(str), n, ".");
+        assert_true(StringRefEqual(field, token));
+        assert_true(field.data == token.data);
+        n++;
+    }
+    assert_int_equal(n, StringCountTokens(str, strlen(str), "."));
+    assert_int_equal(n, 3);
+
+    rest = StringRefFromCString("...");
+    assert_false(StringRefNextToken(&rest, ".", &field));
+}
+
+static void test_StringRef_to_long(void)
+{
+    const char *const inputs[] = {
+        "0", "123", "-123", "+5", "  42", "42 ", "42 x", "42x", "", " ", "-",
+        "9223372036854775807", "-9223372036854775808",
+        "9223372036854775808", "-9223372036854775809",
+        "99999999999999999999999",
+    };
+
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        if (sizeof(long) < 8 && strlen(inputs[i]) > 15)
+        {
+            continue;
+        }
+
+        long expected = -1, value = -1;
+        const int expected_ret = StringToLong(inputs[i], &expected);
+        const int ret = StringRefToLong(StringRefFromCString(inputs[i]), &value);
+        assert_int_equal(ret, expected_ret);
+        if (ret == 0)
+        {
+            assert_int_equal(value, expected);
+        }
+    }
+
+    /* not NUL-terminated */
+    long value;
+    assert_int_equal(StringRefToLong(StringRefMake("12345", 3), &value), 0);
+    assert_int_equal(value, 123);
+    assert_int_equal(StringRefToLong(StringRefMake("12345", 0), &value), -81);
+}
+
 int main()
 {
     PRINT_TEST_BANNER();
@@ -1586,6 +1705,10 @@ int main()
 
         unit_test(test_StringMatchesOption),
         unit_test(test_StringFind),
+        unit_test(test_StringRef_compare),
+        unit_test(test_StringRef_find),
+        unit_test(test_StringRef_split),
+        unit_test(test_StringRef_to_long),
     };
 
     return run_tests(tests);
@@ -0,0 +1,212 @@
+#include <test.h>
+
+#include <string_matcher.h>
+#include <alloc.h>
+
+typedef struct
+{
+    size_t pattern;
+    size_t offset;
+} Match;
+
+typedef struct
+{
+    Match matches[4096];
+    size_t n_matches;
+    size_t stop_after;
+} Matches;
+
+static bool CollectMatch(size_t pattern, size_t offset, void *data)
+{
+    Matches *const m = data;
+    assert_true(m->n_matches < sizeof(m->matches) / sizeof(m->matches[0]));
+    m->matches[m->n_matches].pattern = pattern;
+    m->matches[m->n_matches].offset = offset;
+    m->n_matches++;
+    return (m->n_matches != m->stop_after);
+}
+
+static void test_scan(void)
+{
+    const char *const patterns[] = { "he", "she", "his", "hers", "", "he" };
+    StringMatcher *matcher = StringMatcherNew(patterns, 6, false);
+    assert_true(matcher != NULL);
+    assert_int_equal(StringMatcherPatternCount(matcher), 6);
+
+    const char *const text = "ushers and his HERS";
+    Matches m = { .n_matches = 0 };
+    assert_int_equal(StringMatcherScan(matcher, text, strlen(text), CollectMatch, &m), 5);
+
+    // Ordered by end, longer first, duplicates in index order
+    const Match expected[] = { { 1, 1 }, { 0, 2 }, { 5, 2 }, { 3, 2 }, { 2, 11 } };
+    assert_int_equal(m.n_matches, 5);
+    for (size_t i = 0; i < 5; i++)
+    {
+        assert_int_equal(m.matches[i].pattern, expected[i].pattern);
+        assert_int_equal(m.matches[i].offset, expected[i].offset);
+    }
+
+    // Stopping
+    m.n_matches = 0;
+    m.stop_after = 2;
+    assert_int_equal(StringMatcherScan(matcher, text, strlen(text), CollectMatch, &m), 2);
+
+    // Length, not NUL, ends the text
+    assert_true(StringMatcherMatches(matcher, "sh\0e", 4) == false);
+    assert_true(StringMatcherMatches(matcher, "shers", 2) == false);
+    assert_true(StringMatcherMatches(matcher, "shers", 3));
+    assert_false(StringMatcherMatches(matcher, "HIS HERS", 8));
+    assert_false(StringMatcherMatches(matcher, NULL, 0));
+
+    bool matched[6];
+    assert_int_equal(StringMatcherMatchedPatterns(matcher, text, strlen(text), matched), 5);
+    assert_true(matched[0] && matched[1] && matched[2] && matched[3] && matched[5]);
+    assert_false(matched[4]);
+    assert_int_equal(StringMatcherMatchedPatterns(matcher, "hi", 2, matched), 0);
+    assert_false(matched[0]);
+
+    StringMatcherDestroy(matcher);
+}
+
+static void test_ignore_case(void)
+{
+    const char *const patterns[] = { "Error", "FAIL", "x-Y_1" };
+    StringMatcher *matcher = StringMatcherNew(patterns, 3, true);
+    assert_true(matcher != NULL);
+
+    const char *const text = "error: fAiLed on X-y_1 (ERROR)";
+    Matches m = { .n_matches = 0 };
+    assert_int_equal(StringMatcherScan(matcher, text, strlen(text), CollectMatch, &m), 4);
+    const Match expected[] = { { 0, 0 }, { 1, 7 }, { 2, 17 }, { 0, 24 } };
+    for (size_t i = 0; i < 4; i++)
+    {
+        assert_int_equal(m.matches[i].pattern, expected[i].pattern);
+        assert_int_equal(m.matches[i].offset, expected[i].offset);
+    }
+
+    // Only letters are folded
+    assert_false(StringMatcherMatches(matcher, "x-Y\x7f" "1", 5));
+    StringMatcherDestroy(matcher);
+
+    matcher = StringMatcherNew(patterns, 3, false);
+    assert_false(StringMatcherMatches(matcher, "error fail X-y_1", 16));
+    assert_true(StringMatcherMatches(matcher, "an Error", 8));
+    StringMatcherDestroy(matcher);
+}
+
+static void test_no_patterns(void)
+{
+    StringMatcher *matcher = StringMatcherNew(NULL, 0, false);
+    assert_true(matcher != NULL);
+    assert_false(StringMatcherMatches(matcher, "text", 4));
+    assert_int_equal(StringMatcherMatchedPatterns(matcher, "text", 4, NULL), 0);
+    StringMatcherDestroy(matcher);
+}
+
+static void test_binary(void)
+{
+    // All byte values but NUL, in patterns and text
+    char patterns_storage[255][3];
+    const char *patterns[255];
+    for (int i = 0; i < 255; i++)
+    {
+        patterns_storage[i][0] = (char) (i + 1);
+        patterns_storage[i][1] = (char) (255 - i);
+        patterns_storage[i][2] = '\0';
+        patterns[i] = patterns_storage[i];
+    }
+    StringMatcher *matcher = StringMatcherNew(patterns, 255, false);
+    const char text[] = { '\0', (char) 200, (char) 56, '\0' };
+    Matches m = { .n_matches = 0 };
+    assert_int_equal(StringMatcherScan(matcher, text, sizeof(text), CollectMatch, &m), 1);
+    assert_int_equal(m.matches[0].pattern, 199);
+    assert_int_equal(m.matches[0].offset, 1);
+    StringMatcherDestroy(matcher);
+}
+
+/* Compare with a naive search on random patterns over a small alphabet,
+ * where overlaps and shared suffixes are frequent. Half of the rounds use
+ * patterns with few start bytes and sparse matches, which are skipped to. */
+static void test_random(void)
+{
+    srand(42);
+    for (int round = 0; round < 100; round++)
+    {
+        const bool ignore_case = (round % 2 == 1);
+        const bool few_start_bytes = (round % 4 >= 2);
+        const size_t n_patterns = 1 + rand() % 40;
+        char *patterns[40];
+        for (size_t i = 0; i < n_patterns; i++)
+        {
+            const size_t len = 1 + rand() % 6;
+            patterns[i] = xmalloc(len + 1);
+            for (size_t j = 0; j < len; j++)
+            {
+                patterns[i][j] = few_start_bytes ? "aB"[rand() % 2] : "abcAB"[rand() % 5];
+            }
+            patterns[i][len] = '\0';
+        }
+        char text[300];
+        for (size_t j = 0; j < sizeof(text); j++)
+        {
+            text[j] = (few_start_bytes && rand() % 4 != 0) ? 'x' : "abcABx"[rand() % 6];
+        }
+
+        StringMatcher *matcher = StringMatcherNew((const char *const *) patterns,
+                                                  n_patterns, ignore_case);
+        Matches m = { .n_matches = 0 };
+        StringMatcherScan(matcher, text, sizeof(text), CollectMatch, &m);
+
+        size_t n_expected = 0;
+        for (size_t offset = 0; offset < sizeof(text); offset++)
+        {
+            for (size_t i = 0; i < n_patterns; i++)
+            {
+                const size_t len = strlen(patterns[i]);
+                if (offset + len > sizeof(text))
+                {
+                    continue;
+                }
+                const int cmp = ignore_case ? strncasecmp(text + offset, patterns[i], len)
+                                            : strncmp(text + offset, patterns[i], len);
+                if (cmp != 0)
+                {
+                    continue;
+                }
+                n_expected++;
+                bool found = false;
+                for (size_t k = 0; k < m.n_matches; k++)
+                {
+                    if (m.matches[k].pattern == i && m.matches[k].offset == offset)
+                    {
+                        found = true;
+                    }
+                }
+                assert_true(found);
+            }
+        }
+        assert_int_equal(m.n_matches, n_expected);
+        assert_int_equal(StringMatcherMatches(matcher, text, sizeof(text)), n_expected > 0);
+
+        StringMatcherDestroy(matcher);
+        for (size_t i = 0; i < n_patterns; i++)
+        {
+            free(patterns[i]);
+        }
+    }
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_scan),
+        unit_test(test_ignore_case),
+        unit_test(test_no_patterns),
+        unit_test(test_binary),
+        unit_test(test_random),
+    };
+
+    return run_tests(tests);
+}
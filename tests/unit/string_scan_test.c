@@ -0,0 +1,160 @@
+#include <test.h>
+
+#include <string_scan.h>
+
+static const char *const IMPLEMENTATIONS[] = { "scalar", "sse2", "avx2", "neon" };
+
+static const char *NaiveFind(const char *haystack, size_t haystack_len,
+                             const char *needle, size_t needle_len,
+                             bool ignore_case)
+{
+    for (size_t i = 0; i + needle_len <= haystack_len; i++)
+    {
+        size_t j = 0;
+        while (j < needle_len &&
+               (ignore_case ?
+                (tolower((unsigned char) haystack[i + j]) == tolower((unsigned char) needle[j])) :
+                (haystack[i + j] == needle[j])))
+        {
+            j++;
+        }
+        if (j == needle_len)
+        {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+/* Random data from a small alphabet (so that there are many partial
+ * matches), including upper case, high bytes and NULs. */
+static void FillRandom(char *data, size_t len)
+{
+    static const char alphabet[] = "abcAB0129 ~\x7f\x80\xff";
+    for (size_t i = 0; i < len; i++)
+    {
+        data[i] = alphabet[rand() % sizeof(alphabet)];
+    }
+}
+
+static void CheckImplementation(void)
+{
+    char haystack[300];
+    char needle[40];
+
+    for (int iteration = 0; iteration < 20000; iteration++)
+    {
+        const size_t haystack_len = rand() % sizeof(haystack);
+        const size_t needle_len = rand() % ((iteration % 10 == 0) ? sizeof(needle) : 5);
+        FillRandom(haystack, haystack_len);
+        FillRandom(needle, needle_len);
+        if (needle_len <= haystack_len && rand() % 2 == 0)
+        {
+            /* plant a (case changed) occurrence */
+            const size_t pos = rand() % (haystack_len - needle_len + 1);
+            for (size_t i = 0; i < needle_len; i++)
+            {
+                haystack[pos + i] = (rand() % 2) ? toupper((unsigned char) needle[i]) : needle[i];
+            }
+        }
+
+        assert_true(StringScanFind(haystack, haystack_len, needle, needle_len) ==
+                    NaiveFind(haystack, haystack_len, needle, needle_len, false));
+        assert_true(StringScanFindCaseInsensitive(haystack, haystack_len, needle, needle_len) ==
+                    NaiveFind(haystack, haystack_len, needle, needle_len, true));
+
+        size_t count = 0;
+        for (size_t i = 0; i < haystack_len; i++)
+        {
+            count += (haystack[i] == 'a');
+        }
+        assert_int_equal(StringScanCountChar(haystack, haystack_len, 'a'), count);
+
+        char chars[STRING_SCAN_ANY_CHAR_MAX];
+        const size_t n_chars = rand() % (STRING_SCAN_ANY_CHAR_MAX + 1);
+        FillRandom(chars, n_chars);
+        size_t first = 0;
+        while (first < haystack_len && memchr(chars, haystack[first], n_chars) == NULL)
+        {
+            first++;
+        }
+        assert_int_equal(StringScanFindAnyChar(haystack, haystack_len, chars, n_chars), first);
+
+        /* spans ending at a random position */
+        const size_t stop = rand() % (haystack_len + 1);
+        for (size_t i = 0; i < haystack_len; i++)
+        {
+            haystack[i] = '0' + (i % 10);
+        }
+        if (stop < haystack_len)
+        {
+            haystack[stop] = (rand() % 2) ? '/' : ':';
+        }
+        assert_int_equal(StringScanSpanDigits(haystack, haystack_len), stop);
+
+        for (size_t i = 0; i < haystack_len; i++)
+        {
+            haystack[i] = ' ' + (i % 95);
+        }
+        if (stop < haystack_len)
+        {
+            static const char non_printable[] = { '\x1f', '\x7f', '\x80', '\xff', '\0', '\n' };
+            haystack[stop] = non_printable[rand() % sizeof(non_printable)];
+        }
+        assert_int_equal(StringScanSpanPrintable(haystack, haystack_len), stop);
+    }
+
+    /* NULL with zero length */
+    assert_true(StringScanFind(NULL, 0, "a", 1) == NULL);
+    assert_true(StringScanFindCaseInsensitive(NULL, 0, "a", 1) == NULL);
+    assert_int_equal(StringScanCountChar(NULL, 0, 'a'), 0);
+    assert_int_equal(StringScanFindAnyChar(NULL, 0, "ab", 2), 0);
+    assert_int_equal(StringScanSpanDigits(NULL, 0), 0);
+    assert_int_equal(StringScanSpanPrintable(NULL, 0), 0);
+}
+
+static void test_implementations(void)
+{
+    const char *const default_impl = StringScanImplementation();
+    assert_true(default_impl != NULL);
+
+    for (size_t i = 0; i < sizeof(IMPLEMENTATIONS) / sizeof(IMPLEMENTATIONS[0]); i++)
+    {
+        if (!StringScanSetImplementation(IMPLEMENTATIONS[i]))
+        {
+            continue;
+        }
+        assert_string_equal(StringScanImplementation(), IMPLEMENTATIONS[i]);
+        srand(42);
+        CheckImplementation();
+    }
+
+    assert_false(StringScanSetImplementation("nosuch"));
+    assert_true(StringScanSetImplementation(default_impl));
+}
+
+static void test_find(void)
+{
+    const char *str = "Hello CFEngine, hello cfengine";
+    const size_t len = strlen(str);
+
+    assert_true(StringScanFind(str, len, "CFEngine", 8) == str + 6);
+    assert_true(StringScanFind(str, len, "cfengine", 8) == str + 22);
+    assert_true(StringScanFind(str, len, "cfenginE", 8) == NULL);
+    assert_true(StringScanFind(str, len, "", 0) == str);
+    assert_true(StringScanFindCaseInsensitive(str, len, "HELLO", 5) == str);
+    assert_true(StringScanFindCaseInsensitive(str + 1, len - 1, "HELLO", 5) == str + 16);
+    assert_true(StringScanFindCaseInsensitive(str, len, "cfenginE", 8) == str + 6);
+}
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    const UnitTest tests[] =
+    {
+        unit_test(test_find),
+        unit_test(test_implementations),
+    };
+
+    return run_tests(tests);
+}
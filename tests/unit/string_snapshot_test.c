@@ -0,0 +1,225 @@
+#include <test.h>
+
+#include <string_snapshot.h>
+#include <string_lib.h>
+#include <file_lib.h>
+#include <alloc.h>
+
+static char snapshot_dir[] = "/tmp/string_snapshot_testXXXXXX";
+static char *snapshot_path = NULL;
+
+static void test_set_snapshot(void)
+{
+    StringSet *set = StringSetNew();
+    for (int i = 0; i < 1000; i++)
+    {
+        StringSetAddF(set, "element %d", i);
+    }
+    StringSetAdd(set, xstrdup(""));
+    assert_true(StringSetWriteSnapshot(set, snapshot_path));
+
+    StringSnapshot *snapshot = StringSnapshotOpen(snapshot_path);
+    assert_true(snapshot != NULL);
+    assert_false(StringSnapshotIsMap(snapshot));
+    assert_int_equal(StringSnapshotSize(snapshot), 1001);
+
+    StringSetIterator iter = StringSetIteratorInit(set);
+    const char *element;
+    while ((element = StringSetIteratorNext(&iter)) != NULL)
+    {
+        assert_true(StringSnapshotContains(snapshot, element));
+        assert_true(StringSnapshotGet(snapshot, element) == NULL);
+    }
+    assert_false(StringSnapshotContains(snapshot, "element 1000"));
+    assert_false(StringSnapshotContains(snapshot, "element"));
+    assert_false(StringSnapshotContains(snapshot, "element 10 "));
+
+    // Keys don't have to be NUL-terminated
+    const char *value = "unchanged";
+    assert_true(StringSnapshotLookup(snapshot, "element 123456", 11, &value));
+    assert_true(value == NULL);
+    assert_false(StringSnapshotLookup(snapshot, "element 123456", 14, NULL));
+
+    // Sorted by key
+    const char *previous = NULL;
+    for (size_t i = 0; i < StringSnapshotSize(snapshot); i++)
+    {
+        const char *key;
+        assert_true(StringSnapshotAt(snapshot, i, &key, NULL));
+        assert_true(StringSetContains(set, key));
+        if (previous != NULL)
+        {
+            assert_true(strcmp(previous, key) < 0);
+        }
+        previous = key;
+    }
+    assert_string_equal(previous, "element 999");
+
+    StringSnapshotClose(snapshot);
+    StringSetDestroy(set);
+    unlink(snapshot_path);
+}
+
+static void test_map_snapshot(void)
+{
+    StringMap *map = StringMapNew();
+    for (int i = 0; i < 500; i++)
+    {
+        StringMapInsert(map, StringFormat("key%d", i), StringFormat("value%d", i * 2));
+    }
+    StringMapInsert(map, xstrdup("empty"), xstrdup(""));
+    assert_true(StringMapWriteSnapshot(map, snapshot_path));
+
+    StringSnapshot *snapshot = StringSnapshotOpen(snapshot_path);
+    assert_true(snapshot != NULL);
+    assert_true(StringSnapshotIsMap(snapshot));
+    assert_int_equal(StringSnapshotSize(snapshot), 501);
+
+    assert_string_equal(StringSnapshotGet(snapshot, "key0"), "value0");
+    assert_string_equal(StringSnapshotGet(snapshot, "key499"), "value998");
+    assert_string_equal(StringSnapshotGet(snapshot, "empty"), "");
+    assert_true(StringSnapshotGet(snapshot, "key500") == NULL);
+    assert_false(StringSnapshotContains(snapshot, "key500"));
+
+    for (size_t i = 0; i < StringSnapshotSize(snapshot); i++)
+    {
+        const char *key, *value;
+        assert_true(StringSnapshotAt(snapshot, i, &key, &value));
+        assert_true(StringMapHasKey(map, key));
+        assert_string_equal(value, StringMapGet(map, key));
+    }
+
+    // Replacing the file doesn't affect the open snapshot
+    StringMapClear(map);
+    StringMapInsert(map, xstrdup("key0"), xstrdup("new"));
+    assert_true(StringMapWriteSnapshot(map, snapshot_path));
+    assert_string_equal(StringSnapshotGet(snapshot, "key0"), "value0");
+    assert_string_equal(StringSnapshotGet(snapshot, "key1"), "value2");
+
+    StringSnapshot *replaced = StringSnapshotOpen(snapshot_path);
+    assert_true(replaced != NULL);
+    assert_int_equal(StringSnapshotSize(replaced), 1);
+    assert_string_equal(StringSnapshotGet(replaced, "key0"), "new");
+    assert_false(StringSnapshotContains(replaced, "key1"));
+
+    StringSnapshotClose(replaced);
+    StringSnapshotClose(snapshot);
+    StringMapDestroy(map);
+    unlink(snapshot_path);
+}
+
+static void test_empty_snapshot(void)
+{
+    StringSet *set = StringSetNew();
+    assert_true(StringSetWriteSnapshot(set, snapshot_path));
+    StringSnapshot *snapshot = StringSnapshotOpen(snapshot_path);
+    assert_true(snapshot != NULL);
+    assert_int_equal(StringSnapshotSize(snapshot), 0);
+    assert_false(StringSnapshotContains(snapshot, ""));
+    assert_false(StringSnapshotContains(snapshot, "a"));
+    StringSnapshotClose(snapshot);
+    StringSetDestroy(set);
+    unlink(snapshot_path);
+}
+
+#ifndef __MINGW32__
+static void test_invalid_snapshot(void)
+{
+    assert_true(StringSnapshotOpen(snapshot_path) == NULL);
+
+    StringMap *map = StringMapNew();
+    StringMapInsert(map, xstrdup("a"), xstrdup("1"));
+    StringMapInsert(map, xstrdup("b"), xstrdup("2"));
+    assert_true(StringMapWriteSnapshot(map, snapshot_path));
+    StringMapDestroy(map);
+
+    struct stat sb;
+    assert_int_equal(stat(snapshot_path, &sb), 0);
+
+    // Corrupted counts and offsets in the header (after the magic, version
+    // and flags), including values that wrap when added
+    const uint64_t bad_values[] = {
+        UINT64_MAX, UINT64_MAX - 7, UINT64_C(1) << 63, (uint64_t) sb.st_size + 8,
+    };
+    for (off_t field = 16; field < 56; field += 8)
+    {
+        int fd = open(snapshot_path, O_RDWR);
+        assert_true(fd >= 0);
+        uint64_t saved;
+        assert_int_equal(pread(fd, &saved, sizeof(saved), field), sizeof(saved));
+        for (size_t i = 0; i < sizeof(bad_values) / sizeof(bad_values[0]); i++)
+        {
+            assert_int_equal(pwrite(fd, &bad_values[i], sizeof(uint64_t), field),
+                             sizeof(uint64_t));
+            assert_true(StringSnapshotOpen(snapshot_path) == NULL);
+        }
+        assert_int_equal(pwrite(fd, &saved, sizeof(saved), field), sizeof(saved));
+        close(fd);
+    }
+    StringSnapshot *restored = StringSnapshotOpen(snapshot_path);
+    assert_true(restored != NULL);
+    assert_string_equal(StringSnapshotGet(restored, "a"), "1");
+    StringSnapshotClose(restored);
+
+    // Corrupted key offset of the first entry, which comes after the
+    // 64 bytes header: found at open, but not its key
+    int fd = open(snapshot_path, O_RDWR);
+    assert_true(fd >= 0);
+    const uint64_t bad_offset = 1000000;
+    assert_int_equal(pwrite(fd, &bad_offset, sizeof(bad_offset), 64), sizeof(bad_offset));
+    close(fd);
+
+    StringSnapshot *snapshot = StringSnapshotOpen(snapshot_path);
+    assert_true(snapshot != NULL);
+    assert_false(StringSnapshotContains(snapshot, "a"));
+    assert_string_equal(StringSnapshotGet(snapshot, "b"), "2");
+    const char *key;
+    assert_false(StringSnapshotAt(snapshot, 0, &key, NULL));
+    assert_true(StringSnapshotAt(snapshot, 1, &key, NULL));
+    assert_string_equal(key, "b");
+    StringSnapshotClose(snapshot);
+
+    // Truncated
+    assert_int_equal(truncate(snapshot_path, sb.st_size - 1), 0);
+    assert_true(StringSnapshotOpen(snapshot_path) == NULL);
+    assert_int_equal(truncate(snapshot_path, 10), 0);
+    assert_true(StringSnapshotOpen(snapshot_path) == NULL);
+
+    // Not a snapshot
+    fd = open(snapshot_path, O_WRONLY | O_TRUNC);
+    assert_true(fd >= 0);
+    char garbage[256];
+    memset(garbage, 'x', sizeof(garbage));
+    assert_int_equal(FullWrite(fd, garbage, sizeof(garbage)), sizeof(garbage));
+    close(fd);
+    assert_true(StringSnapshotOpen(snapshot_path) == NULL);
+
+    unlink(snapshot_path);
+}
+#endif
+
+int main()
+{
+    PRINT_TEST_BANNER();
+    if (mkdtemp(snapshot_dir) == NULL)
+    {
+        return 1;
+    }
+    xasprintf(&snapshot_path, "%s/snapshot", snapshot_dir);
+
+    const UnitTest tests[] =
+    {
+        unit_test(test_set_snapshot),
+        unit_test(test_map_snapshot),
+        unit_test(test_empty_snapshot),
+#ifndef __MINGW32__
+        unit_test(test_invalid_snapshot),
+#endif
+    };
+    const int ret = run_tests(tests);
+
+    unlink(snapshot_path);
+    free(snapshot_path);
+    rmdir(snapshot_dir);
+    return ret;
+}
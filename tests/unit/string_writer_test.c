@@ -76,6 +76,58 @@ void test_release_string(void)
     free(ret);
 }
 
+void test_write_bytes_string_buffer(void)
+{
+    Writer *w = StringWriter();
+
+    WriterWriteBytes(w, "12\0" "3", 4);
+    WriterWriteLen(w, "45\0" "6", 4);
+
+    assert_int_equal(StringWriterLength(w), 6);
+    assert_memory_equal(StringWriterData(w), "12\0" "345", 7);
+
+    WriterClose(w);
+}
+
+void test_reserve_commit_string_buffer(void)
+{
+    Writer *w = StringWriter();
+
+    WriterWrite(w, "123");
+    char *space = WriterReserve(w, 1000);
+    memset(space, 'x', 1000);
+    WriterCommit(w, 2);
+
+    WriterReserve(w, 10);
+    WriterCommit(w, 0);
+
+    WriterWrite(w, "456");
+
+    assert_int_equal(StringWriterLength(w), 8);
+    assert_string_equal(StringWriterData(w), "123xx456");
+
+    WriterClose(w);
+}
+
+void test_write_f_string_buffer(void)
+{
+    Writer *w = StringWriter();
+
+    WriterWriteF(w, "%d-%s", 123, "abc");
+    assert_string_equal(StringWriterData(w), "123-abc");
+
+    /* longer than the free space */
+    char long_string[5000];
+    memset(long_string, 'a', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+    WriterWriteF(w, "[%s]", long_string);
+    assert_int_equal(StringWriterLength(w), 7 + 2 + sizeof(long_string) - 1);
+    assert_int_equal(StringWriterData(w)[7], '[');
+    assert_int_equal(StringWriterData(w)[StringWriterLength(w) - 1], ']');
+
+    WriterClose(w);
+}
+
 int main()
 {
     PRINT_TEST_BANNER();
@@ -87,6 +139,9 @@ int main()
         unit_test(test_multiwrite_string_buffer),
         unit_test(test_write_char_string_buffer),
         unit_test(test_release_string),
+        unit_test(test_write_bytes_string_buffer),
+        unit_test(test_reserve_commit_string_buffer),
+        unit_test(test_write_f_string_buffer),
     };
 
     return run_tests(tests);
@@ -1,5 +1,6 @@
 #include <version_comparison.h>
 #include <test.h>
+#include <sequence.h>
 
 static void test_CompareVersion(void)
 {
@@ -70,6 +71,217 @@ static void test_CompareVersionExpression(void)
     assert_true(BOOLEAN_ERROR == CompareVersionExpression("1", "2", "3"));
 }
 
+static int CompareStrings(const char *a, const char *b, VersionScheme scheme)
+{
+    Version *x = VersionParse(a, scheme);
+    Version *y = VersionParse(b, scheme);
+    assert_true(x != NULL);
+    assert_true(y != NULL);
+    assert_string_equal(VersionString(x), a);
+
+    const int r = VersionCompare(x, y);
+    const int reverse = VersionCompare(y, x);
+    assert_int_equal(r < 0, reverse > 0);
+    assert_int_equal(r == 0, reverse == 0);
+
+    VersionDestroy(x);
+    VersionDestroy(y);
+    return (r > 0) - (r < 0);
+}
+
+/* Each version is older than the next one */
+static void CheckAscending(const char *const *versions, size_t n, VersionScheme scheme)
+{
+    for (size_t i = 0; i + 1 < n; i++)
+    {
+        assert_int_equal(CompareStrings(versions[i], versions[i + 1], scheme), -1);
+        assert_int_equal(CompareStrings(versions[i], versions[i], scheme), 0);
+    }
+}
+
+#define CHECK_ASCENDING(versions, scheme) \
+    CheckAscending(versions, sizeof(versions) / sizeof(versions[0]), scheme)
+
+static void test_VersionSemver(void)
+{
+    /* The example from the semver 2.0.0 specification */
+    const char *const ascending[] = {
+        "0.9.9", "1.0.0-alpha", "1.0.0-alpha.1", "1.0.0-alpha.beta", "1.0.0-beta",
+        "1.0.0-beta.2", "1.0.0-beta.11", "1.0.0-rc.1", "1.0.0", "1.0.1", "1.2",
+        "1.10.0", "2", "2.0.0.1", "18446744073709551616.0",
+        "99999999999999999999999.0",
+    };
+    CHECK_ASCENDING(ascending, VERSION_SCHEME_SEMVER);
+
+    assert_int_equal(CompareStrings("1.2", "1.2.0", VERSION_SCHEME_SEMVER), 0);
+    assert_int_equal(CompareStrings("v1.2.3", "1.2.3", VERSION_SCHEME_SEMVER), 0);
+    assert_int_equal(CompareStrings("1.2.3+build.5", "1.2.3", VERSION_SCHEME_SEMVER), 0);
+    assert_int_equal(CompareStrings("1.2.3-rc.1+b", "1.2.3-rc.1", VERSION_SCHEME_SEMVER), 0);
+    assert_int_equal(CompareStrings("1.02.3", "1.2.3", VERSION_SCHEME_SEMVER), 0);
+
+    const char *const invalid[] = {
+        "", "v", "a.b", "1.", ".1", "1..2", "1.2.3-", "1.2.3+", "1.2.3-a..b",
+        "1.2.3-a_b", "1.2.3 ", " 1.2.3", "1.2.3+a..b", "1.2.3x",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        assert_true(VersionParse(invalid[i], VERSION_SCHEME_SEMVER) == NULL);
+    }
+}
+
+static void test_VersionDebian(void)
+{
+    const char *const ascending[] = {
+        "1.0~~", "1.0~~a", "1.0~", "1.0", "1.0-0.1", "1.0-1", "1.0-1.1",
+        "1.0a", "1.0+b", "1.0.1", "1.2.3-0ubuntu1", "1.2.3-1", "7.6-0",
+        "7.6p2-4", "10", "1:0.1", "1:0.2~rc1", "1:0.2", "2:0",
+    };
+    CHECK_ASCENDING(ascending, VERSION_SCHEME_DEBIAN);
+
+    assert_int_equal(CompareStrings("0.1", "00.1", VERSION_SCHEME_DEBIAN), 0);
+    assert_int_equal(CompareStrings("0:1.0", "1.0", VERSION_SCHEME_DEBIAN), 0);
+    assert_int_equal(CompareStrings("1.0-0", "1.0", VERSION_SCHEME_DEBIAN), 0);
+    assert_int_equal(CompareStrings("1.0-2-1", "1.0-2-2", VERSION_SCHEME_DEBIAN), -1);
+
+    const char *const invalid[] = { "", "-1", "1.0-", "a:1.0", ":1.0", "1.0 1", "1:" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        assert_true(VersionParse(invalid[i], VERSION_SCHEME_DEBIAN) == NULL);
+    }
+}
+
+static void test_VersionLongParts(void)
+{
+    /* Alternating digits and letters give the most tokens per byte, in
+     * both the upstream version and the revision */
+    for (size_t main_len = 1; main_len <= 32; main_len++)
+    {
+        for (size_t revision_len = 1; revision_len <= 32; revision_len++)
+        {
+            char str[80];
+            size_t n = 0;
+            for (size_t i = 0; i < main_len; i++)
+            {
+                str[n++] = (i % 2 == 0) ? '1' : 'a';
+            }
+            str[n++] = '-';
+            for (size_t i = 0; i < revision_len; i++)
+            {
+                str[n++] = (i % 2 == 0) ? '1' : 'a';
+            }
+            str[n] = '\0';
+
+            Version *debian = VersionParse(str, VERSION_SCHEME_DEBIAN);
+            Version *rpm = VersionParse(str, VERSION_SCHEME_RPM);
+            assert_true(debian != NULL);
+            assert_true(rpm != NULL);
+            assert_string_equal(VersionString(debian), str);
+            assert_int_equal(VersionCompare(debian, debian), 0);
+            assert_int_equal(VersionCompare(rpm, rpm), 0);
+            VersionDestroy(debian);
+            VersionDestroy(rpm);
+        }
+    }
+}
+
+static void test_VersionRPM(void)
+{
+    /* Mostly from rpm's own rpmvercmp tests */
+    const char *const ascending[] = {
+        "1.0~rc1~git123", "1.0~rc1", "1.0~rc2", "1.0", "1.0^", "1.0^git1~pre",
+        "1.0^git1", "1.0^git2", "1.0a", "1.0aa", "1.0.1", "1.01.1", "2.0",
+        "2.0.1", "2.0.1a", "4.999.9", "5.0", "5.5p1", "5.5p2", "5.5p10", "5.6p1",
+        "6.0", "6.0.rc1", "10a1", "10b2", "10xyz", "10.1xyz", "20101121",
+        "20101122", "1:1.0", "1:1.0-1", "1:1.0-2", "1:1.0-10",
+    };
+    CHECK_ASCENDING(ascending, VERSION_SCHEME_RPM);
+
+    assert_int_equal(CompareStrings("xyz.4", "8", VERSION_SCHEME_RPM), -1);
+    assert_int_equal(CompareStrings("xyz10", "xyz10.1", VERSION_SCHEME_RPM), -1);
+    assert_int_equal(CompareStrings("10.0001", "10.1", VERSION_SCHEME_RPM), 0);
+    assert_int_equal(CompareStrings("2.0", "2_0", VERSION_SCHEME_RPM), 0);
+    assert_int_equal(CompareStrings("1.0a", "1.0.a", VERSION_SCHEME_RPM), 0);
+    assert_int_equal(CompareStrings("1.0^git1", "1.01", VERSION_SCHEME_RPM), -1);
+    assert_int_equal(CompareStrings("1.0^20160101", "1.0.1", VERSION_SCHEME_RPM), -1);
+}
+
+static void test_VersionSort(void)
+{
+    const char *const sorted[] = {
+        "0.1.0", "0.9.0-rc.1", "0.9.0", "1.0.0-alpha", "1.0.0", "1.2.0", "1.10.0",
+        "3.15.0", "3.18.1", "10.0.0",
+    };
+    const size_t n = sizeof(sorted) / sizeof(sorted[0]);
+
+    Seq *seq = SeqNew(n, VersionDestroy);
+    for (size_t i = 0; i < n; i++)
+    {
+        /* Insert in a shuffled order */
+        SeqAppend(seq, VersionParse(sorted[(i * 7) % n], VERSION_SCHEME_SEMVER));
+    }
+    SeqSort(seq, VersionCompareSeq, NULL);
+    for (size_t i = 0; i < n; i++)
+    {
+        assert_string_equal(VersionString(SeqAt(seq, i)), sorted[i]);
+    }
+    SeqDestroy(seq);
+}
+
+static bool ConstraintMatches(const char *expression, const char *version_str)
+{
+    VersionConstraint *constraint = VersionConstraintParse(expression, VERSION_SCHEME_SEMVER);
+    Version *version = VersionParse(version_str, VERSION_SCHEME_SEMVER);
+    assert_true(constraint != NULL);
+    assert_true(version != NULL);
+
+    const bool matches = VersionConstraintMatches(constraint, version);
+    VersionConstraintDestroy(constraint);
+    VersionDestroy(version);
+    return matches;
+}
+
+static void test_VersionConstraint(void)
+{
+    assert_true(ConstraintMatches("1.2.3", "1.2.3"));
+    assert_true(ConstraintMatches("= 1.2.3", "1.2.3"));
+    assert_true(ConstraintMatches("==1.2", "1.2.0"));
+    assert_false(ConstraintMatches("== 1.2.3", "1.2.4"));
+    assert_true(ConstraintMatches("!= 1.2.3", "1.2.4"));
+    assert_false(ConstraintMatches("!=1.2.3", "1.2.3"));
+    assert_true(ConstraintMatches(">1.2.3", "1.10.0"));
+    assert_false(ConstraintMatches(">1.2.3", "1.2.3"));
+    assert_true(ConstraintMatches(">=1.2.3", "1.2.3"));
+    assert_true(ConstraintMatches("< 2", "1.99.99"));
+    assert_false(ConstraintMatches("< 2", "2.0.0"));
+    assert_true(ConstraintMatches("< 2", "2.0.0-rc.1"));
+    assert_true(ConstraintMatches("<= 2", "2.0.0"));
+
+    const char *const range = " >= 1.2 , < 2.0 || = 3.0.1 || >= 4 ";
+    assert_false(ConstraintMatches(range, "1.1.9"));
+    assert_true(ConstraintMatches(range, "1.2.0"));
+    assert_true(ConstraintMatches(range, "1.9.9"));
+    assert_false(ConstraintMatches(range, "2.0.0"));
+    assert_false(ConstraintMatches(range, "3.0.0"));
+    assert_true(ConstraintMatches(range, "3.0.1"));
+    assert_false(ConstraintMatches(range, "3.5.0"));
+    assert_true(ConstraintMatches(range, "4.0.0"));
+
+    const char *const invalid[] = {
+        "", ">=", "1.2,", ",1.2", "1.2 | 1.3", "1.2 ||", ">= x", "=> 1.2", "1.2 1.3",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        assert_true(VersionConstraintParse(invalid[i], VERSION_SCHEME_SEMVER) == NULL);
+    }
+
+    /* Same as the string-based interface */
+    VersionConstraint *constraint = VersionConstraintParse(">= 3.15", VERSION_SCHEME_DEBIAN);
+    Version *version = VersionParse("1:3.15.0-1", VERSION_SCHEME_DEBIAN);
+    assert_true(VersionConstraintMatches(constraint, version));
+    VersionDestroy(version);
+    VersionConstraintDestroy(constraint);
+}
+
 int main()
 {
     PRINT_TEST_BANNER();
@@ -77,6 +289,12 @@ int main()
     {
         unit_test(test_CompareVersion),
         unit_test(test_CompareVersionExpression),
+        unit_test(test_VersionSemver),
+        unit_test(test_VersionDebian),
+        unit_test(test_VersionLongParts),
+        unit_test(test_VersionRPM),
+        unit_test(test_VersionSort),
+        unit_test(test_VersionConstraint),
     };
 
     return run_tests(tests);